@@ -80,6 +80,7 @@ rm -rf $RPM_BUILD_ROOT
 %defattr(-,root,root)
 %doc README COPYING NEWS
 %{_bindir}/cpuinfo
+%{_bindir}/cpuinfo-fleet
 %if %{build_shared}
 %{_libdir}/libcpuinfo.so.*
 %endif
@@ -0,0 +1,1203 @@
+/*
+ *  bench.c - Library benchmarks
+ *
+ *  cpuinfo (C) 2006-2007 Gwenole Beauchesne
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#define _GNU_SOURCE 1
+#include "sysdeps.h"
+#include <stdarg.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <ftw.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/stat.h>
+#include "cpuinfo.h"
+#include "writer.h"
+
+#define N_ITERATIONS (1 << 22)
+
+// Features checked in turn, a mix of present and absent ones
+static const int bench_features[4] = {
+  CPUINFO_FEATURE_SIMD,
+  CPUINFO_FEATURE_POPCOUNT,
+  CPUINFO_FEATURE_CRYPTO,
+#if defined(__i386__) || defined(__x86_64__)
+  CPUINFO_FEATURE_X86_SSE2,
+#elif defined(__ppc__) || defined(__ppc64__)
+  CPUINFO_FEATURE_PPC_VMX,
+#elif defined(__arm__)
+  CPUINFO_FEATURE_ARM_NEON,
+#elif defined(__aarch64__)
+  CPUINFO_FEATURE_AARCH64_ASIMD,
+#else
+  CPUINFO_FEATURE_BIG_ENDIAN,
+#endif
+};
+
+static __thread volatile int bench_sink;	// per thread, for the harness threads
+
+// Get current value of nanosecond timer
+static uint64_t get_ticks_nsec(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+static void print_result(const char *name, uint64_t nsec, int count)
+{
+  printf("  %-40s %10.2f ns\n", name, (double)nsec / count);
+}
+
+static void bench_has_feature(cpuinfo_t *cip)
+{
+  int i, hits;
+  uint64_t start;
+
+  printf("Feature checks (per check)\n");
+
+  cpuinfo_has_feature(cip, bench_features[0]);
+  hits = 0;
+  start = get_ticks_nsec();
+  for (i = 0; i < N_ITERATIONS; i++)
+	hits += cpuinfo_has_feature(cip, bench_features[i & 3]);
+  print_result("cpuinfo_has_feature()", get_ticks_nsec() - start, N_ITERATIONS);
+  bench_sink = hits;
+
+  hits = 0;
+  start = get_ticks_nsec();
+  for (i = 0; i < N_ITERATIONS; i++)
+	hits += cpuinfo_has_feature(cip, CPUINFO_FEATURE_64BIT);
+  print_result("cpuinfo_has_feature(64BIT)", get_ticks_nsec() - start, N_ITERATIONS);
+  bench_sink = hits;
+
+  start = get_ticks_nsec();
+  hits = cpuinfo_has_feature_fast(bench_features[0]);
+  print_result("cpuinfo_has_feature_fast(), first call", get_ticks_nsec() - start, 1);
+  bench_sink = hits;
+
+  hits = 0;
+  start = get_ticks_nsec();
+  for (i = 0; i < N_ITERATIONS; i++)
+	hits += cpuinfo_has_feature_fast(bench_features[i & 3]);
+  print_result("cpuinfo_has_feature_fast()", get_ticks_nsec() - start, N_ITERATIONS);
+  bench_sink = hits;
+
+  hits = 0;
+  start = get_ticks_nsec();
+  for (i = 0; i < N_ITERATIONS; i++)
+	hits += cpuinfo_has_feature_fast(CPUINFO_FEATURE_64BIT);
+  print_result("cpuinfo_has_feature_fast(64BIT)", get_ticks_nsec() - start, N_ITERATIONS);
+  bench_sink = hits;
+}
+
+static void bench_frequency(void)
+{
+  uint64_t start;
+  int freq;
+
+  printf("Frequency determination (per descriptor)\n");
+
+  cpuinfo_t *cip = cpuinfo_new();
+  if (cip == NULL)
+	return;
+  start = get_ticks_nsec();
+  freq = cpuinfo_get_frequency(cip);
+  print_result("cpuinfo_get_frequency()", get_ticks_nsec() - start, 1);
+  printf("  %-40s %d MHz, %s, %d%%\n", "result", freq,
+		 cpuinfo_string_of_frequency_source(cpuinfo_get_frequency_source(cip)),
+		 cpuinfo_get_frequency_confidence(cip));
+  cpuinfo_destroy(cip);
+}
+
+static void bench_probe(void)
+{
+  uint64_t start;
+  int heterogeneity;
+
+  printf("Per-CPU probing (per descriptor)\n");
+
+  cpuinfo_t *cip = cpuinfo_new();
+  if (cip == NULL)
+	return;
+  cpuinfo_get_topology(cip);
+  start = get_ticks_nsec();
+  heterogeneity = cpuinfo_get_heterogeneity(cip);
+  print_result("cpuinfo_get_heterogeneity()", get_ticks_nsec() - start, 1);
+  printf("  %-40s %d logical CPUs, heterogeneity %d\n", "result",
+		 cpuinfo_get_topology(cip)->n_cpus, heterogeneity);
+  cpuinfo_destroy(cip);
+}
+
+static void bench_descriptor(void)
+{
+  uint64_t start;
+  int i, n_caches = 0;
+  const int n_iterations = 1000;
+
+  printf("Descriptor lifetime (per descriptor)\n");
+
+  start = get_ticks_nsec();
+  for (i = 0; i < n_iterations; i++) {
+	cpuinfo_t *cip = cpuinfo_new();
+	if (cip == NULL)
+	  return;
+	cpuinfo_get_model(cip);
+	n_caches = cpuinfo_get_caches(cip)->count;
+	cpuinfo_get_topology(cip);
+	cpuinfo_destroy(cip);
+  }
+  print_result("cpuinfo_new() to cpuinfo_destroy()", get_ticks_nsec() - start, n_iterations);
+  printf("  %-40s model, %d caches, topology\n", "result", n_caches);
+}
+
+static void bench_snapshot(cpuinfo_t *cip)
+{
+  uint64_t start;
+  int i, size;
+  const int n_iterations = 100000;
+
+  printf("Snapshots (per call)\n");
+
+  if ((size = cpuinfo_save(cip, NULL, 0)) < 0)
+	return;
+  void *buf = malloc(size);
+  if (buf == NULL)
+	return;
+  start = get_ticks_nsec();
+  cpuinfo_save(cip, buf, size);
+  print_result("cpuinfo_save()", get_ticks_nsec() - start, 1);
+
+  start = get_ticks_nsec();
+  for (i = 0; i < n_iterations; i++) {
+	cpuinfo_t *sip = cpuinfo_load(buf, size);
+	if (sip == NULL)
+	  break;
+	bench_sink = cpuinfo_get_frequency(sip);
+	cpuinfo_destroy(sip);
+  }
+  print_result("cpuinfo_load() to cpuinfo_destroy()", get_ticks_nsec() - start, n_iterations);
+  printf("  %-40s %d bytes\n", "result", size);
+  free(buf);
+}
+
+static void bench_parallelism(cpuinfo_t *cip)
+{
+  uint64_t start;
+  cpuinfo_parallelism_t p;
+
+  printf("Usable parallelism (per call)\n");
+
+  start = get_ticks_nsec();
+  cpuinfo_get_parallelism(cip, &p);
+  print_result("cpuinfo_get_parallelism()", get_ticks_nsec() - start, 1);
+  printf("  %-40s %d logical CPUs, budget %.2f CPUs\n", "result", p.n_cpus, p.budget);
+}
+
+#define SYSFS_TREE_CPUS 1024
+#define SYNTHETIC_TREE_MAX_CPUS 4096
+
+// Layout of a synthetic machine. Logical CPUs are numbered like Linux does
+// on x86: the first thread of every core, then their SMT siblings
+typedef struct {
+  int n_cpus;			// logical CPUs, 2 to SYNTHETIC_TREE_MAX_CPUS
+  int n_threads;		// SMT threads per core
+  int n_packages;		// packages, with the same number of cores
+  int n_nodes;			// NUMA nodes, splitting cores evenly (0 for none)
+  int llc_cpus;			// logical CPUs sharing an L3 cache (0 for the package)
+  int hybrid;			// hybrid layout (below), the first half of the cores being big cores
+} tree_config_t;
+
+// Hybrid layouts of synthetic machines
+enum {
+  TREE_HOMOGENEOUS,
+  TREE_INTEL_HYBRID,	// cpu_core and cpu_atom PMUs, all at the same maximum frequency
+  TREE_BIG_LITTLE,		// ARM cpu_capacity, without PMUs
+  TREE_ARM_PMUS			// one PMU per ARM cluster, maximum frequencies differing within a cluster
+};
+
+// Create a file of a synthetic tree, and its parent directories if needed
+static FILE *vcreate_tree_file(const char *root, const char *format, va_list args)
+{
+  char path[4096], *p;
+  int n = snprintf(path, sizeof(path), "%s/", root);
+  vsnprintf(path + n, sizeof(path) - n, format, args);
+  FILE *fp = fopen(path, "w");
+  if (fp == NULL && errno == ENOENT) {
+	for (p = path + 1; (p = strchr(p, '/')) != NULL; p++) {
+	  *p = '\0';
+	  mkdir(path, 0755);
+	  *p = '/';
+	}
+	fp = fopen(path, "w");
+  }
+  return fp;
+}
+
+static FILE *create_tree_file(const char *root, const char *format, ...)
+{
+  va_list args;
+  va_start(args, format);
+  FILE *fp = vcreate_tree_file(root, format, args);
+  va_end(args);
+  return fp;
+}
+
+static int write_tree_file(const char *root, const char *contents, const char *format, ...)
+{
+  va_list args;
+  va_start(args, format);
+  FILE *fp = vcreate_tree_file(root, format, args);
+  va_end(args);
+  if (fp == NULL)
+	return -1;
+  fputs(contents, fp);
+  fclose(fp);
+  return 0;
+}
+
+// Format the list of logical CPUs of N_CORES cores from FIRST, with all their threads
+static void format_core_list(char *str, int size, const tree_config_t *tcp, int first, int n_cores)
+{
+  const int stride = tcp->n_cpus / tcp->n_threads;
+  int i, n = 0;
+  for (i = 0; i < tcp->n_threads && n < size; i++) {
+	const int cpu = first + i * stride;
+	if (n_cores == 1)
+	  n += snprintf(str + n, size - n, "%s%d", i ? "," : "", cpu);
+	else
+	  n += snprintf(str + n, size - n, "%s%d-%d", i ? "," : "", cpu, cpu + n_cores - 1);
+  }
+  if (n < size)
+	snprintf(str + n, size - n, "\n");
+}
+
+// Create a synthetic sysfs tree in ROOT/sys and /proc/cpuinfo in ROOT/proc:
+// private L1/L2 caches, L3 caches shared by TCP->llc_cpus logical CPUs
+static int make_tree(const char *root, const tree_config_t *tcp)
+{
+  static const struct {
+	const char *level;
+	const char *type;
+	const char *size;
+	int shared;			// shared by TCP->llc_cpus, or else by SMT siblings
+  } caches[] = {
+	{ "1\n", "Data\n", "48K\n", 0 },
+	{ "1\n", "Instruction\n", "32K\n", 0 },
+	{ "2\n", "Unified\n", "2048K\n", 0 },
+	{ "3\n", "Unified\n", "105M\n", 1 },
+  };
+  if (tcp->n_cpus < 2 || tcp->n_cpus > SYNTHETIC_TREE_MAX_CPUS ||
+	  tcp->n_threads < 1 || tcp->n_packages < 1 || tcp->n_nodes < 0 || tcp->llc_cpus < 0 ||
+	  tcp->n_cpus % tcp->n_threads != 0 || tcp->llc_cpus % tcp->n_threads != 0)
+	return -1;
+  const int n_cores = tcp->n_cpus / tcp->n_threads;
+  const int package_cores = n_cores / tcp->n_packages;
+  const int llc_cores = tcp->llc_cpus ? tcp->llc_cpus / tcp->n_threads : package_cores;
+  const int node_cores = tcp->n_nodes ? n_cores / tcp->n_nodes : 0;
+  if (package_cores < 1 || n_cores % tcp->n_packages != 0 ||
+	  llc_cores < 1 || package_cores % llc_cores != 0 ||
+	  (tcp->n_nodes && (node_cores < 1 || n_cores % tcp->n_nodes != 0)))
+	return -1;
+
+  char sys[4096], str[8192];
+  int cpu, i, j;
+  snprintf(sys, sizeof(sys), "%s/sys", root);
+
+  FILE *proc = create_tree_file(root, "proc/cpuinfo");
+  if (proc == NULL)
+	return -1;
+  snprintf(str, sizeof(str), "0-%d\n", tcp->n_cpus - 1);
+  if (write_tree_file(sys, str, "devices/system/cpu/online") < 0) {
+	fclose(proc);
+	return -1;
+  }
+  for (cpu = 0; cpu < tcp->n_cpus; cpu++) {
+	const int core = cpu % n_cores;
+	const int package = core / package_cores;
+	snprintf(str, sizeof(str), "%d\n", package);
+	write_tree_file(sys, str, "devices/system/cpu/cpu%d/topology/physical_package_id", cpu);
+	write_tree_file(sys, "0\n", "devices/system/cpu/cpu%d/topology/die_id", cpu);
+	snprintf(str, sizeof(str), "%d\n", core % package_cores);
+	write_tree_file(sys, str, "devices/system/cpu/cpu%d/topology/core_id", cpu);
+	const int big = core < n_cores / 2;
+	const char *max_freq = "3000000\n";
+	if (tcp->hybrid == TREE_ARM_PMUS)
+	  max_freq = big ? "2800000\n" : core == n_cores - 1 ? "2500000\n" : "1800000\n";
+	write_tree_file(sys, max_freq, "devices/system/cpu/cpu%d/cpufreq/cpuinfo_max_freq", cpu);
+	if (tcp->hybrid == TREE_BIG_LITTLE)
+	  write_tree_file(sys, big ? "1024\n" : "446\n", "devices/system/cpu/cpu%d/cpu_capacity", cpu);
+	for (i = 0; i < sizeof(caches) / sizeof(caches[0]); i++) {
+	  write_tree_file(sys, caches[i].level, "devices/system/cpu/cpu%d/cache/index%d/level", cpu, i);
+	  write_tree_file(sys, caches[i].type, "devices/system/cpu/cpu%d/cache/index%d/type", cpu, i);
+	  write_tree_file(sys, caches[i].size, "devices/system/cpu/cpu%d/cache/index%d/size", cpu, i);
+	  write_tree_file(sys, "64\n", "devices/system/cpu/cpu%d/cache/index%d/coherency_line_size", cpu, i);
+	  if (caches[i].shared)
+		format_core_list(str, sizeof(str), tcp, core - core % llc_cores, llc_cores);
+	  else
+		format_core_list(str, sizeof(str), tcp, core, 1);
+	  if (write_tree_file(sys, str, "devices/system/cpu/cpu%d/cache/index%d/shared_cpu_list", cpu, i) < 0) {
+		fclose(proc);
+		return -1;
+	  }
+	}
+	fprintf(proc, "processor\t: %d\nphysical id\t: %d\ncore id\t\t: %d\nmicrocode\t: 0x1\n\n",
+			cpu, package, core % package_cores);
+  }
+  fclose(proc);
+
+  if (tcp->hybrid == TREE_INTEL_HYBRID || tcp->hybrid == TREE_ARM_PMUS) {
+	const int intel = tcp->hybrid == TREE_INTEL_HYBRID;
+	format_core_list(str, sizeof(str), tcp, 0, n_cores / 2);
+	write_tree_file(sys, str, "devices/%s/cpus", intel ? "cpu_core" : "armv8_cortex_a76");
+	format_core_list(str, sizeof(str), tcp, n_cores / 2, n_cores - n_cores / 2);
+	if (write_tree_file(sys, str, "devices/%s/cpus", intel ? "cpu_atom" : "armv8_cortex_a55") < 0)
+	  return -1;
+  }
+
+  if (tcp->n_nodes > 0) {
+	snprintf(str, sizeof(str), "0-%d\n", tcp->n_nodes - 1);
+	write_tree_file(sys, str, "devices/system/node/online");
+	for (i = 0; i < tcp->n_nodes; i++) {
+	  format_core_list(str, sizeof(str), tcp, i * node_cores, node_cores);
+	  write_tree_file(sys, str, "devices/system/node/node%d/cpulist", i);
+	  snprintf(str, sizeof(str), "Node %d MemTotal:       67108864 kB\nNode %d MemFree:        33554432 kB\n", i, i);
+	  write_tree_file(sys, str, "devices/system/node/node%d/meminfo", i);
+	  // nodes of the same package are closer (sub-NUMA clustering)
+	  int n = 0;
+	  for (j = 0; j < tcp->n_nodes && n < sizeof(str); j++) {
+		const int distance = j == i ? 10 :
+		  (j * node_cores) / package_cores == (i * node_cores) / package_cores ? 12 : 21;
+		n += snprintf(str + n, sizeof(str) - n, "%s%d", j ? " " : "", distance);
+	  }
+	  if (n < sizeof(str))
+		snprintf(str + n, sizeof(str) - n, "\n");
+	  if (write_tree_file(sys, str, "devices/system/node/node%d/distance", i) < 0)
+		return -1;
+	}
+  }
+  return 0;
+}
+
+static int remove_tree_file(const char *path, const struct stat *sb, int flag, struct FTW *ftwbuf)
+{
+  return remove(path);
+}
+
+// Read descriptors from the synthetic tree in ROOT (NULL restores the system trees)
+static void use_tree(const char *root)
+{
+  char path[4096];
+  if (root == NULL) {
+	cpuinfo_set_sysfs_root(NULL);
+	cpuinfo_set_procfs_root(NULL);
+	return;
+  }
+  snprintf(path, sizeof(path), "%s/sys", root);
+  cpuinfo_set_sysfs_root(path);
+  snprintf(path, sizeof(path), "%s/proc", root);
+  cpuinfo_set_procfs_root(path);
+}
+
+static void bench_sysfs(void)
+{
+  char root[] = "/tmp/cpuinfo-bench-XXXXXX";
+  const tree_config_t config = { SYSFS_TREE_CPUS, 2, 2, 0, 0 };
+  uint64_t start;
+
+  printf("Sysfs enumeration (%d CPUs synthetic tree)\n", SYSFS_TREE_CPUS);
+
+  if (mkdtemp(root) == NULL)
+	return;
+  if (make_tree(root, &config) == 0) {
+	use_tree(root);
+
+	cpuinfo_t *cip = cpuinfo_new();
+	if (cip) {
+	  start = get_ticks_nsec();
+	  const cpuinfo_topology_t *tp = cpuinfo_get_topology(cip);
+	  print_result("cpuinfo_get_topology(), per CPU", get_ticks_nsec() - start, SYSFS_TREE_CPUS);
+	  start = get_ticks_nsec();
+	  const cpuinfo_cache_instances_t *ip = cpuinfo_get_cache_instances(cip);
+	  print_result("cpuinfo_get_cache_instances(), per CPU", get_ticks_nsec() - start, SYSFS_TREE_CPUS);
+	  printf("  %-40s %d CPUs, %d cores, %d cache instances\n", "result",
+			 tp->n_cpus, tp->n_cores, ip->count);
+	  cpuinfo_destroy(cip);
+	}
+
+	use_tree(NULL);
+  }
+  nftw(root, remove_tree_file, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+// Query everything a descriptor knows about the machine
+static int enumerate(cpuinfo_t *cip)
+{
+  cpuinfo_cpuset_t set;
+  cpuinfo_parallelism_t p;
+  int i, sum = 0;
+
+  const cpuinfo_topology_t *tp = cpuinfo_get_topology(cip);
+  for (i = 0; i < tp->n_cpus; i++)
+	sum += tp->cpus[i].core + tp->cpus[i].node;
+  const cpuinfo_numa_t *np = cpuinfo_get_numa_nodes(cip);
+  for (i = 0; i < np->count; i++)
+	sum += cpuinfo_get_numa_distance(cip, np->nodes[0].id, np->nodes[i].id);
+  const cpuinfo_cache_t *ccp = cpuinfo_get_caches(cip);
+  for (i = 0; i < ccp->count; i++)
+	sum += cpuinfo_get_cache_geometry(cip, i) != NULL;
+  const cpuinfo_cache_instances_t *ip = cpuinfo_get_cache_instances(cip);
+  for (i = 0; i < ip->count; i++)
+	sum += cpuinfo_cpuset_count(&ip->instances[i].cpus);
+  sum += cpuinfo_get_fastest_cpus(cip, &set);
+  sum += cpuinfo_get_feature_cpus(cip, CPUINFO_FEATURE_SIMD, &set);
+  sum += cpuinfo_get_heterogeneity(cip);
+  sum += cpuinfo_get_parallelism(cip, &p);
+  return sum;
+}
+
+// Time descriptor creation and full enumeration as the number of CPUs grows:
+// the cost per CPU stays flat unless enumeration is superlinear
+static void bench_scaling(void)
+{
+  static const int cpu_counts[] = { 2, 16, 64, 256, 1024, 2048, 4096 };
+  char name[64];
+  int i, j;
+
+  printf("Enumeration scaling (cpuinfo_new() and all queries, SMT2, up to 8 sockets)\n");
+
+  for (i = 0; i < sizeof(cpu_counts) / sizeof(cpu_counts[0]); i++) {
+	char root[] = "/tmp/cpuinfo-bench-XXXXXX";
+	const int n_cpus = cpu_counts[i];
+	// SMT2, 8 sockets on the largest machines, one NUMA node per package
+	const int n_packages = n_cpus >= 1024 ? 8 : n_cpus >= 64 ? 2 : 1;
+	const tree_config_t config = { n_cpus, 2, n_packages, n_packages, 0 };
+	const int n_iterations = n_cpus >= 256 ? 3 : 1024 / n_cpus;
+
+	if (mkdtemp(root) == NULL)
+	  return;
+	if (make_tree(root, &config) == 0) {
+	  use_tree(root);
+	  uint64_t start = 0, elapsed = 0;
+	  int count = 0;
+	  // first run warms up the dentry cache
+	  for (j = -1; j < n_iterations; j++) {
+		if (j == 0)
+		  start = get_ticks_nsec();
+		cpuinfo_t *cip = cpuinfo_new();
+		if (cip == NULL)
+		  break;
+		bench_sink = enumerate(cip);
+		cpuinfo_destroy(cip);
+		count = j + 1;
+	  }
+	  elapsed = get_ticks_nsec() - start;
+	  use_tree(NULL);
+	  if (count > 0) {
+		snprintf(name, sizeof(name), "%d CPUs", n_cpus);
+		printf("  %-40s %10.2f us, %8.2f ns per CPU\n", name,
+			   (double)elapsed / count / 1000, (double)elapsed / count / n_cpus);
+	  }
+	}
+	nftw(root, remove_tree_file, 16, FTW_DEPTH | FTW_PHYS);
+  }
+}
+
+#define HYBRID_TREE_CPUS 8
+
+// Check core classes, capacities and fastest CPUs read from synthetic
+// hybrid machines (returns the number of failed checks)
+static int check_hybrid(void)
+{
+  static const struct {
+	const char *name;
+	int hybrid;
+  } layouts[] = {
+	{ "Intel hybrid PMUs", TREE_INTEL_HYBRID },
+	{ "ARM big.LITTLE capacities", TREE_BIG_LITTLE },
+	{ "ARM cluster PMUs", TREE_ARM_PMUS },
+  };
+  int i, j, n_failures = 0;
+
+  printf("Hybrid core classification (%d CPUs synthetic trees, CPUs 0-%d big)\n",
+		 HYBRID_TREE_CPUS, HYBRID_TREE_CPUS / 2 - 1);
+
+  for (i = 0; i < sizeof(layouts) / sizeof(layouts[0]); i++) {
+	char root[] = "/tmp/cpuinfo-bench-XXXXXX";
+	const tree_config_t config = { HYBRID_TREE_CPUS, 1, 1, 0, 0, layouts[i].hybrid };
+	const char *error = NULL;
+
+	if (mkdtemp(root) == NULL)
+	  return n_failures + 1;
+	if (make_tree(root, &config) < 0)
+	  error = "could not create tree";
+	else {
+	  use_tree(root);
+	  cpuinfo_t *cip = cpuinfo_new();
+	  if (cip == NULL)
+		error = "could not allocate descriptor";
+	  else {
+		cpuinfo_cpuset_t set;
+		const cpuinfo_topology_t *tp = cpuinfo_get_topology(cip);
+		if (tp == NULL || tp->n_cpus != HYBRID_TREE_CPUS)
+		  error = "wrong number of CPUs";
+		for (j = 0; error == NULL && j < tp->n_cpus; j++) {
+		  const cpuinfo_topology_cpu_t *cp = &tp->cpus[j];
+		  const int big = cp->cpu < HYBRID_TREE_CPUS / 2;
+		  if (cp->core_class != (big ? CPUINFO_CORE_CLASS_PERFORMANCE : CPUINFO_CORE_CLASS_EFFICIENCY))
+			error = "wrong core class";
+		  else if (big ? cp->capacity != 1024 :
+				   layouts[i].hybrid != TREE_INTEL_HYBRID && cp->capacity >= 1024)
+			error = "wrong capacity";
+		}
+		if (error == NULL && cpuinfo_get_fastest_cpus(cip, &set) != HYBRID_TREE_CPUS / 2)
+		  error = "wrong number of fastest CPUs";
+		for (j = 0; error == NULL && j < HYBRID_TREE_CPUS; j++) {
+		  if (cpuinfo_cpuset_isset(&set, j) != (j < HYBRID_TREE_CPUS / 2))
+			error = "wrong fastest CPUs";
+		}
+		cpuinfo_destroy(cip);
+	  }
+	  use_tree(NULL);
+	}
+	nftw(root, remove_tree_file, 16, FTW_DEPTH | FTW_PHYS);
+
+	printf("  %-40s %s\n", layouts[i].name, error ? error : "ok");
+	if (error)
+	  n_failures++;
+  }
+  return n_failures;
+}
+
+#define CGROUP_FILES_MAX 6
+
+// Check logical CPUs and CPU time read from synthetic cgroups, on top of the
+// affinity mask of the process (returns the number of failed checks)
+static int check_parallelism(void)
+{
+  static const struct {
+	const char *name;
+	const char *cgroup;			// proc/self/cgroup
+	const char *files[CGROUP_FILES_MAX][2];	// path below sys/fs/cgroup, contents
+	const char *cpus;			// CPUs the cgroups allow (NULL for all)
+	double budget;				// CPU time they allow (-1 for no limit)
+  } cases[] = {
+	{ "v2 cpu.max quota", "0::/job\n",
+	  { { "job/cpu.max", "50000 100000\n" } }, NULL, 0.5 },
+	{ "v2 cpu.max unlimited", "0::/job\n",
+	  { { "job/cpu.max", "max 100000\n" } }, NULL, -1 },
+	{ "v2 cpuset.cpus.effective", "0::/job\n",
+	  { { "job/cpuset.cpus.effective", "2-3\n" } }, "2-3", -1 },
+	{ "v2 limits of an ancestor", "0::/job/task\n",
+	  { { "job/cpu.max", "25000 100000\n" },
+		{ "job/task/cpu.max", "max 100000\n" },
+		{ "job/cpuset.cpus.effective", "0,2\n" } }, "0,2", 0.25 },
+	{ "v1 cfs quota and effective cpuset", "4:cpu,cpuacct:/job\n3:cpuset:/job\n",
+	  { { "cpu,cpuacct/cpu.cfs_period_us", "100000\n" },
+		{ "cpu,cpuacct/cpu.cfs_quota_us", "-1\n" },
+		{ "cpu,cpuacct/job/cpu.cfs_period_us", "100000\n" },
+		{ "cpu,cpuacct/job/cpu.cfs_quota_us", "50000\n" },
+		{ "cpuset/cpuset.cpus", "0-7\n" },
+		{ "cpuset/job/cpuset.effective_cpus", "0,3\n" } }, "0,3", 0.5 },
+  };
+  int i, j, n_failures = 0;
+
+  printf("Parallelism (%d CPUs synthetic trees with cgroups)\n", HYBRID_TREE_CPUS);
+
+  // the affinity mask of the process applies too
+  cpuinfo_cpuset_t affinity;
+  cpu_set_t *set = CPU_ALLOC(CPUINFO_CPUSET_SIZE);
+  const size_t set_size = CPU_ALLOC_SIZE(CPUINFO_CPUSET_SIZE);
+  memset(&affinity, 0, sizeof(affinity));
+  if (set == NULL || sched_getaffinity(0, set_size, set) < 0) {
+	if (set)
+	  CPU_FREE(set);
+	return 1;
+  }
+  for (i = 0; i < CPUINFO_CPUSET_SIZE; i++) {
+	if (CPU_ISSET_S(i, set_size, set))
+	  affinity.bits[i / 32] |= 1U << (i % 32);
+  }
+  CPU_FREE(set);
+
+  for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+	char root[] = "/tmp/cpuinfo-bench-XXXXXX", sys[4096];
+	const tree_config_t config = { HYBRID_TREE_CPUS, 1, 1, 0, 0, TREE_HOMOGENEOUS };
+	const char *error = NULL;
+
+	// expected CPUs: the tree ones the process and the cgroups allow
+	cpuinfo_cpuset_t cpus;
+	char list[32];
+	snprintf(list, sizeof(list), "0-%d", HYBRID_TREE_CPUS - 1);
+	cpuinfo_cpuset_parse(cases[i].cpus ? cases[i].cpus : list, &cpus);
+	for (j = 0; j < CPUINFO_CPUSET_SIZE / 32; j++)
+	  cpus.bits[j] &= affinity.bits[j];
+	const int n_cpus = cpuinfo_cpuset_count(&cpus);
+	const double budget = cases[i].budget < 0 || cases[i].budget > n_cpus ? n_cpus : cases[i].budget;
+
+	if (mkdtemp(root) == NULL)
+	  return n_failures + 1;
+	snprintf(sys, sizeof(sys), "%s/sys", root);
+	if (make_tree(root, &config) < 0 || write_tree_file(root, cases[i].cgroup, "proc/self/cgroup") < 0)
+	  error = "could not create tree";
+	for (j = 0; error == NULL && j < CGROUP_FILES_MAX && cases[i].files[j][0]; j++) {
+	  if (write_tree_file(sys, cases[i].files[j][1], "fs/cgroup/%s", cases[i].files[j][0]) < 0)
+		error = "could not create tree";
+	}
+	if (error == NULL) {
+	  use_tree(root);
+	  cpuinfo_t *cip = cpuinfo_new();
+	  cpuinfo_parallelism_t p;
+	  if (cip == NULL)
+		error = "could not allocate descriptor";
+	  else if (cpuinfo_get_parallelism(cip, &p) < 0)
+		error = "could not get parallelism";
+	  else if (p.n_cpus != n_cpus || memcmp(&p.cpus, &cpus, sizeof(cpus)) != 0)
+		error = "wrong CPUs";
+	  else if (p.budget < budget - 1e-6 || p.budget > budget + 1e-6)
+		error = "wrong budget";
+	  if (cip)
+		cpuinfo_destroy(cip);
+	  use_tree(NULL);
+	}
+	nftw(root, remove_tree_file, 16, FTW_DEPTH | FTW_PHYS);
+
+	printf("  %-40s %s\n", cases[i].name, error ? error : "ok");
+	if (error)
+	  n_failures++;
+  }
+  return n_failures;
+}
+
+static int dispatch_generic(void) { return 0; }
+static int dispatch_simd(void) { return 1; }
+
+static void bench_dispatcher(void)
+{
+  int i, hits;
+  uint64_t start;
+  cpuinfo_dispatcher_t *dp;
+
+  printf("Dispatcher (per resolve)\n");
+
+  if ((dp = cpuinfo_dispatcher_new("bench")) == NULL)
+	return;
+  cpuinfo_dispatcher_add(dp, "generic", (cpuinfo_function_t)dispatch_generic, 0, 0);
+  cpuinfo_dispatcher_add(dp, "simd", (cpuinfo_function_t)dispatch_simd, 10, CPUINFO_FEATURE_SIMD, 0);
+
+  start = get_ticks_nsec();
+  hits = ((int (*)(void))cpuinfo_dispatcher_resolve(dp))();
+  print_result("cpuinfo_dispatcher_resolve(), first call", get_ticks_nsec() - start, 1);
+  bench_sink = hits;
+
+  hits = 0;
+  start = get_ticks_nsec();
+  for (i = 0; i < N_ITERATIONS; i++)
+	hits += cpuinfo_dispatcher_resolve(dp) != NULL;
+  print_result("cpuinfo_dispatcher_resolve()", get_ticks_nsec() - start, N_ITERATIONS);
+  bench_sink = hits;
+
+  printf("  %-40s %s\n", "resolved to", cpuinfo_dispatcher_get_name(dp));
+  cpuinfo_dispatcher_destroy(dp);
+}
+
+static void bench_cached(void)
+{
+  char dir[] = "/tmp/cpuinfo-bench-XXXXXX";
+  uint64_t start;
+  int i;
+  const int n_iterations = 10000;
+
+  printf("Per-boot cache (per descriptor)\n");
+
+  if (mkdtemp(dir) == NULL)
+	return;
+  const char *old_dir = getenv("CPUINFO_CACHE_DIR");
+  setenv("CPUINFO_CACHE_DIR", dir, 1);
+
+  start = get_ticks_nsec();
+  cpuinfo_t *cip = cpuinfo_new_cached();
+  print_result("cpuinfo_new_cached(), miss", get_ticks_nsec() - start, 1);
+  if (cip) {
+	cpuinfo_destroy(cip);
+	start = get_ticks_nsec();
+	for (i = 0; i < n_iterations; i++) {
+	  if ((cip = cpuinfo_new_cached()) == NULL)
+		break;
+	  bench_sink = cpuinfo_get_caches(cip)->count;
+	  cpuinfo_destroy(cip);
+	}
+	print_result("cpuinfo_new_cached(), hit", get_ticks_nsec() - start, n_iterations);
+  }
+
+  if (old_dir)
+	setenv("CPUINFO_CACHE_DIR", old_dir, 1);
+  else
+	unsetenv("CPUINFO_CACHE_DIR");
+  nftw(dir, remove_tree_file, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+#define HARNESS_THREADS_MAX 16			// threads of the per_thread and contended runs, at most
+#define HARNESS_BATCH 64			// calls per sample of the fast calls
+
+#if defined(__i386__) || defined(__x86_64__)
+#define TICKS_UNIT "cycles"
+#else
+#define TICKS_UNIT "ns"
+#endif
+
+// Get current value of the cycle counter, or else of the nanosecond timer
+static inline uint64_t get_ticks(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+  uint32_t low, high;
+  __asm__ __volatile__ ("lfence; rdtsc" : "=a" (low), "=d" (high) : : "memory");
+  return ((uint64_t)high << 32) | low;
+#else
+  return get_ticks_nsec();
+#endif
+}
+
+// A sample times N calls on descriptor CIP (returns the elapsed ticks)
+typedef uint64_t (*sample_function_t)(cpuinfo_t *cip, int n);
+
+static uint64_t sample_new(cpuinfo_t *cip, int n)
+{
+  uint64_t start = get_ticks();
+  cpuinfo_t *nip = cpuinfo_new();
+  uint64_t ticks = get_ticks() - start;
+  cpuinfo_destroy(nip);
+  return ticks;
+}
+
+static uint64_t sample_destroy(cpuinfo_t *cip, int n)
+{
+  cpuinfo_t *nip = cpuinfo_new();
+  uint64_t start = get_ticks();
+  cpuinfo_destroy(nip);
+  return get_ticks() - start;
+}
+
+static uint64_t sample_has_feature_first(cpuinfo_t *cip, int n)
+{
+  cpuinfo_t *nip = cpuinfo_new();
+  uint64_t start = get_ticks();
+  bench_sink = cpuinfo_has_feature(nip, bench_features[0]);
+  uint64_t ticks = get_ticks() - start;
+  cpuinfo_destroy(nip);
+  return ticks;
+}
+
+static uint64_t sample_has_feature(cpuinfo_t *cip, int n)
+{
+  int i, hits = 0;
+  uint64_t start = get_ticks();
+  for (i = 0; i < n; i++)
+	hits += cpuinfo_has_feature(cip, bench_features[i & 3]);
+  uint64_t ticks = get_ticks() - start;
+  bench_sink = hits;
+  return ticks;
+}
+
+static uint64_t sample_get_caches_first(cpuinfo_t *cip, int n)
+{
+  cpuinfo_t *nip = cpuinfo_new();
+  uint64_t start = get_ticks();
+  bench_sink = cpuinfo_get_caches(nip)->count;
+  uint64_t ticks = get_ticks() - start;
+  cpuinfo_destroy(nip);
+  return ticks;
+}
+
+static uint64_t sample_get_caches(cpuinfo_t *cip, int n)
+{
+  int i, count = 0;
+  uint64_t start = get_ticks();
+  for (i = 0; i < n; i++)
+	count += cpuinfo_get_caches(cip)->count;
+  uint64_t ticks = get_ticks() - start;
+  bench_sink = count;
+  return ticks;
+}
+
+static uint64_t sample_get_model(cpuinfo_t *cip, int n)
+{
+  int i, length = 0;
+  uint64_t start = get_ticks();
+  for (i = 0; i < n; i++)
+	length += cpuinfo_get_model(cip)[0];
+  uint64_t ticks = get_ticks() - start;
+  bench_sink = length;
+  return ticks;
+}
+
+static uint64_t sample_get_frequency_first(cpuinfo_t *cip, int n)
+{
+  cpuinfo_t *nip = cpuinfo_new();
+  uint64_t start = get_ticks();
+  bench_sink = cpuinfo_get_frequency(nip);
+  uint64_t ticks = get_ticks() - start;
+  cpuinfo_destroy(nip);
+  return ticks;
+}
+
+static uint64_t sample_get_frequency(cpuinfo_t *cip, int n)
+{
+  int i, freq = 0;
+  uint64_t start = get_ticks();
+  for (i = 0; i < n; i++)
+	freq += cpuinfo_get_frequency(cip);
+  uint64_t ticks = get_ticks() - start;
+  bench_sink = freq;
+  return ticks;
+}
+
+static uint64_t sample_string_of_feature(cpuinfo_t *cip, int n)
+{
+  int i, length = 0;
+  uint64_t start = get_ticks();
+  for (i = 0; i < n; i++)
+	length += cpuinfo_string_of_feature(bench_features[i & 3])[0];
+  uint64_t ticks = get_ticks() - start;
+  bench_sink = length;
+  return ticks;
+}
+
+// Calls measured by the harness. Fast calls run in batches on a warmed up
+// descriptor, which threads may share; the others use fresh descriptors
+static const struct {
+  const char *name;
+  sample_function_t sample;
+  int batch;				// calls per sample, 1 for fresh descriptors
+  int n_samples;			// samples per thread
+} harness_calls[] = {
+  { "cpuinfo_new()", sample_new, 1, 100 },
+  { "cpuinfo_destroy()", sample_destroy, 1, 100 },
+  { "cpuinfo_has_feature(), first call", sample_has_feature_first, 1, 100 },
+  { "cpuinfo_has_feature()", sample_has_feature, HARNESS_BATCH, 1000 },
+  { "cpuinfo_get_caches(), first call", sample_get_caches_first, 1, 100 },
+  { "cpuinfo_get_caches()", sample_get_caches, HARNESS_BATCH, 1000 },
+  { "cpuinfo_get_model()", sample_get_model, HARNESS_BATCH, 1000 },
+  { "cpuinfo_get_frequency(), first call", sample_get_frequency_first, 1, 50 },
+  { "cpuinfo_get_frequency()", sample_get_frequency, HARNESS_BATCH, 1000 },
+  { "cpuinfo_string_of_feature()", sample_string_of_feature, HARNESS_BATCH, 1000 },
+};
+
+#define N_HARNESS_CALLS (sizeof(harness_calls) / sizeof(harness_calls[0]))
+
+// Ways of running a call
+enum {
+  VARIANT_SINGLE,			// from the main thread only
+  VARIANT_PER_THREAD,		// from all threads at once, each on its own descriptor
+  VARIANT_CONTENDED,		// from all threads at once, on one shared descriptor
+  N_VARIANTS
+};
+
+static const char *const variant_names[N_VARIANTS] = {
+  "single", "per_thread", "contended"
+};
+
+typedef struct {
+  double median;			// ticks per call (negative if not measured)
+  double p99;
+} harness_result_t;
+
+// A thread running the samples of a call
+typedef struct {
+  int call;
+  cpuinfo_t *cip;			// shared descriptor, or NULL for one of its own
+  pthread_barrier_t *barrier;
+  double *samples;			// ticks per call
+} harness_thread_t;
+
+// Create a descriptor, with everything the fast calls use already determined
+static cpuinfo_t *harness_descriptor(void)
+{
+  cpuinfo_t *cip = cpuinfo_new();
+  if (cip) {
+	cpuinfo_has_feature(cip, bench_features[0]);
+	cpuinfo_get_caches(cip);
+	cpuinfo_get_model(cip);
+	cpuinfo_get_frequency(cip);
+  }
+  return cip;
+}
+
+static void *harness_thread(void *arg)
+{
+  harness_thread_t *htp = (harness_thread_t *)arg;
+  const int call = htp->call;
+  const int batch = harness_calls[call].batch;
+  cpuinfo_t *cip = htp->cip;
+  int i;
+
+  if (cip == NULL && batch > 1)
+	cip = harness_descriptor();
+  if (htp->barrier)
+	pthread_barrier_wait(htp->barrier);
+  for (i = 0; i < harness_calls[call].n_samples; i++)
+	htp->samples[i] = (cip || batch == 1) ? (double)harness_calls[call].sample(cip, batch) / batch : 0;
+  if (cip != htp->cip)
+	cpuinfo_destroy(cip);
+  return NULL;
+}
+
+// Logical CPU each harness thread is pinned to (-1 if not pinned)
+static int harness_cpus[HARNESS_THREADS_MAX];
+
+// Create a harness thread, pinned to logical CPU if not negative
+static int harness_spawn(pthread_t *thread, int cpu, harness_thread_t *htp)
+{
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  cpu_set_t *set = NULL;
+  if (cpu >= 0 && (set = CPU_ALLOC(CPUINFO_CPUSET_SIZE)) != NULL) {
+	const size_t set_size = CPU_ALLOC_SIZE(CPUINFO_CPUSET_SIZE);
+	CPU_ZERO_S(set_size, set);
+	CPU_SET_S(cpu, set_size, set);
+	pthread_attr_setaffinity_np(&attr, set_size, set);
+  }
+  int ret = (cpu < 0 || set) && pthread_create(thread, &attr, harness_thread, htp) == 0 ? 0 : -1;
+  if (set)
+	CPU_FREE(set);
+  pthread_attr_destroy(&attr);
+  return ret;
+}
+
+static int compare_samples(const void *a, const void *b)
+{
+  const double da = *(const double *)a, db = *(const double *)b;
+  return da < db ? -1 : da > db;
+}
+
+// Run CALL on N_THREADS threads, sharing descriptor CIP if not NULL
+static int harness_run(int call, int n_threads, cpuinfo_t *cip, harness_result_t *rp)
+{
+  const int n_samples = harness_calls[call].n_samples;
+  harness_thread_t threads[HARNESS_THREADS_MAX];
+  pthread_t ids[HARNESS_THREADS_MAX];
+  pthread_barrier_t barrier;
+  int i;
+
+  rp->median = rp->p99 = -1;
+  double *samples = (double *)malloc(n_threads * n_samples * sizeof(*samples));
+  if (samples == NULL)
+	return -1;
+  if (n_threads > 1)
+	pthread_barrier_init(&barrier, NULL, n_threads);
+  for (i = 0; i < n_threads; i++) {
+	threads[i].call = call;
+	threads[i].cip = cip;
+	threads[i].barrier = n_threads > 1 ? &barrier : NULL;
+	threads[i].samples = &samples[i * n_samples];
+  }
+  if (n_threads == 1)
+	harness_thread(&threads[0]);
+  else {
+	for (i = 0; i < n_threads; i++) {
+	  // threads already waiting on the barrier could not be released
+	  if (harness_spawn(&ids[i], harness_cpus[i], &threads[i]) < 0) {
+		fprintf(stderr, "ERROR: could not create benchmark thread on CPU %d\n", harness_cpus[i]);
+		exit(1);
+	  }
+	}
+	for (i = 0; i < n_threads; i++)
+	  pthread_join(ids[i], NULL);
+	pthread_barrier_destroy(&barrier);
+  }
+
+  const int n = n_threads * n_samples;
+  qsort(samples, n, sizeof(*samples), compare_samples);
+  rp->median = samples[n / 2];
+  rp->p99 = samples[(n * 99) / 100 < n ? (n * 99) / 100 : n - 1];
+  free(samples);
+  return 0;
+}
+
+// Write harness results as JSON into FILE
+static int harness_write_json(const char *file, int n_threads, harness_result_t results[][N_VARIANTS])
+{
+  writer_t w;
+  int i, j;
+  FILE *out = fopen(file, "w");
+  if (out == NULL)
+	return -1;
+  writer_init(&w, out, WRITER_FORMAT_JSON);
+  writer_string(&w, "unit", TICKS_UNIT);
+  writer_int(&w, "threads", n_threads);
+  writer_int(&w, "max_threads", HARNESS_THREADS_MAX);
+  writer_begin_array(&w, "cpus");
+  for (i = 0; i < n_threads; i++)
+	writer_int(&w, NULL, harness_cpus[i]);
+  writer_end(&w);
+  writer_begin_array(&w, "calls");
+  for (i = 0; i < N_HARNESS_CALLS; i++) {
+	writer_begin_object(&w, NULL);
+	writer_string(&w, "name", harness_calls[i].name);
+	writer_int(&w, "samples", harness_calls[i].n_samples);
+	for (j = 0; j < N_VARIANTS; j++) {
+	  if (results[i][j].median < 0)
+		continue;
+	  writer_begin_object(&w, variant_names[j]);
+	  writer_double(&w, "median", results[i][j].median);
+	  writer_double(&w, "p99", results[i][j].p99);
+	  writer_end(&w);
+	}
+	writer_end(&w);
+  }
+  writer_end(&w);
+  writer_finish(&w);
+  return fclose(out) == 0 ? 0 : -1;
+}
+
+// Time each public call on the startup path: median and 99th percentile,
+// alone and from one thread per usable CPU (at most HARNESS_THREADS_MAX),
+// thread i pinned to the i-th usable CPU. The contended variant shares one
+// descriptor, which only the calls reading determined results allow
+static int bench_calls(const char *json_file)
+{
+  harness_result_t results[N_HARNESS_CALLS][N_VARIANTS];
+  cpuinfo_parallelism_t p;
+  int i, j, n_cpus = 0;
+
+  cpuinfo_t *cip = harness_descriptor();
+  if (cip == NULL)
+	return -1;
+  if (cpuinfo_get_parallelism(cip, &p) == 0) {
+	for (i = 0; i < CPUINFO_CPUSET_SIZE && n_cpus < HARNESS_THREADS_MAX; i++) {
+	  if (cpuinfo_cpuset_isset(&p.cpus, i))
+		harness_cpus[n_cpus++] = i;
+	}
+  }
+  const int n_threads = n_cpus < 2 ? 2 : n_cpus;
+  // with fewer usable CPUs than threads, they take turns
+  for (i = n_cpus; i < n_threads; i++)
+	harness_cpus[i] = n_cpus > 0 ? harness_cpus[i % n_cpus] : -1;
+
+  printf("Public calls (%s per call, median / p99, %d threads, at most %d)\n",
+		 TICKS_UNIT, n_threads, HARNESS_THREADS_MAX);
+  printf("  %-40s %19s %19s %19s\n", "", variant_names[VARIANT_SINGLE],
+		 variant_names[VARIANT_PER_THREAD], variant_names[VARIANT_CONTENDED]);
+  for (i = 0; i < N_HARNESS_CALLS; i++) {
+	const int shared = harness_calls[i].batch > 1;
+	harness_run(i, 1, cip, &results[i][VARIANT_SINGLE]);
+	harness_run(i, n_threads, NULL, &results[i][VARIANT_PER_THREAD]);
+	results[i][VARIANT_CONTENDED].median = results[i][VARIANT_CONTENDED].p99 = -1;
+	if (shared)
+	  harness_run(i, n_threads, cip, &results[i][VARIANT_CONTENDED]);
+
+	printf("  %-40s", harness_calls[i].name);
+	for (j = 0; j < N_VARIANTS; j++) {
+	  if (results[i][j].median < 0)
+		printf(" %19s", "-");
+	  else
+		printf(" %9.1f %9.1f", results[i][j].median, results[i][j].p99);
+	}
+	printf("\n");
+  }
+  cpuinfo_destroy(cip);
+
+  if (json_file && harness_write_json(json_file, n_threads, results) < 0) {
+	fprintf(stderr, "ERROR: could not write %s\n", json_file);
+	return -1;
+  }
+  return 0;
+}
+
+static void usage(const char *prog)
+{
+  printf("Usage: %s [--calls | --scaling | --check] [--json FILE]\n", prog);
+  printf("       %s --make-tree DIR CPUS [SMT [PACKAGES [NODES [LLC_CPUS]]]]\n", prog);
+  printf("\n");
+  printf("  --calls       only time the public calls on the startup path, from one\n");
+  printf("                thread per usable CPU (at most %d), each pinned to its CPU\n", HARNESS_THREADS_MAX);
+  printf("  --scaling     only time enumeration of synthetic trees of 2 to %d CPUs\n", SYNTHETIC_TREE_MAX_CPUS);
+  printf("  --check       only check core classes read from synthetic hybrid machines,\n");
+  printf("                and parallelism read from synthetic cgroups\n");
+  printf("  --json        write timings of the public calls into FILE\n");
+  printf("  --make-tree   create a synthetic machine in DIR/sys and DIR/proc, for\n");
+  printf("                cpuinfo_set_sysfs_root() and cpuinfo_set_procfs_root(), or\n");
+  printf("                $CPUINFO_SYSFS_ROOT and $CPUINFO_PROCFS_ROOT\n");
+}
+
+int main(int argc, char *argv[])
+{
+  const char *json_file = NULL;
+  int i, only_calls = 0, only_scaling = 0, only_check = 0;
+
+  for (i = 1; i < argc; i++) {
+	if (strcmp(argv[i], "--calls") == 0)
+	  only_calls = 1;
+	else if (strcmp(argv[i], "--scaling") == 0)
+	  only_scaling = 1;
+	else if (strcmp(argv[i], "--check") == 0)
+	  only_check = 1;
+	else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+	  json_file = argv[++i];
+	else if (i == 1 && argc > 3 && argc <= 8 && strcmp(argv[1], "--make-tree") == 0) {
+	  // defaults to SMT2 in a single package, without NUMA nodes
+	  tree_config_t config = { atoi(argv[3]), 2, 1, 0, 0 };
+	  if (argc > 4)
+		config.n_threads = atoi(argv[4]);
+	  if (argc > 5)
+		config.n_packages = atoi(argv[5]);
+	  if (argc > 6)
+		config.n_nodes = atoi(argv[6]);
+	  if (argc > 7)
+		config.llc_cpus = atoi(argv[7]);
+	  if (make_tree(argv[2], &config) < 0) {
+		fprintf(stderr, "ERROR: could not create synthetic tree in %s\n", argv[2]);
+		return 1;
+	  }
+	  return 0;
+	}
+	else {
+	  usage(argv[0]);
+	  return 1;
+	}
+  }
+  if (only_check)
+	return check_hybrid() + check_parallelism() > 0;
+  if (only_scaling) {
+	bench_scaling();
+	return 0;
+  }
+  if (only_calls)
+	return bench_calls(json_file) < 0;
+
+  cpuinfo_t *cip = cpuinfo_new();
+  if (cip == NULL) {
+	fprintf(stderr, "ERROR: could not allocate cpuinfo descriptor\n");
+	return 1;
+  }
+
+  bench_has_feature(cip);
+  bench_dispatcher();
+  bench_frequency();
+  bench_probe();
+  bench_descriptor();
+  bench_snapshot(cip);
+  bench_cached();
+  bench_parallelism(cip);
+  bench_sysfs();
+  cpuinfo_destroy(cip);
+
+  return bench_calls(json_file) < 0;
+}
@@ -51,12 +51,41 @@ PROTOTYPES: ENABLE
 struct cpuinfo *
 cpuinfo_new()
 
+struct cpuinfo *
+cpuinfo_new_cached()
+
+int
+cpuinfo_set_sysfs_root(root)
+    const char *root;
+
+int
+cpuinfo_set_procfs_root(root)
+    const char *root;
+
 void
 cpuinfo_DESTROY(cip)
     struct cpuinfo *cip;
 CODE:
     cpuinfo_destroy(cip);
 
+void
+cpuinfo_save(cip)
+    struct cpuinfo *cip;
+PREINIT:
+    int size;
+    SV *sv;
+PPCODE:
+    if ((size = cpuinfo_save(cip, NULL, 0)) > 0) {
+	sv = newSV(size);
+	if (cpuinfo_save(cip, SvPVX(sv), size) == size) {
+	    SvCUR_set(sv, size);
+	    SvPOK_on(sv);
+	    XPUSHs(sv_2mortal(sv));
+	}
+	else
+	    SvREFCNT_dec(sv);
+    }
+
 int
 cpuinfo_get_vendor(cip)
     struct cpuinfo *cip;
@@ -69,6 +98,14 @@ int
 cpuinfo_get_frequency(cip)
     struct cpuinfo *cip;
 
+int
+cpuinfo_get_frequency_source(cip)
+    struct cpuinfo *cip;
+
+int
+cpuinfo_get_frequency_confidence(cip)
+    struct cpuinfo *cip;
+
 int
 cpuinfo_get_socket(cip)
     struct cpuinfo *cip;
@@ -81,12 +118,17 @@ int
 cpuinfo_get_threads(cip)
     struct cpuinfo *cip;
 
+unsigned int
+cpuinfo_get_microcode(cip)
+    struct cpuinfo *cip;
+
 void
 cpuinfo_get_caches(cip)
     struct cpuinfo *cip;
 PREINIT:
     int i;
     const cpuinfo_cache_t *ccp;
+    const cpuinfo_cache_geometry_t *cgp;
 PPCODE:
     ccp = cpuinfo_get_caches(cip);
     if (ccp && ccp->count > 0) {
@@ -97,10 +139,221 @@ PPCODE:
 	    hv_store(rh, "type",  4, newSVnv(cdp->type), 0);
 	    hv_store(rh, "level", 5, newSVnv(cdp->level), 0);
 	    hv_store(rh, "size",  4, newSVnv(cdp->size), 0);
+	    if ((cgp = cpuinfo_get_cache_geometry(cip, i)) != NULL) {
+		hv_store(rh, "line_size",  9, newSVnv(cgp->line_size), 0);
+		hv_store(rh, "ways",       4, newSVnv(cgp->ways), 0);
+		hv_store(rh, "sets",       4, newSVnv(cgp->sets), 0);
+		hv_store(rh, "partitions", 10, newSVnv(cgp->partitions), 0);
+		hv_store(rh, "flags",      5, newSVnv(cgp->flags), 0);
+	    }
 	    PUSHs(sv_2mortal(newRV((SV *)rh)));
 	}
     }
 
+void
+cpuinfo_get_cache_instances(cip)
+    struct cpuinfo *cip;
+PREINIT:
+    int i, cpu;
+    const cpuinfo_cache_instances_t *cip_instances;
+PPCODE:
+    cip_instances = cpuinfo_get_cache_instances(cip);
+    if (cip_instances && cip_instances->count > 0) {
+	EXTEND(SP, cip_instances->count);
+	for (i = 0; i < cip_instances->count; i++) {
+	    const cpuinfo_cache_instance_t *cp = &cip_instances->instances[i];
+	    HV *rh = newHV();
+	    AV *cpus = newAV();
+	    for (cpu = 0; cpu < CPUINFO_CPUSET_SIZE; cpu++) {
+		if (cpuinfo_cpuset_isset(&cp->cpus, cpu))
+		    av_push(cpus, newSVnv(cpu));
+	    }
+	    hv_store(rh, "id",    2, newSVnv(cp->id), 0);
+	    hv_store(rh, "type",  4, newSVnv(cp->type), 0);
+	    hv_store(rh, "level", 5, newSVnv(cp->level), 0);
+	    hv_store(rh, "size",  4, newSVnv(cp->size), 0);
+	    hv_store(rh, "cpus",  4, newRV_noinc((SV *)cpus), 0);
+	    PUSHs(sv_2mortal(newRV((SV *)rh)));
+	}
+    }
+
+void
+cpuinfo_measure_caches(cip)
+    struct cpuinfo *cip;
+PREINIT:
+    int i;
+    const cpuinfo_cache_measurement_t *cmp;
+PPCODE:
+    if ((cmp = cpuinfo_measure_caches(cip)) != NULL) {
+	HV *rh = newHV();
+	AV *caches = newAV();
+	for (i = 0; i < cmp->count; i++) {
+	    const cpuinfo_measured_cache_t *mcp = &cmp->caches[i];
+	    HV *ch = newHV();
+	    hv_store(ch, "type",  4, newSVnv(mcp->type), 0);
+	    hv_store(ch, "level", 5, newSVnv(mcp->level), 0);
+	    hv_store(ch, "size",  4, newSVnv(mcp->size), 0);
+	    hv_store(ch, "flags", 5, newSVnv(mcp->flags), 0);
+	    hv_store(ch, "latency_ns", 10, newSVnv(mcp->latency_ns), 0);
+	    hv_store(ch, "latency_cycles", 14, newSVnv(mcp->latency_cycles), 0);
+	    av_push(caches, newRV_noinc((SV *)ch));
+	}
+	hv_store(rh, "caches", 6, newRV_noinc((SV *)caches), 0);
+	hv_store(rh, "memory_latency_ns", 17, newSVnv(cmp->memory_latency_ns), 0);
+	hv_store(rh, "memory_latency_cycles", 21, newSVnv(cmp->memory_latency_cycles), 0);
+	XPUSHs(sv_2mortal(newRV_noinc((SV *)rh)));
+    }
+
+void
+cpuinfo_measure_bandwidth(cip, cpus = NULL, node = -1)
+    struct cpuinfo *cip;
+    const char *cpus;
+    int node;
+PREINIT:
+    int i;
+    cpuinfo_bandwidth_config_t config;
+    const cpuinfo_bandwidth_t *bp;
+PPCODE:
+    memset(&config, 0, sizeof(config));
+    config.node = node;
+    if (cpus && cpuinfo_cpuset_parse(cpus, &config.cpus) < 0)
+	XSRETURN_EMPTY;
+    if ((bp = cpuinfo_measure_bandwidth(cip, (cpus || node >= 0) ? &config : NULL)) != NULL) {
+	HV *rh = newHV();
+	HV *kernels = newHV();
+	AV *loaded = newAV();
+	for (i = 0; i < CPUINFO_BANDWIDTH_KERNELS; i++) {
+	    const char *name = cpuinfo_string_of_bandwidth_kernel(i);
+	    hv_store(kernels, name, strlen(name), newSVnv(bp->bandwidth[i]), 0);
+	}
+	for (i = 0; i < bp->n_loaded_latencies; i++) {
+	    HV *lh = newHV();
+	    hv_store(lh, "bandwidth",  9, newSVnv(bp->loaded_latencies[i].bandwidth), 0);
+	    hv_store(lh, "latency_ns", 10, newSVnv(bp->loaded_latencies[i].latency_ns), 0);
+	    av_push(loaded, newRV_noinc((SV *)lh));
+	}
+	hv_store(rh, "n_threads", 9, newSVnv(bp->n_threads), 0);
+	hv_store(rh, "node",      4, newSVnv(bp->node), 0);
+	hv_store(rh, "size",      4, newSVnv(bp->size), 0);
+	hv_store(rh, "kernels",   7, newRV_noinc((SV *)kernels), 0);
+	hv_store(rh, "loaded_latencies", 16, newRV_noinc((SV *)loaded), 0);
+	XPUSHs(sv_2mortal(newRV_noinc((SV *)rh)));
+    }
+
+void
+cpuinfo_get_topology(cip)
+    struct cpuinfo *cip;
+PREINIT:
+    int i;
+    const cpuinfo_topology_t *tp;
+PPCODE:
+    tp = cpuinfo_get_topology(cip);
+    if (tp && tp->n_cpus > 0 && tp->cpus) {
+	EXTEND(SP, tp->n_cpus);
+	for (i = 0; i < tp->n_cpus; i++) {
+	    const cpuinfo_topology_cpu_t *cp = &tp->cpus[i];
+	    HV *rh = newHV();
+	    hv_store(rh, "cpu",     3, newSVnv(cp->cpu), 0);
+	    hv_store(rh, "package", 7, newSVnv(cp->package), 0);
+	    hv_store(rh, "die",     3, newSVnv(cp->die), 0);
+	    hv_store(rh, "core",    4, newSVnv(cp->core), 0);
+	    hv_store(rh, "thread",  6, newSVnv(cp->thread), 0);
+	    hv_store(rh, "node",    4, newSVnv(cp->node), 0);
+	    hv_store(rh, "core_class", 10, newSVnv(cp->core_class), 0);
+	    hv_store(rh, "capacity", 8, newSVnv(cp->capacity), 0);
+	    PUSHs(sv_2mortal(newRV((SV *)rh)));
+	}
+    }
+
+void
+cpuinfo_get_fastest_cpus(cip)
+    struct cpuinfo *cip;
+PREINIT:
+    int cpu;
+    cpuinfo_cpuset_t set;
+PPCODE:
+    if (cpuinfo_get_fastest_cpus(cip, &set) > 0) {
+	for (cpu = 0; cpu < CPUINFO_CPUSET_SIZE; cpu++) {
+	    if (cpuinfo_cpuset_isset(&set, cpu))
+		XPUSHs(sv_2mortal(newSVnv(cpu)));
+	}
+    }
+
+void
+cpuinfo_get_parallelism(cip)
+    struct cpuinfo *cip;
+PREINIT:
+    int cpu;
+    cpuinfo_parallelism_t p;
+PPCODE:
+    if (cpuinfo_get_parallelism(cip, &p) == 0) {
+	HV *rh = newHV();
+	AV *cpus = newAV();
+	for (cpu = 0; cpu < CPUINFO_CPUSET_SIZE; cpu++) {
+	    if (cpuinfo_cpuset_isset(&p.cpus, cpu))
+		av_push(cpus, newSVnv(cpu));
+	}
+	hv_store(rh, "cpus",   4, newRV_noinc((SV *)cpus), 0);
+	hv_store(rh, "n_cpus", 6, newSVnv(p.n_cpus), 0);
+	hv_store(rh, "budget", 6, newSVnv(p.budget), 0);
+	XPUSHs(sv_2mortal(newRV_noinc((SV *)rh)));
+    }
+
+int
+cpuinfo_get_usable_cpus(cip)
+    struct cpuinfo *cip;
+
+int
+cpuinfo_get_heterogeneity(cip)
+    struct cpuinfo *cip;
+
+void
+cpuinfo_get_feature_cpus(cip, feature)
+    struct cpuinfo *cip;
+    int feature;
+PREINIT:
+    int cpu;
+    cpuinfo_cpuset_t set;
+PPCODE:
+    if (cpuinfo_get_feature_cpus(cip, feature, &set) > 0) {
+	for (cpu = 0; cpu < CPUINFO_CPUSET_SIZE; cpu++) {
+	    if (cpuinfo_cpuset_isset(&set, cpu))
+		XPUSHs(sv_2mortal(newSVnv(cpu)));
+	}
+    }
+
+void
+cpuinfo_get_numa_nodes(cip)
+    struct cpuinfo *cip;
+PREINIT:
+    int i, cpu;
+    const cpuinfo_numa_t *np;
+PPCODE:
+    np = cpuinfo_get_numa_nodes(cip);
+    if (np && np->count > 0) {
+	EXTEND(SP, np->count);
+	for (i = 0; i < np->count; i++) {
+	    const cpuinfo_numa_node_t *nnp = &np->nodes[i];
+	    HV *rh = newHV();
+	    AV *cpus = newAV();
+	    for (cpu = 0; cpu < CPUINFO_CPUSET_SIZE; cpu++) {
+		if (cpuinfo_cpuset_isset(&nnp->cpus, cpu))
+		    av_push(cpus, newSVnv(cpu));
+	    }
+	    hv_store(rh, "id",           2, newSVnv(nnp->id), 0);
+	    hv_store(rh, "cpus",         4, newRV_noinc((SV *)cpus), 0);
+	    hv_store(rh, "memory_total", 12, newSVnv(nnp->memory_total), 0);
+	    hv_store(rh, "memory_free",  11, newSVnv(nnp->memory_free), 0);
+	    PUSHs(sv_2mortal(newRV((SV *)rh)));
+	}
+    }
+
+int
+cpuinfo_get_numa_distance(cip, from, to)
+    struct cpuinfo *cip;
+    int from;
+    int to;
+
 int
 cpuinfo_has_feature(cip, feature)
     struct cpuinfo *cip;
@@ -114,6 +367,14 @@ const char *
 cpuinfo_string_of_socket(socket)
     int socket;
 
+const char *
+cpuinfo_string_of_frequency_source(source)
+    int source;
+
+const char *
+cpuinfo_string_of_core_class(core_class)
+    int core_class;
+
 const char *
 cpuinfo_string_of_cache_type(cache_type)
     int cache_type;
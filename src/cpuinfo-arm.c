@@ -57,10 +57,9 @@ typedef struct arm_cpuinfo arm_cpuinfo_t;
 // Returns a new cpuinfo descriptor
 int cpuinfo_arch_new(struct cpuinfo *cip)
 {
-  arm_cpuinfo_t *p = (arm_cpuinfo_t *)malloc(sizeof(*p));
+  arm_cpuinfo_t *p = (arm_cpuinfo_t *)cpuinfo_arena_alloc(cip, sizeof(*p));
   if (p == NULL)
 	return -1;
-  memset(p->features, 0, sizeof(p->features));
   cip->opaque = p;
   return 0;
 
@@ -70,8 +69,33 @@ int cpuinfo_arch_new(struct cpuinfo *cip)
 // Release the cpuinfo descriptor and all allocated data
 void cpuinfo_arch_destroy(struct cpuinfo *cip)
 {
-  if (cip->opaque)
-	free(cip->opaque);
+}
+
+// Get processor signature (none, the boot ID covers it)
+uint64_t cpuinfo_arch_get_signature(void)
+{
+    return 0;
+}
+
+// Serialize arch-dependent data
+int cpuinfo_arch_save(struct cpuinfo *cip, void *buf, int size)
+{
+    if (buf && size >= (int)sizeof(arm_cpuinfo_t))
+	memcpy(buf, cip->opaque, sizeof(arm_cpuinfo_t));
+    return sizeof(arm_cpuinfo_t);
+}
+
+// Restore arch-dependent data
+int cpuinfo_arch_load(struct cpuinfo *cip, const void *data, int size)
+{
+    if (size != sizeof(arm_cpuinfo_t))
+	return -1;
+    arm_cpuinfo_t *p = (arm_cpuinfo_t *)cpuinfo_arena_alloc(cip, sizeof(*p));
+    if (p == NULL)
+	return -1;
+    memcpy(p, data, sizeof(*p));
+    cip->opaque = p;
+    return 0;
 }
 
 int cpuinfo_dump(struct cpuinfo *cip, FILE *out)
@@ -79,6 +103,12 @@ int cpuinfo_dump(struct cpuinfo *cip, FILE *out)
     return 0;
 }
 
+// Dump raw identification registers (unsupported)
+int cpuinfo_dump_raw(struct cpuinfo *cip, FILE *out)
+{
+    return -1;
+}
+
 int cpuinfo_arch_get_vendor(struct cpuinfo *cip)
 {
     return 0;
@@ -87,14 +117,25 @@ int cpuinfo_arch_get_vendor(struct cpuinfo *cip)
 // Get processor name
 char *cpuinfo_arch_get_model(struct cpuinfo *cip)
 {
-    return read_sys_str("devices/system/cpu/cpu0/of_node/compatible");
+    // list of NUL-separated strings, the first one is the most specific
+    char str[256];
+    if (cpuinfo_sysfs_read_cpu(0, "of_node/compatible", str, sizeof(str)) <= 0)
+	return NULL;
+    return cpuinfo_arena_strdup(cip, str);
 }
 
 // Get processor frequency in MHz
 int cpuinfo_arch_get_frequency(struct cpuinfo *cip)
 {
-    int freq = read_sys_int("bus/cpu/devices/cpu0/of_node/clock-frequency");
-    return freq/1000000;
+    // device tree cells are big-endian, either 32 or 64 bits wide
+    unsigned char cells[8 + 1];
+    unsigned long long freq = 0;
+    int i, n = cpuinfo_sysfs_read_cpu(0, "of_node/clock-frequency", (char *)cells, sizeof(cells));
+    if (n != 4 && n != 8)
+	return -1;
+    for (i = 0; i < n; i++)
+	freq = (freq << 8) | cells[i];
+    return freq / 1000000;
 }
 
 int cpuinfo_arch_get_socket(struct cpuinfo *cip)
@@ -105,9 +146,9 @@ int cpuinfo_arch_get_socket(struct cpuinfo *cip)
 // Get number of cores per CPU package
 int cpuinfo_arch_get_cores(struct cpuinfo *cip)
 {
-    int cores = read_sys_int_str("devices/system/cpu/kernel_max");
-
-    return ++cores;
+    // kernel_max is the highest CPU number the kernel supports, count
+    // online CPUs instead, as a single package without SMT
+    return sysconf(_SC_NPROCESSORS_ONLN);
 }
 
 // Get number of threads per CPU core
@@ -116,9 +157,39 @@ int cpuinfo_arch_get_threads(struct cpuinfo *cip)
     return 1;
 }
 
-cpuinfo_list_t cpuinfo_arch_get_caches(struct cpuinfo *cip)
+int cpuinfo_arch_get_caches(struct cpuinfo *cip, cpuinfo_cache_list_t *caches_list)
 {
-    return NULL;
+    return 0;
+}
+
+// Get topology of each logical CPU
+int cpuinfo_arch_get_cpu_topology(struct cpuinfo *cip, cpuinfo_topology_cpu_t *cpus, int max_cpus)
+{
+    return 0;
+}
+
+// Get core class of a logical CPU
+int cpuinfo_arch_get_core_class(struct cpuinfo *cip, int cpu)
+{
+    return CPUINFO_CORE_CLASS_UNKNOWN;
+}
+
+// Get number of logical CPUs sharing a cache
+int cpuinfo_arch_get_cache_sharing(struct cpuinfo *cip, int level, int type)
+{
+    return -1;
+}
+
+// Get differences between logical CPUs (-1 if unknown)
+int cpuinfo_arch_get_heterogeneity(struct cpuinfo *cip)
+{
+    return -1;
+}
+
+// Get logical CPUs supporting the specified feature (-1 if unknown)
+int cpuinfo_arch_get_feature_cpus(struct cpuinfo *cip, int feature, cpuinfo_cpuset_t *set)
+{
+    return -1;
 }
 
 // Returns features table
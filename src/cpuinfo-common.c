@@ -18,6 +18,7 @@
  *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
  */
 
+#define _GNU_SOURCE 1
 #include "sysdeps.h"
 #include <signal.h>
 #include <setjmp.h>
@@ -25,11 +26,14 @@
 #include <stdalign.h>
 #include <string.h>
 #include <sys/types.h>
-#include <sys/stat.h>
 #include <unistd.h>
-#include <fcntl.h>
-#define _BSD_SOURCE             /* See feature_test_macros(7) */
-#include <endian.h>
+#include <sys/mman.h>
+#include <pthread.h>
+#include <limits.h>
+#include <dirent.h>
+#if defined __linux__
+#include <sched.h>
+#endif
 
 
 #include "cpuinfo.h"
@@ -42,23 +46,52 @@
 cpuinfo_feature_t cpuinfo_feature_common = CPUINFO_FEATURE_COMMON,
 		  cpuinfo_feature_common_max = CPUINFO_FEATURE_COMMON_MAX;
 
-// Returns a new cpuinfo descriptor
-cpuinfo_t *cpuinfo_new(void)
+static void arena_release(cpuinfo_arena_t *ap);
+
+// Allocate a descriptor with nothing determined yet, nor arch-dependent data
+cpuinfo_t *cpuinfo_alloc(void)
 {
   cpuinfo_t *cip = (cpuinfo_t *)malloc(sizeof(*cip));
   if (cip) {
 	cip->vendor = -1;
 	cip->model = NULL;
 	cip->frequency = -1;
+	cip->frequency_source = CPUINFO_FREQUENCY_SOURCE_UNKNOWN;
+	cip->frequency_confidence = 0;
 	cip->socket = -1;
 	cip->n_cores = -1;
 	cip->n_threads = -1;
+	cip->microcode = -1;
 	cip->cache_info.count = -1;
 	cip->cache_info.descriptors = NULL;
+	cip->cache_geometry = NULL;
+	memset(&cip->topology, 0, sizeof(cip->topology));
+	cip->topology.n_cpus = -1;
+	memset(&cip->numa, 0, sizeof(cip->numa));
+	cip->numa.count = -1;
+	cip->cache_instances.count = -1;
+	cip->cache_instances.instances = NULL;
+	cip->cache_measurement = NULL;
+	cip->bandwidth = NULL;
 	cip->opaque = NULL;
+	cip->mapping = NULL;
+	cip->mapping_size = 0;
+	cip->cache_key = 0;
 	memset(cip->features, 0, sizeof(cip->features));
+	cip->arena.ptr = (char *)(((uintptr_t)cip->arena.data + 15) & ~(uintptr_t)15);
+	cip->arena.end = (char *)cip->arena.data + sizeof(cip->arena.data);
+	cip->arena.chunks = NULL;
+  }
+  return cip;
+}
+
+// Returns a new cpuinfo descriptor
+cpuinfo_t *cpuinfo_new(void)
+{
+  cpuinfo_t *cip = cpuinfo_alloc();
+  if (cip) {
 	if (cpuinfo_arch_new(cip) < 0) {
-	  free(cip);
+	  cpuinfo_destroy(cip);
 	  return NULL;
 	}
 	cpuinfo_get_endian(cip);
@@ -71,10 +104,9 @@ void cpuinfo_destroy(cpuinfo_t *cip)
 {
   if (cip) {
 	cpuinfo_arch_destroy(cip);
-	if (cip->model)
-	  free(cip->model);
-	if (cip->cache_info.descriptors)
-	  free((void *)cip->cache_info.descriptors);
+	if (cip->mapping)
+	  munmap(cip->mapping, cip->mapping_size);
+	arena_release(&cip->arena);
 	free(cip);
   }
 }
@@ -115,12 +147,8 @@ const char *cpuinfo_get_model(cpuinfo_t *cip)
 	return NULL;
   if (cip->model == NULL) {
 	cip->model = cpuinfo_arch_get_model(cip);
-	if (cip->model == NULL) {
-	  static const char unknown_model[] = "<unknown>";
-	  if ((cip->model = (char *)malloc(sizeof(unknown_model))) == NULL)
-		return NULL;
-	  strcpy(cip->model, unknown_model);
-	}
+	if (cip->model == NULL)
+	  cip->model = cpuinfo_arena_strdup(cip, "<unknown>");
   }
   return cip->model;
 }
@@ -130,11 +158,33 @@ int cpuinfo_get_frequency(cpuinfo_t *cip)
 {
   if (cip == NULL)
 	return -1;
-  if (cip->frequency <= 0)
+  if (cip->frequency <= 0) {
 	cip->frequency = cpuinfo_arch_get_frequency(cip);
+	// arch code that does not tell otherwise got it from the platform
+	if (cip->frequency > 0 && cip->frequency_source == CPUINFO_FREQUENCY_SOURCE_UNKNOWN) {
+	  cip->frequency_source = CPUINFO_FREQUENCY_SOURCE_OS;
+	  cip->frequency_confidence = 100;
+	}
+  }
   return cip->frequency;
 }
 
+// Get how the processor frequency was determined
+int cpuinfo_get_frequency_source(cpuinfo_t *cip)
+{
+  if (cpuinfo_get_frequency(cip) <= 0)
+	return CPUINFO_FREQUENCY_SOURCE_UNKNOWN;
+  return cip->frequency_source;
+}
+
+// Get confidence in the processor frequency, in percent
+int cpuinfo_get_frequency_confidence(cpuinfo_t *cip)
+{
+  if (cpuinfo_get_frequency(cip) <= 0)
+	return 0;
+  return cip->frequency_confidence;
+}
+
 // Get processor socket ID
 int cpuinfo_get_socket(cpuinfo_t *cip)
 {
@@ -154,7 +204,8 @@ int cpuinfo_get_cores(cpuinfo_t *cip)
   if (cip == NULL)
 	return -1;
   if (cip->n_cores < 0) {
-	cip->n_cores = cpuinfo_arch_get_cores(cip);
+	const cpuinfo_topology_t *tp = cpuinfo_get_topology(cip);
+	cip->n_cores = tp->n_packages > 0 ? tp->n_cores / tp->n_packages : 1;
 	if (cip->n_cores < 1)
 	  cip->n_cores = 1;
   }
@@ -167,18 +218,935 @@ int cpuinfo_get_threads(cpuinfo_t *cip)
   if (cip == NULL)
 	return -1;
   if (cip->n_threads < 0) {
-	cip->n_threads = cpuinfo_arch_get_threads(cip);
+	const cpuinfo_topology_t *tp = cpuinfo_get_topology(cip);
+	cip->n_threads = tp->n_cores > 0 ? tp->n_cpus / tp->n_cores : 1;
 	if (cip->n_threads < 1)
 	  cip->n_threads = 1;
   }
   return cip->n_threads;
 }
 
+#define SYSFS_CPU_PATH "devices/system/cpu"
+
+// Get microcode revision, as reported by the OS (0 if unknown)
+unsigned int cpuinfo_get_microcode(cpuinfo_t *cip)
+{
+  if (cip == NULL)
+	return 0;
+  if (cip->microcode < 0) {
+	char str[32];
+	cip->microcode = 0;
+	if (cpuinfo_sysfs_read_cpu(0, "microcode/version", str, sizeof(str)) > 0)
+	  cip->microcode = strtoul(str, NULL, 0);
+	else {
+	  cpuinfo_proc_t *pp = cpuinfo_proc_parse();
+	  if (pp) {
+		if (pp->n_cpus > 0)
+		  cip->microcode = pp->cpus[0].microcode;
+		cpuinfo_proc_destroy(pp);
+	  }
+	}
+  }
+  return cip->microcode;
+}
+
+// Read a sysfs cache attribute of a CPU
+static int read_sys_cache_str(int cpu, int index, const char *name, char *str, int size)
+{
+  char path[64];
+  snprintf(path, sizeof(path), "cache/index%d/%s", index, name);
+  return cpuinfo_sysfs_read_cpu(cpu, path, str, size) < 0 ? -1 : 0;
+}
+
+static int read_sys_cache_int(int cpu, int index, const char *name, int *value)
+{
+  char str[32];
+  if (read_sys_cache_str(cpu, index, name, str, sizeof(str)) < 0)
+	return -1;
+  char *end;
+  *value = strtol(str, &end, 10);
+  if (*end == 'M')
+	*value *= 1024;
+  return end == str ? -1 : 0;
+}
+
+static int read_sys_cache_type(int cpu, int index)
+{
+  char str[32];
+  if (read_sys_cache_str(cpu, index, "type", str, sizeof(str)) == 0) {
+	if (strncmp(str, "Data", 4) == 0)
+	  return CPUINFO_CACHE_TYPE_DATA;
+	if (strncmp(str, "Instruction", 11) == 0)
+	  return CPUINFO_CACHE_TYPE_CODE;
+	if (strncmp(str, "Unified", 7) == 0)
+	  return CPUINFO_CACHE_TYPE_UNIFIED;
+  }
+  return CPUINFO_CACHE_TYPE_UNKNOWN;
+}
+
+// Read geometry of a sysfs cache (returns -1 if the cache does not exist)
+static int read_sys_cache_geometry(int cpu, int index, cpuinfo_cache_geometry_t *cgp)
+{
+  memset(cgp, 0, sizeof(*cgp));
+  if (read_sys_cache_int(cpu, index, "level", &cgp->level) < 0)
+	return -1;
+  cgp->type = read_sys_cache_type(cpu, index);
+  read_sys_cache_int(cpu, index, "size", &cgp->size);
+  read_sys_cache_int(cpu, index, "coherency_line_size", &cgp->line_size);
+  read_sys_cache_int(cpu, index, "ways_of_associativity", &cgp->ways);
+  read_sys_cache_int(cpu, index, "number_of_sets", &cgp->sets);
+  read_sys_cache_int(cpu, index, "physical_line_partition", &cgp->partitions);
+  return 0;
+}
+
+// Get number of logical CPUs in the set
+int cpuinfo_cpuset_count(const cpuinfo_cpuset_t *set)
+{
+  int i, n = 0;
+  for (i = 0; i < CPUINFO_CPUSET_SIZE / 32; i++)
+	n += __builtin_popcount(set->bits[i]);
+  return n;
+}
+
+// Get the lowest logical CPU of the set (-1 if empty)
+int cpuinfo_cpuset_first(const cpuinfo_cpuset_t *set)
+{
+  int i;
+  for (i = 0; i < CPUINFO_CPUSET_SIZE / 32; i++) {
+	if (set->bits[i])
+	  return i * 32 + __builtin_ctz(set->bits[i]);
+  }
+  return -1;
+}
+
+// Parse a CPU list ("0-3,8,10-11") into SET
+int cpuinfo_cpuset_parse(const char *str, cpuinfo_cpuset_t *set)
+{
+  memset(set, 0, sizeof(*set));
+  if (str == NULL || cpuinfo_parse_cpu_list(str, NULL, set) == 0)
+	return -1;
+  return cpuinfo_cpuset_count(set);
+}
+
+static inline void cpuset_set(cpuinfo_cpuset_t *set, int cpu)
+{
+  if (cpu >= 0 && cpu < CPUINFO_CPUSET_SIZE)
+	set->bits[cpu / 32] |= 1U << (cpu % 32);
+}
+
+static int topology_cpu_compare(const void *a, const void *b)
+{
+  const cpuinfo_topology_cpu_t *cpa = (const cpuinfo_topology_cpu_t *)a;
+  const cpuinfo_topology_cpu_t *cpb = (const cpuinfo_topology_cpu_t *)b;
+  if (cpa->package != cpb->package)
+	return cpa->package - cpb->package;
+  if (cpa->die != cpb->die)
+	return cpa->die - cpb->die;
+  if (cpa->core != cpb->core)
+	return cpa->core - cpb->core;
+  return cpa->cpu - cpb->cpu;
+}
+
+static int topology_cpu_compare_id(const void *a, const void *b)
+{
+  return ((const cpuinfo_topology_cpu_t *)a)->cpu - ((const cpuinfo_topology_cpu_t *)b)->cpu;
+}
+
+// Get topology of online CPUs from sysfs
+static cpuinfo_topology_cpu_t *topology_from_sysfs(cpuinfo_t *cip, int *n_cpus)
+{
+  char line[4096];
+  if (cpuinfo_sysfs_read(SYSFS_CPU_PATH "/online", line, sizeof(line)) < 0)
+	return NULL;
+  int n = 0;
+  int *ids = NULL;
+  if ((n = cpuinfo_parse_cpu_list(line, NULL, NULL)) == 0 || (ids = (int *)malloc(n * sizeof(*ids))) == NULL)
+	return NULL;
+  cpuinfo_parse_cpu_list(line, ids, NULL);
+
+  cpuinfo_topology_cpu_t *cpus = (cpuinfo_topology_cpu_t *)cpuinfo_arena_alloc(cip, n * sizeof(*cpus));
+  int i;
+  for (i = 0; cpus && i < n; i++) {
+	cpuinfo_topology_cpu_t *cp = &cpus[i];
+	cp->cpu = ids[i];
+	if (cpuinfo_sysfs_read_cpu_int(ids[i], "topology/physical_package_id", &cp->package) < 0 ||
+		cpuinfo_sysfs_read_cpu_int(ids[i], "topology/core_id", &cp->core) < 0) {
+	  D(bug("cpuinfo_get_topology: no sysfs topology for cpu%d\n", ids[i]));
+	  cpus = NULL;
+	  break;
+	}
+	// older kernels have no die level, some report no package
+	if (cpuinfo_sysfs_read_cpu_int(ids[i], "topology/die_id", &cp->die) < 0 || cp->die < 0)
+	  cp->die = 0;
+	if (cp->package < 0)
+	  cp->package = 0;
+  }
+  free(ids);
+  if (cpus)
+	*n_cpus = n;
+  return cpus;
+}
+
+// Get topology from the processor: IDs of each logical CPU if it can tell
+// them, or else a single package, assuming contiguous CPU numbers
+static cpuinfo_topology_cpu_t *topology_from_arch(cpuinfo_t *cip, int *n_cpus)
+{
+  cpuinfo_topology_cpu_t *records = (cpuinfo_topology_cpu_t *)malloc(CPUINFO_CPUSET_SIZE * sizeof(*records));
+  if (records) {
+	int n = cpuinfo_arch_get_cpu_topology(cip, records, CPUINFO_CPUSET_SIZE);
+	cpuinfo_topology_cpu_t *cpus = n > 0 ? (cpuinfo_topology_cpu_t *)cpuinfo_arena_alloc(cip, n * sizeof(*cpus)) : NULL;
+	if (cpus)
+	  memcpy(cpus, records, n * sizeof(*cpus));
+	free(records);
+	if (cpus) {
+	  *n_cpus = n;
+	  return cpus;
+	}
+  }
+
+  int n_cores = cpuinfo_arch_get_cores(cip);
+  int n_threads = cpuinfo_arch_get_threads(cip);
+  if (n_cores < 1)
+	n_cores = 1;
+  if (n_threads < 1)
+	n_threads = 1;
+
+  int i, n = n_cores * n_threads;
+  cpuinfo_topology_cpu_t *cpus = (cpuinfo_topology_cpu_t *)cpuinfo_arena_alloc(cip, n * sizeof(*cpus));
+  if (cpus == NULL)
+	return NULL;
+  for (i = 0; i < n; i++) {
+	cpus[i].cpu = i;
+	cpus[i].package = 0;
+	cpus[i].die = 0;
+	cpus[i].core = i / n_threads;
+  }
+  *n_cpus = n;
+  return cpus;
+}
+
+#define CPU_CAPACITY_MAX 1024
+#define PMU_CLUSTERS_MAX 16
+
+// Core PMU covering part of the logical CPUs
+typedef struct {
+  cpuinfo_cpuset_t cpus;
+  int core_class;		// from the PMU name, CPUINFO_CORE_CLASS_UNKNOWN if generic
+  long long capacity;	// sum of the capacities of its CPUs
+  int n_cpus;			// CPUs with a known capacity
+} pmu_cluster_t;
+
+// Read core PMUs of hybrid processors: cpu_core and cpu_atom on Intel, one
+// per cluster on ARM big.LITTLE (e.g. armv8_cortex_a55). Returns the number
+// of PMUs, 0 unless CPUs are split between two or more
+static int topology_read_pmus(pmu_cluster_t *clusters, int max_clusters)
+{
+  char path[PATH_MAX];
+  struct dirent *de;
+  int n = 0;
+  snprintf(path, sizeof(path), "%s/devices", cpuinfo_sysfs_root());
+  DIR *d = opendir(path);
+  if (d == NULL)
+	return 0;
+  while ((de = readdir(d)) != NULL && n < max_clusters) {
+	pmu_cluster_t *pcp = &clusters[n];
+	if (de->d_name[0] == '.' || strcmp(de->d_name, "system") == 0)
+	  continue;
+	// only core PMUs list the CPUs they count on
+	snprintf(path, sizeof(path), "devices/%s/cpus", de->d_name);
+	if (cpuinfo_sysfs_read_cpu_list(path, &pcp->cpus) < 0 || cpuinfo_cpuset_count(&pcp->cpus) == 0)
+	  continue;
+	if (strcmp(de->d_name, "cpu_core") == 0)
+	  pcp->core_class = CPUINFO_CORE_CLASS_PERFORMANCE;
+	else if (strcmp(de->d_name, "cpu_atom") == 0)
+	  pcp->core_class = CPUINFO_CORE_CLASS_EFFICIENCY;
+	else
+	  pcp->core_class = CPUINFO_CORE_CLASS_UNKNOWN;
+	pcp->capacity = 0;
+	pcp->n_cpus = 0;
+	D(bug("topology_read_pmus: %s\n", de->d_name));
+	n++;
+  }
+  closedir(d);
+  return n >= 2 ? n : 0;
+}
+
+// Get the PMU counting on a logical CPU (NULL if none)
+static pmu_cluster_t *topology_pmu_of(pmu_cluster_t *clusters, int n_clusters, int cpu)
+{
+  int i;
+  for (i = 0; i < n_clusters; i++) {
+	if (cpuinfo_cpuset_isset(&clusters[i].cpus, cpu))
+	  return &clusters[i];
+  }
+  return NULL;
+}
+
+// Classify cores of hybrid processors and estimate their relative capacity
+static void topology_classify(cpuinfo_t *cip, cpuinfo_topology_cpu_t *cpus, int n_cpus)
+{
+  int i, min_capacity = INT_MAX, max_capacity = 0;
+  if (n_cpus <= 0)
+	return;
+
+  // CPUs of a hybrid PMU are the same kind of core
+  int n_clusters = 0;
+  pmu_cluster_t *clusters = (pmu_cluster_t *)malloc(PMU_CLUSTERS_MAX * sizeof(*clusters));
+  if (clusters)
+	n_clusters = topology_read_pmus(clusters, PMU_CLUSTERS_MAX);
+
+  // scheduler capacity (ARM), or else maximum frequency
+  const char *capacity_attr = "cpu_capacity";
+  if (cpuinfo_sysfs_read_cpu_int(cpus[0].cpu, capacity_attr, &cpus[0].capacity) < 0)
+	capacity_attr = "cpufreq/cpuinfo_max_freq";
+
+  for (i = 0; i < n_cpus; i++) {
+	cpuinfo_topology_cpu_t *cp = &cpus[i];
+	pmu_cluster_t *pcp = topology_pmu_of(clusters, n_clusters, cp->cpu);
+	cp->core_class = pcp ? pcp->core_class : CPUINFO_CORE_CLASS_UNKNOWN;
+
+	if (cpuinfo_sysfs_read_cpu_int(cp->cpu, capacity_attr, &cp->capacity) < 0 || cp->capacity <= 0)
+	  cp->capacity = 0;
+	if (min_capacity > cp->capacity)
+	  min_capacity = cp->capacity;
+	if (max_capacity < cp->capacity)
+	  max_capacity = cp->capacity;
+	if (pcp && cp->capacity > 0) {
+	  pcp->capacity += cp->capacity;
+	  pcp->n_cpus++;
+	}
+  }
+
+  for (i = 0; i < n_cpus; i++) {
+	cpuinfo_topology_cpu_t *cp = &cpus[i];
+	if (cp->core_class == CPUINFO_CORE_CLASS_UNKNOWN) {
+	  if (min_capacity > 0 && min_capacity < max_capacity) {
+		// split halfway between the extremes, by the average capacity of
+		// the cluster for CPUs with a hybrid PMU
+		const pmu_cluster_t *pcp = topology_pmu_of(clusters, n_clusters, cp->cpu);
+		long long capacity = pcp && pcp->n_cpus > 0 ? pcp->capacity / pcp->n_cpus : cp->capacity;
+		if (2 * capacity > min_capacity + max_capacity)
+		  cp->core_class = CPUINFO_CORE_CLASS_PERFORMANCE;
+		else
+		  cp->core_class = CPUINFO_CORE_CLASS_EFFICIENCY;
+	  }
+	  else {
+		// nothing in sysfs tells cores apart, ask the processor last as it
+		// may have to run code on every logical CPU
+		cp->core_class = cpuinfo_arch_get_core_class(cip, cp->cpu);
+		if (cp->core_class == CPUINFO_CORE_CLASS_UNKNOWN && min_capacity > 0)
+		  cp->core_class = CPUINFO_CORE_CLASS_PERFORMANCE;
+	  }
+	}
+	if (min_capacity > 0)
+	  cp->capacity = ((long long)cp->capacity * CPU_CAPACITY_MAX) / max_capacity;
+	else {
+	  // no measure at all, little cores are assumed to run at half speed
+	  cp->capacity = CPU_CAPACITY_MAX;
+	  if (cp->core_class == CPUINFO_CORE_CLASS_EFFICIENCY)
+		cp->capacity /= 2;
+	}
+  }
+  free(clusters);
+}
+
+// Get logical CPUs topology (returns read-only records)
+const cpuinfo_topology_t *cpuinfo_get_topology(cpuinfo_t *cip)
+{
+  if (cip == NULL)
+	return NULL;
+  if (cip->topology.n_cpus < 0) {
+	int i, n_cpus = 0;
+	cpuinfo_topology_cpu_t *cpus = topology_from_sysfs(cip, &n_cpus);
+	if (cpus == NULL)
+	  cpus = topology_from_arch(cip, &n_cpus);
+	if (cpus == NULL)
+	  n_cpus = 0;
+	cpuinfo_topology_t *tp = &cip->topology;
+	memset(tp, 0, sizeof(*tp));
+	if (cpus) {
+	  // number threads within each core, and count distinct IDs at each level
+	  qsort(cpus, n_cpus, sizeof(*cpus), topology_cpu_compare);
+	  for (i = 0; i < n_cpus; i++) {
+		const cpuinfo_topology_cpu_t *pp = i > 0 ? &cpus[i - 1] : NULL;
+		cpuinfo_topology_cpu_t *cp = &cpus[i];
+		if (pp == NULL || pp->package != cp->package) {
+		  tp->n_packages++;
+		  pp = NULL;
+		}
+		if (pp == NULL || pp->die != cp->die) {
+		  tp->n_dies++;
+		  pp = NULL;
+		}
+		if (pp == NULL || pp->core != cp->core) {
+		  tp->n_cores++;
+		  cp->thread = 0;
+		}
+		else
+		  cp->thread = pp->thread + 1;
+	  }
+	  qsort(cpus, n_cpus, sizeof(*cpus), topology_cpu_compare_id);
+	  tp->cpus = cpus;
+	}
+	tp->n_cpus = n_cpus;
+	D(bug("cpuinfo_get_topology: %d cpus, %d packages, %d dies, %d cores\n",
+		  tp->n_cpus, tp->n_packages, tp->n_dies, tp->n_cores));
+
+	// link logical CPUs to their NUMA node
+	const cpuinfo_numa_t *np = cpuinfo_get_numa_nodes(cip);
+	for (i = 0; i < n_cpus; i++) {
+	  int j;
+	  cpus[i].node = 0;
+	  for (j = 0; j < np->count; j++) {
+		if (cpuinfo_cpuset_isset(&np->nodes[j].cpus, cpus[i].cpu)) {
+		  cpus[i].node = np->nodes[j].id;
+		  break;
+		}
+	  }
+	}
+	topology_classify(cip, cpus, n_cpus);
+  }
+  return &cip->topology;
+}
+
+// Get logical CPUs of the fastest core class (returns the number of CPUs)
+int cpuinfo_get_fastest_cpus(cpuinfo_t *cip, cpuinfo_cpuset_t *set)
+{
+  const cpuinfo_topology_t *tp = cpuinfo_get_topology(cip);
+  if (tp == NULL || set == NULL)
+	return -1;
+
+  int i, n = 0, core_class = CPUINFO_CORE_CLASS_UNKNOWN;
+  for (i = 0; i < tp->n_cpus; i++) {
+	if (tp->cpus[i].capacity == CPU_CAPACITY_MAX) {
+	  core_class = tp->cpus[i].core_class;
+	  break;
+	}
+  }
+  memset(set, 0, sizeof(*set));
+  for (i = 0; i < tp->n_cpus; i++) {
+	const cpuinfo_topology_cpu_t *cp = &tp->cpus[i];
+	if (core_class != CPUINFO_CORE_CLASS_UNKNOWN ? cp->core_class == core_class : cp->capacity == CPU_CAPACITY_MAX) {
+	  cpuset_set(set, cp->cpu);
+	  n++;
+	}
+  }
+  return n;
+}
+
+#define CGROUP_PATH "fs/cgroup"
+
+// Read a cgroup file (MOUNT is empty for the unified hierarchy)
+static int read_cgroup_str(const char *mount, const char *cgroup, const char *name, char *str, int size)
+{
+  char path[PATH_MAX];
+  if (snprintf(path, sizeof(path), CGROUP_PATH "%s%s/%s", mount, cgroup, name) >= (int)sizeof(path))
+	return -1;
+  return cpuinfo_sysfs_read(path, str, size) < 0 ? -1 : 0;
+}
+
+// Get the tightest CPU bandwidth limit from CGROUP up to the root, in CPUs (-1 if none)
+static double cgroup_get_budget(const char *mount, const char *cgroup)
+{
+  char path[PATH_MAX], str[64];
+  double budget = -1;
+  snprintf(path, sizeof(path), "%s", cgroup);
+  for (;;) {
+	double quota = -1, period = 0;
+	if (mount[0] == '\0') {
+	  // "max 100000", or "50000 100000" for half a CPU
+	  if (read_cgroup_str(mount, path, "cpu.max", str, sizeof(str)) == 0 && sscanf(str, "%lf %lf", &quota, &period) != 2)
+		quota = -1;
+	}
+	else {
+	  // a quota of -1 means unlimited
+	  if (read_cgroup_str(mount, path, "cpu.cfs_quota_us", str, sizeof(str)) == 0)
+		quota = strtod(str, NULL);
+	  if (read_cgroup_str(mount, path, "cpu.cfs_period_us", str, sizeof(str)) == 0)
+		period = strtod(str, NULL);
+	}
+	if (quota > 0 && period > 0 && (budget < 0 || quota / period < budget))
+	  budget = quota / period;
+	char *p = strrchr(path, '/');
+	if (p == NULL)
+	  break;
+	*p = '\0';
+  }
+  return budget;
+}
+
+// Restrict SET to the effective cpuset of CGROUP, or of its nearest visible ancestor
+static void cgroup_restrict_cpus(const char *mount, const char *cgroup, cpuinfo_cpuset_t *set)
+{
+  char path[PATH_MAX], str[4096];
+  snprintf(path, sizeof(path), "%s", cgroup);
+  for (;;) {
+	if ((mount[0] == '\0' && read_cgroup_str(mount, path, "cpuset.cpus.effective", str, sizeof(str)) == 0) ||
+		(mount[0] != '\0' && (read_cgroup_str(mount, path, "cpuset.effective_cpus", str, sizeof(str)) == 0 ||
+							   read_cgroup_str(mount, path, "cpuset.cpus", str, sizeof(str)) == 0))) {
+	  cpuinfo_cpuset_t cpus;
+	  memset(&cpus, 0, sizeof(cpus));
+	  if (cpuinfo_parse_cpu_list(str, NULL, &cpus) > 0) {
+		int i;
+		for (i = 0; i < CPUINFO_CPUSET_SIZE / 32; i++)
+		  set->bits[i] &= cpus.bits[i];
+	  }
+	  return;
+	}
+	char *p = strrchr(path, '/');
+	if (p == NULL)
+	  break;
+	*p = '\0';
+  }
+}
+
+// Find where a cgroup v1 controller is mounted ("cpu,cpuacct" is usually also linked as "cpu")
+static int cgroup_v1_mount(const char *controllers, const char *name, const char *probe, char *mount, int size)
+{
+  const char *candidates[2] = { name, controllers };
+  char str[64];
+  int i;
+  for (i = 0; i < 2; i++) {
+	snprintf(mount, size, "/%s", candidates[i]);
+	if (read_cgroup_str(mount, "", probe, str, sizeof(str)) == 0)
+	  return 0;
+  }
+  return -1;
+}
+
+// Get logical CPUs and CPU time available to the calling thread (-1 on error)
+int cpuinfo_get_parallelism(cpuinfo_t *cip, cpuinfo_parallelism_t *pp)
+{
+  const cpuinfo_topology_t *tp = cpuinfo_get_topology(cip);
+  if (tp == NULL || pp == NULL)
+	return -1;
+
+  int i;
+  memset(pp, 0, sizeof(*pp));
+  for (i = 0; i < tp->n_cpus; i++)
+	cpuset_set(&pp->cpus, tp->cpus[i].cpu);
+  pp->budget = -1;
+
+#if defined __linux__
+  // sized for all CPUs of a descriptor, as a cpu_set_t only holds 1024 and
+  // the kernel rejects masks smaller than its number of possible CPUs
+  const size_t affinity_size = CPU_ALLOC_SIZE(CPUINFO_CPUSET_SIZE);
+  cpu_set_t *affinity = CPU_ALLOC(CPUINFO_CPUSET_SIZE);
+  if (affinity == NULL || sched_getaffinity(0, affinity_size, affinity) < 0) {
+	D(bug("cpuinfo_get_parallelism: could not get affinity mask\n"));
+	if (affinity)
+	  CPU_FREE(affinity);
+	return -1;
+  }
+  for (i = 0; i < CPUINFO_CPUSET_SIZE; i++) {
+	if (!CPU_ISSET_S(i, affinity_size, affinity))
+	  pp->cpus.bits[i / 32] &= ~(1U << (i % 32));
+  }
+  CPU_FREE(affinity);
+
+  char str[8192];
+  if (cpuinfo_procfs_read("self/cgroup", str, sizeof(str)) >= 0) {
+	char *line, *state;
+	for (line = strtok_r(str, "\n", &state); line; line = strtok_r(NULL, "\n", &state)) {
+	  // hierarchy-ID:controller-list:cgroup-path, with an empty list for cgroup v2
+	  char *controllers = strchr(line, ':'), *cgroup;
+	  if (controllers == NULL || (cgroup = strchr(++controllers, ':')) == NULL)
+		continue;
+	  *cgroup++ = '\0';
+	  if (strcmp(cgroup, "/") == 0)
+		cgroup[0] = '\0';
+
+	  double budget = -1;
+	  char mount[256];
+	  if (controllers[0] == '\0') {
+		cgroup_restrict_cpus("", cgroup, &pp->cpus);
+		budget = cgroup_get_budget("", cgroup);
+	  }
+	  else {
+		char list[256], *name, *state;
+		snprintf(list, sizeof(list), "%s", controllers);
+		for (name = strtok_r(list, ",", &state); name; name = strtok_r(NULL, ",", &state)) {
+		  if (strcmp(name, "cpuset") == 0 && cgroup_v1_mount(controllers, name, "cpuset.cpus", mount, sizeof(mount)) == 0)
+			cgroup_restrict_cpus(mount, cgroup, &pp->cpus);
+		  else if (strcmp(name, "cpu") == 0 && cgroup_v1_mount(controllers, name, "cpu.cfs_period_us", mount, sizeof(mount)) == 0)
+			budget = cgroup_get_budget(mount, cgroup);
+		}
+	  }
+	  if (budget > 0 && (pp->budget < 0 || budget < pp->budget))
+		pp->budget = budget;
+	}
+  }
+#endif
+
+  pp->n_cpus = cpuinfo_cpuset_count(&pp->cpus);
+  if (pp->budget < 0 || pp->budget > pp->n_cpus)
+	pp->budget = pp->n_cpus;
+  D(bug("cpuinfo_get_parallelism: %d cpus, budget %.2f\n", pp->n_cpus, pp->budget));
+  return 0;
+}
+
+// Get number of threads worth running in parallel (at least 1)
+int cpuinfo_get_usable_cpus(cpuinfo_t *cip)
+{
+  cpuinfo_parallelism_t p;
+  if (cpuinfo_get_parallelism(cip, &p) < 0)
+	return 1;
+  int n = (int)p.budget;
+  if (n < p.budget)
+	n++;
+  return n > 0 ? n : 1;
+}
+
+#define SYSFS_NODE_PATH "devices/system/node"
+
+// Read a sysfs NUMA node attribute
+static int read_sys_node_str(int node, const char *name, char *str, int size)
+{
+  char path[64];
+  snprintf(path, sizeof(path), SYSFS_NODE_PATH "/node%d/%s", node, name);
+  return cpuinfo_sysfs_read(path, str, size) < 0 ? -1 : 0;
+}
+
+// Read memory sizes of a NUMA node, in KB
+static void read_sys_node_meminfo(int node, unsigned long long *total, unsigned long long *avail)
+{
+  char str[4096], *line, *state;
+  if (read_sys_node_str(node, "meminfo", str, sizeof(str)) < 0)
+	return;
+  for (line = strtok_r(str, "\n", &state); line; line = strtok_r(NULL, "\n", &state)) {
+	unsigned long long value;
+	int id;
+	if (sscanf(line, "Node %d MemTotal: %llu", &id, &value) == 2)
+	  *total = value;
+	else if (sscanf(line, "Node %d MemFree: %llu", &id, &value) == 2)
+	  *avail = value;
+  }
+}
+
+// Get NUMA nodes from sysfs
+static int numa_from_sysfs(cpuinfo_t *cip, cpuinfo_numa_node_t **nodes, int **distances)
+{
+  char str[4096];
+  if (cpuinfo_sysfs_read(SYSFS_NODE_PATH "/online", str, sizeof(str)) < 0)
+	return 0;
+
+  int i, j, count = cpuinfo_parse_cpu_list(str, NULL, NULL);
+  int *ids = (int *)malloc(count * sizeof(*ids));
+  if (count == 0 || ids == NULL) {
+	free(ids);
+	return 0;
+  }
+  cpuinfo_parse_cpu_list(str, ids, NULL);
+
+  *nodes = (cpuinfo_numa_node_t *)cpuinfo_arena_alloc(cip, count * sizeof(**nodes));
+  *distances = (int *)cpuinfo_arena_alloc(cip, count * count * sizeof(**distances));
+  if (*nodes == NULL || *distances == NULL) {
+	free(ids);
+	return -1;
+  }
+  for (i = 0; i < count; i++) {
+	cpuinfo_numa_node_t *np = &(*nodes)[i];
+	np->id = ids[i];
+	if (read_sys_node_str(ids[i], "cpulist", str, sizeof(str)) == 0)
+	  cpuinfo_parse_cpu_list(str, NULL, &np->cpus);
+	read_sys_node_meminfo(ids[i], &np->memory_total, &np->memory_free);
+
+	// distances to all possible nodes, keep the online ones
+	int *dp = &(*distances)[i * count];
+	for (j = 0; j < count; j++)
+	  dp[j] = -1;
+	if (read_sys_node_str(ids[i], "distance", str, sizeof(str)) == 0) {
+	  char *p = str, *end;
+	  int node = 0;
+	  for (;;) {
+		long distance = strtol(p, &end, 10);
+		if (end == p)
+		  break;
+		for (j = 0; j < count; j++) {
+		  if (ids[j] == node)
+			dp[j] = distance;
+		}
+		node++;
+		p = end;
+	  }
+	}
+  }
+  free(ids);
+  return count;
+}
+
+// Get NUMA nodes (returns read-only descriptors)
+const cpuinfo_numa_t *cpuinfo_get_numa_nodes(cpuinfo_t *cip)
+{
+  if (cip == NULL)
+	return NULL;
+  if (cip->numa.count < 0) {
+	cpuinfo_numa_node_t *nodes = NULL;
+	int *distances = NULL;
+	int i, count = numa_from_sysfs(cip, &nodes, &distances);
+	if (count <= 0) {
+	  nodes = NULL;
+	  distances = NULL;
+	  count = 0;
+	  // a single node holding everything
+	  if ((nodes = (cpuinfo_numa_node_t *)cpuinfo_arena_alloc(cip, sizeof(*nodes))) != NULL &&
+		  (distances = (int *)cpuinfo_arena_alloc(cip, sizeof(*distances))) != NULL) {
+		const cpuinfo_topology_t *tp = cpuinfo_get_topology(cip);
+		for (i = 0; i < tp->n_cpus; i++)
+		  cpuset_set(&nodes->cpus, tp->cpus[i].cpu);
+		long page_size = sysconf(_SC_PAGESIZE);
+		long n_pages = sysconf(_SC_PHYS_PAGES);
+		long n_free_pages = sysconf(_SC_AVPHYS_PAGES);
+		if (page_size > 0 && n_pages > 0)
+		  nodes->memory_total = (unsigned long long)n_pages * (page_size / 1024);
+		if (page_size > 0 && n_free_pages > 0)
+		  nodes->memory_free = (unsigned long long)n_free_pages * (page_size / 1024);
+		distances[0] = 10;
+		count = 1;
+	  }
+	}
+	cip->numa.count = count;
+	cip->numa.nodes = nodes;
+	cip->numa.distances = distances;
+	D(bug("cpuinfo_get_numa_nodes: %d nodes\n", count));
+  }
+  return &cip->numa;
+}
+
+// Get distance between two NUMA nodes, by node ID (-1 if unknown)
+int cpuinfo_get_numa_distance(cpuinfo_t *cip, int from, int to)
+{
+  const cpuinfo_numa_t *np = cpuinfo_get_numa_nodes(cip);
+  if (np == NULL)
+	return -1;
+  int i, j;
+  for (i = 0; i < np->count && np->nodes[i].id != from; i++)
+	;
+  for (j = 0; j < np->count && np->nodes[j].id != to; j++)
+	;
+  if (i == np->count || j == np->count)
+	return -1;
+  return np->distances[i * np->count + j];
+}
+
+static int cache_instance_compare(const void *a, const void *b)
+{
+  const cpuinfo_cache_instance_t *cia = (const cpuinfo_cache_instance_t *)a;
+  const cpuinfo_cache_instance_t *cib = (const cpuinfo_cache_instance_t *)b;
+  if (cia->level != cib->level)
+	return cia->level - cib->level;
+  if (cia->type != cib->type)
+	return cia->type - cib->type;
+  return cpuinfo_cpuset_first(&cia->cpus) - cpuinfo_cpuset_first(&cib->cpus);
+}
+
+// Append a cache instance
+static int cache_instances_append(cpuinfo_cache_instance_t **instances, int *count, const cpuinfo_cache_instance_t *cip)
+{
+  // capacity doubles whenever the count reaches a power of two
+  if ((*count & (*count - 1)) == 0) {
+	cpuinfo_cache_instance_t *p = (cpuinfo_cache_instance_t *)realloc(*instances, (*count ? 2 * *count : 1) * sizeof(*p));
+	if (p == NULL)
+	  return -1;
+	*instances = p;
+  }
+  (*instances)[(*count)++] = *cip;
+  return 0;
+}
+
+// Add a cache instance, unless one with the same CPU set exists
+static int cache_instances_add(cpuinfo_cache_instance_t **instances, int *count, const cpuinfo_cache_instance_t *cip)
+{
+  int i;
+  for (i = 0; i < *count; i++) {
+	const cpuinfo_cache_instance_t *p = &(*instances)[i];
+	if (p->level == cip->level && p->type == cip->type && memcmp(&p->cpus, &cip->cpus, sizeof(p->cpus)) == 0)
+	  return 0;
+  }
+  return cache_instances_append(instances, count, cip);
+}
+
+#define CACHE_KINDS_MAX 16	// distinct cache levels and types tracked
+
+// Logical CPUs of all the cache instances of a level and type
+typedef struct {
+  int level;
+  int type;
+  cpuinfo_cpuset_t cpus;
+} cache_kind_t;
+
+// Get the CPUs of all cache instances of LEVEL and TYPE (NULL if too many kinds)
+static cache_kind_t *cache_kind_get(cache_kind_t *kinds, int *n_kinds, int level, int type)
+{
+  int i;
+  for (i = 0; i < *n_kinds; i++) {
+	if (kinds[i].level == level && kinds[i].type == type)
+	  return &kinds[i];
+  }
+  if (*n_kinds == CACHE_KINDS_MAX)
+	return NULL;
+  cache_kind_t *kp = &kinds[(*n_kinds)++];
+  memset(kp, 0, sizeof(*kp));
+  kp->level = level;
+  kp->type = type;
+  return kp;
+}
+
+// Get cache instances of online CPUs from sysfs. Instances are tracked per
+// level and type, so that each CPU is checked in constant time
+static int cache_instances_from_sysfs(const cpuinfo_topology_t *tp, cpuinfo_cache_instance_t **instances)
+{
+  cache_kind_t *kinds = (cache_kind_t *)malloc(CACHE_KINDS_MAX * sizeof(*kinds));
+  int i, j, k, n_kinds = 0, count = 0;
+  if (kinds == NULL)
+	return -1;
+  for (i = 0; i < tp->n_cpus; i++) {
+	for (j = 0; ; j++) {
+	  const int cpu = tp->cpus[i].cpu;
+	  cpuinfo_cache_instance_t ci;
+	  memset(&ci, 0, sizeof(ci));
+	  if (read_sys_cache_int(cpu, j, "level", &ci.level) < 0)
+		break;
+	  ci.type = read_sys_cache_type(cpu, j);
+
+	  // skip caches already seen from a CPU sharing them
+	  cache_kind_t *kp = cache_kind_get(kinds, &n_kinds, ci.level, ci.type);
+	  if (kp && cpuinfo_cpuset_isset(&kp->cpus, cpu))
+		continue;
+	  if (kp == NULL) {
+		for (k = 0; k < count; k++) {
+		  const cpuinfo_cache_instance_t *p = &(*instances)[k];
+		  if (p->level == ci.level && p->type == ci.type && cpuinfo_cpuset_isset(&p->cpus, cpu))
+			break;
+		}
+		if (k < count)
+		  continue;
+	  }
+
+	  char str[4096];
+	  read_sys_cache_int(cpu, j, "size", &ci.size);
+	  if (read_sys_cache_str(cpu, j, "shared_cpu_list", str, sizeof(str)) == 0)
+		cpuinfo_parse_cpu_list(str, NULL, &ci.cpus);
+	  if (cpuinfo_cpuset_count(&ci.cpus) == 0)
+		cpuset_set(&ci.cpus, tp->cpus[i].cpu);
+
+	  // an instance sharing no CPU with those seen is new
+	  int is_new = kp != NULL;
+	  if (kp) {
+		for (k = 0; k < CPUINFO_CPUSET_SIZE / 32; k++) {
+		  if (kp->cpus.bits[k] & ci.cpus.bits[k])
+			is_new = 0;
+		  kp->cpus.bits[k] |= ci.cpus.bits[k];
+		}
+	  }
+	  if ((is_new ? cache_instances_append(instances, &count, &ci) : cache_instances_add(instances, &count, &ci)) < 0)
+		goto error;
+	}
+  }
+  free(kinds);
+  return count;
+
+ error:
+  free(kinds);
+  return -1;
+}
+
+// Get cache instances from the cache descriptors, grouping logical CPUs
+// of each package by the number of CPUs sharing each cache
+static int cache_instances_from_arch(cpuinfo_t *cip, const cpuinfo_topology_t *tp, cpuinfo_cache_instance_t **instances)
+{
+  const cpuinfo_cache_t *ccp = cpuinfo_get_caches(cip);
+  if (ccp == NULL || ccp->count <= 0 || tp->n_cpus <= 0)
+	return 0;
+
+  // logical CPUs in topology order, so that SMT siblings are adjacent
+  cpuinfo_topology_cpu_t *cpus = (cpuinfo_topology_cpu_t *)malloc(tp->n_cpus * sizeof(*cpus));
+  if (cpus == NULL)
+	return -1;
+  memcpy(cpus, tp->cpus, tp->n_cpus * sizeof(*cpus));
+  qsort(cpus, tp->n_cpus, sizeof(*cpus), topology_cpu_compare);
+
+  int i, j, count = 0;
+  for (i = 0; i < ccp->count; i++) {
+	const cpuinfo_cache_descriptor_t *cdp = &ccp->descriptors[i];
+	int n_sharing = cpuinfo_arch_get_cache_sharing(cip, cdp->level, cdp->type);
+	if (n_sharing < 1) {
+	  // assume private L1/L2 caches, and shared caches beyond
+	  if (cdp->level <= 2)
+		n_sharing = tp->n_cores > 0 ? tp->n_cpus / tp->n_cores : 1;
+	  else
+		n_sharing = tp->n_packages > 0 ? tp->n_cpus / tp->n_packages : tp->n_cpus;
+	}
+
+	cpuinfo_cache_instance_t ci;
+	int index = 0;
+	for (j = 0; j < tp->n_cpus; j++) {
+	  if (j > 0 && (cpus[j].package != cpus[j - 1].package || index == n_sharing)) {
+		if (cache_instances_add(instances, &count, &ci) < 0)
+		  goto error;
+		index = 0;
+	  }
+	  if (index == 0) {
+		memset(&ci, 0, sizeof(ci));
+		ci.type = cdp->type;
+		ci.level = cdp->level;
+		ci.size = cdp->size;
+	  }
+	  cpuset_set(&ci.cpus, cpus[j].cpu);
+	  index++;
+	}
+	if (cache_instances_add(instances, &count, &ci) < 0)
+	  goto error;
+  }
+  free(cpus);
+  return count;
+
+ error:
+  free(cpus);
+  return -1;
+}
+
+// Get cache instances and the logical CPUs sharing each of them
+const cpuinfo_cache_instances_t *cpuinfo_get_cache_instances(cpuinfo_t *cip)
+{
+  if (cip == NULL)
+	return NULL;
+  if (cip->cache_instances.count < 0) {
+	const cpuinfo_topology_t *tp = cpuinfo_get_topology(cip);
+	cpuinfo_cache_instance_t *instances = NULL;
+	int i, count = cache_instances_from_sysfs(tp, &instances);
+	if (count <= 0) {
+	  free(instances);
+	  instances = NULL;
+	  count = cache_instances_from_arch(cip, tp, &instances);
+	}
+	// move the instances to the arena, numbered within each level and type by their lowest CPU
+	cpuinfo_cache_instance_t *cis = NULL;
+	if (count > 0 && (cis = (cpuinfo_cache_instance_t *)cpuinfo_arena_alloc(cip, count * sizeof(*cis))) != NULL) {
+	  qsort(instances, count, sizeof(*instances), cache_instance_compare);
+	  memcpy(cis, instances, count * sizeof(*cis));
+	}
+	else
+	  count = 0;
+	free(instances);
+	for (i = 0; i < count; i++) {
+	  const cpuinfo_cache_instance_t *p = i > 0 ? &cis[i - 1] : NULL;
+	  if (p && p->level == cis[i].level && p->type == cis[i].type)
+		cis[i].id = p->id + 1;
+	  else
+		cis[i].id = 0;
+	}
+	cip->cache_instances.count = count;
+	cip->cache_instances.instances = cis;
+  }
+  return &cip->cache_instances;
+}
+
 // Cache descriptor comparator
 static int cache_desc_compare(const void *a, const void *b)
 {
-  const cpuinfo_cache_descriptor_t *cdp1 = (const cpuinfo_cache_descriptor_t *)a;
-  const cpuinfo_cache_descriptor_t *cdp2 = (const cpuinfo_cache_descriptor_t *)b;
+  const cpuinfo_cache_geometry_t *cdp1 = (const cpuinfo_cache_geometry_t *)a;
+  const cpuinfo_cache_geometry_t *cdp2 = (const cpuinfo_cache_geometry_t *)b;
 
   if (cdp1->type == cdp2->type)
 	return cdp1->level - cdp2->level;
@@ -211,38 +1179,83 @@ static int cache_desc_compare(const void *a, const void *b)
   return 0;
 }
 
+// Complete cache geometry from the sysfs caches of the first online CPU
+static void cache_geometry_from_sysfs(cpuinfo_t *cip, cpuinfo_cache_list_t *caches_list)
+{
+  const cpuinfo_topology_t *tp = cpuinfo_get_topology(cip);
+  if (tp == NULL || tp->n_cpus <= 0)
+	return;
+
+  int i, j, n_arch = caches_list->count;
+  cpuinfo_cache_geometry_t cg;
+  for (j = 0; read_sys_cache_geometry(tp->cpus[0].cpu, j, &cg) == 0; j++) {
+	for (i = 0; i < caches_list->count; i++) {
+	  cpuinfo_cache_geometry_t *cgp = &caches_list->caches[i];
+	  if (cgp->level == cg.level && cgp->type == cg.type) {
+		if (cgp->line_size == 0)
+		  cgp->line_size = cg.line_size;
+		if (cgp->ways == 0)
+		  cgp->ways = cg.ways;
+		if (cgp->sets == 0)
+		  cgp->sets = cg.sets;
+		if (cgp->partitions == 0)
+		  cgp->partitions = cg.partitions;
+		break;
+	  }
+	}
+	// arch code knows nothing, use sysfs caches
+	if (i == caches_list->count && n_arch == 0) {
+	  if (cpuinfo_cache_list_insert(caches_list, &cg) < 0)
+		break;
+	}
+  }
+}
+
 // Get cache information (returns read-only descriptors)
 const cpuinfo_cache_t *cpuinfo_get_caches(cpuinfo_t *cip)
 {
   if (cip == NULL)
 	return NULL;
   if (cip->cache_info.count < 0) {
-	int count = 0;
+	cpuinfo_cache_list_t caches_list;
+	caches_list.count = 0;
+	cpuinfo_arch_get_caches(cip, &caches_list);
+	cache_geometry_from_sysfs(cip, &caches_list);
+
+	int i, count = caches_list.count;
+	cpuinfo_cache_geometry_t *cgs = NULL;
 	cpuinfo_cache_descriptor_t *descs = NULL;
-	cpuinfo_list_t caches_list = cpuinfo_arch_get_caches(cip);
-	if (caches_list) {
-	  int i;
-	  cpuinfo_list_t p = caches_list;
-	  while (p) {
-		++count;
-		p = p->next;
-	  }
-	  if ((descs = (cpuinfo_cache_descriptor_t *)malloc(count * sizeof(*descs))) != NULL) {
-		p = caches_list;
+	if (count > 0) {
+	  qsort(caches_list.caches, count, sizeof(caches_list.caches[0]), cache_desc_compare);
+	  cgs = (cpuinfo_cache_geometry_t *)cpuinfo_arena_alloc(cip, count * sizeof(*cgs));
+	  descs = (cpuinfo_cache_descriptor_t *)cpuinfo_arena_alloc(cip, count * sizeof(*descs));
+	  if (cgs && descs) {
+		memcpy(cgs, caches_list.caches, count * sizeof(*cgs));
 		for (i = 0; i < count; i++) {
-		  memcpy(&descs[i], p->data, sizeof(*descs));
-		  p = p->next;
+		  descs[i].type = cgs[i].type;
+		  descs[i].level = cgs[i].level;
+		  descs[i].size = cgs[i].size;
 		}
-		qsort(descs, count, sizeof(*descs), cache_desc_compare);
 	  }
-	  cpuinfo_list_clear(&caches_list);
+	  else
+		count = 0;
 	}
 	cip->cache_info.count = count;
 	cip->cache_info.descriptors = descs;
+	cip->cache_geometry = cgs;
   }
   return &cip->cache_info;
 }
 
+// Get geometry of a cache (returns read-only descriptor)
+const cpuinfo_cache_geometry_t *cpuinfo_get_cache_geometry(cpuinfo_t *cip, int index)
+{
+  const cpuinfo_cache_t *ccp = cpuinfo_get_caches(cip);
+  if (ccp == NULL || index < 0 || index >= ccp->count)
+	return NULL;
+  return &cip->cache_geometry[index];
+}
+
 // Returns 1 if CPU supports the specified feature
 int cpuinfo_has_feature(cpuinfo_t *cip, int feature)
 {
@@ -254,6 +1267,124 @@ int cpuinfo_has_feature(cpuinfo_t *cip, int feature)
   return cpuinfo_arch_has_feature(cip, feature);
 }
 
+// Get differences between logical CPUs (0 if all alike, -1 if unknown)
+int cpuinfo_get_heterogeneity(cpuinfo_t *cip)
+{
+  const cpuinfo_topology_t *tp = cpuinfo_get_topology(cip);
+  if (tp == NULL)
+	return -1;
+
+  int i, heterogeneity = cpuinfo_arch_get_heterogeneity(cip);
+  for (i = 1; i < tp->n_cpus; i++) {
+	if (tp->cpus[i].core_class != tp->cpus[0].core_class) {
+	  if (heterogeneity < 0)
+		heterogeneity = 0;
+	  heterogeneity |= CPUINFO_HETEROGENEOUS_CORE_CLASSES;
+	  break;
+	}
+  }
+  return heterogeneity;
+}
+
+// Get logical CPUs supporting the specified feature (returns the number of CPUs)
+int cpuinfo_get_feature_cpus(cpuinfo_t *cip, int feature, cpuinfo_cpuset_t *set)
+{
+  const cpuinfo_topology_t *tp = cpuinfo_get_topology(cip);
+  if (tp == NULL || set == NULL)
+	return -1;
+
+  int i, n = cpuinfo_arch_get_feature_cpus(cip, feature, set);
+  if (n < 0) {
+	// all logical CPUs are assumed alike
+	memset(set, 0, sizeof(*set));
+	n = 0;
+	if (cpuinfo_has_feature(cip, feature)) {
+	  for (i = 0; i < tp->n_cpus; i++) {
+		cpuset_set(set, tp->cpus[i].cpu);
+		n++;
+	  }
+	}
+  }
+  return n;
+}
+
+
+/* ========================================================================= */
+/* == Process-wide Features Snapshot                                      == */
+/* ========================================================================= */
+
+// only written here, callers see it as the read-only cpuinfo_feature_snapshot
+alignas(64) static unsigned int feature_snapshot[CPUINFO_FEATURE_SNAPSHOT_WORDS];
+extern const unsigned int cpuinfo_feature_snapshot[CPUINFO_FEATURE_SNAPSHOT_WORDS] __attribute__((alias("feature_snapshot")));
+static int feature_snapshot_64bit;		// whether the CPU runs 64-bit code, whatever the persona
+
+static pthread_once_t feature_snapshot_once = PTHREAD_ONCE_INIT;
+
+// Returns the end of the specified features class (arch tables are sized to it)
+static int feature_snapshot_class_max(int class)
+{
+  switch (class) {
+  case CPUINFO_FEATURE_COMMON:		return CPUINFO_FEATURE_COMMON_MAX;
+  case CPUINFO_FEATURE_X86:		return CPUINFO_FEATURE_X86_MAX;
+  case CPUINFO_FEATURE_IA64:		return CPUINFO_FEATURE_IA64_MAX;
+  case CPUINFO_FEATURE_PPC:		return CPUINFO_FEATURE_PPC_MAX;
+  case CPUINFO_FEATURE_MIPS:		return CPUINFO_FEATURE_MIPS_MAX;
+  case CPUINFO_FEATURE_ARM:		return CPUINFO_FEATURE_ARM_MAX;
+  case CPUINFO_FEATURE_AARCH64:		return CPUINFO_FEATURE_AARCH64_MAX;
+  case CPUINFO_FEATURE_ARM_CRYPTO:	return CPUINFO_FEATURE_ARM_CRYPTO_MAX;
+  }
+  return class;
+}
+
+// Resolve every feature once through cpuinfo_has_feature(), then publish
+static void feature_snapshot_init(void)
+{
+  unsigned int bits[CPUINFO_FEATURE_SNAPSHOT_WORDS];
+  memset(bits, 0, sizeof(bits));
+
+  cpuinfo_t *cip = cpuinfo_new();
+  if (cip) {
+	int class, feature;
+	for (class = 0; class <= CPUINFO_FEATURE_ARCH; class += CPUINFO_CLASS(1)) {
+	  if (cpuinfo_arch_feature_table(cip, class) == NULL)
+		continue;
+	  for (feature = class; feature < feature_snapshot_class_max(class); feature++) {
+		if (feature != CPUINFO_FEATURE_64BIT && cpuinfo_has_feature(cip, feature))
+		  bits[feature / 32] |= 1U << (feature % 32);
+	  }
+	}
+	feature_snapshot_64bit = cpuinfo_arch_has_feature(cip, CPUINFO_FEATURE_64BIT) != 0;
+	cpuinfo_destroy(cip);
+  }
+
+  // words are only ever written with their final value, the marker goes last
+  int i;
+  for (i = 1; i < CPUINFO_FEATURE_SNAPSHOT_WORDS; i++)
+	__atomic_store_n(&feature_snapshot[i], bits[i], __ATOMIC_RELAXED);
+  __atomic_store_n(&feature_snapshot[0], bits[0] | (1U << CPUINFO_FEATURE_COMMON), __ATOMIC_RELEASE);
+}
+
+// Initialize the process-wide features snapshot (thread-safe, runs once)
+void cpuinfo_features_init(void)
+{
+  pthread_once(&feature_snapshot_once, feature_snapshot_init);
+}
+
+// Returns 1 if CPU supports the specified feature (out-of-line version)
+int cpuinfo_has_feature_slow(int feature)
+{
+  cpuinfo_features_init();
+  if (feature == CPUINFO_FEATURE_64BIT) {
+#ifdef HAVE_SYS_PERSONALITY_H
+	if ((personality(0xffffffff) & PER_MASK) == PER_LINUX32)
+	  return 0;
+#endif
+	return feature_snapshot_64bit;
+  }
+  feature &= CPUINFO_FEATURE_ARCH | CPUINFO_FEATURE_MASK;
+  return (feature_snapshot[feature / 32] >> (feature % 32)) & 1;
+}
+
 
 /* ========================================================================= */
 /* == Processor Features Information                                      == */
@@ -364,6 +1495,28 @@ const char *cpuinfo_string_of_socket(int socket)
   return str;
 }
 
+const char *cpuinfo_string_of_frequency_source(int source)
+{
+  const char *str = "<unknown>";
+  switch (source) {
+  case CPUINFO_FREQUENCY_SOURCE_CPUID:			str = "cpuid";			break;
+  case CPUINFO_FREQUENCY_SOURCE_HYPERVISOR:		str = "hypervisor";		break;
+  case CPUINFO_FREQUENCY_SOURCE_CALIBRATION:	str = "calibration";	break;
+  case CPUINFO_FREQUENCY_SOURCE_OS:				str = "os";				break;
+  }
+  return str;
+}
+
+const char *cpuinfo_string_of_core_class(int core_class)
+{
+  const char *str = "<unknown>";
+  switch (core_class) {
+  case CPUINFO_CORE_CLASS_PERFORMANCE:	str = "performance";	break;
+  case CPUINFO_CORE_CLASS_EFFICIENCY:	str = "efficiency";		break;
+  }
+  return str;
+}
+
 const char *cpuinfo_string_of_cache_type(int cache_type)
 {
   const char *str = "<unknown>";
@@ -376,6 +1529,21 @@ const char *cpuinfo_string_of_cache_type(int cache_type)
   return str;
 }
 
+const char *cpuinfo_string_of_bandwidth_kernel(int kernel)
+{
+  const char *str = "<unknown>";
+  switch (kernel) {
+  case CPUINFO_BANDWIDTH_READ:		str = "read";		break;
+  case CPUINFO_BANDWIDTH_COPY:		str = "copy";		break;
+  case CPUINFO_BANDWIDTH_SCALE:		str = "scale";		break;
+  case CPUINFO_BANDWIDTH_ADD:		str = "add";		break;
+  case CPUINFO_BANDWIDTH_TRIAD:		str = "triad";		break;
+  case CPUINFO_BANDWIDTH_COPY_NT:	str = "copy_nt";	break;
+  case CPUINFO_BANDWIDTH_TRIAD_NT:	str = "triad_nt";	break;
+  }
+  return str;
+}
+
 typedef struct {
 #ifndef HAVE_DESIGNATED_INITIALIZERS
   int feature;
@@ -409,97 +1577,14 @@ static constexpr(int) n_common_feature_strings = sizeof(common_feature_strings)
 
 static const cpuinfo_feature_string_t x86_feature_strings[] = {
   DEFINE_(X86,			"[x86]",	"-- x86-specific features --"),
-  DEFINE_(X86_AC,		"ac",		"Alignment Check"),
-  DEFINE_(X86_CPUID,		"cpuid",	"CPU Identificaion"),
-  DEFINE_(X86_FPU,		"fpu",		"Floating Point Unit On-Chip"),
-  DEFINE_(X86_VME,		"vme",		"Virtual 8086 Mode Enhancements"),
-  DEFINE_(X86_DE,		"de",		"Debugging Extensions"),
-  DEFINE_(X86_PSE,		"pse",		"Page Size Extension"),
-  DEFINE_(X86_TSC,		"tsc",		"Time Stamp Counter"),
-  DEFINE_(X86_MSR,		"msr",		"Model Specific Registers RDMSR and WRMSR Instructions"),
-  DEFINE_(X86_PAE,		"pae",		"Physical Address Extension"),
-  DEFINE_(X86_MCE,		"mce",		"Machine Check Exception"),
-  DEFINE_(X86_CX8,		"cx8",		"CMPCXHG8B Instruction"),
-  DEFINE_(X86_APIC,		"apic",		"APIC On-Chip"),
-  DEFINE_(X86_SEP,		"sep",		"SYSENTER and SYSEXIT Instructions"),
-  DEFINE_(X86_MTRR,		"mtrr",		"Memory Type Range Registers"),
-  DEFINE_(X86_PGE,		"pge",		"PTE Global Bit"),
-  DEFINE_(X86_MCA,		"mca",		"Machine Check Architecture"),
-  DEFINE_(X86_CMOV,		"cmov",		"Conditional Moves"),
-  DEFINE_(X86_PAT,		"pat",		"Page Attribute Table"),
-  DEFINE_(X86_PSE_36,		"pse36",	"36-Bit Page Size Extension"),
-  DEFINE_(X86_PSN,		"psn",		"Processor Serial Number"),
-  DEFINE_(X86_CLFLUSH,		"clflush",	"CLFLUSH Instruction"),
-  DEFINE_(X86_DS,		"ds",		"Debug Store"),
-  DEFINE_(X86_ACPI,		"acpi",		"Thermal Monitor and Software Controlled Clock Facilities"),
-  DEFINE_(X86_FXSR,		"fxsr",		"Supports FXSAVE/FXSTOR instructions"),
-  DEFINE_(X86_FFXSR,		"ffxsr",	"Supports FXSAVE/FXSTOR instruction optimizations"),
-  DEFINE_(X86_SS,		"ss",		"Self Snoop"),
-  DEFINE_(X86_HTT,		"htt",		"Hyper-Threading Technology"),
-  DEFINE_(X86_PBE,		"pbe",		"Pending Break Enable"),
-  DEFINE_(X86_MMX,		"mmx",		"MMX Technology"),
-  DEFINE_(X86_MMX_EXT,		"mmxext",	"MMX+ Technology (AMD or Cyrix)"),
-  DEFINE_(X86_3DNOW,		"3dnow",	"3DNow! Technology"),
-  DEFINE_(X86_3DNOW_EXT,	"3dnowext",	"Enhanced 3DNow! Technology"),
-  DEFINE_(X86_3DNOW_PREFETCH,	"3dnowprefetch","3DNow! prefetch"),
-  DEFINE_(X86_SSE,		"sse",		"SSE Technology"),
-  DEFINE_(X86_SSE2,		"sse2",		"SSE2 Technology"),
-  DEFINE_(X86_SSE3,		"sse3",		"SSE3 Technology (Prescott New Instructions)"),
-  DEFINE_(X86_SSSE3,		"ssse3",	"SSSE3 Technology (Merom New Instructions)"),
-  DEFINE_(X86_SSE4_1,		"sse4.1",	"SSE4.1 Technology (Penryn New Instructions)"),
-  DEFINE_(X86_SSE4_2,		"sse4.2",	"SSE4.2 Technology (Nehalem New Instructions)"),
-  DEFINE_(X86_SSE4A,		"sse4a",	"SSE4A Technology (AMD Barcelona Instructions)"),
-  DEFINE_(X86_SSE5,		"sse5",		"SSE5 Technology (AMD Bulldozer Instructions)"),
-  DEFINE_(X86_MISALIGNSSE,	"misalignsse",	"Misaligned SSE mode"),
-  DEFINE_(X86_VMX,		"vmx",		"Intel Virtualisation Technology (VT)"),
-  DEFINE_(X86_SVM,		"svm",		"AMD-v Technology (Pacifica)"),
-  DEFINE_(X86_LM,		"lm",		"Long Mode (64-bit capable)"),
-  DEFINE_(X86_LAHF64,		"lahf_lm",	"LAHF/SAHF Supported in 64-bit mode"),
-  DEFINE_(X86_POPCNT,		"popcnt",	"POPCNT (population count) instruction supported"),
-  DEFINE_(X86_TSC_DEADLINE,	"tsc_deadline",	"Time Stamp Counter Deadline"),
-  DEFINE_(X86_ABM,		"abm",		"Advanced Bit Manipulation instructions (LZCNT9"),
-  DEFINE_(X86_BSFCC,		"bsf_cc",	"BSF instruction clobbers condition codes"),
-  DEFINE_(X86_TM,		"tm",		"Thermal Monitor"),
-  DEFINE_(X86_TM2,		"tm2",		"Thermal Monitor 2"),
-  DEFINE_(X86_IA64,		"ia64",		"Intel 64 Instruction Set Architecture"),
-  DEFINE_(X86_EIST,		"eist",		"Enhanced Intel Speedstep Technology"),
-  DEFINE_(X86_NX,		"nx",		"No eXecute (AMD NX) / Execute Disable (Intel XD)"),
-  DEFINE_(X86_DTES64,		"dtes64",	"64-bit DS Area"),
-  DEFINE_(X86_MONITOR,		"monitor",	"MONITOR/MWAIT"),
-  DEFINE_(X86_DS_CPL,		"ds_cpl",	"CPL Qualified Debug Store"),
-  DEFINE_(X86_SMX,		"smx",		"Safer Mode Extensions"),
-  DEFINE_(X86_CNXT_ID,		"cnxt_id",	"L1 Context ID"),
-  DEFINE_(X86_CX16,		"cx16",		"Supports CMPCXHG16B Instruction"),
-  DEFINE_(X86_XTPR,		"xtpr",		"xTPR Update Conrol"),
-  DEFINE_(X86_PDCM,		"pdcm",		"Perfmon and Debug Capability"),
-  DEFINE_(X86_PCID,		"pcid",		"Process Context Identifiers"),
-  DEFINE_(X86_DCA,		"dca",		"Supports prefetching from memory mapped device"),
-  DEFINE_(X86_X2APIC,		"x2apic",	"Supports x2APIC"),
-  DEFINE_(X86_MOVBE,		"movbe",	"Supports MOVBE instruction"),
-  DEFINE_(X86_XSAVE,		"xsave",	"Supports XSAVE/XRSTOR instructions"),
-  DEFINE_(X86_PCLMULQDQ,	"pclmulqdq",	"Supports PCLMULQDQ instruction"),
-  DEFINE_(X86_FMA,		"fma",		"Supports FMA extensions using YMM state."),
-  DEFINE_(X86_AES,		"aes",		"Supports AES instruction"),
-  DEFINE_(X86_AVX,		"avx",		"Supports Advanced Vector Extensions"),
-  DEFINE_(X86_F16C,		"f16c",		"F16C half-precision convert instruction"),
-  DEFINE_(X86_HYPERVISOR,	"hypervisor",	"Hypervisor Guest Status"),
-  DEFINE_(X86_CMP_LEGACY,	"cmp_legacy",	"Core multi-processing legacy mode"),
-  DEFINE_(X86_EXTAPIC,		"extapic",	"Supports Advanced Vector Extensions"),
-  DEFINE_(X86_CR8_LEGACY,	"cr8_legacy",	"LOCK MOV CR0 means MOV CR8"),
-  DEFINE_(X86_OSVW,		"osvw",		"OS visible workaround"),
-  DEFINE_(X86_IBS,		"ibs",		"Instruction based sampling"),
-  DEFINE_(X86_SKINIT,		"skinit",	"Supports SKINIT/STGI instructions"),
-  DEFINE_(X86_WDT,		"wdt",		"Watchdog timer support"),
-  DEFINE_(X86_LWP,		"lwp",		"Lightweight profiling support"),
-  DEFINE_(X86_FMA4,		"fma4",		"4-operand FMA instruction"),
-  DEFINE_(X86_NODEID_MSR,	"nodeid_msr",	"NodeId MSR C001100C"),
-  DEFINE_(X86_TBM,		"tbm",		"Trailing bit manipulation instruction support"),
-  DEFINE_(X86_TOPOEXT,		"topoext",	"Topology extensions support"),
-  DEFINE_(X86_PAGE1GB,		"page1gb",	"1-GB large page support"),
-  DEFINE_(X86_RDTSCP,		"rdtscp",	"Supports RDTSCP instruction"),
-  
-
-
+#define CPUINFO_X86_CPUID_REG(SLOT, LEAF, SUBLEAF, REG)
+#define CPUINFO_X86_FEATURE(ID, NAME, DETAIL, SLOT, BIT, VENDORS, XSTATE) \
+  DEFINE_(X86_##ID, NAME, DETAIL),
+#define CPUINFO_X86_FEATURE_ALT(ID, SLOT, BIT, VENDORS, XSTATE)
+#include "cpuinfo-x86-features.h"
+#undef CPUINFO_X86_FEATURE_ALT
+#undef CPUINFO_X86_FEATURE
+#undef CPUINFO_X86_CPUID_REG
 };
 
 static constexpr(int) n_x86_feature_strings = sizeof(x86_feature_strings) / sizeof(x86_feature_strings[0]);
@@ -656,77 +1741,74 @@ const char *cpuinfo_string_of_feature_detail(int feature)
 
 
 /* ========================================================================= */
-/* == Lists                                                               == */
+/* == Memory Arena                                                        == */
 /* ========================================================================= */
 
-// Clear list
-int cpuinfo_list_clear(cpuinfo_list_t *lp)
+#define ARENA_ALIGN 16
+#define ARENA_ROUND(SIZE) (((SIZE) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+
+// Allocate zero-filled memory released along with the descriptor (NULL on failure)
+void *cpuinfo_arena_alloc(struct cpuinfo *cip, size_t size)
 {
-  assert(lp != NULL);
-  cpuinfo_list_t d, p = *lp;
-  while (p) {
-	d = p;
-	p = p->next;
-	free(d);
+  assert(cip != NULL);
+  cpuinfo_arena_t *ap = &cip->arena;
+  const size_t header_size = ARENA_ROUND(sizeof(cpuinfo_arena_chunk_t));
+  size = ARENA_ROUND(size > 0 ? size : 1);
+  if (size > (size_t)(ap->end - ap->ptr)) {
+	// large blocks get a chunk of their own, the current one keeps serving small blocks
+	size_t chunk_size = size > CPUINFO_ARENA_CHUNK_SIZE / 4 ? size : CPUINFO_ARENA_CHUNK_SIZE;
+	cpuinfo_arena_chunk_t *cp = (cpuinfo_arena_chunk_t *)malloc(header_size + chunk_size);
+	if (cp == NULL)
+	  return NULL;
+	cp->next = ap->chunks;
+	ap->chunks = cp;
+	char *data = (char *)cp + header_size;
+	if (chunk_size == size)
+	  return memset(data, 0, size);
+	ap->ptr = data;
+	ap->end = data + chunk_size;
   }
-  *lp = NULL;
-  return 0;
+  void *ptr = ap->ptr;
+  ap->ptr += size;
+  return memset(ptr, 0, size);
 }
 
-// Insert new element into the list
-int (cpuinfo_list_insert)(cpuinfo_list_t *lp, const void *ptr, int size)
+// Copy a string into the arena (NULL on failure)
+char *cpuinfo_arena_strdup(struct cpuinfo *cip, const char *str)
 {
-  assert(lp != NULL);
-  cpuinfo_list_t p = (cpuinfo_list_t)malloc(sizeof(*p));
-  if (p == NULL)
-	return -1;
-  p->next = *lp;
-  if ((p->data = malloc(size)) == NULL) {
-	free(p);
-	return -1;
-  }
-  memcpy((void *)p->data, ptr, size);
-  *lp = p;
-  return 0;
+  size_t length = strlen(str) + 1;
+  char *copy = (char *)cpuinfo_arena_alloc(cip, length);
+  if (copy)
+	memcpy(copy, str, length);
+  return copy;
 }
 
-char * read_sys_str(const char *path) {
-    char syspath[sizeof("/sys/")+strlen(path)];
-    stpcpy(stpcpy(syspath, "/sys/"), path);
-    struct stat sb;
-    ssize_t rd = -1;
-
-    if (stat(syspath, &sb) == -1) {
-	perror("stat failed: ");
-	return NULL;
-    }
-    int fd = open(syspath, O_RDONLY);
-    char buf[sb.st_size];
-    memset(buf, 0, sizeof(buf));
-    if ((rd = read(fd, buf, sb.st_size) == -1)) {
-       perror("read failed: ");
-       close(fd);
-       return NULL;
-    }
-
-    close(fd);
-
-    return strdup(buf);
+// Release all additional chunks
+static void arena_release(cpuinfo_arena_t *ap)
+{
+  cpuinfo_arena_chunk_t *cp = ap->chunks;
+  while (cp) {
+	cpuinfo_arena_chunk_t *next = cp->next;
+	free(cp);
+	cp = next;
+  }
+  ap->chunks = NULL;
+  ap->ptr = ap->end;
 }
 
-int read_sys_int(const char *syspath) {
-    char *buf = read_sys_str(syspath);
-
-    int ret = htobe32(*buf);
-    free(buf);
-
-    return ret;
-}
-int read_sys_int_str(const char *syspath) {
-    char *buf = read_sys_str(syspath);
 
-    int ret = atoi(buf);
-    free(buf);
+/* ========================================================================= */
+/* == Cache Lists                                                         == */
+/* ========================================================================= */
 
-    return ret;
+// Append a cache descriptor or geometry (returns -1 if the list is full)
+int (cpuinfo_cache_list_insert)(cpuinfo_cache_list_t *clp, const void *ptr, int size)
+{
+  assert(clp != NULL);
+  if (clp->count >= CPUINFO_CACHES_MAX)
+	return -1;
+  cpuinfo_cache_geometry_t *cgp = &clp->caches[clp->count++];
+  memset(cgp, 0, sizeof(*cgp));
+  memcpy(cgp, ptr, size < (int)sizeof(*cgp) ? size : (int)sizeof(*cgp));
+  return 0;
 }
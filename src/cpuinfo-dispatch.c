@@ -0,0 +1,184 @@
+/*
+ *  cpuinfo-dispatch.c - Function multi-versioning dispatcher
+ *
+ *  cpuinfo (C) 2006-2007 Gwenole Beauchesne
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "sysdeps.h"
+#include <stdarg.h>
+#include <pthread.h>
+#include "cpuinfo.h"
+
+#define DEBUG 1
+#include "debug.h"
+
+// Candidate implementation
+typedef struct {
+  char *name;
+  cpuinfo_function_t func;
+  int priority;
+  int n_features;
+  int *features;
+} cpuinfo_candidate_t;
+
+struct cpuinfo_dispatcher {
+  char *name;
+  cpuinfo_function_t resolved;					// Cached function, NULL if not resolved yet
+  const char *resolved_name;					// Name of the resolved candidate
+  pthread_mutex_t lock;							// Protects candidates and resolution
+  int n_candidates;
+  int max_candidates;
+  cpuinfo_candidate_t *candidates;				// Sorted by decreasing priority
+};
+
+// Allocate a new dispatcher
+cpuinfo_dispatcher_t *cpuinfo_dispatcher_new(const char *name)
+{
+  cpuinfo_dispatcher_t *dp = (cpuinfo_dispatcher_t *)calloc(1, sizeof(*dp));
+  if (dp == NULL)
+	return NULL;
+  if ((dp->name = strdup(name ? name : "<anonymous>")) == NULL) {
+	free(dp);
+	return NULL;
+  }
+  pthread_mutex_init(&dp->lock, NULL);
+  return dp;
+}
+
+// Release the dispatcher and all registered candidates
+void cpuinfo_dispatcher_destroy(cpuinfo_dispatcher_t *dp)
+{
+  if (dp == NULL)
+	return;
+  int i;
+  for (i = 0; i < dp->n_candidates; i++) {
+	free(dp->candidates[i].name);
+	free(dp->candidates[i].features);
+  }
+  free(dp->candidates);
+  pthread_mutex_destroy(&dp->lock);
+  free(dp->name);
+  free(dp);
+}
+
+// Register a candidate implementation (zero-terminated list of required features)
+int cpuinfo_dispatcher_add(cpuinfo_dispatcher_t *dp, const char *name, cpuinfo_function_t func, int priority, ...)
+{
+  if (dp == NULL || func == NULL)
+	return -1;
+
+  cpuinfo_candidate_t c;
+  c.priority = priority;
+  c.func = func;
+  c.n_features = 0;
+  c.features = NULL;
+  if ((c.name = strdup(name ? name : "<anonymous>")) == NULL)
+	return -1;
+
+  va_list args;
+  va_start(args, priority);
+  int feature;
+  while ((feature = va_arg(args, int)) != 0) {
+	int *features = (int *)realloc(c.features, (c.n_features + 1) * sizeof(*features));
+	if (features == NULL) {
+	  va_end(args);
+	  free(c.features);
+	  free(c.name);
+	  return -1;
+	}
+	c.features = features;
+	c.features[c.n_features++] = feature;
+  }
+  va_end(args);
+
+  pthread_mutex_lock(&dp->lock);
+  if (dp->n_candidates == dp->max_candidates) {
+	int max_candidates = dp->max_candidates ? 2 * dp->max_candidates : 4;
+	cpuinfo_candidate_t *candidates = (cpuinfo_candidate_t *)realloc(dp->candidates, max_candidates * sizeof(*candidates));
+	if (candidates == NULL) {
+	  pthread_mutex_unlock(&dp->lock);
+	  free(c.features);
+	  free(c.name);
+	  return -1;
+	}
+	dp->candidates = candidates;
+	dp->max_candidates = max_candidates;
+  }
+
+  // keep registration order among candidates of equal priority
+  int i = dp->n_candidates;
+  while (i > 0 && dp->candidates[i - 1].priority < priority) {
+	dp->candidates[i] = dp->candidates[i - 1];
+	--i;
+  }
+  dp->candidates[i] = c;
+  dp->n_candidates++;
+
+  // force a new resolution, with the new candidate
+  __atomic_store_n(&dp->resolved, NULL, __ATOMIC_RELEASE);
+  pthread_mutex_unlock(&dp->lock);
+  return 0;
+}
+
+static cpuinfo_function_t dispatcher_resolve(cpuinfo_dispatcher_t *dp)
+{
+  pthread_mutex_lock(&dp->lock);
+  cpuinfo_function_t func = dp->resolved;
+  if (func == NULL) {
+	int i, j;
+	for (i = 0; i < dp->n_candidates; i++) {
+	  const cpuinfo_candidate_t *cp = &dp->candidates[i];
+	  for (j = 0; j < cp->n_features; j++) {
+		if (!cpuinfo_has_feature_fast(cp->features[j]))
+		  break;
+	  }
+	  if (j == cp->n_features) {
+		D(bug("cpuinfo_dispatcher_resolve: %s -> %s\n", dp->name, cp->name));
+		dp->resolved_name = cp->name;
+		func = cp->func;
+		break;
+	  }
+	}
+	if (func == NULL)
+	  D(bug("cpuinfo_dispatcher_resolve: %s -> no suitable candidate\n", dp->name));
+	__atomic_store_n(&dp->resolved, func, __ATOMIC_RELEASE);
+  }
+  pthread_mutex_unlock(&dp->lock);
+  return func;
+}
+
+// Get the best candidate supported by the CPU (NULL if none)
+cpuinfo_function_t cpuinfo_dispatcher_resolve(cpuinfo_dispatcher_t *dp)
+{
+  if (dp == NULL)
+	return NULL;
+  cpuinfo_function_t func = __atomic_load_n(&dp->resolved, __ATOMIC_ACQUIRE);
+  if (func)
+	return func;
+  return dispatcher_resolve(dp);
+}
+
+// Get the name of the resolved candidate (NULL if none)
+const char *cpuinfo_dispatcher_get_name(cpuinfo_dispatcher_t *dp)
+{
+  if (cpuinfo_dispatcher_resolve(dp) == NULL)
+	return NULL;
+  pthread_mutex_lock(&dp->lock);
+  const char *name = dp->resolved_name;
+  pthread_mutex_unlock(&dp->lock);
+  return name;
+}
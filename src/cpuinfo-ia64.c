@@ -19,6 +19,7 @@
  */
 
 #include "sysdeps.h"
+#include <limits.h>
 #include "cpuinfo.h"
 #include "cpuinfo-private.h"
 
@@ -49,7 +50,7 @@ static uint64_t cpuid(int reg)
 #define N_CPUID_REGISTERS 5
 struct ia64_cpuinfo {
   uint64_t cpuid[N_CPUID_REGISTERS];
-  cpuinfo_list_t caches;
+  cpuinfo_cache_list_t caches;
   int frequency;
   uint32_t features[CPUINFO_FEATURES_SZ_(IA64)];
 };
@@ -60,7 +61,7 @@ typedef struct ia64_cpuinfo ia64_cpuinfo_t;
 static int cpuinfo_arch_init(ia64_cpuinfo_t *acip)
 {
   memset(&acip->cpuid, 0, sizeof(acip->cpuid));
-  acip->caches = NULL;
+  acip->caches.count = 0;
   acip->frequency = 0;
   memset(&acip->features, 0, sizeof(acip->features));
 
@@ -77,7 +78,9 @@ static int cpuinfo_arch_init(ia64_cpuinfo_t *acip)
   char line[256];
   char dummy[sizeof(line)];
   cpuinfo_cache_descriptor_t cache_desc;
-  FILE *cache_info = fopen("/proc/pal/cpu0/cache_info", "r"); // XXX: iterate until an online processor
+  char cache_info_path[PATH_MAX];
+  snprintf(cache_info_path, sizeof(cache_info_path), "%s/pal/cpu0/cache_info", cpuinfo_procfs_root());
+  FILE *cache_info = fopen(cache_info_path, "r"); // XXX: iterate until an online processor
   if (cache_info) {
 	char cache_type[32];
 	cache_desc.level = -1;
@@ -92,7 +95,7 @@ static int cpuinfo_arch_init(ia64_cpuinfo_t *acip)
 	  int i;
 	  if (sscanf(line, "%s Cache level %d", cache_type, &i) == 2) {
 		if (cache_desc.level > 0)
-		  cpuinfo_list_insert(&acip->caches, &cache_desc);
+		  cpuinfo_cache_list_insert(&acip->caches, &cache_desc);
 		cache_desc.level = i;
 		if (strcmp(cache_type, "Instruction") == 0)
 		  cache_desc.type = CPUINFO_CACHE_TYPE_CODE;
@@ -108,7 +111,7 @@ static int cpuinfo_arch_init(ia64_cpuinfo_t *acip)
 	  }
 	}
 	if (cache_desc.level > 0)
-	  cpuinfo_list_insert(&acip->caches, &cache_desc);
+	  cpuinfo_cache_list_insert(&acip->caches, &cache_desc);
 	fclose(cache_info);
   }
 #elif defined __hpux
@@ -129,7 +132,7 @@ static int cpuinfo_arch_init(ia64_cpuinfo_t *acip)
 	  int level, size, assoc;
 	  if (sscanf(line, " L%d %[^:]: size = %d KB, associativity = %d", &level, cache_type, &size, &assoc) == 4) {
 		if (cache_desc.level > 0)
-		  cpuinfo_list_insert(&acip->caches, &cache_desc);
+		  cpuinfo_cache_list_insert(&acip->caches, &cache_desc);
 		cache_desc.level = level;
 		cache_desc.size = size;
 		if (strcmp(cache_type, "Instruction") == 0)
@@ -143,27 +146,21 @@ static int cpuinfo_arch_init(ia64_cpuinfo_t *acip)
 	  }
 	}
 	if (cache_desc.level > 0)
-	  cpuinfo_list_insert(&acip->caches, &cache_desc);
+	  cpuinfo_cache_list_insert(&acip->caches, &cache_desc);
 	pclose(cache_info);
   }
 #endif
 
   // Determine CPU clock frequency
 #if defined __linux__
-  FILE *proc_file = fopen("/proc/cpuinfo", "r");
-  if (proc_file) {
-	while(fgets(line, sizeof(line), proc_file)) {
-	  // Read line
-	  int len = strlen(line);
-	  if (len == 0)
-		continue;
-	  line[len - 1] = 0;
-
-	  // Parse line
-	  float f;
-	  if (sscanf(line, "cpu MHz : %fMHz", &f) == 1)
-		acip->frequency = (int)f;
+  cpuinfo_proc_t *pp = cpuinfo_proc_parse();
+  if (pp) {
+	int i;
+	for (i = 0; i < pp->n_cpus; i++) {
+	  if (pp->cpus[i].mhz > 0)
+		acip->frequency = (int)pp->cpus[i].mhz;
 	}
+	cpuinfo_proc_destroy(pp);
   }
 #elif defined __hpux
   struct pst_processor proc;
@@ -180,13 +177,11 @@ static int cpuinfo_arch_init(ia64_cpuinfo_t *acip)
 // Returns a new cpuinfo descriptor
 int cpuinfo_arch_new(struct cpuinfo *cip)
 {
-  ia64_cpuinfo_t *p = (ia64_cpuinfo_t *)malloc(sizeof(*p));
+  ia64_cpuinfo_t *p = (ia64_cpuinfo_t *)cpuinfo_arena_alloc(cip, sizeof(*p));
   if (p == NULL)
 	return -1;
-  if (cpuinfo_arch_init(p) < 0) {
-	free(p);
+  if (cpuinfo_arch_init(p) < 0)
 	return -1;
-  }
   cip->opaque = p;
   return 0;
 }
@@ -194,12 +189,33 @@ int cpuinfo_arch_new(struct cpuinfo *cip)
 // Release the cpuinfo descriptor and all allocated data
 void cpuinfo_arch_destroy(struct cpuinfo *cip)
 {
-  ia64_cpuinfo_t *acip = (ia64_cpuinfo_t *)(cip->opaque);
-  if (acip) {
-	if (acip->caches)
-	  cpuinfo_list_clear(&acip->caches);
-	free(acip);
-  }
+}
+
+// Get processor signature (none, the boot ID covers it)
+uint64_t cpuinfo_arch_get_signature(void)
+{
+  return 0;
+}
+
+// Serialize arch-dependent data
+int cpuinfo_arch_save(struct cpuinfo *cip, void *buf, int size)
+{
+  if (buf && size >= (int)sizeof(ia64_cpuinfo_t))
+	memcpy(buf, cip->opaque, sizeof(ia64_cpuinfo_t));
+  return sizeof(ia64_cpuinfo_t);
+}
+
+// Restore arch-dependent data
+int cpuinfo_arch_load(struct cpuinfo *cip, const void *data, int size)
+{
+  if (size != sizeof(ia64_cpuinfo_t))
+	return -1;
+  ia64_cpuinfo_t *p = (ia64_cpuinfo_t *)cpuinfo_arena_alloc(cip, sizeof(*p));
+  if (p == NULL)
+	return -1;
+  memcpy(p, data, sizeof(*p));
+  cip->opaque = p;
+  return 0;
 }
 
 // Dump all useful information for debugging
@@ -226,6 +242,12 @@ int cpuinfo_dump(struct cpuinfo *cip, FILE *out)
   return 0;
 }
 
+// Dump raw identification registers (unsupported)
+int cpuinfo_dump_raw(struct cpuinfo *cip, FILE *out)
+{
+  return -1;
+}
+
 // Get processor vendor ID 
 int cpuinfo_arch_get_vendor(struct cpuinfo *cip)
 {
@@ -282,10 +304,10 @@ char *cpuinfo_arch_get_model(struct cpuinfo *cip)
 	int model_length = strlen(name) + 1;
 	if (codename)
 	  model_length += strlen(codename) + 3;
-	char *model = (char *)malloc(model_length);
+	char *model = (char *)cpuinfo_arena_alloc(cip, model_length);
 	if (model) {
 	  if (codename)
-		sprintf("%s","%s", model, "%s '%s'", name, codename);
+		snprintf(model, model_length, "%s '%s'", name, codename);
 	  else
 		strcpy(model, name);
 	}
@@ -320,9 +342,40 @@ int cpuinfo_arch_get_threads(struct cpuinfo *cip)
 }
 
 // Get cache information
-cpuinfo_list_t cpuinfo_arch_get_caches(struct cpuinfo *cip)
+int cpuinfo_arch_get_caches(struct cpuinfo *cip, cpuinfo_cache_list_t *caches_list)
+{
+  *caches_list = ((ia64_cpuinfo_t *)(cip->opaque))->caches;
+  return caches_list->count;
+}
+
+// Get topology of each logical CPU
+int cpuinfo_arch_get_cpu_topology(struct cpuinfo *cip, cpuinfo_topology_cpu_t *cpus, int max_cpus)
+{
+  return 0;
+}
+
+// Get core class of a logical CPU
+int cpuinfo_arch_get_core_class(struct cpuinfo *cip, int cpu)
 {
-  return ((ia64_cpuinfo_t *)(cip->opaque))->caches;
+  return CPUINFO_CORE_CLASS_UNKNOWN;
+}
+
+// Get number of logical CPUs sharing a cache
+int cpuinfo_arch_get_cache_sharing(struct cpuinfo *cip, int level, int type)
+{
+  return -1;
+}
+
+// Get differences between logical CPUs (-1 if unknown)
+int cpuinfo_arch_get_heterogeneity(struct cpuinfo *cip)
+{
+  return -1;
+}
+
+// Get logical CPUs supporting the specified feature (-1 if unknown)
+int cpuinfo_arch_get_feature_cpus(struct cpuinfo *cip, int feature, cpuinfo_cpuset_t *set)
+{
+  return -1;
 }
 
 // Returns features table
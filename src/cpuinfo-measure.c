@@ -0,0 +1,762 @@
+/*
+ *  cpuinfo-measure.c - Processor characteristics measured by timing code
+ *
+ *  cpuinfo (C) 2006-2007 Gwenole Beauchesne
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#define _GNU_SOURCE 1
+#include "sysdeps.h"
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#if defined __linux__
+#include <sched.h>
+#include <sys/syscall.h>
+#endif
+#if defined __SSE2__
+#include <emmintrin.h>
+#endif
+#include "cpuinfo.h"
+#include "cpuinfo-private.h"
+
+#define DEBUG 0
+#include "debug.h"
+
+// Get current value of the nanosecond timer
+static uint64_t get_ticks_nsec(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+// Next value of a xorshift generator, good enough to shuffle working sets
+static uint32_t random_next(uint32_t *state)
+{
+  uint32_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return *state = x;
+}
+
+// Map anonymous memory, in huge pages if possible so that TLB misses do
+// not show up as cache levels (NULL on failure)
+static void *measure_map(size_t size)
+{
+  void *ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (ptr == MAP_FAILED)
+	return NULL;
+#ifdef MADV_HUGEPAGE
+  madvise(ptr, size, MADV_HUGEPAGE);
+#endif
+  return ptr;
+}
+
+// Create a thread running FUNCTION, pinned to logical CPU CPU if not -1
+// (returns -1 if it could not be created, or not pinned)
+static int measure_spawn(pthread_t *thread, int cpu, void *(*function)(void *), void *arg)
+{
+  pthread_attr_t attr;
+  int ret = -1;
+  pthread_attr_init(&attr);
+#if defined __linux__
+  if (cpu >= 0) {
+	cpu_set_t *set = cpu < CPUINFO_CPUSET_SIZE ? CPU_ALLOC(CPUINFO_CPUSET_SIZE) : NULL;
+	const size_t set_size = CPU_ALLOC_SIZE(CPUINFO_CPUSET_SIZE);
+	if (set == NULL)
+	  goto error;
+	CPU_ZERO_S(set_size, set);
+	CPU_SET_S(cpu, set_size, set);
+	int failed = pthread_attr_setaffinity_np(&attr, set_size, set) != 0;
+	CPU_FREE(set);
+	if (failed)
+	  goto error;
+  }
+#endif
+  if (pthread_create(thread, &attr, function, arg) == 0)
+	ret = 0;
+ error:
+  if (ret < 0)
+	D(bug("measure_spawn: could not create thread on CPU %d\n", cpu));
+  pthread_attr_destroy(&attr);
+  return ret;
+}
+
+// Run FUNCTION on the logical CPU the caller runs on, without changing the
+// affinity of the calling thread (returns -1 if it could not run)
+static int measure_run_pinned(void *(*function)(void *), void *arg)
+{
+  pthread_t thread;
+  int cpu = -1;
+#if defined __linux__
+  cpu = sched_getcpu();
+#endif
+  if (measure_spawn(&thread, cpu, function, arg) < 0)
+	return -1;
+  return pthread_join(thread, NULL) == 0 ? 0 : -1;
+}
+
+// Get the size of physical memory in bytes (0 if unknown)
+static size_t measure_memory_size(void)
+{
+  long page_size = sysconf(_SC_PAGESIZE);
+  long n_pages = sysconf(_SC_PHYS_PAGES);
+  return page_size > 0 && n_pages > 0 ? (size_t)n_pages * page_size : 0;
+}
+
+#define WORKING_SET_MIN_SIZE (16 << 20)		// working set beyond caches, at least
+#define WORKING_SET_MAX_SIZE (512 << 20)	// working set beyond caches, at most
+
+// Get the size of a working set that does not fit in caches, 4 times the
+// largest reported cache, so that N_SETS of them fit in an eighth of memory.
+// Without any reported cache, the sweep goes up to WORKING_SET_MAX_SIZE.
+// The largest line size goes into LINE_SIZE
+static size_t measure_working_set(cpuinfo_t *cip, int n_sets, int *line_size)
+{
+  const cpuinfo_cache_t *ccp = cpuinfo_get_caches(cip);
+  size_t size = WORKING_SET_MIN_SIZE;
+  int i, n_caches = 0;
+  *line_size = 64;
+  for (i = 0; ccp && i < ccp->count; i++) {
+	const cpuinfo_cache_geometry_t *cgp = cpuinfo_get_cache_geometry(cip, i);
+	if (ccp->descriptors[i].type == CPUINFO_CACHE_TYPE_TRACE || ccp->descriptors[i].size <= 0)
+	  continue;
+	n_caches++;
+	if (size < 4 * (size_t)ccp->descriptors[i].size * 1024)
+	  size = 4 * (size_t)ccp->descriptors[i].size * 1024;
+	if (cgp && *line_size < cgp->line_size)
+	  *line_size = cgp->line_size;
+  }
+  if (n_caches == 0)
+	size = WORKING_SET_MAX_SIZE;
+  const size_t memory_size = measure_memory_size();
+  if (memory_size > 0 && size > memory_size / 8 / n_sets)
+	size = memory_size / 8 / n_sets;
+  if (size > WORKING_SET_MAX_SIZE)
+	size = WORKING_SET_MAX_SIZE;
+  return size & ~(size_t)(*line_size - 1);
+}
+
+
+/* ========================================================================= */
+/* == Cache Latency                                                       == */
+/* ========================================================================= */
+
+#define LATENCY_MIN_SIZE 4096				// smallest working set
+#define LATENCY_LOADS (1 << 17)				// timed loads per run
+#define LATENCY_RUNS 3						// runs per working set, the fastest is kept
+
+// Splitting the latency curve into plateaus, one per cache level
+#define PLATEAU_RISE 1.2		// latency ratio within a plateau
+#define TRANSITION_RISE 1.1		// latency ratio between points of a transition
+#define LEVEL_RISE 1.5			// latency ratio between levels
+#define LEVEL_MIN_SAMPLES 3		// working sets at the latency of a level, at least
+
+typedef struct {
+  char *buf;					// working sets, at the start of the buffer
+  size_t max_size;
+  int line_size;				// distance between loaded addresses
+  int n_samples;
+  cpuinfo_latency_sample_t *samples;
+} latency_sweep_t;
+
+static void *volatile latency_sink;		// keeps the chase from being optimized out
+
+// Chase N pointers from P
+static void *latency_chase(void *p, long n)
+{
+  for (; n >= 8; n -= 8) {
+	p = *(void **)p; p = *(void **)p; p = *(void **)p; p = *(void **)p;
+	p = *(void **)p; p = *(void **)p; p = *(void **)p; p = *(void **)p;
+  }
+  return p;
+}
+
+// Link the lines of a working set of SIZE bytes into a single cycle, in
+// random order so that hardware prefetchers cannot follow
+static void latency_link(latency_sweep_t *lsp, size_t size, uint32_t *seed)
+{
+  const size_t n_lines = size / lsp->line_size;
+  size_t i;
+  for (i = 0; i < n_lines; i++)
+	*(void **)(lsp->buf + i * lsp->line_size) = lsp->buf + i * lsp->line_size;
+  // Sattolo's shuffle yields a single cycle through all lines
+  for (i = n_lines - 1; i > 0; i--) {
+	void **a = (void **)(lsp->buf + i * lsp->line_size);
+	void **b = (void **)(lsp->buf + (random_next(seed) % i) * lsp->line_size);
+	void *t = *a;
+	*a = *b;
+	*b = t;
+  }
+}
+
+// Time loads through working sets of increasing sizes
+static void *latency_sweep_thread(void *arg)
+{
+  latency_sweep_t *lsp = (latency_sweep_t *)arg;
+  uint32_t seed = 0x2545f491;
+  size_t base, size;
+  int i, k;
+
+  for (base = LATENCY_MIN_SIZE; base <= lsp->max_size; base *= 2) {
+	// 4 points per octave, on sizes common for caches (e.g. 48 KB, 1.25 MB)
+	for (k = 4; k < 8 && (size = base * k / 4) <= lsp->max_size; k++) {
+	  cpuinfo_latency_sample_t *sp = &lsp->samples[lsp->n_samples];
+	  const size_t n_lines = size / lsp->line_size;
+	  latency_link(lsp, size, &seed);
+	  void *p = latency_chase(lsp->buf, n_lines < LATENCY_LOADS ? n_lines : LATENCY_LOADS);
+	  sp->size = size / 1024;
+	  sp->latency_ns = 0;
+	  for (i = 0; i < LATENCY_RUNS; i++) {
+		uint64_t start = get_ticks_nsec();
+		p = latency_chase(p, LATENCY_LOADS);
+		double latency = (double)(get_ticks_nsec() - start) / LATENCY_LOADS;
+		if (i == 0 || sp->latency_ns > latency)
+		  sp->latency_ns = latency;
+	  }
+	  latency_sink = p;
+	  D(bug("cpuinfo_measure_caches: %zu KB, %.2f ns\n", size / 1024, sp->latency_ns));
+	  lsp->n_samples++;
+	}
+  }
+  return NULL;
+}
+
+// Get the median of LATENCIES FIRST to LAST
+static double latency_median(const double *latencies, int first, int last)
+{
+  double sorted[64];
+  int i, j, n = 0;
+  for (i = first; i <= last && n < 64; i++) {
+	// insertion sort, plateaus are short
+	for (j = n++; j > 0 && sorted[j - 1] > latencies[i]; j--)
+	  sorted[j] = sorted[j - 1];
+	sorted[j] = latencies[i];
+  }
+  return n > 0 ? sorted[n / 2] : 0;
+}
+
+// Find cache levels in the latency curve: each level is a plateau, and the
+// last plateau is memory. A level holds the working sets up to halfway, in
+// latency, to the next plateau
+static int latency_find_levels(cpuinfo_t *cip, cpuinfo_cache_measurement_t *cmp,
+							   const cpuinfo_latency_sample_t *samples, int n_samples)
+{
+  struct {
+	int first;			// first sample of the plateau
+	int last;			// last sample of the plateau
+	double latency;
+  } plateaus[CPUINFO_CACHES_MAX];
+  int i, j, n_plateaus = 0;
+
+  // median of 3 neighbours, against samples disturbed by other activity
+  double *latencies = (double *)malloc(n_samples * sizeof(*latencies));
+  if (latencies == NULL)
+	return -1;
+  for (i = 0; i < n_samples; i++) {
+	if (i == 0 || i == n_samples - 1)
+	  latencies[i] = samples[i].latency_ns;
+	else {
+	  double a = samples[i - 1].latency_ns, b = samples[i].latency_ns, c = samples[i + 1].latency_ns;
+	  latencies[i] = a > b ? (b > c ? b : a > c ? c : a) : (a > c ? a : b > c ? c : b);
+	}
+  }
+
+  for (i = 0; i < n_samples; i++) {
+	const int first = i;
+	while (i + 1 < n_samples && latencies[i + 1] <= latencies[first] * PLATEAU_RISE)
+	  i++;
+	double latency = latency_median(latencies, first, i);
+	if (n_plateaus > 0 && latency < plateaus[n_plateaus - 1].latency * LEVEL_RISE)
+	  plateaus[n_plateaus - 1].last = i;		// not a level of its own
+	else if (n_plateaus < CPUINFO_CACHES_MAX && (i - first + 1 >= LEVEL_MIN_SAMPLES || i == n_samples - 1)) {
+	  plateaus[n_plateaus].first = first;
+	  plateaus[n_plateaus].last = i;
+	  plateaus[n_plateaus].latency = latency;
+	  n_plateaus++;
+	}
+	// skip the transition to the next level
+	while (i + 2 < n_samples && latencies[i + 2] > latencies[i + 1] * TRANSITION_RISE)
+	  i++;
+  }
+  if (n_plateaus == 0) {
+	free(latencies);
+	return -1;
+  }
+
+  int frequency = cpuinfo_get_frequency(cip);
+  if (frequency < 0)
+	frequency = 0;
+  cpuinfo_measured_cache_t *caches = NULL;
+  cmp->count = n_plateaus - 1;
+  if (cmp->count > 0 &&
+	  (caches = (cpuinfo_measured_cache_t *)cpuinfo_arena_alloc(cip, cmp->count * sizeof(*caches))) == NULL) {
+	free(latencies);
+	return -1;
+  }
+  for (j = 0; j < cmp->count; j++) {
+	cpuinfo_measured_cache_t *mcp = &caches[j];
+	const double halfway = (plateaus[j].latency + plateaus[j + 1].latency) / 2;
+	for (i = plateaus[j].last; i < plateaus[j + 1].first && latencies[i + 1] <= halfway; i++)
+	  ;
+	mcp->level = j + 1;
+	mcp->type = mcp->level == 1 ? CPUINFO_CACHE_TYPE_DATA : CPUINFO_CACHE_TYPE_UNIFIED;
+	mcp->size = samples[i].size;
+	mcp->flags = CPUINFO_CACHE_FLAG_MEASURED;
+	mcp->latency_ns = plateaus[j].latency;
+	mcp->latency_cycles = plateaus[j].latency * frequency / 1000;
+  }
+  cmp->caches = caches;
+  cmp->memory_latency_ns = plateaus[n_plateaus - 1].latency;
+  cmp->memory_latency_cycles = cmp->memory_latency_ns * frequency / 1000;
+  free(latencies);
+  return 0;
+}
+
+// Measure caches by chasing pointers through random working sets
+const cpuinfo_cache_measurement_t *cpuinfo_measure_caches(cpuinfo_t *cip)
+{
+  if (cip == NULL)
+	return NULL;
+  if (cip->cache_measurement)
+	return cip->cache_measurement;
+
+  // sweep up to 4 times the largest cache, within an eighth of memory
+  latency_sweep_t sweep;
+  int i;
+  memset(&sweep, 0, sizeof(sweep));
+  size_t max_size = measure_working_set(cip, 1, &sweep.line_size);
+  sweep.max_size = max_size;
+
+  // 4 samples per octave
+  int max_samples = 4;
+  for (i = LATENCY_MIN_SIZE; i < max_size; i *= 2)
+	max_samples += 4;
+  sweep.samples = (cpuinfo_latency_sample_t *)cpuinfo_arena_alloc(cip, max_samples * sizeof(*sweep.samples));
+  if (sweep.samples == NULL || (sweep.buf = (char *)measure_map(max_size)) == NULL)
+	return NULL;
+  int ret = measure_run_pinned(latency_sweep_thread, &sweep);
+  munmap(sweep.buf, max_size);
+  if (ret < 0 || sweep.n_samples == 0)
+	return NULL;
+
+  cpuinfo_cache_measurement_t *cmp = (cpuinfo_cache_measurement_t *)cpuinfo_arena_alloc(cip, sizeof(*cmp));
+  if (cmp == NULL)
+	return NULL;
+  cmp->n_samples = sweep.n_samples;
+  cmp->samples = sweep.samples;
+  if (latency_find_levels(cip, cmp, sweep.samples, sweep.n_samples) < 0)
+	return NULL;
+  D(bug("cpuinfo_measure_caches: %d levels, memory %.2f ns\n", cmp->count, cmp->memory_latency_ns));
+  cip->cache_measurement = cmp;
+  cpuinfo_cache_update(cip);
+  return cmp;
+}
+
+
+/* ========================================================================= */
+/* == Memory Bandwidth                                                    == */
+/* ========================================================================= */
+
+#define BANDWIDTH_RUNS 10			// runs per kernel, the fastest is kept
+#define BANDWIDTH_SCALAR 3.0		// q of the scale and triad kernels
+#define BANDWIDTH_STAGGER 256		// offset between arrays, so that they do not map to the same sets
+#define LOADED_CHUNK 4096			// bytes read by background threads between delays
+#define LOADED_LOADS (1 << 18)		// timed loads per rate of background traffic
+
+// Delays of background threads between chunks, in spins, from idle (-1) to full traffic
+static const int loaded_delays[] = { -1, 4096, 1024, 256, 64, 16, 0 };
+#define LOADED_LEVELS ((int)(sizeof(loaded_delays) / sizeof(loaded_delays[0])))
+
+// Bytes moved per element, as counted by STREAM
+static const int bandwidth_bytes[CPUINFO_BANDWIDTH_KERNELS] = { 8, 16, 16, 24, 24, 16, 24 };
+
+// Keep plain loads and stores in kernels, not calls to memcpy() that may stream
+#if defined __clang__
+#define attribute_no_memcpy __attribute__((no_builtin("memcpy")))
+#elif defined __GNUC__
+#define attribute_no_memcpy __attribute__((optimize("no-tree-loop-distribute-patterns")))
+#else
+#define attribute_no_memcpy
+#endif
+
+#define BANDWIDTH_LINE_SIZE 64		// records of threads do not share cache lines
+
+typedef struct bandwidth_run bandwidth_run_t;
+
+typedef struct {
+  bandwidth_run_t *brp;
+  pthread_t thread;
+  int index;					// thread 0 takes timings
+  int cpu;
+  double *a, *b, *c;			// arrays of the thread, in one mapping at A
+  double sum;					// result of the read kernel
+  unsigned long long bytes;		// bytes read as background traffic
+} __attribute__((aligned(BANDWIDTH_LINE_SIZE))) bandwidth_thread_t;
+
+struct bandwidth_run {
+  int n_threads;
+  int n_levels;					// rates of background traffic
+  size_t n_elements;			// elements of each array
+  size_t arrays_size;			// bytes mapped for the arrays of a thread
+  bandwidth_thread_t *threads;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  int state;					// 0 while threads are created, 1 to run, -1 to give up
+  pthread_barrier_t barrier;
+  double times[CPUINFO_BANDWIDTH_KERNELS];	// fastest run of each kernel in ns
+  latency_sweep_t chase;		// working set for latency under load, chased by thread 0
+  int stop;						// set when background threads should wait for the next rate
+  cpuinfo_loaded_latency_t loaded[LOADED_LEVELS];
+};
+
+// Get the size in bytes of the last level cache instances shared by logical
+// CPUs of SET, all of them together (0 if unknown)
+static size_t bandwidth_llc_size(cpuinfo_t *cip, const cpuinfo_cpuset_t *set)
+{
+  const cpuinfo_cache_instances_t *cisp = cpuinfo_get_cache_instances(cip);
+  size_t size = 0;
+  int i, j, level = 0;
+  for (i = 0; cisp && i < cisp->count; i++) {
+	const cpuinfo_cache_instance_t *cp = &cisp->instances[i];
+	if (cp->type != CPUINFO_CACHE_TYPE_CODE && cp->type != CPUINFO_CACHE_TYPE_TRACE && level < cp->level)
+	  level = cp->level;
+  }
+  for (i = 0; cisp && i < cisp->count; i++) {
+	const cpuinfo_cache_instance_t *cp = &cisp->instances[i];
+	if (cp->level != level || cp->type == CPUINFO_CACHE_TYPE_CODE || cp->type == CPUINFO_CACHE_TYPE_TRACE)
+	  continue;
+	for (j = 0; j < CPUINFO_CPUSET_SIZE / 32; j++) {
+	  if (cp->cpus.bits[j] & set->bits[j]) {
+		size += (size_t)cp->size * 1024;
+		break;
+	  }
+	}
+  }
+  return size;
+}
+
+// Bind SIZE bytes at PTR to NUMA node NODE, before they are touched
+// (returns -1 on error)
+static int measure_bind(void *ptr, size_t size, int node)
+{
+#if defined __linux__ && defined SYS_mbind
+  unsigned long mask[1024 / (8 * sizeof(unsigned long))];
+  const int bits = 8 * sizeof(unsigned long);
+  if (node < 0 || node >= 1024)
+	return -1;
+  memset(mask, 0, sizeof(mask));
+  mask[node / bits] = 1UL << (node % bits);
+  // MPOL_BIND, the kernel reads one bit less than the node count passed
+  if (syscall(SYS_mbind, ptr, size, 2, mask, 1024 + 1, 0) == 0)
+	return 0;
+#endif
+  D(bug("measure_bind: could not bind memory to node %d\n", node));
+  return -1;
+}
+
+static double bandwidth_read(const double *a, size_t n)
+{
+  // independent sums, so that the loop is not bound by the latency of adds
+  double s0 = 0, s1 = 0, s2 = 0, s3 = 0, s4 = 0, s5 = 0, s6 = 0, s7 = 0;
+  size_t i;
+  for (i = 0; i + 8 <= n; i += 8) {
+	s0 += a[i + 0]; s1 += a[i + 1]; s2 += a[i + 2]; s3 += a[i + 3];
+	s4 += a[i + 4]; s5 += a[i + 5]; s6 += a[i + 6]; s7 += a[i + 7];
+  }
+  for (; i < n; i++)
+	s0 += a[i];
+  return ((s0 + s1) + (s2 + s3)) + ((s4 + s5) + (s6 + s7));
+}
+
+// Run KERNEL once on the arrays of a thread
+static attribute_no_memcpy void bandwidth_kernel(bandwidth_thread_t *btp, int kernel)
+{
+  double *restrict a = btp->a, *restrict b = btp->b, *restrict c = btp->c;
+  const size_t n = btp->brp->n_elements;
+  const double q = BANDWIDTH_SCALAR;
+  size_t i = 0;
+
+  switch (kernel) {
+  case CPUINFO_BANDWIDTH_READ:
+	btp->sum += bandwidth_read(a, n);
+	break;
+  case CPUINFO_BANDWIDTH_COPY:
+	for (i = 0; i < n; i++)
+	  c[i] = a[i];
+	break;
+  case CPUINFO_BANDWIDTH_SCALE:
+	for (i = 0; i < n; i++)
+	  b[i] = q * c[i];
+	break;
+  case CPUINFO_BANDWIDTH_ADD:
+	for (i = 0; i < n; i++)
+	  c[i] = a[i] + b[i];
+	break;
+  case CPUINFO_BANDWIDTH_TRIAD:
+	for (i = 0; i < n; i++)
+	  a[i] = b[i] + q * c[i];
+	break;
+  case CPUINFO_BANDWIDTH_COPY_NT:
+#if defined __SSE2__
+	for (; i + 2 <= n; i += 2)
+	  _mm_stream_pd(c + i, _mm_load_pd(a + i));
+	_mm_sfence();
+#endif
+	// plain stores for the rest, and on processors without streaming stores
+	for (; i < n; i++)
+	  c[i] = a[i];
+	break;
+  case CPUINFO_BANDWIDTH_TRIAD_NT:
+#if defined __SSE2__
+	for (; i + 2 <= n; i += 2)
+	  _mm_stream_pd(a + i, _mm_add_pd(_mm_load_pd(b + i), _mm_mul_pd(_mm_set1_pd(q), _mm_load_pd(c + i))));
+	_mm_sfence();
+#endif
+	for (; i < n; i++)
+	  a[i] = b[i] + q * c[i];
+	break;
+  }
+}
+
+// Get bytes read by background threads so far
+static unsigned long long loaded_bytes(bandwidth_run_t *brp)
+{
+  unsigned long long bytes = 0;
+  int i;
+  for (i = 1; i < brp->n_threads; i++)
+	bytes += __atomic_load_n(&brp->threads[i].bytes, __ATOMIC_RELAXED);
+  return bytes;
+}
+
+// Time loads from memory, on thread 0, at each rate of background traffic
+static void loaded_latency_chase(bandwidth_run_t *brp)
+{
+  uint32_t seed = 0x2545f491;
+  int i;
+  latency_link(&brp->chase, brp->chase.max_size, &seed);
+  void *p = brp->chase.buf;
+  for (i = 0; i < brp->n_levels; i++) {
+	cpuinfo_loaded_latency_t *llp = &brp->loaded[i];
+	pthread_barrier_wait(&brp->barrier);
+	p = latency_chase(p, LOADED_LOADS / 8);		// background traffic settles meanwhile
+	unsigned long long bytes = loaded_bytes(brp);
+	uint64_t start = get_ticks_nsec();
+	p = latency_chase(p, LOADED_LOADS);
+	uint64_t elapsed = get_ticks_nsec() - start;
+	bytes = loaded_bytes(brp) - bytes;
+	llp->latency_ns = (double)elapsed / LOADED_LOADS;
+	llp->bandwidth = elapsed > 0 ? (double)bytes * 1000 / elapsed : 0;
+	D(bug("cpuinfo_measure_bandwidth: %.0f MB/s, %.2f ns\n", llp->bandwidth, llp->latency_ns));
+	__atomic_store_n(&brp->stop, 1, __ATOMIC_RELAXED);
+	pthread_barrier_wait(&brp->barrier);
+	__atomic_store_n(&brp->stop, 0, __ATOMIC_RELAXED);
+  }
+  latency_sink = p;
+}
+
+// Read memory, on other threads, in chunks separated by each delay in turn
+static void loaded_latency_load(bandwidth_thread_t *btp)
+{
+  bandwidth_run_t *brp = btp->brp;
+  const size_t chunk = LOADED_CHUNK / sizeof(double);
+  size_t offset = 0;
+  double sum = 0;
+  int i, j;
+  for (i = 0; i < brp->n_levels; i++) {
+	const int delay = loaded_delays[i];
+	pthread_barrier_wait(&brp->barrier);
+	while (delay >= 0 && !__atomic_load_n(&brp->stop, __ATOMIC_RELAXED)) {
+	  if (offset + chunk > brp->n_elements)
+		offset = 0;
+	  sum += bandwidth_read(btp->a + offset, chunk);
+	  offset += chunk;
+	  __atomic_store_n(&btp->bytes, btp->bytes + LOADED_CHUNK, __ATOMIC_RELAXED);
+	  for (j = delay; j > 0; j--)
+		__asm__ __volatile__ ("" : : : "memory");
+	}
+	pthread_barrier_wait(&brp->barrier);
+  }
+  btp->sum += sum;
+}
+
+static void *bandwidth_thread(void *arg)
+{
+  bandwidth_thread_t *btp = (bandwidth_thread_t *)arg;
+  bandwidth_run_t *brp = btp->brp;
+  size_t i;
+  int k, r;
+
+  pthread_mutex_lock(&brp->lock);
+  while (brp->state == 0)
+	pthread_cond_wait(&brp->cond, &brp->lock);
+  int state = brp->state;
+  pthread_mutex_unlock(&brp->lock);
+  if (state < 0)
+	return NULL;
+
+  // first touch, from the CPU the arrays are local to
+  for (i = 0; i < brp->n_elements; i++) {
+	btp->a[i] = 1.0;
+	btp->b[i] = 2.0;
+	btp->c[i] = 0.0;
+  }
+
+  for (k = 0; k < CPUINFO_BANDWIDTH_KERNELS; k++) {
+	for (r = 0; r < BANDWIDTH_RUNS; r++) {
+	  uint64_t start = 0;
+	  pthread_barrier_wait(&brp->barrier);
+	  if (btp->index == 0)
+		start = get_ticks_nsec();
+	  bandwidth_kernel(btp, k);
+	  pthread_barrier_wait(&brp->barrier);
+	  if (btp->index == 0) {
+		double elapsed = (double)(get_ticks_nsec() - start);
+		if (r == 0 || brp->times[k] > elapsed)
+		  brp->times[k] = elapsed;
+	  }
+	}
+  }
+
+  if (btp->index == 0)
+	loaded_latency_chase(brp);
+  else
+	loaded_latency_load(btp);
+  return NULL;
+}
+
+// Measure memory bandwidth with STREAM kernels, then latency under load
+const cpuinfo_bandwidth_t *cpuinfo_measure_bandwidth(cpuinfo_t *cip, const cpuinfo_bandwidth_config_t *config)
+{
+  if (cip == NULL)
+	return NULL;
+  if (config == NULL && cip->bandwidth)
+	return cip->bandwidth;
+
+  cpuinfo_cpuset_t cpus;
+  int node = config ? config->node : -1;
+  if (config && cpuinfo_cpuset_count(&config->cpus) > 0)
+	cpus = config->cpus;
+  else {
+	cpuinfo_parallelism_t p;
+	if (cpuinfo_get_parallelism(cip, &p) < 0)
+	  return NULL;
+	cpus = p.cpus;
+  }
+  int n_threads = cpuinfo_cpuset_count(&cpus);
+  if (n_threads == 0)
+	return NULL;
+
+  // as STREAM requires, each array of all threads together is 4 times the
+  // last level caches they share, and at least the working set for latency.
+  // The 3 arrays take a quarter of memory, at most
+  bandwidth_run_t run;
+  memset(&run, 0, sizeof(run));
+  run.n_threads = n_threads;
+  run.n_levels = n_threads > 1 ? LOADED_LEVELS : 1;
+  run.chase.max_size = measure_working_set(cip, 4, &run.chase.line_size);
+  size_t array_size = 4 * bandwidth_llc_size(cip, &cpus);
+  if (array_size < run.chase.max_size)
+	array_size = run.chase.max_size;
+  const size_t memory_size = measure_memory_size();
+  if (memory_size > 0 && array_size > memory_size / 4 / 3)
+	array_size = memory_size / 4 / 3;
+  run.n_elements = array_size / n_threads / sizeof(double);
+  if (run.n_elements < LOADED_CHUNK / sizeof(double))
+	run.n_elements = LOADED_CHUNK / sizeof(double);
+  run.n_elements &= ~(size_t)7;
+  const size_t stride = run.n_elements * sizeof(double) + BANDWIDTH_STAGGER;
+  run.arrays_size = 3 * stride;
+  pthread_mutex_init(&run.lock, NULL);
+  pthread_cond_init(&run.cond, NULL);
+  pthread_barrier_init(&run.barrier, NULL, n_threads);
+
+  const cpuinfo_bandwidth_t *result = NULL;
+  int i, cpu, n_created = 0;
+  if (posix_memalign((void **)&run.threads, BANDWIDTH_LINE_SIZE, n_threads * sizeof(*run.threads)) != 0)
+	goto error;
+  memset(run.threads, 0, n_threads * sizeof(*run.threads));
+  if ((run.chase.buf = (char *)measure_map(run.chase.max_size)) == NULL ||
+	  (node >= 0 && measure_bind(run.chase.buf, run.chase.max_size, node) < 0))
+	goto error;
+  for (i = 0, cpu = 0; i < n_threads; i++, cpu++) {
+	bandwidth_thread_t *btp = &run.threads[i];
+	while (!cpuinfo_cpuset_isset(&cpus, cpu))
+	  cpu++;
+	btp->brp = &run;
+	btp->index = i;
+	btp->cpu = cpu;
+	if ((btp->a = (double *)measure_map(run.arrays_size)) == NULL ||
+		(node >= 0 && measure_bind(btp->a, run.arrays_size, node) < 0))
+	  goto error;
+	btp->b = (double *)((char *)btp->a + stride);
+	btp->c = (double *)((char *)btp->b + stride);
+  }
+
+  for (i = 0; i < n_threads; i++) {
+	if (measure_spawn(&run.threads[i].thread, run.threads[i].cpu, bandwidth_thread, &run.threads[i]) < 0)
+	  break;
+	n_created++;
+  }
+  pthread_mutex_lock(&run.lock);
+  run.state = n_created == n_threads ? 1 : -1;
+  pthread_cond_broadcast(&run.cond);
+  pthread_mutex_unlock(&run.lock);
+  for (i = 0; i < n_created; i++)
+	pthread_join(run.threads[i].thread, NULL);
+  if (run.state < 0)
+	goto error;
+
+  cpuinfo_bandwidth_t *bp = (cpuinfo_bandwidth_t *)cpuinfo_arena_alloc(cip, sizeof(*bp));
+  cpuinfo_loaded_latency_t *loaded = (cpuinfo_loaded_latency_t *)cpuinfo_arena_alloc(cip, run.n_levels * sizeof(*loaded));
+  if (bp == NULL || loaded == NULL)
+	goto error;
+  bp->cpus = cpus;
+  bp->n_threads = n_threads;
+  bp->node = node;
+  bp->size = run.n_elements * sizeof(double) / 1024;
+  for (i = 0; i < CPUINFO_BANDWIDTH_KERNELS; i++) {
+	const double bytes = (double)bandwidth_bytes[i] * run.n_elements * n_threads;
+	bp->bandwidth[i] = run.times[i] > 0 ? bytes * 1000 / run.times[i] : 0;
+	D(bug("cpuinfo_measure_bandwidth: %s %.0f MB/s\n", cpuinfo_string_of_bandwidth_kernel(i), bp->bandwidth[i]));
+  }
+  memcpy(loaded, run.loaded, run.n_levels * sizeof(*loaded));
+  bp->n_loaded_latencies = run.n_levels;
+  bp->loaded_latencies = loaded;
+  if (config == NULL) {
+	cip->bandwidth = bp;
+	cpuinfo_cache_update(cip);
+  }
+  result = bp;
+
+ error:
+  if (run.threads) {
+	for (i = 0; i < n_threads; i++) {
+	  if (run.threads[i].a)
+		munmap(run.threads[i].a, run.arrays_size);
+	}
+	free(run.threads);
+  }
+  if (run.chase.buf)
+	munmap(run.chase.buf, run.chase.max_size);
+  pthread_barrier_destroy(&run.barrier);
+  pthread_cond_destroy(&run.cond);
+  pthread_mutex_destroy(&run.lock);
+  return result;
+}
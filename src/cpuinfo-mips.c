@@ -198,7 +198,7 @@ struct mips_cpuinfo {
   uint32_t frequency;
   int vendor;
   const char *model;
-  cpuinfo_list_t caches;
+  cpuinfo_cache_list_t caches;
   uint32_t features[CPUINFO_FEATURES_SZ_(MIPS)];
 };
 
@@ -211,10 +211,10 @@ static int cpuinfo_arch_init(mips_cpuinfo_t *acip)
   acip->frequency = 0;
   acip->vendor = CPUINFO_VENDOR_UNKNOWN;
   acip->model = NULL;
-  acip->caches = NULL;
+  acip->caches.count = 0;
   memset(&acip->features, 0, sizeof(acip->features));
 
-  cpuinfo_list_t caches_list = NULL;
+  cpuinfo_cache_list_t *caches_list = &acip->caches;
 #if defined __sgi
   inv_state_t *isp = NULL;
   cpuinfo_cache_descriptor_t cache_desc;
@@ -239,31 +239,31 @@ static int cpuinfo_arch_init(mips_cpuinfo_t *acip)
 		cache_desc.level = 1;
 		cache_desc.type = CPUINFO_CACHE_TYPE_CODE;
 		cache_desc.size = inv->inv_state / 1024;
-		cpuinfo_list_insert(&caches_list, &cache_desc);
+		cpuinfo_cache_list_insert(caches_list, &cache_desc);
 		break;
 	  case INV_DCACHE:
 		cache_desc.level = 1;
 		cache_desc.type = CPUINFO_CACHE_TYPE_DATA;
 		cache_desc.size = inv->inv_state / 1024;
-		cpuinfo_list_insert(&caches_list, &cache_desc);
+		cpuinfo_cache_list_insert(caches_list, &cache_desc);
 		break;
 	  case INV_SICACHE:
 		cache_desc.level = 2;
 		cache_desc.type = CPUINFO_CACHE_TYPE_CODE;
 		cache_desc.size = inv->inv_state / 1024;
-		cpuinfo_list_insert(&caches_list, &cache_desc);
+		cpuinfo_cache_list_insert(caches_list, &cache_desc);
 		break;
 	  case INV_SDCACHE:
 		cache_desc.level = 2;
 		cache_desc.type = CPUINFO_CACHE_TYPE_DATA;
 		cache_desc.size = inv->inv_state / 1024;
-		cpuinfo_list_insert(&caches_list, &cache_desc);
+		cpuinfo_cache_list_insert(caches_list, &cache_desc);
 		break;
 	  case INV_SIDCACHE:
 		cache_desc.level = 2;
 		cache_desc.type = CPUINFO_CACHE_TYPE_UNIFIED;
 		cache_desc.size = inv->inv_state / 1024;
-		cpuinfo_list_insert(&caches_list, &cache_desc);
+		cpuinfo_cache_list_insert(caches_list, &cache_desc);
 		break;
 	  }
 	  break;
@@ -279,20 +279,14 @@ static int cpuinfo_arch_init(mips_cpuinfo_t *acip)
   if (spec) {
 	acip->vendor = spec->vendor;
 	acip->model = spec->model;
-	if (caches_list == NULL) {
+	if (caches_list->count == 0) {
 	  for (int i = 0; i < N_CACHE_DESCRIPTORS; i++) {
-		if (spec->caches[i]) {
-		  if (cpuinfo_list_insert(&caches_list, spec->caches[i]) < 0) {
-			cpuinfo_list_clear(&caches_list);
-			return -1;
-		  }
-		}
+		if (spec->caches[i])
+		  cpuinfo_cache_list_insert(caches_list, spec->caches[i]);
 	  }
 	}
   }
 
-  acip->caches = caches_list;
-
   // XXX: fill in additional vendors
 
   return 0;
@@ -301,13 +295,11 @@ static int cpuinfo_arch_init(mips_cpuinfo_t *acip)
 // Returns a new cpuinfo descriptor
 int cpuinfo_arch_new(struct cpuinfo *cip)
 {
-  mips_cpuinfo_t *p = (mips_cpuinfo_t *)malloc(sizeof(*p));
+  mips_cpuinfo_t *p = (mips_cpuinfo_t *)cpuinfo_arena_alloc(cip, sizeof(*p));
   if (p == NULL)
 	return -1;
-  if (cpuinfo_arch_init(p) < 0) {
-	free(p);
+  if (cpuinfo_arch_init(p) < 0)
 	return -1;
-  }
   cip->opaque = p;
   return 0;
 }
@@ -315,9 +307,37 @@ int cpuinfo_arch_new(struct cpuinfo *cip)
 // Release the cpuinfo descriptor and all allocated data
 void cpuinfo_arch_destroy(struct cpuinfo *cip)
 {
-  mips_cpuinfo_t *acip = (mips_cpuinfo_t *)cip->opaque;
-  if (acip)
-	free(acip);
+}
+
+// Get processor signature (none, the boot ID covers it)
+uint64_t cpuinfo_arch_get_signature(void)
+{
+  return 0;
+}
+
+// Serialize arch-dependent data
+int cpuinfo_arch_save(struct cpuinfo *cip, void *buf, int size)
+{
+  if (buf && size >= (int)sizeof(mips_cpuinfo_t))
+	memcpy(buf, cip->opaque, sizeof(mips_cpuinfo_t));
+  return sizeof(mips_cpuinfo_t);
+}
+
+// Restore arch-dependent data
+int cpuinfo_arch_load(struct cpuinfo *cip, const void *data, int size)
+{
+  if (size != sizeof(mips_cpuinfo_t))
+	return -1;
+  mips_cpuinfo_t *p = (mips_cpuinfo_t *)cpuinfo_arena_alloc(cip, sizeof(*p));
+  if (p == NULL)
+	return -1;
+  memcpy(p, data, sizeof(*p));
+
+  // model names are static strings of the saving process
+  const mips_spec_t *spec = lookup_mips_spec(p->prid);
+  p->model = spec ? spec->model : NULL;
+  cip->opaque = p;
+  return 0;
 }
 
 // Dump all useful information for debugging
@@ -334,6 +354,12 @@ int cpuinfo_dump(struct cpuinfo *cip, FILE *out)
   return 0;
 }
 
+// Dump raw identification registers (unsupported)
+int cpuinfo_dump_raw(struct cpuinfo *cip, FILE *out)
+{
+  return -1;
+}
+
 // Get processor vendor ID 
 int cpuinfo_arch_get_vendor(struct cpuinfo *cip)
 {
@@ -344,12 +370,8 @@ int cpuinfo_arch_get_vendor(struct cpuinfo *cip)
 char *cpuinfo_arch_get_model(struct cpuinfo *cip)
 {
   const char *imodel = ((mips_cpuinfo_t *)(cip->opaque))->model;
-  if (imodel) {
-	char *model = (char *)malloc(strlen(imodel) + 1);
-	if (model)
-	  strcpy(model, imodel);
-	return model;
-  }
+  if (imodel)
+	return cpuinfo_arena_strdup(cip, imodel);
   return NULL;
 }
 
@@ -378,9 +400,40 @@ int cpuinfo_arch_get_threads(struct cpuinfo *cip)
 }
 
 // Get cache information
-cpuinfo_list_t cpuinfo_arch_get_caches(struct cpuinfo *cip)
+int cpuinfo_arch_get_caches(struct cpuinfo *cip, cpuinfo_cache_list_t *caches_list)
+{
+  *caches_list = ((mips_cpuinfo_t *)(cip->opaque))->caches;
+  return caches_list->count;
+}
+
+// Get topology of each logical CPU
+int cpuinfo_arch_get_cpu_topology(struct cpuinfo *cip, cpuinfo_topology_cpu_t *cpus, int max_cpus)
 {
-  return ((mips_cpuinfo_t *)(cip->opaque))->caches;
+  return 0;
+}
+
+// Get core class of a logical CPU
+int cpuinfo_arch_get_core_class(struct cpuinfo *cip, int cpu)
+{
+  return CPUINFO_CORE_CLASS_UNKNOWN;
+}
+
+// Get number of logical CPUs sharing a cache
+int cpuinfo_arch_get_cache_sharing(struct cpuinfo *cip, int level, int type)
+{
+  return -1;
+}
+
+// Get differences between logical CPUs (-1 if unknown)
+int cpuinfo_arch_get_heterogeneity(struct cpuinfo *cip)
+{
+  return -1;
+}
+
+// Get logical CPUs supporting the specified feature (-1 if unknown)
+int cpuinfo_arch_get_feature_cpus(struct cpuinfo *cip, int feature, cpuinfo_cpuset_t *set)
+{
+  return -1;
 }
 
 // Returns features table
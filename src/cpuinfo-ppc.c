@@ -185,7 +185,8 @@ static int of_get_properties(of_info_t *ofip)
 #elif defined __linux__
   char path[PATH_MAX];
   struct dirent *de;
-  static const char oftree_cpus[] = "/proc/device-tree/cpus";
+  char oftree_cpus[PATH_MAX];
+  snprintf(oftree_cpus, sizeof(oftree_cpus), "%s/device-tree/cpus", cpuinfo_procfs_root());
   DIR *d = opendir(oftree_cpus);
   if (d == NULL)
 	return -1;
@@ -644,25 +645,14 @@ static int cpuinfo_arch_init(ppc_cpuinfo_t *acip)
   }
 #elif defined __linux__
   if (acip->frequency == 0) {
-	FILE *proc_file = fopen("/proc/cpuinfo", "r");
-	if (proc_file) {
-	  char line[256];
-	  while(fgets(line, sizeof(line), proc_file)) {
-		// Read line
-		int len = strlen(line);
-		if (len == 0)
-		  continue;
-		line[len-1] = 0;
-
-		// Parse line
-		int i;
-		float f;
-		if (sscanf(line, "clock : %fMHz", &f) == 1)
-		  acip->frequency = (int)f;
-		else if (sscanf(line, "clock : %dMHz", &i) == 1)
-		  acip->frequency = i;
+	cpuinfo_proc_t *pp = cpuinfo_proc_parse();
+	if (pp) {
+	  int i;
+	  for (i = 0; i < pp->n_cpus; i++) {
+		if (pp->cpus[i].mhz > 0)
+		  acip->frequency = (int)pp->cpus[i].mhz;
 	  }
-	  fclose(proc_file);
+	  cpuinfo_proc_destroy(pp);
 	}
   }
 #endif
@@ -676,13 +666,11 @@ static int cpuinfo_arch_init(ppc_cpuinfo_t *acip)
 // Returns a new cpuinfo descriptor
 int cpuinfo_arch_new(struct cpuinfo *cip)
 {
-  ppc_cpuinfo_t *p = (ppc_cpuinfo_t *)malloc(sizeof(*p));
+  ppc_cpuinfo_t *p = (ppc_cpuinfo_t *)cpuinfo_arena_alloc(cip, sizeof(*p));
   if (p == NULL)
 	return -1;
-  if (cpuinfo_arch_init(p) < 0) {
-	free(p);
+  if (cpuinfo_arch_init(p) < 0)
 	return -1;
-  }
   cip->opaque = p;
   return 0;
 }
@@ -690,8 +678,33 @@ int cpuinfo_arch_new(struct cpuinfo *cip)
 // Release the cpuinfo descriptor and all allocated data
 void cpuinfo_arch_destroy(struct cpuinfo *cip)
 {
-  if (cip->opaque)
-	free(cip->opaque);
+}
+
+// Get processor signature (none, the boot ID covers it)
+uint64_t cpuinfo_arch_get_signature(void)
+{
+  return 0;
+}
+
+// Serialize arch-dependent data
+int cpuinfo_arch_save(struct cpuinfo *cip, void *buf, int size)
+{
+  if (buf && size >= (int)sizeof(ppc_cpuinfo_t))
+	memcpy(buf, cip->opaque, sizeof(ppc_cpuinfo_t));
+  return sizeof(ppc_cpuinfo_t);
+}
+
+// Restore arch-dependent data
+int cpuinfo_arch_load(struct cpuinfo *cip, const void *data, int size)
+{
+  if (size != sizeof(ppc_cpuinfo_t))
+	return -1;
+  ppc_cpuinfo_t *p = (ppc_cpuinfo_t *)cpuinfo_arena_alloc(cip, sizeof(*p));
+  if (p == NULL)
+	return -1;
+  memcpy(p, data, sizeof(*p));
+  cip->opaque = p;
+  return 0;
 }
 
 // Dump all useful information for debugging
@@ -732,6 +745,12 @@ int cpuinfo_dump(struct cpuinfo *cip, FILE *out)
   return 0;
 }
 
+// Dump raw identification registers (unsupported)
+int cpuinfo_dump_raw(struct cpuinfo *cip, FILE *out)
+{
+  return -1;
+}
+
 // Get CPU spec
 static const ppc_spec_t *get_ppc_spec(struct cpuinfo *cip)
 {
@@ -760,13 +779,8 @@ int cpuinfo_arch_get_vendor(struct cpuinfo *cip)
 char *cpuinfo_arch_get_model(struct cpuinfo *cip)
 {
   const ppc_spec_t *spec = get_ppc_spec(cip);
-  if (spec && spec->model) {
-	char *model = (char *)malloc(strlen(spec->model) + 1);
-	if (model == NULL)
-	  return NULL;
-	strcpy(model, spec->model);
-	return model;
-  }
+  if (spec && spec->model)
+	return cpuinfo_arena_strdup(cip, spec->model);
 
   return NULL;
 }
@@ -861,11 +875,10 @@ static int decode_l3cr(struct cpuinfo *cip, cpuinfo_cache_descriptor_t *cdp)
 }
 
 // Get cache information
-cpuinfo_list_t cpuinfo_arch_get_caches(struct cpuinfo *cip)
+int cpuinfo_arch_get_caches(struct cpuinfo *cip, cpuinfo_cache_list_t *caches_list)
 {
   const ppc_spec_t *spec = get_ppc_spec(cip);
   if (spec) {
-	cpuinfo_list_t caches_list = NULL;
 	int i;
 	for (i = 0; i < N_CACHE_DESCRIPTORS; i++) {
 	  if (spec->caches[i])
@@ -877,11 +890,39 @@ cpuinfo_list_t cpuinfo_arch_get_caches(struct cpuinfo *cip)
 	  cpuinfo_caches_list_insert(&cache_desc);
 	if (decode_l3cr(cip, &cache_desc) == 0)
 	  cpuinfo_caches_list_insert(&cache_desc);
-
-	return caches_list;
   }
 
-  return NULL;
+  return caches_list->count;
+}
+
+// Get topology of each logical CPU
+int cpuinfo_arch_get_cpu_topology(struct cpuinfo *cip, cpuinfo_topology_cpu_t *cpus, int max_cpus)
+{
+  return 0;
+}
+
+// Get core class of a logical CPU
+int cpuinfo_arch_get_core_class(struct cpuinfo *cip, int cpu)
+{
+  return CPUINFO_CORE_CLASS_UNKNOWN;
+}
+
+// Get number of logical CPUs sharing a cache
+int cpuinfo_arch_get_cache_sharing(struct cpuinfo *cip, int level, int type)
+{
+  return -1;
+}
+
+// Get differences between logical CPUs (-1 if unknown)
+int cpuinfo_arch_get_heterogeneity(struct cpuinfo *cip)
+{
+  return -1;
+}
+
+// Get logical CPUs supporting the specified feature (-1 if unknown)
+int cpuinfo_arch_get_feature_cpus(struct cpuinfo *cip, int feature, cpuinfo_cpuset_t *set)
+{
+  return -1;
 }
 
 // Returns features table
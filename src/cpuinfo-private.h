@@ -28,39 +28,80 @@ extern "C" {
 #define CPUINFO_FEATURES_SZ_(NAME) \
 		(1 + ((CPUINFO_FEATURE_##NAME##_MAX - CPUINFO_FEATURE_##NAME) / 32))
 
+/* ========================================================================= */
+/* == Memory Arena                                                        == */
+/* ========================================================================= */
+
+#define CPUINFO_ARENA_INLINE_SIZE 8192		// room for the arch data and the records of small systems
+#define CPUINFO_ARENA_CHUNK_SIZE 65536		// size of additional chunks
+
+typedef struct cpuinfo_arena_chunk {
+  struct cpuinfo_arena_chunk *next;
+} cpuinfo_arena_chunk_t;
+
+typedef struct {
+  char *ptr;											// Next free byte of the current chunk
+  char *end;											// End of the current chunk
+  cpuinfo_arena_chunk_t *chunks;						// Additional chunks, most recent first
+  uint64_t data[CPUINFO_ARENA_INLINE_SIZE / 8];			// First chunk, within the descriptor
+} cpuinfo_arena_t;
+
+// Allocate zero-filled memory released along with the descriptor (NULL on failure)
+extern void *cpuinfo_arena_alloc(struct cpuinfo *cip, size_t size) attribute_hidden;
+
+// Copy a string into the arena (NULL on failure)
+extern char *cpuinfo_arena_strdup(struct cpuinfo *cip, const char *str) attribute_hidden;
+
 struct cpuinfo {
   int vendor;											// CPU vendor
   char *model;											// CPU model name
   int frequency;										// CPU frequency in MHz
+  int frequency_source;									// How the CPU frequency was determined
+  int frequency_confidence;								// Confidence in the CPU frequency, in percent
   int socket;											// CPU socket type
   int n_cores;											// Number of CPU cores
   int n_threads;										// Number of threads per CPU core
+  int64_t microcode;									// Microcode revision
   cpuinfo_cache_t cache_info;							// Cache descriptors
+  cpuinfo_cache_geometry_t *cache_geometry;				// Cache geometry, one per descriptor
+  cpuinfo_topology_t topology;							// Logical CPUs topology
+  cpuinfo_numa_t numa;									// NUMA nodes
+  cpuinfo_cache_instances_t cache_instances;			// Cache instances
+  cpuinfo_cache_measurement_t *cache_measurement;		// Measured caches, if any
+  cpuinfo_bandwidth_t *bandwidth;						// Measured memory bandwidth, if any
   uint32_t features[CPUINFO_FEATURES_SZ_(COMMON)];		// Common CPU features
   void *opaque;											// Arch-dependent data
+  void *mapping;										// Cache file the records live in, if any
+  size_t mapping_size;
+  uint64_t cache_key;									// Key of its per-boot cache file, 0 if none
+  cpuinfo_arena_t arena;								// Storage for all of the above
 };
 
+// Allocate a descriptor with nothing determined yet, nor arch-dependent data
+extern struct cpuinfo *cpuinfo_alloc(void) attribute_hidden;
+
+// Save measurements into the per-boot cache file the descriptor comes from, if any (-1 on error)
+extern int cpuinfo_cache_update(struct cpuinfo *cip) attribute_hidden;
+
 /* ========================================================================= */
-/* == Lists                                                               == */
+/* == Cache Lists                                                         == */
 /* ========================================================================= */
 
-typedef struct cpuinfo_list {
-  const void *data;
-  struct cpuinfo_list *next;
-} *cpuinfo_list_t;
+#define CPUINFO_CACHES_MAX 16
 
-// Clear list
-extern int cpuinfo_list_clear(cpuinfo_list_t *lp) attribute_hidden;
+// Caches reported by the arch code, plain descriptors are zero-extended
+typedef struct {
+  int count;
+  cpuinfo_cache_geometry_t caches[CPUINFO_CACHES_MAX];
+} cpuinfo_cache_list_t;
 
-// Insert new element into the list
-extern int cpuinfo_list_insert(cpuinfo_list_t *lp, const void *ptr, int size) attribute_hidden;
-#define cpuinfo_list_insert(LIST, PTR) (cpuinfo_list_insert)(LIST, PTR, sizeof(*(PTR)))
+// Append a cache descriptor or geometry (returns -1 if the list is full)
+extern int cpuinfo_cache_list_insert(cpuinfo_cache_list_t *clp, const void *ptr, int size) attribute_hidden;
+#define cpuinfo_cache_list_insert(LIST, PTR) (cpuinfo_cache_list_insert)(LIST, PTR, sizeof(*(PTR)))
 
-#define cpuinfo_caches_list_insert(PTR) do {		\
-  if (cpuinfo_list_insert(&caches_list, PTR) < 0) {	\
-	cpuinfo_list_clear(&caches_list);				\
-	return NULL;									\
-  }													\
+#define cpuinfo_caches_list_insert(PTR) do {			\
+  if (cpuinfo_cache_list_insert(caches_list, PTR) < 0)	\
+	return caches_list->count;							\
 } while (0)
 
 /* ========================================================================= */
@@ -87,10 +128,19 @@ extern int cpuinfo_arch_new(struct cpuinfo *cip) attribute_hidden;
 // Release the cpuinfo descriptor and all allocated data
 extern void cpuinfo_arch_destroy(struct cpuinfo *cip) attribute_hidden;
 
+// Serialize arch-dependent data into BUF if SIZE is large enough (returns the size needed)
+extern int cpuinfo_arch_save(struct cpuinfo *cip, void *buf, int size) attribute_hidden;
+
+// Restore arch-dependent data from a snapshot, which outlives the descriptor (-1 if invalid)
+extern int cpuinfo_arch_load(struct cpuinfo *cip, const void *data, int size) attribute_hidden;
+
+// Get processor signature without a descriptor, e.g. from CPUID (0 if unknown)
+extern uint64_t cpuinfo_arch_get_signature(void) attribute_hidden;
+
 // Get processor vendor ID 
 extern int cpuinfo_arch_get_vendor(struct cpuinfo *cip) attribute_hidden;
 
-// Get processor name
+// Get processor name, allocated from the arena
 extern char *cpuinfo_arch_get_model(struct cpuinfo *cip) attribute_hidden;
 
 // Get processor frequency in MHz
@@ -106,7 +156,23 @@ extern int cpuinfo_arch_get_cores(struct cpuinfo *cip) attribute_hidden;
 extern int cpuinfo_arch_get_threads(struct cpuinfo *cip) attribute_hidden;
 
 // Get cache information (returns the number of caches detected)
-extern cpuinfo_list_t cpuinfo_arch_get_caches(struct cpuinfo *cip) attribute_hidden;
+extern int cpuinfo_arch_get_caches(struct cpuinfo *cip, cpuinfo_cache_list_t *caches_list) attribute_hidden;
+
+// Get package, die and core IDs of each logical CPU from the processor
+// (returns the number of CPUs filled in, 0 if unknown)
+extern int cpuinfo_arch_get_cpu_topology(struct cpuinfo *cip, cpuinfo_topology_cpu_t *cpus, int max_cpus) attribute_hidden;
+
+// Get core class of a logical CPU (CPUINFO_CORE_CLASS_UNKNOWN if unknown)
+extern int cpuinfo_arch_get_core_class(struct cpuinfo *cip, int cpu) attribute_hidden;
+
+// Get number of logical CPUs sharing a cache (-1 if unknown)
+extern int cpuinfo_arch_get_cache_sharing(struct cpuinfo *cip, int level, int type) attribute_hidden;
+
+// Get differences between logical CPUs (-1 if unknown)
+extern int cpuinfo_arch_get_heterogeneity(struct cpuinfo *cip) attribute_hidden;
+
+// Get logical CPUs supporting the specified feature (-1 if unknown)
+extern int cpuinfo_arch_get_feature_cpus(struct cpuinfo *cip, int feature, cpuinfo_cpuset_t *set) attribute_hidden;
 
 // Returns features table
 extern uint32_t *cpuinfo_arch_feature_table(struct cpuinfo *cip, int feature) attribute_hidden;
@@ -114,12 +180,63 @@ extern uint32_t *cpuinfo_arch_feature_table(struct cpuinfo *cip, int feature) at
 // Returns 1 if CPU supports the specified feature
 extern int cpuinfo_arch_has_feature(struct cpuinfo *cip, unsigned long feature) attribute_hidden;
 
+/* ========================================================================= */
+/* == Sysfs and Procfs Readers                                            == */
+/* ========================================================================= */
+
+// Get root of the sysfs and procfs trees
+extern const char *cpuinfo_sysfs_root(void) attribute_hidden;
+extern const char *cpuinfo_procfs_root(void) attribute_hidden;
+
+// Read a sysfs file into BUF, NUL-terminated (returns the number of bytes read, -1 on error)
+extern int cpuinfo_sysfs_read(const char *path, char *buf, int size) attribute_hidden;
 
-extern int read_sys_int(const char *syspath) attribute_hidden;
+// Read a sysfs attribute of a logical CPU, relative to devices/system/cpu/cpuN
+extern int cpuinfo_sysfs_read_cpu(int cpu, const char *name, char *buf, int size) attribute_hidden;
 
-int read_sys_int_str(const char *syspath) attribute_hidden;
+// Read an integer from a sysfs file or CPU attribute (-1 on error)
+extern int cpuinfo_sysfs_read_int(const char *path, int *value) attribute_hidden;
+extern int cpuinfo_sysfs_read_cpu_int(int cpu, const char *name, int *value) attribute_hidden;
+
+// Read a CPU list from a sysfs file (-1 on error)
+extern int cpuinfo_sysfs_read_cpu_list(const char *path, cpuinfo_cpuset_t *set) attribute_hidden;
+
+// Read a procfs file into BUF, NUL-terminated (returns the number of bytes read, -1 on error)
+extern int cpuinfo_procfs_read(const char *path, char *buf, int size) attribute_hidden;
+
+// Parse a decimal integer (-1 on error)
+extern int cpuinfo_parse_int(const char *str, int *value) attribute_hidden;
+
+// Parse a CPU list ("0-3,8,10-11"), returns the number of CPUs (CPUS and SET may be NULL)
+extern int cpuinfo_parse_cpu_list(const char *str, int *cpus, cpuinfo_cpuset_t *set) attribute_hidden;
+
+/* ========================================================================= */
+/* == /proc/cpuinfo Parser                                                == */
+/* ========================================================================= */
 
-extern char * read_sys_str(const char *syspath) attribute_hidden;
+// Processor block of /proc/cpuinfo
+typedef struct {
+  int processor;		// logical CPU number
+  int physical_id;		// package ID, -1 if not reported
+  int core_id;			// core ID, -1 if not reported
+  double mhz;			// current frequency ("cpu MHz", or "clock" on PowerPC), 0 if not reported
+  unsigned int microcode;	// microcode revision, 0 if not reported
+  const char *flags;	// feature flags ("flags", "Features" or "features"), NULL if not reported
+  const char *isa;		// ISA string (MIPS, RISC-V), NULL if not reported
+} cpuinfo_proc_cpu_t;
+
+typedef struct {
+  int n_cpus;
+  int max_cpus;
+  cpuinfo_proc_cpu_t *cpus;		// processor records, in file order
+  void *strings;				// interned strings, shared between records
+} cpuinfo_proc_t;
+
+// Parse /proc/cpuinfo in a single pass (returns NULL if unavailable)
+extern cpuinfo_proc_t *cpuinfo_proc_parse(void) attribute_hidden;
+
+// Release /proc/cpuinfo records
+extern void cpuinfo_proc_destroy(cpuinfo_proc_t *pp) attribute_hidden;
 
 #ifdef __cplusplus
 }
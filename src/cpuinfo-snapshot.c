@@ -0,0 +1,564 @@
+/*
+ *  cpuinfo-snapshot.c - Descriptor snapshots
+ *
+ *  cpuinfo (C) 2006-2007 Gwenole Beauchesne
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "sysdeps.h"
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include "cpuinfo.h"
+#include "cpuinfo-private.h"
+
+#define DEBUG 0
+#include "debug.h"
+
+// Snapshots use the native layout of the saving library: records are
+// used in place by the loading process, e.g. straight from a mapped file
+
+#define SNAPSHOT_MAGIC "CPUINFO"
+#define SNAPSHOT_VERSION 4
+#define SNAPSHOT_BYTE_ORDER 0x01020304
+#define SNAPSHOT_ALIGN 8
+#define SNAPSHOT_ROUND(SIZE) (((SIZE) + SNAPSHOT_ALIGN - 1) & ~(SNAPSHOT_ALIGN - 1))
+
+enum {
+  SECTION_MODEL,						// NUL-terminated model name
+  SECTION_CACHE_DESCRIPTORS,			// cpuinfo_cache_descriptor_t[]
+  SECTION_CACHE_GEOMETRY,				// cpuinfo_cache_geometry_t[], one per descriptor
+  SECTION_TOPOLOGY,						// cpuinfo_topology_cpu_t[]
+  SECTION_NUMA_NODES,					// cpuinfo_numa_node_t[]
+  SECTION_NUMA_DISTANCES,				// int[], count * count
+  SECTION_CACHE_INSTANCES,				// cpuinfo_cache_instance_t[]
+  SECTION_CACHE_MEASUREMENT,			// snapshot_cache_measurement_t, if caches were measured
+  SECTION_MEASURED_CACHES,				// cpuinfo_measured_cache_t[]
+  SECTION_LATENCY_SAMPLES,				// cpuinfo_latency_sample_t[]
+  SECTION_BANDWIDTH,					// snapshot_bandwidth_t, if bandwidth was measured
+  SECTION_LOADED_LATENCIES,				// cpuinfo_loaded_latency_t[]
+  SECTION_ARCH,							// arch-dependent data
+  N_SECTIONS
+};
+
+typedef struct {
+  uint32_t offset;						// from the start of the snapshot, aligned
+  uint32_t size;						// in bytes
+} snapshot_section_t;
+
+typedef struct {
+  char magic[8];						// "CPUINFO"
+  uint32_t byte_order;					// SNAPSHOT_BYTE_ORDER, as written by the saving process
+  uint16_t version;						// SNAPSHOT_VERSION
+  uint16_t header_size;					// size of this header
+  char arch[16];						// target architecture of the saving library
+  uint32_t size;						// size of the whole snapshot
+  uint32_t record_sizes[8];				// sizes of records, see snapshot_record_sizes
+  int32_t vendor;
+  int32_t frequency;
+  int32_t frequency_source;
+  int32_t frequency_confidence;
+  int32_t socket;
+  int32_t n_cores;
+  int32_t n_threads;
+  uint32_t microcode;
+  int32_t n_packages;					// topology summary
+  int32_t n_dies;
+  int32_t n_topology_cores;
+  uint32_t features[CPUINFO_FEATURES_SZ_(COMMON)];
+  snapshot_section_t sections[N_SECTIONS];
+} snapshot_header_t;
+
+// Measurements, without the pointers to their records
+typedef struct {
+  double memory_latency_ns;
+  double memory_latency_cycles;
+} snapshot_cache_measurement_t;
+
+typedef struct {
+  cpuinfo_cpuset_t cpus;
+  int32_t n_threads;
+  int32_t node;
+  int32_t size;
+  int32_t n_kernels;					// CPUINFO_BANDWIDTH_KERNELS
+  double bandwidth[CPUINFO_BANDWIDTH_KERNELS];
+} snapshot_bandwidth_t;
+
+static const uint32_t snapshot_record_sizes[8] = {
+  sizeof(cpuinfo_cache_geometry_t),
+  sizeof(cpuinfo_topology_cpu_t),
+  sizeof(cpuinfo_numa_node_t),
+  sizeof(cpuinfo_cache_instance_t),
+  sizeof(cpuinfo_measured_cache_t),
+  sizeof(cpuinfo_latency_sample_t),
+  sizeof(snapshot_bandwidth_t),
+  sizeof(cpuinfo_loaded_latency_t)
+};
+
+// Determine everything a loaded descriptor could be asked for
+static void snapshot_resolve(cpuinfo_t *cip)
+{
+  cpuinfo_get_vendor(cip);
+  cpuinfo_get_model(cip);
+  cpuinfo_get_frequency(cip);
+  cpuinfo_get_socket(cip);
+  cpuinfo_get_cores(cip);
+  cpuinfo_get_threads(cip);
+  cpuinfo_get_microcode(cip);
+  cpuinfo_get_caches(cip);
+  cpuinfo_get_topology(cip);
+  cpuinfo_get_numa_nodes(cip);
+  cpuinfo_get_cache_instances(cip);
+  cpuinfo_has_feature(cip, CPUINFO_FEATURE_64BIT);	// decodes all features
+  cpuinfo_get_heterogeneity(cip);
+}
+
+// Save a fully determined descriptor into BUF if SIZE is large enough
+// (returns the snapshot size, -1 on error)
+int cpuinfo_save(cpuinfo_t *cip, void *buf, int size)
+{
+  if (cip == NULL || size < 0)
+	return -1;
+  snapshot_resolve(cip);
+
+  const void *data[N_SECTIONS];
+  int i, sizes[N_SECTIONS];
+  data[SECTION_MODEL] = cip->model;
+  sizes[SECTION_MODEL] = strlen(cip->model) + 1;
+  data[SECTION_CACHE_DESCRIPTORS] = cip->cache_info.descriptors;
+  sizes[SECTION_CACHE_DESCRIPTORS] = cip->cache_info.count * sizeof(cpuinfo_cache_descriptor_t);
+  data[SECTION_CACHE_GEOMETRY] = cip->cache_geometry;
+  sizes[SECTION_CACHE_GEOMETRY] = cip->cache_info.count * sizeof(cpuinfo_cache_geometry_t);
+  data[SECTION_TOPOLOGY] = cip->topology.cpus;
+  sizes[SECTION_TOPOLOGY] = cip->topology.n_cpus * sizeof(cpuinfo_topology_cpu_t);
+  data[SECTION_NUMA_NODES] = cip->numa.nodes;
+  sizes[SECTION_NUMA_NODES] = cip->numa.count * sizeof(cpuinfo_numa_node_t);
+  data[SECTION_NUMA_DISTANCES] = cip->numa.distances;
+  sizes[SECTION_NUMA_DISTANCES] = cip->numa.count * cip->numa.count * sizeof(int);
+  data[SECTION_CACHE_INSTANCES] = cip->cache_instances.instances;
+  sizes[SECTION_CACHE_INSTANCES] = cip->cache_instances.count * sizeof(cpuinfo_cache_instance_t);
+  // measurements are kept if they were taken, never taken here
+  snapshot_cache_measurement_t cm;
+  const cpuinfo_cache_measurement_t *cmp = cip->cache_measurement;
+  memset(&cm, 0, sizeof(cm));
+  if (cmp) {
+	cm.memory_latency_ns = cmp->memory_latency_ns;
+	cm.memory_latency_cycles = cmp->memory_latency_cycles;
+  }
+  data[SECTION_CACHE_MEASUREMENT] = &cm;
+  sizes[SECTION_CACHE_MEASUREMENT] = cmp ? sizeof(cm) : 0;
+  data[SECTION_MEASURED_CACHES] = cmp ? cmp->caches : NULL;
+  sizes[SECTION_MEASURED_CACHES] = cmp ? cmp->count * sizeof(cpuinfo_measured_cache_t) : 0;
+  data[SECTION_LATENCY_SAMPLES] = cmp ? cmp->samples : NULL;
+  sizes[SECTION_LATENCY_SAMPLES] = cmp ? cmp->n_samples * sizeof(cpuinfo_latency_sample_t) : 0;
+  snapshot_bandwidth_t bw;
+  const cpuinfo_bandwidth_t *bp = cip->bandwidth;
+  memset(&bw, 0, sizeof(bw));
+  if (bp) {
+	bw.cpus = bp->cpus;
+	bw.n_threads = bp->n_threads;
+	bw.node = bp->node;
+	bw.size = bp->size;
+	bw.n_kernels = CPUINFO_BANDWIDTH_KERNELS;
+	memcpy(bw.bandwidth, bp->bandwidth, sizeof(bw.bandwidth));
+  }
+  data[SECTION_BANDWIDTH] = &bw;
+  sizes[SECTION_BANDWIDTH] = bp ? sizeof(bw) : 0;
+  data[SECTION_LOADED_LATENCIES] = bp ? bp->loaded_latencies : NULL;
+  sizes[SECTION_LOADED_LATENCIES] = bp ? bp->n_loaded_latencies * sizeof(cpuinfo_loaded_latency_t) : 0;
+  data[SECTION_ARCH] = NULL;
+  sizes[SECTION_ARCH] = cpuinfo_arch_save(cip, NULL, 0);
+  if (sizes[SECTION_ARCH] < 0)
+	return -1;
+
+  snapshot_section_t sections[N_SECTIONS];
+  int total = SNAPSHOT_ROUND((int)sizeof(snapshot_header_t));
+  for (i = 0; i < N_SECTIONS; i++) {
+	sections[i].offset = total;
+	sections[i].size = sizes[i];
+	total = SNAPSHOT_ROUND(total + sizes[i]);
+  }
+  if (buf == NULL || size < total)
+	return total;
+
+  // zero padding, so that snapshots of the same machine compare equal
+  char *p = (char *)buf;
+  memset(p, 0, total);
+  snapshot_header_t *hp = (snapshot_header_t *)p;
+  memcpy(hp->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+  hp->byte_order = SNAPSHOT_BYTE_ORDER;
+  hp->version = SNAPSHOT_VERSION;
+  hp->header_size = sizeof(*hp);
+  strncpy(hp->arch, TARGET_ARCH, sizeof(hp->arch) - 1);
+  hp->size = total;
+  memcpy(hp->record_sizes, snapshot_record_sizes, sizeof(hp->record_sizes));
+  hp->vendor = cip->vendor;
+  hp->frequency = cip->frequency;
+  hp->frequency_source = cip->frequency_source;
+  hp->frequency_confidence = cip->frequency_confidence;
+  hp->socket = cip->socket;
+  hp->n_cores = cip->n_cores;
+  hp->n_threads = cip->n_threads;
+  hp->microcode = cip->microcode;
+  hp->n_packages = cip->topology.n_packages;
+  hp->n_dies = cip->topology.n_dies;
+  hp->n_topology_cores = cip->topology.n_cores;
+  memcpy(hp->features, cip->features, sizeof(hp->features));
+  memcpy(hp->sections, sections, sizeof(hp->sections));
+  for (i = 0; i < N_SECTIONS; i++) {
+	if (data[i] && sizes[i] > 0)
+	  memcpy(p + sections[i].offset, data[i], sizes[i]);
+  }
+  cpuinfo_arch_save(cip, p + sections[SECTION_ARCH].offset, sizes[SECTION_ARCH]);
+  return total;
+}
+
+// Get the records of a section (NULL if empty), checking they fill it exactly
+static const void *snapshot_section(const snapshot_header_t *hp, int section, int record_size, int *count)
+{
+  const snapshot_section_t *sp = &hp->sections[section];
+  *count = sp->size / record_size;
+  if (sp->size % record_size != 0)
+	*count = -1;
+  return sp->size > 0 ? (const char *)hp + sp->offset : NULL;
+}
+
+// Create a descriptor from a snapshot, used in place (NULL if invalid)
+cpuinfo_t *cpuinfo_load(const void *buf, int size)
+{
+  const snapshot_header_t *hp = (const snapshot_header_t *)buf;
+  if (hp == NULL || ((uintptr_t)hp % SNAPSHOT_ALIGN) != 0 || size < (int)sizeof(*hp))
+	return NULL;
+  if (memcmp(hp->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0)
+	return NULL;
+  if (hp->byte_order != SNAPSHOT_BYTE_ORDER) {
+	D(bug("cpuinfo_load: foreign byte order %08x\n", hp->byte_order));
+	return NULL;
+  }
+  if (hp->version != SNAPSHOT_VERSION || hp->header_size != sizeof(*hp)
+	  || strncmp(hp->arch, TARGET_ARCH, sizeof(hp->arch)) != 0
+	  || memcmp(hp->record_sizes, snapshot_record_sizes, sizeof(hp->record_sizes)) != 0) {
+	D(bug("cpuinfo_load: incompatible snapshot, version %d, arch %.16s\n", hp->version, hp->arch));
+	return NULL;
+  }
+  if (hp->size > (uint32_t)size)
+	return NULL;
+  int i;
+  for (i = 0; i < N_SECTIONS; i++) {
+	const snapshot_section_t *sp = &hp->sections[i];
+	if (sp->offset % SNAPSHOT_ALIGN != 0 || sp->offset < sizeof(*hp)
+		|| sp->offset > hp->size || sp->size > hp->size - sp->offset)
+	  return NULL;
+  }
+
+  // the model name, then the records sized by their section
+  int n_caches, n_descs, n_cpus, n_nodes, n_distances, n_instances, n_chars;
+  const char *model = (const char *)snapshot_section(hp, SECTION_MODEL, 1, &n_chars);
+  const cpuinfo_cache_descriptor_t *descs = (const cpuinfo_cache_descriptor_t *)
+	snapshot_section(hp, SECTION_CACHE_DESCRIPTORS, sizeof(*descs), &n_descs);
+  const cpuinfo_cache_geometry_t *cgs = (const cpuinfo_cache_geometry_t *)
+	snapshot_section(hp, SECTION_CACHE_GEOMETRY, sizeof(*cgs), &n_caches);
+  const cpuinfo_topology_cpu_t *cpus = (const cpuinfo_topology_cpu_t *)
+	snapshot_section(hp, SECTION_TOPOLOGY, sizeof(*cpus), &n_cpus);
+  const cpuinfo_numa_node_t *nodes = (const cpuinfo_numa_node_t *)
+	snapshot_section(hp, SECTION_NUMA_NODES, sizeof(*nodes), &n_nodes);
+  const int *distances = (const int *)
+	snapshot_section(hp, SECTION_NUMA_DISTANCES, sizeof(*distances), &n_distances);
+  const cpuinfo_cache_instance_t *instances = (const cpuinfo_cache_instance_t *)
+	snapshot_section(hp, SECTION_CACHE_INSTANCES, sizeof(*instances), &n_instances);
+  // at most one node per logical CPU, so that the distance matrix size cannot overflow
+  if (model == NULL || model[n_chars - 1] != '\0' || n_descs != n_caches || n_cpus < 0
+	  || n_nodes < 0 || n_nodes > CPUINFO_CPUSET_SIZE || n_distances != n_nodes * n_nodes || n_instances < 0)
+	return NULL;
+
+  // measurements, if they were taken before saving
+  int n_measurements, n_measured, n_samples, n_bandwidths, n_loaded;
+  const snapshot_cache_measurement_t *cmp = (const snapshot_cache_measurement_t *)
+	snapshot_section(hp, SECTION_CACHE_MEASUREMENT, sizeof(*cmp), &n_measurements);
+  const cpuinfo_measured_cache_t *measured = (const cpuinfo_measured_cache_t *)
+	snapshot_section(hp, SECTION_MEASURED_CACHES, sizeof(*measured), &n_measured);
+  const cpuinfo_latency_sample_t *samples = (const cpuinfo_latency_sample_t *)
+	snapshot_section(hp, SECTION_LATENCY_SAMPLES, sizeof(*samples), &n_samples);
+  const snapshot_bandwidth_t *bwp = (const snapshot_bandwidth_t *)
+	snapshot_section(hp, SECTION_BANDWIDTH, sizeof(*bwp), &n_bandwidths);
+  const cpuinfo_loaded_latency_t *loaded = (const cpuinfo_loaded_latency_t *)
+	snapshot_section(hp, SECTION_LOADED_LATENCIES, sizeof(*loaded), &n_loaded);
+  if (n_measurements < 0 || n_measurements > 1 || n_measured < 0 || n_samples < 0
+	  || n_bandwidths < 0 || n_bandwidths > 1 || n_loaded < 0
+	  || (bwp && bwp->n_kernels != CPUINFO_BANDWIDTH_KERNELS))
+	return NULL;
+
+  cpuinfo_t *cip = cpuinfo_alloc();
+  if (cip == NULL)
+	return NULL;
+  const snapshot_section_t *sp = &hp->sections[SECTION_ARCH];
+  if (cpuinfo_arch_load(cip, (const char *)hp + sp->offset, sp->size) < 0) {
+	D(bug("cpuinfo_load: invalid arch-dependent data\n"));
+	cpuinfo_destroy(cip);
+	return NULL;
+  }
+  cip->vendor = hp->vendor;
+  cip->model = (char *)model;
+  cip->frequency = hp->frequency;
+  cip->frequency_source = hp->frequency_source;
+  cip->frequency_confidence = hp->frequency_confidence;
+  cip->socket = hp->socket;
+  cip->n_cores = hp->n_cores;
+  cip->n_threads = hp->n_threads;
+  cip->microcode = hp->microcode;
+  cip->cache_info.count = n_caches;
+  cip->cache_info.descriptors = descs;
+  cip->cache_geometry = (cpuinfo_cache_geometry_t *)cgs;
+  cip->topology.n_cpus = n_cpus;
+  cip->topology.n_packages = hp->n_packages;
+  cip->topology.n_dies = hp->n_dies;
+  cip->topology.n_cores = hp->n_topology_cores;
+  cip->topology.cpus = cpus;
+  cip->numa.count = n_nodes;
+  cip->numa.nodes = nodes;
+  cip->numa.distances = distances;
+  cip->cache_instances.count = n_instances;
+  cip->cache_instances.instances = instances;
+  if (cmp && (cip->cache_measurement = (cpuinfo_cache_measurement_t *)
+			  cpuinfo_arena_alloc(cip, sizeof(*cip->cache_measurement))) != NULL) {
+	cpuinfo_cache_measurement_t *cm = cip->cache_measurement;
+	cm->count = n_measured;
+	cm->caches = measured;
+	cm->memory_latency_ns = cmp->memory_latency_ns;
+	cm->memory_latency_cycles = cmp->memory_latency_cycles;
+	cm->n_samples = n_samples;
+	cm->samples = samples;
+  }
+  if (bwp && (cip->bandwidth = (cpuinfo_bandwidth_t *)cpuinfo_arena_alloc(cip, sizeof(*cip->bandwidth))) != NULL) {
+	cpuinfo_bandwidth_t *bp = cip->bandwidth;
+	bp->cpus = bwp->cpus;
+	bp->n_threads = bwp->n_threads;
+	bp->node = bwp->node;
+	bp->size = bwp->size;
+	memcpy(bp->bandwidth, bwp->bandwidth, sizeof(bp->bandwidth));
+	bp->n_loaded_latencies = n_loaded;
+	bp->loaded_latencies = loaded;
+  }
+  memcpy(cip->features, hp->features, sizeof(cip->features));
+  return cip;
+}
+
+
+/* ========================================================================= */
+/* == Per-boot Cache                                                      == */
+/* ========================================================================= */
+
+#define CACHE_MAGIC "CPUINFOC"
+
+// Cache file header, followed by a snapshot
+typedef struct {
+  char magic[8];						// "CPUINFOC"
+  uint64_t key;							// see cache_key()
+} cache_header_t;
+
+// FNV-1a hash
+static uint64_t cache_hash(uint64_t hash, const void *data, int size)
+{
+  const unsigned char *p = (const unsigned char *)data;
+  while (size-- > 0) {
+	hash ^= *p++;
+	hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+// Get key of the results valid for this boot, set of online CPUs, processor
+// and microcode revision (0 if the boot cannot be identified)
+static uint64_t cache_key(void)
+{
+  char str[4096];
+  uint64_t key = 0xcbf29ce484222325ULL;
+  int n;
+  if ((n = cpuinfo_procfs_read("sys/kernel/random/boot_id", str, sizeof(str))) <= 0)
+	return 0;
+  key = cache_hash(key, str, n);
+  key = cache_hash(key, cpuinfo_sysfs_root(), strlen(cpuinfo_sysfs_root()) + 1);
+  if ((n = cpuinfo_sysfs_read("devices/system/cpu/online", str, sizeof(str))) > 0)
+	key = cache_hash(key, str, n);
+  if ((n = cpuinfo_sysfs_read_cpu(0, "microcode/version", str, sizeof(str))) > 0)
+	key = cache_hash(key, str, n);
+  uint64_t signature = cpuinfo_arch_get_signature();
+  key = cache_hash(key, &signature, sizeof(signature));
+  return key ? key : 1;
+}
+
+// Check that a cache file or directory is ours, and only writable by us:
+// the directory may be shared, and its files are used as descriptors
+static int cache_is_private(const struct stat *st)
+{
+  return st->st_uid == geteuid() && (st->st_mode & (S_IWGRP | S_IWOTH)) == 0;
+}
+
+// Get path of the cache file (-1 if there is no usable directory)
+static int cache_path(char *path, int size, uint64_t key)
+{
+  char dir[PATH_MAX];
+  const char *env;
+  if ((env = getenv("CPUINFO_CACHE_DIR")) != NULL && env[0] != '\0')
+	snprintf(dir, sizeof(dir), "%s", env);
+  else if ((env = getenv("XDG_RUNTIME_DIR")) != NULL && env[0] != '\0')
+	snprintf(dir, sizeof(dir), "%s/cpuinfo", env);
+  else
+	snprintf(dir, sizeof(dir), "/run/cpuinfo");
+  struct stat st;
+  if (mkdir(dir, 0700) < 0 && errno != EEXIST)
+	return -1;
+  if (lstat(dir, &st) < 0 || !S_ISDIR(st.st_mode) || !cache_is_private(&st)) {
+	D(bug("cpuinfo_new_cached: %s is not a private directory\n", dir));
+	return -1;
+  }
+  if (snprintf(path, size, "%s/%016llx", dir, (unsigned long long)key) >= size)
+	return -1;
+  return 0;
+}
+
+// Create a descriptor from the cache file, which stays mapped (NULL if none)
+static cpuinfo_t *cache_load(const char *path, uint64_t key)
+{
+  int fd = open(path, O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+  if (fd < 0)
+	return NULL;
+  struct stat st;
+  void *mapping = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && cache_is_private(&st)
+	  && st.st_size > (off_t)sizeof(cache_header_t) && st.st_size < INT_MAX)
+	mapping = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED)
+	return NULL;
+
+  cpuinfo_t *cip = NULL;
+  const cache_header_t *hp = (const cache_header_t *)mapping;
+  if (memcmp(hp->magic, CACHE_MAGIC, sizeof(hp->magic)) == 0 && hp->key == key)
+	cip = cpuinfo_load(hp + 1, st.st_size - sizeof(*hp));
+  if (cip == NULL) {
+	D(bug("cpuinfo_new_cached: stale cache file %s\n", path));
+	munmap(mapping, st.st_size);
+	return NULL;
+  }
+  cip->mapping = mapping;
+  cip->mapping_size = st.st_size;
+  return cip;
+}
+
+// Remove cache files of earlier boots from the directory of PATH
+static void cache_prune(const char *path)
+{
+  char str[4096], dir[PATH_MAX], *p;
+  long long boot_time = -1;
+  if (cpuinfo_procfs_read("stat", str, sizeof(str)) > 0 && (p = strstr(str, "\nbtime ")) != NULL)
+	boot_time = strtoll(p + 7, NULL, 10);
+  snprintf(dir, sizeof(dir), "%s", path);
+  if (boot_time <= 0 || (p = strrchr(dir, '/')) == NULL)
+	return;
+  *p = '\0';
+
+  DIR *d = opendir(dir);
+  struct dirent *de;
+  if (d == NULL)
+	return;
+  while ((de = readdir(d)) != NULL) {
+	// cache files are named after their key, in 16 hex digits
+	struct stat st;
+	if (strlen(de->d_name) != 16 || strspn(de->d_name, "0123456789abcdef") != 16)
+	  continue;
+	if (fstatat(dirfd(d), de->d_name, &st, AT_SYMLINK_NOFOLLOW) == 0 && S_ISREG(st.st_mode)
+		&& st.st_uid == geteuid() && st.st_mtime < boot_time) {
+	  D(bug("cpuinfo_new_cached: removing stale cache file %s\n", de->d_name));
+	  unlinkat(dirfd(d), de->d_name, 0);
+	}
+  }
+  closedir(d);
+}
+
+// Save the descriptor into the cache file, replacing it atomically
+static int cache_store(cpuinfo_t *cip, const char *path, uint64_t key)
+{
+  int size = cpuinfo_save(cip, NULL, 0);
+  if (size < 0)
+	return -1;
+  const int total = sizeof(cache_header_t) + size;
+  char *buf = (char *)malloc(total);
+  if (buf == NULL)
+	return -1;
+  cache_header_t *hp = (cache_header_t *)buf;
+  memcpy(hp->magic, CACHE_MAGIC, sizeof(hp->magic));
+  hp->key = key;
+  cpuinfo_save(cip, hp + 1, size);
+
+  // readers see either the previous file or the complete new one
+  char tmp_path[PATH_MAX];
+  int fd = -1, written = 0;
+  if (snprintf(tmp_path, sizeof(tmp_path), "%s.XXXXXX", path) < (int)sizeof(tmp_path))
+	fd = mkstemp(tmp_path);
+  if (fd >= 0) {
+	while (written < total) {
+	  ssize_t n = write(fd, buf + written, total - written);
+	  if (n < 0 && errno == EINTR)
+		continue;
+	  if (n <= 0)
+		break;
+	  written += n;
+	}
+	if (fsync(fd) < 0)
+	  written = -1;
+	close(fd);
+	if (written != total || rename(tmp_path, path) < 0) {
+	  unlink(tmp_path);
+	  written = -1;
+	}
+  }
+  if (written == total)
+	cache_prune(path);
+  free(buf);
+  D(bug("cpuinfo_new_cached: %s %s\n", written == total ? "saved" : "could not save", path));
+  return written == total ? 0 : -1;
+}
+
+// Returns a new cpuinfo descriptor, reusing the results saved during this boot
+cpuinfo_t *cpuinfo_new_cached(void)
+{
+  char path[PATH_MAX];
+  uint64_t key = cache_key();
+  if (key == 0 || cache_path(path, sizeof(path), key) < 0)
+	return cpuinfo_new();
+
+  cpuinfo_t *cip = cache_load(path, key);
+  if (cip == NULL && (cip = cpuinfo_new()) != NULL)
+	cache_store(cip, path, key);
+  if (cip)
+	cip->cache_key = key;
+  return cip;
+}
+
+// Save measurements into the per-boot cache file the descriptor comes from
+int cpuinfo_cache_update(cpuinfo_t *cip)
+{
+  char path[PATH_MAX];
+  if (cip->cache_key == 0 || cache_path(path, sizeof(path), cip->cache_key) < 0)
+	return 0;
+  return cache_store(cip, path, cip->cache_key);
+}
@@ -0,0 +1,423 @@
+/*
+ *  cpuinfo-sysfs.c - Sysfs and procfs readers
+ *
+ *  cpuinfo (C) 2006-2007 Gwenole Beauchesne
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "sysdeps.h"
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include "cpuinfo.h"
+#include "cpuinfo-private.h"
+
+#define DEBUG 0
+#include "debug.h"
+
+#ifndef O_CLOEXEC
+#define O_CLOEXEC 0
+#endif
+#ifndef O_DIRECTORY
+#define O_DIRECTORY 0
+#endif
+
+#define SYSFS_CPU_DIRS 64	// number of cached CPU directories
+
+// Directory descriptors, all relative to the sysfs root they were opened from
+static pthread_rwlock_t sysfs_lock = PTHREAD_RWLOCK_INITIALIZER;
+static char sysfs_cached_root[PATH_MAX];
+static int sysfs_cache_ready;
+static int sysfs_root_fd = -1;
+static struct {
+  int cpu;
+  int fd;
+} sysfs_cpu_dirs[SYSFS_CPU_DIRS];			// Indexed by CPU number modulo SYSFS_CPU_DIRS
+
+// Roots set by the application, overriding the environment (leaving
+// room in PATH_MAX for the paths below them)
+#define ROOT_MAX (PATH_MAX / 2)
+static char sysfs_root[ROOT_MAX];
+static char procfs_root[ROOT_MAX];
+
+// Copy ROOT, without trailing slashes, into BUF (NULL or empty clears it)
+static int set_root(char *buf, const char *root)
+{
+  int len = root ? strlen(root) : 0;
+  while (len > 1 && root[len - 1] == '/')
+	--len;
+  if (len >= ROOT_MAX)
+	return -1;
+  memcpy(buf, root ? root : "", len);
+  buf[len] = '\0';
+  return 0;
+}
+
+// Read sysfs below ROOT (NULL restores $CPUINFO_SYSFS_ROOT or /sys)
+int cpuinfo_set_sysfs_root(const char *root)
+{
+  return set_root(sysfs_root, root);
+}
+
+// Read procfs below ROOT (NULL restores $CPUINFO_PROCFS_ROOT or /proc)
+int cpuinfo_set_procfs_root(const char *root)
+{
+  return set_root(procfs_root, root);
+}
+
+// Get root of the sysfs tree (CPUINFO_SYSFS_ROOT selects a synthetic one)
+const char *cpuinfo_sysfs_root(void)
+{
+  if (sysfs_root[0])
+	return sysfs_root;
+  const char *root = getenv("CPUINFO_SYSFS_ROOT");
+  return root && root[0] ? root : "/sys";
+}
+
+// Get root of the procfs tree (CPUINFO_PROCFS_ROOT selects a synthetic one)
+const char *cpuinfo_procfs_root(void)
+{
+  if (procfs_root[0])
+	return procfs_root;
+  const char *root = getenv("CPUINFO_PROCFS_ROOT");
+  return root && root[0] ? root : "/proc";
+}
+
+// Read a whole file into BUF, NUL-terminated (returns the number of bytes read, -1 on error)
+static int read_fd(int fd, char *buf, int size)
+{
+  if (fd < 0)
+	return -1;
+  ssize_t n = pread(fd, buf, size - 1, 0);
+  close(fd);
+  if (n < 0)
+	return -1;
+  buf[n] = '\0';
+  return n;
+}
+
+// Drop all descriptors and open the new sysfs root (called with sysfs_lock held for writing)
+static void sysfs_cache_reset(const char *root)
+{
+  int i;
+  for (i = 0; i < SYSFS_CPU_DIRS; i++) {
+	if (sysfs_cache_ready && sysfs_cpu_dirs[i].fd >= 0)
+	  close(sysfs_cpu_dirs[i].fd);
+	sysfs_cpu_dirs[i].cpu = -1;
+	sysfs_cpu_dirs[i].fd = -1;
+  }
+  if (sysfs_root_fd >= 0)
+	close(sysfs_root_fd);
+  sysfs_root_fd = open(root, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  snprintf(sysfs_cached_root, sizeof(sysfs_cached_root), "%s", root);
+  sysfs_cache_ready = 1;
+  D(bug("cpuinfo_sysfs: root %s, fd %d\n", root, sysfs_root_fd));
+}
+
+// Open the directory of a CPU (or the sysfs root if CPU is negative) into the cache
+static void sysfs_cache_fill(const char *root, int cpu)
+{
+  pthread_rwlock_wrlock(&sysfs_lock);
+  if (!sysfs_cache_ready || strcmp(root, sysfs_cached_root) != 0 || sysfs_root_fd < 0)
+	sysfs_cache_reset(root);
+  if (cpu >= 0 && sysfs_root_fd >= 0) {
+	int slot = cpu % SYSFS_CPU_DIRS;
+	if (sysfs_cpu_dirs[slot].cpu != cpu || sysfs_cpu_dirs[slot].fd < 0) {
+	  char name[64];
+	  snprintf(name, sizeof(name), "devices/system/cpu/cpu%d", cpu);
+	  int fd = openat(sysfs_root_fd, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	  if (fd >= 0) {
+		if (sysfs_cpu_dirs[slot].fd >= 0)
+		  close(sysfs_cpu_dirs[slot].fd);
+		sysfs_cpu_dirs[slot].cpu = cpu;
+		sysfs_cpu_dirs[slot].fd = fd;
+	  }
+	}
+  }
+  pthread_rwlock_unlock(&sysfs_lock);
+}
+
+// Read a file relative to a CPU directory, or to the sysfs root if CPU is negative
+static int sysfs_read(int cpu, const char *name, char *buf, int size)
+{
+  const char *root = cpuinfo_sysfs_root();
+  int i;
+  if (size <= 0)
+	return -1;
+  for (i = 0; i < 2; i++) {
+	int fd = -1, dirfd = -1;
+	pthread_rwlock_rdlock(&sysfs_lock);
+	if (sysfs_cache_ready && strcmp(root, sysfs_cached_root) == 0) {
+	  if (cpu < 0)
+		dirfd = sysfs_root_fd;
+	  else if (sysfs_cpu_dirs[cpu % SYSFS_CPU_DIRS].cpu == cpu)
+		dirfd = sysfs_cpu_dirs[cpu % SYSFS_CPU_DIRS].fd;
+	  if (dirfd >= 0)
+		fd = openat(dirfd, name, O_RDONLY | O_CLOEXEC);
+	}
+	pthread_rwlock_unlock(&sysfs_lock);
+	if (dirfd >= 0)
+	  return read_fd(fd, buf, size);
+	if (i == 0)
+	  sysfs_cache_fill(root, cpu);
+  }
+  return -1;
+}
+
+// Read a sysfs file, by path relative to the sysfs root
+int cpuinfo_sysfs_read(const char *path, char *buf, int size)
+{
+  return sysfs_read(-1, path, buf, size);
+}
+
+// Read a sysfs attribute of a logical CPU, by path relative to its directory
+int cpuinfo_sysfs_read_cpu(int cpu, const char *name, char *buf, int size)
+{
+  if (cpu < 0)
+	return -1;
+  return sysfs_read(cpu, name, buf, size);
+}
+
+// Read an integer from a sysfs file
+int cpuinfo_sysfs_read_int(const char *path, int *value)
+{
+  char str[32];
+  if (cpuinfo_sysfs_read(path, str, sizeof(str)) < 0)
+	return -1;
+  return cpuinfo_parse_int(str, value);
+}
+
+// Read an integer from a sysfs attribute of a logical CPU
+int cpuinfo_sysfs_read_cpu_int(int cpu, const char *name, int *value)
+{
+  char str[32];
+  if (cpuinfo_sysfs_read_cpu(cpu, name, str, sizeof(str)) < 0)
+	return -1;
+  return cpuinfo_parse_int(str, value);
+}
+
+// Read a CPU list from a sysfs file
+int cpuinfo_sysfs_read_cpu_list(const char *path, cpuinfo_cpuset_t *set)
+{
+  char str[4096];
+  memset(set, 0, sizeof(*set));
+  if (cpuinfo_sysfs_read(path, str, sizeof(str)) < 0)
+	return -1;
+  cpuinfo_parse_cpu_list(str, NULL, set);
+  return 0;
+}
+
+// Read a procfs file, by path relative to the procfs root
+int cpuinfo_procfs_read(const char *path, char *buf, int size)
+{
+  char full_path[PATH_MAX];
+  if (size <= 0)
+	return -1;
+  snprintf(full_path, sizeof(full_path), "%s/%s", cpuinfo_procfs_root(), path);
+  return read_fd(open(full_path, O_RDONLY | O_CLOEXEC), buf, size);
+}
+
+// Parse a decimal integer
+int cpuinfo_parse_int(const char *str, int *value)
+{
+  char *end;
+  long v = strtol(str, &end, 10);
+  if (end == str)
+	return -1;
+  *value = v;
+  return 0;
+}
+
+// Parse a CPU list ("0-3,8,10-11"), returns the number of CPUs (CPUS
+// and SET may be NULL)
+int cpuinfo_parse_cpu_list(const char *str, int *cpus, cpuinfo_cpuset_t *set)
+{
+  int n = 0;
+  while (*str && *str != '\n') {
+	char *end;
+	long first = strtol(str, &end, 10), last = first;
+	if (end == str)
+	  break;
+	if (*end == '-')
+	  last = strtol(end + 1, &end, 10);
+	for (; first <= last; first++, n++) {
+	  if (cpus)
+		cpus[n] = first;
+	  if (set && first >= 0 && first < CPUINFO_CPUSET_SIZE)
+		set->bits[first / 32] |= 1U << (first % 32);
+	}
+	str = (*end == ',') ? end + 1 : end;
+  }
+  return n;
+}
+
+
+/* ========================================================================= */
+/* == /proc/cpuinfo Parser                                                == */
+/* ========================================================================= */
+
+#define PROC_CPUINFO_CHUNK 65536	// read size, also the longest line parsed
+
+// Interned string, shared by all processors reporting the same value
+typedef struct proc_string {
+  struct proc_string *next;
+  int length;
+  char str[];
+} proc_string_t;
+
+static const char *proc_intern(cpuinfo_proc_t *pp, const char *str, int length)
+{
+  proc_string_t *sp;
+  for (sp = (proc_string_t *)pp->strings; sp; sp = sp->next) {
+	if (sp->length == length && memcmp(sp->str, str, length) == 0)
+	  return sp->str;
+  }
+  if ((sp = (proc_string_t *)malloc(sizeof(*sp) + length + 1)) == NULL)
+	return NULL;
+  sp->length = length;
+  memcpy(sp->str, str, length);
+  sp->str[length] = '\0';
+  sp->next = (proc_string_t *)pp->strings;
+  pp->strings = sp;
+  return sp->str;
+}
+
+// Parse one "key : value" line (returns -1 on allocation failure)
+static int proc_parse_line(cpuinfo_proc_t *pp, char *line, int length)
+{
+  char *colon = (char *)memchr(line, ':', length);
+  if (colon == NULL)
+	return 0;
+  char *key_end = colon;
+  while (key_end > line && (key_end[-1] == ' ' || key_end[-1] == '\t'))
+	key_end--;
+  const int key_length = key_end - line;
+  char *value = colon + 1;
+  while (*value == ' ' || *value == '\t')
+	value++;
+  const int value_length = line + length - value;
+
+#define KEY_IS(NAME) (key_length == sizeof(NAME) - 1 && memcmp(line, NAME, key_length) == 0)
+  if (KEY_IS("processor")) {
+	if (pp->n_cpus == pp->max_cpus) {
+	  int max_cpus = pp->max_cpus ? 2 * pp->max_cpus : 64;
+	  cpuinfo_proc_cpu_t *cpus = (cpuinfo_proc_cpu_t *)realloc(pp->cpus, max_cpus * sizeof(*cpus));
+	  if (cpus == NULL)
+		return -1;
+	  pp->cpus = cpus;
+	  pp->max_cpus = max_cpus;
+	}
+	cpuinfo_proc_cpu_t *cp = &pp->cpus[pp->n_cpus++];
+	memset(cp, 0, sizeof(*cp));
+	cp->processor = strtol(value, NULL, 10);
+	cp->physical_id = -1;
+	cp->core_id = -1;
+	return 0;
+  }
+  if (pp->n_cpus == 0)		// global header, e.g. on older ARM kernels
+	return 0;
+
+  cpuinfo_proc_cpu_t *cp = &pp->cpus[pp->n_cpus - 1];
+  if (KEY_IS("physical id"))
+	cp->physical_id = strtol(value, NULL, 10);
+  else if (KEY_IS("core id"))
+	cp->core_id = strtol(value, NULL, 10);
+  else if (KEY_IS("cpu MHz") || KEY_IS("clock"))	// "clock : 1000.000000MHz" on PowerPC
+	cp->mhz = strtod(value, NULL);
+  else if (KEY_IS("microcode"))
+	cp->microcode = strtoul(value, NULL, 0);
+  else if (KEY_IS("flags") || KEY_IS("Features") || KEY_IS("features")) {
+	if ((cp->flags = proc_intern(pp, value, value_length)) == NULL)
+	  return -1;
+  }
+  else if (KEY_IS("isa")) {
+	if ((cp->isa = proc_intern(pp, value, value_length)) == NULL)
+	  return -1;
+  }
+#undef KEY_IS
+  return 0;
+}
+
+// Parse /proc/cpuinfo in a single pass (returns NULL if unavailable)
+cpuinfo_proc_t *cpuinfo_proc_parse(void)
+{
+  char path[PATH_MAX];
+  snprintf(path, sizeof(path), "%s/cpuinfo", cpuinfo_procfs_root());
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+	return NULL;
+
+  cpuinfo_proc_t *pp = (cpuinfo_proc_t *)calloc(1, sizeof(*pp));
+  char *buf = (char *)malloc(PROC_CPUINFO_CHUNK);
+  int fill = 0, skip = 0, ret = 0;
+  while (pp && buf && ret == 0) {
+	ssize_t n = read(fd, buf + fill, PROC_CPUINFO_CHUNK - 1 - fill);
+	if (n < 0 && errno == EINTR)
+	  continue;
+	if (n <= 0) {
+	  // last line, without a trailing newline
+	  buf[fill] = '\0';
+	  if (n == 0 && fill > 0 && !skip)
+		ret = proc_parse_line(pp, buf, fill);
+	  if (n < 0)
+		ret = -1;
+	  break;
+	}
+	fill += n;
+
+	char *line = buf, *end = buf + fill, *nl;
+	while (ret == 0 && (nl = (char *)memchr(line, '\n', end - line)) != NULL) {
+	  *nl = '\0';
+	  if (!skip)
+		ret = proc_parse_line(pp, line, nl - line);
+	  skip = 0;
+	  line = nl + 1;
+	}
+	fill = end - line;
+	if (fill == PROC_CPUINFO_CHUNK - 1) {
+	  // drop the rest of an overlong line
+	  skip = 1;
+	  fill = 0;
+	}
+	else
+	  memmove(buf, line, fill);
+  }
+  close(fd);
+  free(buf);
+  if (pp && (buf == NULL || ret < 0)) {
+	cpuinfo_proc_destroy(pp);
+	return NULL;
+  }
+  D(bug("cpuinfo_proc_parse: %d processors\n", pp ? pp->n_cpus : 0));
+  return pp;
+}
+
+// Release /proc/cpuinfo records
+void cpuinfo_proc_destroy(cpuinfo_proc_t *pp)
+{
+  if (pp == NULL)
+	return;
+  proc_string_t *sp = (proc_string_t *)pp->strings;
+  while (sp) {
+	proc_string_t *next = sp->next;
+	free(sp);
+	sp = next;
+  }
+  free(pp->cpus);
+  free(pp);
+}
@@ -0,0 +1,412 @@
+/*
+ *  cpuinfo-x86-features.h - x86 features specification
+ *
+ *  cpuinfo (C) 2006-2007 Gwenole Beauchesne
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*
+ * This file is included several times with the following macros defined:
+ *
+ * CPUINFO_X86_CPUID_REG(SLOT, LEAF, SUBLEAF, REG)
+ *   CPUID register holding feature bits
+ *
+ * CPUINFO_X86_FEATURE(ID, NAME, DETAIL, SLOT, BIT, VENDORS, XSTATE)
+ *   CPUINFO_FEATURE_X86_<ID>, reported in bit BIT of SLOT register by
+ *   VENDORS (ANY, or a CPUINFO_VENDOR_<VENDORS> name). Features probed
+ *   by other means use the NONE slot. XSTATE names the register state
+ *   the OS must enable in XCR0 for the feature to be usable (NONE, YMM,
+ *   ZMM or TILE). Order defines the enumeration values, so new features
+ *   are appended at the end.
+ *
+ * CPUINFO_X86_FEATURE_ALT(ID, SLOT, BIT, VENDORS, XSTATE)
+ *   Alternate location for an already defined feature
+ */
+
+CPUINFO_X86_CPUID_REG(CPUID_1_EDX,		0x00000001, 0, EDX)
+CPUINFO_X86_CPUID_REG(CPUID_1_ECX,		0x00000001, 0, ECX)
+CPUINFO_X86_CPUID_REG(CPUID_7_0_EBX,		0x00000007, 0, EBX)
+CPUINFO_X86_CPUID_REG(CPUID_7_0_ECX,		0x00000007, 0, ECX)
+CPUINFO_X86_CPUID_REG(CPUID_7_0_EDX,		0x00000007, 0, EDX)
+CPUINFO_X86_CPUID_REG(CPUID_7_1_EAX,		0x00000007, 1, EAX)
+CPUINFO_X86_CPUID_REG(CPUID_7_1_EDX,		0x00000007, 1, EDX)
+CPUINFO_X86_CPUID_REG(CPUID_D_1_EAX,		0x0000000d, 1, EAX)
+CPUINFO_X86_CPUID_REG(CPUID_80000001_EDX,	0x80000001, 0, EDX)
+CPUINFO_X86_CPUID_REG(CPUID_80000001_ECX,	0x80000001, 0, ECX)
+
+CPUINFO_X86_FEATURE(AC,			"ac",		"Alignment Check",
+		    NONE, 0, ANY, NONE)
+CPUINFO_X86_FEATURE(CPUID,		"cpuid",	"CPU Identificaion",
+		    NONE, 0, ANY, NONE)
+CPUINFO_X86_FEATURE(FPU,		"fpu",		"Floating Point Unit On-Chip",
+		    CPUID_1_EDX, 0, ANY, NONE)
+CPUINFO_X86_FEATURE(VME,		"vme",		"Virtual 8086 Mode Enhancements",
+		    CPUID_1_EDX, 1, ANY, NONE)
+CPUINFO_X86_FEATURE(DE,			"de",		"Debugging Extensions",
+		    CPUID_1_EDX, 2, ANY, NONE)
+CPUINFO_X86_FEATURE(PSE,		"pse",		"Page Size Extension",
+		    CPUID_1_EDX, 3, ANY, NONE)
+CPUINFO_X86_FEATURE(TSC,		"tsc",		"Time Stamp Counter",
+		    CPUID_1_EDX, 4, ANY, NONE)
+CPUINFO_X86_FEATURE(MSR,		"msr",		"Model Specific Registers RDMSR and WRMSR Instructions",
+		    CPUID_1_EDX, 5, ANY, NONE)
+CPUINFO_X86_FEATURE(PAE,		"pae",		"Physical Address Extension",
+		    CPUID_1_EDX, 6, ANY, NONE)
+CPUINFO_X86_FEATURE(MCE,		"mce",		"Machine Check Exception",
+		    CPUID_1_EDX, 7, ANY, NONE)
+CPUINFO_X86_FEATURE(CX8,		"cx8",		"CMPCXHG8B Instruction",
+		    CPUID_1_EDX, 8, ANY, NONE)
+CPUINFO_X86_FEATURE(APIC,		"apic",		"APIC On-Chip",
+		    CPUID_1_EDX, 9, ANY, NONE)
+CPUINFO_X86_FEATURE(SEP,		"sep",		"SYSENTER and SYSEXIT Instructions",
+		    CPUID_1_EDX, 11, ANY, NONE)
+CPUINFO_X86_FEATURE(MTRR,		"mtrr",		"Memory Type Range Registers",
+		    CPUID_1_EDX, 12, ANY, NONE)
+CPUINFO_X86_FEATURE(PGE,		"pge",		"PTE Global Bit",
+		    CPUID_1_EDX, 13, ANY, NONE)
+CPUINFO_X86_FEATURE(MCA,		"mca",		"Machine Check Architecture",
+		    CPUID_1_EDX, 14, ANY, NONE)
+CPUINFO_X86_FEATURE(CMOV,		"cmov",		"Conditional Moves",
+		    CPUID_1_EDX, 15, ANY, NONE)
+CPUINFO_X86_FEATURE(PAT,		"pat",		"Page Attribute Table",
+		    CPUID_1_EDX, 16, ANY, NONE)
+CPUINFO_X86_FEATURE(PSE_36,		"pse36",	"36-Bit Page Size Extension",
+		    CPUID_1_EDX, 17, ANY, NONE)
+CPUINFO_X86_FEATURE(PSN,		"psn",		"Processor Serial Number",
+		    CPUID_1_EDX, 18, ANY, NONE)
+CPUINFO_X86_FEATURE(CLFLUSH,		"clflush",	"CLFLUSH Instruction",
+		    CPUID_1_EDX, 19, ANY, NONE)
+CPUINFO_X86_FEATURE(DS,			"ds",		"Debug Store",
+		    CPUID_1_EDX, 21, ANY, NONE)
+CPUINFO_X86_FEATURE(ACPI,		"acpi",		"Thermal Monitor and Software Controlled Clock Facilities",
+		    CPUID_1_EDX, 22, ANY, NONE)
+CPUINFO_X86_FEATURE(FXSR,		"fxsr",		"Supports FXSAVE/FXSTOR instructions",
+		    CPUID_1_EDX, 24, ANY, NONE)
+CPUINFO_X86_FEATURE(SS,			"ss",		"Self Snoop",
+		    CPUID_1_EDX, 27, ANY, NONE)
+CPUINFO_X86_FEATURE(HTT,		"htt",		"Hyper-Threading Technology",
+		    CPUID_1_EDX, 28, ANY, NONE)
+CPUINFO_X86_FEATURE(IA64,		"ia64",		"Intel 64 Instruction Set Architecture",
+		    CPUID_1_EDX, 30, ANY, NONE)
+CPUINFO_X86_FEATURE(PBE,		"pbe",		"Pending Break Enable",
+		    CPUID_1_EDX, 31, ANY, NONE)
+CPUINFO_X86_FEATURE(MMX,		"mmx",		"MMX Technology",
+		    CPUID_1_EDX, 23, ANY, NONE)
+CPUINFO_X86_FEATURE(MMX_EXT,		"mmxext",	"MMX+ Technology (AMD or Cyrix)",
+		    CPUID_80000001_EDX, 22, AMD, NONE)
+CPUINFO_X86_FEATURE(3DNOW,		"3dnow",	"3DNow! Technology",
+		    CPUID_80000001_EDX, 31, ANY, NONE)
+CPUINFO_X86_FEATURE(3DNOW_EXT,		"3dnowext",	"Enhanced 3DNow! Technology",
+		    CPUID_80000001_EDX, 30, ANY, NONE)
+CPUINFO_X86_FEATURE(3DNOW_PREFETCH,	"3dnowprefetch","3DNow! prefetch",
+		    CPUID_80000001_ECX, 8, ANY, NONE)
+CPUINFO_X86_FEATURE(SSE,		"sse",		"SSE Technology",
+		    CPUID_1_EDX, 25, ANY, NONE)
+CPUINFO_X86_FEATURE(SSE2,		"sse2",		"SSE2 Technology",
+		    CPUID_1_EDX, 26, ANY, NONE)
+CPUINFO_X86_FEATURE(SSE3,		"sse3",		"SSE3 Technology (Prescott New Instructions)",
+		    CPUID_1_ECX, 0, ANY, NONE)
+CPUINFO_X86_FEATURE(SSSE3,		"ssse3",	"SSSE3 Technology (Merom New Instructions)",
+		    CPUID_1_ECX, 9, ANY, NONE)
+CPUINFO_X86_FEATURE(SSE4_1,		"sse4.1",	"SSE4.1 Technology (Penryn New Instructions)",
+		    CPUID_1_ECX, 19, ANY, NONE)
+CPUINFO_X86_FEATURE(SSE4_2,		"sse4.2",	"SSE4.2 Technology (Nehalem New Instructions)",
+		    CPUID_1_ECX, 20, ANY, NONE)
+CPUINFO_X86_FEATURE(SSE4A,		"sse4a",	"SSE4A Technology (AMD Barcelona Instructions)",
+		    CPUID_80000001_ECX, 6, ANY, NONE)
+CPUINFO_X86_FEATURE(SSE5,		"sse5",		"SSE5 Technology (AMD Bulldozer Instructions)",
+		    CPUID_80000001_ECX, 11, ANY, YMM)
+CPUINFO_X86_FEATURE(MISALIGNSSE,	"misalignsse",	"Misaligned SSE mode",
+		    CPUID_80000001_ECX, 7, ANY, NONE)
+CPUINFO_X86_FEATURE(VMX,		"vmx",		"Intel Virtualisation Technology (VT)",
+		    CPUID_1_ECX, 5, ANY, NONE)
+CPUINFO_X86_FEATURE(SVM,		"svm",		"AMD-v Technology (Pacifica)",
+		    CPUID_80000001_ECX, 2, ANY, NONE)
+CPUINFO_X86_FEATURE(LM,			"lm",		"Long Mode (64-bit capable)",
+		    CPUID_80000001_EDX, 29, ANY, NONE)
+CPUINFO_X86_FEATURE(LAHF64,		"lahf_lm",	"LAHF/SAHF Supported in 64-bit mode",
+		    CPUID_80000001_ECX, 0, ANY, NONE)
+CPUINFO_X86_FEATURE(POPCNT,		"popcnt",	"POPCNT (population count) instruction supported",
+		    CPUID_1_ECX, 23, ANY, NONE)
+CPUINFO_X86_FEATURE(TSC_DEADLINE,	"tsc_deadline",	"Time Stamp Counter Deadline",
+		    CPUID_1_ECX, 24, ANY, NONE)
+CPUINFO_X86_FEATURE(ABM,		"abm",		"Advanced Bit Manipulation instructions (LZCNT9",
+		    CPUID_80000001_ECX, 5, ANY, NONE)
+CPUINFO_X86_FEATURE(BSFCC,		"bsf_cc",	"BSF instruction clobbers condition codes",
+		    NONE, 0, ANY, NONE)
+CPUINFO_X86_FEATURE(TM,			"tm",		"Thermal Monitor",
+		    CPUID_1_EDX, 29, ANY, NONE)
+CPUINFO_X86_FEATURE(TM2,		"tm2",		"Thermal Monitor 2",
+		    CPUID_1_ECX, 8, ANY, NONE)
+CPUINFO_X86_FEATURE(EIST,		"eist",		"Enhanced Intel Speedstep Technology",
+		    CPUID_1_ECX, 7, ANY, NONE)
+CPUINFO_X86_FEATURE(NX,			"nx",		"No eXecute (AMD NX) / Execute Disable (Intel XD)",
+		    CPUID_80000001_EDX, 20, ANY, NONE)
+CPUINFO_X86_FEATURE(DTES64,		"dtes64",	"64-bit DS Area",
+		    CPUID_1_ECX, 2, ANY, NONE)
+CPUINFO_X86_FEATURE(MONITOR,		"monitor",	"MONITOR/MWAIT",
+		    CPUID_1_ECX, 3, ANY, NONE)
+CPUINFO_X86_FEATURE(DS_CPL,		"ds_cpl",	"CPL Qualified Debug Store",
+		    CPUID_1_ECX, 4, ANY, NONE)
+CPUINFO_X86_FEATURE(SMX,		"smx",		"Safer Mode Extensions",
+		    CPUID_1_ECX, 6, ANY, NONE)
+CPUINFO_X86_FEATURE(CNXT_ID,		"cnxt_id",	"L1 Context ID",
+		    CPUID_1_ECX, 10, ANY, NONE)
+CPUINFO_X86_FEATURE(CX16,		"cx16",		"Supports CMPCXHG16B Instruction",
+		    CPUID_1_ECX, 13, ANY, NONE)
+CPUINFO_X86_FEATURE(XTPR,		"xtpr",		"xTPR Update Conrol",
+		    CPUID_1_ECX, 14, ANY, NONE)
+CPUINFO_X86_FEATURE(PDCM,		"pdcm",		"Perfmon and Debug Capability",
+		    CPUID_1_ECX, 15, ANY, NONE)
+CPUINFO_X86_FEATURE(PCID,		"pcid",		"Process Context Identifiers",
+		    CPUID_1_ECX, 17, ANY, NONE)
+CPUINFO_X86_FEATURE(DCA,		"dca",		"Supports prefetching from memory mapped device",
+		    CPUID_1_ECX, 18, ANY, NONE)
+CPUINFO_X86_FEATURE(X2APIC,		"x2apic",	"Supports x2APIC",
+		    CPUID_1_ECX, 21, ANY, NONE)
+CPUINFO_X86_FEATURE(MOVBE,		"movbe",	"Supports MOVBE instruction",
+		    CPUID_1_ECX, 22, ANY, NONE)
+CPUINFO_X86_FEATURE(XSAVE,		"xsave",	"Supports XSAVE/XRSTOR instructions",
+		    CPUID_1_ECX, 26, ANY, NONE)
+CPUINFO_X86_FEATURE(OSXSAVE,		"osxsave",	"XSAVE enabled by the OS",
+		    CPUID_1_ECX, 27, ANY, NONE)
+CPUINFO_X86_FEATURE(PCLMULQDQ,		"pclmulqdq",	"Supports PCLMULQDQ instruction",
+		    CPUID_1_ECX, 1, ANY, NONE)
+CPUINFO_X86_FEATURE(FMA,		"fma",		"Supports FMA extensions using YMM state.",
+		    CPUID_1_ECX, 12, ANY, YMM)
+CPUINFO_X86_FEATURE(AES,		"aes",		"Supports AES instruction",
+		    CPUID_1_ECX, 25, ANY, NONE)
+CPUINFO_X86_FEATURE(AVX,		"avx",		"Supports Advanced Vector Extensions",
+		    CPUID_1_ECX, 28, ANY, YMM)
+CPUINFO_X86_FEATURE(F16C,		"f16c",		"F16C half-precision convert instruction",
+		    CPUID_1_ECX, 29, ANY, YMM)
+CPUINFO_X86_FEATURE(HYPERVISOR,		"hypervisor",	"Hypervisor Guest Status",
+		    CPUID_1_ECX, 31, ANY, NONE)
+CPUINFO_X86_FEATURE(CMP_LEGACY,		"cmp_legacy",	"Core multi-processing legacy mode",
+		    CPUID_80000001_ECX, 1, ANY, NONE)
+CPUINFO_X86_FEATURE(EXTAPIC,		"extapic",	"Extended APIC register space",
+		    CPUID_80000001_ECX, 3, ANY, NONE)
+CPUINFO_X86_FEATURE(CR8_LEGACY,		"cr8_legacy",	"LOCK MOV CR0 means MOV CR8",
+		    CPUID_80000001_ECX, 4, ANY, NONE)
+CPUINFO_X86_FEATURE(OSVW,		"osvw",		"OS visible workaround",
+		    CPUID_80000001_ECX, 9, ANY, NONE)
+CPUINFO_X86_FEATURE(IBS,		"ibs",		"Instruction based sampling",
+		    CPUID_80000001_ECX, 10, ANY, NONE)
+CPUINFO_X86_FEATURE(SKINIT,		"skinit",	"Supports SKINIT/STGI instructions",
+		    CPUID_80000001_ECX, 12, ANY, NONE)
+CPUINFO_X86_FEATURE(WDT,		"wdt",		"Watchdog timer support",
+		    CPUID_80000001_ECX, 13, ANY, NONE)
+CPUINFO_X86_FEATURE(LWP,		"lwp",		"Lightweight profiling support",
+		    CPUID_80000001_ECX, 15, ANY, NONE)
+CPUINFO_X86_FEATURE(FMA4,		"fma4",		"4-operand FMA instruction",
+		    CPUID_80000001_ECX, 16, ANY, YMM)
+CPUINFO_X86_FEATURE(NODEID_MSR,		"nodeid_msr",	"NodeId MSR C001100C",
+		    CPUID_80000001_ECX, 19, ANY, NONE)
+CPUINFO_X86_FEATURE(TBM,		"tbm",		"Trailing bit manipulation instruction support",
+		    CPUID_80000001_ECX, 21, ANY, NONE)
+CPUINFO_X86_FEATURE(TOPOEXT,		"topoext",	"Topology extensions support",
+		    CPUID_80000001_ECX, 22, ANY, NONE)
+CPUINFO_X86_FEATURE(FFXSR,		"ffxsr",	"Supports FXSAVE/FXSTOR instruction optimizations",
+		    CPUID_80000001_EDX, 25, ANY, NONE)
+CPUINFO_X86_FEATURE(PAGE1GB,		"page1gb",	"1-GB large page support",
+		    CPUID_80000001_EDX, 26, ANY, NONE)
+CPUINFO_X86_FEATURE(RDTSCP,		"rdtscp",	"Supports RDTSCP instruction",
+		    CPUID_80000001_EDX, 27, ANY, NONE)
+CPUINFO_X86_FEATURE(FSGSBASE,		"fsgsbase",	"RDFSBASE/RDGSBASE/WRFSBASE/WRGSBASE instructions",
+		    CPUID_7_0_EBX, 0, ANY, NONE)
+CPUINFO_X86_FEATURE(TSC_ADJUST,		"tsc_adjust",	"IA32_TSC_ADJUST MSR",
+		    CPUID_7_0_EBX, 1, ANY, NONE)
+CPUINFO_X86_FEATURE(SGX,		"sgx",		"Software Guard Extensions",
+		    CPUID_7_0_EBX, 2, ANY, NONE)
+CPUINFO_X86_FEATURE(BMI1,		"bmi1",		"Bit Manipulation Instruction Set 1",
+		    CPUID_7_0_EBX, 3, ANY, NONE)
+CPUINFO_X86_FEATURE(HLE,		"hle",		"Hardware Lock Elision",
+		    CPUID_7_0_EBX, 4, ANY, NONE)
+CPUINFO_X86_FEATURE(AVX2,		"avx2",		"Advanced Vector Extensions 2",
+		    CPUID_7_0_EBX, 5, ANY, YMM)
+CPUINFO_X86_FEATURE(SMEP,		"smep",		"Supervisor Mode Execution Prevention",
+		    CPUID_7_0_EBX, 7, ANY, NONE)
+CPUINFO_X86_FEATURE(BMI2,		"bmi2",		"Bit Manipulation Instruction Set 2",
+		    CPUID_7_0_EBX, 8, ANY, NONE)
+CPUINFO_X86_FEATURE(ERMS,		"erms",		"Enhanced REP MOVSB/STOSB",
+		    CPUID_7_0_EBX, 9, ANY, NONE)
+CPUINFO_X86_FEATURE(INVPCID,		"invpcid",	"INVPCID instruction",
+		    CPUID_7_0_EBX, 10, ANY, NONE)
+CPUINFO_X86_FEATURE(RTM,		"rtm",		"Restricted Transactional Memory",
+		    CPUID_7_0_EBX, 11, ANY, NONE)
+CPUINFO_X86_FEATURE(MPX,		"mpx",		"Memory Protection Extensions",
+		    CPUID_7_0_EBX, 14, ANY, NONE)
+CPUINFO_X86_FEATURE(AVX512F,		"avx512f",	"AVX-512 Foundation",
+		    CPUID_7_0_EBX, 16, ANY, ZMM)
+CPUINFO_X86_FEATURE(AVX512DQ,		"avx512dq",	"AVX-512 Doubleword and Quadword Instructions",
+		    CPUID_7_0_EBX, 17, ANY, ZMM)
+CPUINFO_X86_FEATURE(RDSEED,		"rdseed",	"RDSEED instruction",
+		    CPUID_7_0_EBX, 18, ANY, NONE)
+CPUINFO_X86_FEATURE(ADX,		"adx",		"Multi-Precision Add-Carry Instruction Extensions",
+		    CPUID_7_0_EBX, 19, ANY, NONE)
+CPUINFO_X86_FEATURE(SMAP,		"smap",		"Supervisor Mode Access Prevention",
+		    CPUID_7_0_EBX, 20, ANY, NONE)
+CPUINFO_X86_FEATURE(AVX512_IFMA,	"avx512ifma",	"AVX-512 Integer Fused Multiply-Add",
+		    CPUID_7_0_EBX, 21, ANY, ZMM)
+CPUINFO_X86_FEATURE(CLFLUSHOPT,		"clflushopt",	"CLFLUSHOPT instruction",
+		    CPUID_7_0_EBX, 23, ANY, NONE)
+CPUINFO_X86_FEATURE(CLWB,		"clwb",		"CLWB instruction",
+		    CPUID_7_0_EBX, 24, ANY, NONE)
+CPUINFO_X86_FEATURE(INTEL_PT,		"intel_pt",	"Intel Processor Trace",
+		    CPUID_7_0_EBX, 25, ANY, NONE)
+CPUINFO_X86_FEATURE(AVX512PF,		"avx512pf",	"AVX-512 Prefetch Instructions",
+		    CPUID_7_0_EBX, 26, ANY, ZMM)
+CPUINFO_X86_FEATURE(AVX512ER,		"avx512er",	"AVX-512 Exponential and Reciprocal Instructions",
+		    CPUID_7_0_EBX, 27, ANY, ZMM)
+CPUINFO_X86_FEATURE(AVX512CD,		"avx512cd",	"AVX-512 Conflict Detection Instructions",
+		    CPUID_7_0_EBX, 28, ANY, ZMM)
+CPUINFO_X86_FEATURE(SHA,		"sha_ni",	"SHA extensions",
+		    CPUID_7_0_EBX, 29, ANY, NONE)
+CPUINFO_X86_FEATURE(AVX512BW,		"avx512bw",	"AVX-512 Byte and Word Instructions",
+		    CPUID_7_0_EBX, 30, ANY, ZMM)
+CPUINFO_X86_FEATURE(AVX512VL,		"avx512vl",	"AVX-512 Vector Length Extensions",
+		    CPUID_7_0_EBX, 31, ANY, ZMM)
+CPUINFO_X86_FEATURE(PREFETCHWT1,	"prefetchwt1",	"PREFETCHWT1 instruction",
+		    CPUID_7_0_ECX, 0, ANY, NONE)
+CPUINFO_X86_FEATURE(AVX512_VBMI,	"avx512vbmi",	"AVX-512 Vector Bit Manipulation Instructions",
+		    CPUID_7_0_ECX, 1, ANY, ZMM)
+CPUINFO_X86_FEATURE(UMIP,		"umip",		"User Mode Instruction Prevention",
+		    CPUID_7_0_ECX, 2, ANY, NONE)
+CPUINFO_X86_FEATURE(PKU,		"pku",		"Protection Keys for User-mode pages",
+		    CPUID_7_0_ECX, 3, ANY, NONE)
+CPUINFO_X86_FEATURE(OSPKE,		"ospke",	"Protection Keys enabled by the OS",
+		    CPUID_7_0_ECX, 4, ANY, NONE)
+CPUINFO_X86_FEATURE(WAITPKG,		"waitpkg",	"UMONITOR/UMWAIT/TPAUSE instructions",
+		    CPUID_7_0_ECX, 5, ANY, NONE)
+CPUINFO_X86_FEATURE(AVX512_VBMI2,	"avx512_vbmi2",	"AVX-512 Vector Bit Manipulation Instructions 2",
+		    CPUID_7_0_ECX, 6, ANY, ZMM)
+CPUINFO_X86_FEATURE(CET_SS,		"cet_ss",	"CET Shadow Stack",
+		    CPUID_7_0_ECX, 7, ANY, NONE)
+CPUINFO_X86_FEATURE(GFNI,		"gfni",		"Galois Field instructions",
+		    CPUID_7_0_ECX, 8, ANY, NONE)
+CPUINFO_X86_FEATURE(VAES,		"vaes",		"Vector AES instructions",
+		    CPUID_7_0_ECX, 9, ANY, YMM)
+CPUINFO_X86_FEATURE(VPCLMULQDQ,		"vpclmulqdq",	"Carry-less multiplication of vectors",
+		    CPUID_7_0_ECX, 10, ANY, YMM)
+CPUINFO_X86_FEATURE(AVX512_VNNI,	"avx512_vnni",	"AVX-512 Vector Neural Network Instructions",
+		    CPUID_7_0_ECX, 11, ANY, ZMM)
+CPUINFO_X86_FEATURE(AVX512_BITALG,	"avx512_bitalg","AVX-512 BITALG instructions",
+		    CPUID_7_0_ECX, 12, ANY, ZMM)
+CPUINFO_X86_FEATURE(AVX512_VPOPCNTDQ,	"avx512_vpopcntdq","AVX-512 Vector Population Count Doubleword and Quadword",
+		    CPUID_7_0_ECX, 14, ANY, ZMM)
+CPUINFO_X86_FEATURE(LA57,		"la57",		"5-level paging",
+		    CPUID_7_0_ECX, 16, ANY, NONE)
+CPUINFO_X86_FEATURE(RDPID,		"rdpid",	"RDPID instruction",
+		    CPUID_7_0_ECX, 22, ANY, NONE)
+CPUINFO_X86_FEATURE(KL,			"kl",		"Key Locker",
+		    CPUID_7_0_ECX, 23, ANY, NONE)
+CPUINFO_X86_FEATURE(CLDEMOTE,		"cldemote",	"CLDEMOTE instruction",
+		    CPUID_7_0_ECX, 25, ANY, NONE)
+CPUINFO_X86_FEATURE(MOVDIRI,		"movdiri",	"MOVDIRI instruction",
+		    CPUID_7_0_ECX, 27, ANY, NONE)
+CPUINFO_X86_FEATURE(MOVDIR64B,		"movdir64b",	"MOVDIR64B instruction",
+		    CPUID_7_0_ECX, 28, ANY, NONE)
+CPUINFO_X86_FEATURE(ENQCMD,		"enqcmd",	"ENQCMD/ENQCMDS instructions",
+		    CPUID_7_0_ECX, 29, ANY, NONE)
+CPUINFO_X86_FEATURE(SGX_LC,		"sgx_lc",	"SGX Launch Configuration",
+		    CPUID_7_0_ECX, 30, ANY, NONE)
+CPUINFO_X86_FEATURE(AVX512_4VNNIW,	"avx512_4vnniw","AVX-512 4-register Neural Network Instructions",
+		    CPUID_7_0_EDX, 2, ANY, ZMM)
+CPUINFO_X86_FEATURE(AVX512_4FMAPS,	"avx512_4fmaps","AVX-512 4-register Multiply Accumulation Single precision",
+		    CPUID_7_0_EDX, 3, ANY, ZMM)
+CPUINFO_X86_FEATURE(FSRM,		"fsrm",		"Fast Short REP MOVSB",
+		    CPUID_7_0_EDX, 4, ANY, NONE)
+CPUINFO_X86_FEATURE(UINTR,		"uintr",	"User Interrupts",
+		    CPUID_7_0_EDX, 5, ANY, NONE)
+CPUINFO_X86_FEATURE(AVX512_VP2INTERSECT,	"avx512_vp2intersect","AVX-512 VP2INTERSECT instructions",
+		    CPUID_7_0_EDX, 8, ANY, ZMM)
+CPUINFO_X86_FEATURE(MD_CLEAR,		"md_clear",	"VERW clears CPU buffers",
+		    CPUID_7_0_EDX, 10, ANY, NONE)
+CPUINFO_X86_FEATURE(SERIALIZE,		"serialize",	"SERIALIZE instruction",
+		    CPUID_7_0_EDX, 14, ANY, NONE)
+CPUINFO_X86_FEATURE(HYBRID,		"hybrid_cpu",	"Hybrid part (performance and efficient cores)",
+		    CPUID_7_0_EDX, 15, ANY, NONE)
+CPUINFO_X86_FEATURE(TSXLDTRK,		"tsxldtrk",	"TSX suspend load address tracking",
+		    CPUID_7_0_EDX, 16, ANY, NONE)
+CPUINFO_X86_FEATURE(PCONFIG,		"pconfig",	"PCONFIG instruction",
+		    CPUID_7_0_EDX, 18, ANY, NONE)
+CPUINFO_X86_FEATURE(ARCH_LBR,		"arch_lbr",	"Architectural Last Branch Records",
+		    CPUID_7_0_EDX, 19, ANY, NONE)
+CPUINFO_X86_FEATURE(CET_IBT,		"ibt",		"CET Indirect Branch Tracking",
+		    CPUID_7_0_EDX, 20, ANY, NONE)
+CPUINFO_X86_FEATURE(AMX_BF16,		"amx_bf16",	"AMX bfloat16 instructions",
+		    CPUID_7_0_EDX, 22, ANY, TILE)
+CPUINFO_X86_FEATURE(AVX512_FP16,	"avx512_fp16",	"AVX-512 half-precision instructions",
+		    CPUID_7_0_EDX, 23, ANY, ZMM)
+CPUINFO_X86_FEATURE(AMX_TILE,		"amx_tile",	"AMX tile architecture",
+		    CPUID_7_0_EDX, 24, ANY, TILE)
+CPUINFO_X86_FEATURE(AMX_INT8,		"amx_int8",	"AMX 8-bit integer instructions",
+		    CPUID_7_0_EDX, 25, ANY, TILE)
+CPUINFO_X86_FEATURE(SPEC_CTRL,		"spec_ctrl",	"IBRS and IBPB speculation control",
+		    CPUID_7_0_EDX, 26, ANY, NONE)
+CPUINFO_X86_FEATURE(STIBP,		"stibp",	"Single Thread Indirect Branch Predictors",
+		    CPUID_7_0_EDX, 27, ANY, NONE)
+CPUINFO_X86_FEATURE(FLUSH_L1D,		"flush_l1d",	"IA32_FLUSH_CMD MSR",
+		    CPUID_7_0_EDX, 28, ANY, NONE)
+CPUINFO_X86_FEATURE(ARCH_CAPABILITIES,	"arch_capabilities","IA32_ARCH_CAPABILITIES MSR",
+		    CPUID_7_0_EDX, 29, ANY, NONE)
+CPUINFO_X86_FEATURE(SSBD,		"ssbd",		"Speculative Store Bypass Disable",
+		    CPUID_7_0_EDX, 31, ANY, NONE)
+CPUINFO_X86_FEATURE(SHA512,		"sha512",	"SHA512 instructions",
+		    CPUID_7_1_EAX, 0, ANY, YMM)
+CPUINFO_X86_FEATURE(SM3,		"sm3",		"SM3 instructions",
+		    CPUID_7_1_EAX, 1, ANY, NONE)
+CPUINFO_X86_FEATURE(SM4,		"sm4",		"SM4 instructions",
+		    CPUID_7_1_EAX, 2, ANY, YMM)
+CPUINFO_X86_FEATURE(AVX_VNNI,		"avx_vnni",	"AVX (VEX-encoded) Vector Neural Network Instructions",
+		    CPUID_7_1_EAX, 4, ANY, YMM)
+CPUINFO_X86_FEATURE(AVX512_BF16,	"avx512_bf16",	"AVX-512 bfloat16 instructions",
+		    CPUID_7_1_EAX, 5, ANY, ZMM)
+CPUINFO_X86_FEATURE(CMPCCXADD,		"cmpccxadd",	"CMPccXADD instructions",
+		    CPUID_7_1_EAX, 7, ANY, NONE)
+CPUINFO_X86_FEATURE(FZLRM,		"fzlrm",	"Fast zero-length REP MOVSB",
+		    CPUID_7_1_EAX, 10, ANY, NONE)
+CPUINFO_X86_FEATURE(FSRS,		"fsrs",		"Fast short REP STOSB",
+		    CPUID_7_1_EAX, 11, ANY, NONE)
+CPUINFO_X86_FEATURE(FSRC,		"fsrc",		"Fast short REP CMPSB/SCASB",
+		    CPUID_7_1_EAX, 12, ANY, NONE)
+CPUINFO_X86_FEATURE(AMX_FP16,		"amx_fp16",	"AMX half-precision instructions",
+		    CPUID_7_1_EAX, 21, ANY, TILE)
+CPUINFO_X86_FEATURE(AVX_IFMA,		"avx_ifma",	"AVX (VEX-encoded) Integer Fused Multiply-Add",
+		    CPUID_7_1_EAX, 23, ANY, YMM)
+CPUINFO_X86_FEATURE(AVX_VNNI_INT8,	"avx_vnni_int8","AVX Vector Neural Network Instructions INT8",
+		    CPUID_7_1_EDX, 4, ANY, YMM)
+CPUINFO_X86_FEATURE(AVX_NE_CONVERT,	"avx_ne_convert","AVX no-exception FP conversion instructions",
+		    CPUID_7_1_EDX, 5, ANY, YMM)
+CPUINFO_X86_FEATURE(AMX_COMPLEX,	"amx_complex",	"AMX complex instructions",
+		    CPUID_7_1_EDX, 8, ANY, TILE)
+CPUINFO_X86_FEATURE(AVX_VNNI_INT16,	"avx_vnni_int16","AVX Vector Neural Network Instructions INT16",
+		    CPUID_7_1_EDX, 10, ANY, YMM)
+CPUINFO_X86_FEATURE(PREFETCHI,		"prefetchi",	"PREFETCHIT0/1 instructions",
+		    CPUID_7_1_EDX, 14, ANY, NONE)
+CPUINFO_X86_FEATURE(AVX10,		"avx10",	"AVX10 converged vector ISA",
+		    CPUID_7_1_EDX, 19, ANY, YMM)
+CPUINFO_X86_FEATURE(XSAVEOPT,		"xsaveopt",	"XSAVEOPT instruction",
+		    CPUID_D_1_EAX, 0, ANY, NONE)
+CPUINFO_X86_FEATURE(XSAVEC,		"xsavec",	"XSAVEC instruction",
+		    CPUID_D_1_EAX, 1, ANY, NONE)
+CPUINFO_X86_FEATURE(XGETBV1,		"xgetbv1",	"XGETBV with ECX = 1",
+		    CPUID_D_1_EAX, 2, ANY, NONE)
+CPUINFO_X86_FEATURE(XSAVES,		"xsaves",	"XSAVES/XRSTORS instructions",
+		    CPUID_D_1_EAX, 3, ANY, NONE)
+
+// XXX not sure they are the same MMX extensions...
+CPUINFO_X86_FEATURE_ALT(MMX_EXT,	CPUID_80000001_EDX, 24, CYRIX, NONE)
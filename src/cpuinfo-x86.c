@@ -18,12 +18,18 @@
  *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
  */
 
+#define _GNU_SOURCE 1
 #include "sysdeps.h"
 #include <unistd.h>
 #include <ctype.h>
-#include <sys/time.h>
+#include <time.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
 #if defined __linux__
 #include <sys/utsname.h>
+#include <sched.h>
+#include <sys/stat.h>
 #endif
 #include "cpuinfo.h"
 #include "cpuinfo-private.h"
@@ -45,6 +51,8 @@ static int cpuinfo_has_ac()
 						"popf\n\t"
 						"pushf\n\t"
 						"pop %0\n\t"
+						"push %1\n\t"
+						"popf\n\t"
 						: "=a" (a), "=c" (c)
 						:: "cc");
 
@@ -62,53 +70,459 @@ static int cpuinfo_has_cpuid()
 						"popf\n\t"
 						"pushf\n\t"
 						"pop %0\n\t"
+						"push %1\n\t"
+						"popf\n\t"
 						: "=a" (a), "=c" (c)
 						:: "cc");
 
   return a != c;
 }
 
-static void cpuid(uint32_t op, uint32_t *eax, uint32_t *ebx, uint32_t *ecx, uint32_t *edx)
+// Execute CPUID instruction (regs[] = eax, ebx, ecx, edx)
+static void cpuid_insn(uint32_t op, uint32_t subop, uint32_t regs[4])
 {
-  uint32_t a = eax ? *eax : 0;
-  uint32_t b = ebx ? *ebx : 0;
-  uint32_t c = ecx ? *ecx : 0;
-  uint32_t d = edx ? *edx : 0;
-  if(!cpuinfo_has_cpuid())
-	return;
+  uint32_t a, b = 0, c, d;
 
 #if defined __i386__
   __asm__ __volatile__ ("xchgl	%%ebx,%0\n\t"
 						"cpuid	\n\t"
 						"xchgl	%%ebx,%0\n\t"
 						: "+r" (b), "=a" (a), "=c" (c), "=d" (d)
-						: "1" (op), "2" (c));
+						: "1" (op), "2" (subop));
 #else
   __asm__ __volatile__ ("cpuid"
 						: "=a" (a), "=b" (b), "=c" (c), "=d" (d)
-						: "0" (op), "2" (c));
+						: "0" (op), "2" (subop));
 #endif
 
-  if (eax) *eax = a;
-  if (ebx) *ebx = b;
-  if (ecx) *ecx = c;
-  if (edx) *edx = d;
+  regs[0] = a;
+  regs[1] = b;
+  regs[2] = c;
+  regs[3] = d;
+}
+
+enum { R_EAX, R_EBX, R_ECX, R_EDX };
+
+// XCR0 state components
+enum {
+  XCR0_X87		= 1 << 0,
+  XCR0_SSE		= 1 << 1,
+  XCR0_AVX		= 1 << 2,
+  XCR0_OPMASK	= 1 << 5,
+  XCR0_ZMM_HI256	= 1 << 6,
+  XCR0_HI16_ZMM	= 1 << 7,
+  XCR0_TILECFG	= 1 << 17,
+  XCR0_TILEDATA	= 1 << 18,
+};
+
+// Execute XGETBV instruction (requires CPUID.1:ECX.OSXSAVE)
+static uint64_t xgetbv(uint32_t xcr)
+{
+  uint32_t low, high;
+  __asm__ __volatile__ (".byte 0x0f, 0x01, 0xd0"		// xgetbv
+						: "=a" (low), "=d" (high)
+						: "c" (xcr));
+  return (((uint64_t)high) << 32) | low;
 }
 
+// Raw CPUID leaf
+typedef struct {
+  uint32_t leaf;
+  uint32_t subleaf;
+  uint32_t regs[4];
+} x86_cpuid_t;
+
+#define X86_CPUID_MAX 256				// room for CPUID leaves at first, doubled until they fit
+#define X86_CPUID_LIMIT (5 * 256 * 64)	// 256 leaves of each range, with up to 64 subleaves
+
 // Arch-dependent data
 struct x86_cpuinfo {
   uint32_t features[CPUINFO_FEATURES_SZ_(X86)];
+  uint32_t signature;							// CPUID(1).EAX: family/model/stepping
+  uint64_t xcr0;								// XSAVE state components enabled by the OS
+  int cpu;										// Logical CPU the leaves were captured on, -1 if any
+  int cpuid_fd;									// /dev/cpu/N/cpuid to read leaves from, -1 to execute CPUID
+  const struct x86_cpuinfo *replay;				// Recorded leaves to read from, NULL to execute CPUID
+  int n_replays;								// Number of logical CPUs in the recorded dump
+  struct x86_cpuinfo **replays;					// Recorded leaves, sorted by logical CPU number
+  int n_probes;									// Number of per-CPU captures, -1 if not probed yet
+  struct x86_cpuinfo **probes;					// Per-CPU captures, sorted by logical CPU number
+  int heterogeneity;							// Differences between the per-CPU captures
+  int max_cpuid;								// Room for CPUID leaves
+  int n_cpuid;									// Number of captured CPUID leaves
+  x86_cpuid_t cpuid[];							// Captured CPUID leaves, sorted by leaf/subleaf
 };
 
 typedef struct x86_cpuinfo x86_cpuinfo_t;
 
+#define X86_CPUINFO_SIZE(MAX_CPUID) (sizeof(x86_cpuinfo_t) + (MAX_CPUID) * sizeof(x86_cpuid_t))
+
+// Initialize arch-dependent data with room for the specified number of CPUID leaves
+static void x86_cpuinfo_init(x86_cpuinfo_t *acip, int max_cpuid)
+{
+  memset(acip->features, 0, sizeof(acip->features));
+  acip->signature = 0;
+  acip->xcr0 = 0;
+  acip->cpu = -1;
+  acip->cpuid_fd = -1;
+  acip->replay = NULL;
+  acip->n_replays = 0;
+  acip->replays = NULL;
+  acip->n_probes = -1;
+  acip->probes = NULL;
+  acip->heterogeneity = 0;
+  acip->max_cpuid = max_cpuid;
+  acip->n_cpuid = 0;
+}
+
+static int cpuid_probe_all(struct cpuinfo *cip);
+static x86_cpuinfo_t *cpuid_probe_lookup(struct cpuinfo *cip, int cpu);
+static int cpuid_compare(const x86_cpuinfo_t *ref, const x86_cpuinfo_t *acip, FILE *out);
+
+
+// Lookup a captured CPUID leaf (unavailable leaves read as zero)
+static const uint32_t *cpuid_lookup(const x86_cpuinfo_t *acip, uint32_t leaf, uint32_t subleaf)
+{
+  static const uint32_t null_regs[4] = { 0, };
+  int lo = 0, hi = acip->n_cpuid - 1;
+  while (lo <= hi) {
+	int i = (lo + hi) / 2;
+	const x86_cpuid_t *cp = &acip->cpuid[i];
+	if (cp->leaf == leaf && cp->subleaf == subleaf)
+	  return cp->regs;
+	if (cp->leaf < leaf || (cp->leaf == leaf && cp->subleaf < subleaf))
+	  lo = i + 1;
+	else
+	  hi = i - 1;
+  }
+  return null_regs;
+}
+
+// Get CPUID leaf values, from the table captured at cpuinfo_arch_new() time
+static void cpuid_count(struct cpuinfo *cip, uint32_t op, uint32_t subop, uint32_t *eax, uint32_t *ebx, uint32_t *ecx, uint32_t *edx)
+{
+  const uint32_t *regs = cpuid_lookup((x86_cpuinfo_t *)cip->opaque, op, subop);
+  if (eax) *eax = regs[R_EAX];
+  if (ebx) *ebx = regs[R_EBX];
+  if (ecx) *ecx = regs[R_ECX];
+  if (edx) *edx = regs[R_EDX];
+}
+
+static inline void cpuid(struct cpuinfo *cip, uint32_t op, uint32_t *eax, uint32_t *ebx, uint32_t *ecx, uint32_t *edx)
+{
+  cpuid_count(cip, op, 0, eax, ebx, ecx, edx);
+}
+
+// Record CPUID leaf values into the table
+static void cpuid_store(x86_cpuinfo_t *acip, uint32_t leaf, uint32_t subleaf, const uint32_t regs[4])
+{
+  if (acip->n_cpuid >= acip->max_cpuid) {
+	D(bug("cpuinfo_arch_new: no room for cpuid(%08x, %d)\n", leaf, subleaf));
+	return;
+  }
+  x86_cpuid_t *cp = &acip->cpuid[acip->n_cpuid++];
+  cp->leaf = leaf;
+  cp->subleaf = subleaf;
+  memcpy(cp->regs, regs, sizeof(cp->regs));
+}
+
+// Execute CPUID on the logical CPU the leaves are captured for
+static void cpuid_read(x86_cpuinfo_t *acip, uint32_t leaf, uint32_t subleaf, uint32_t regs[4])
+{
+  if (acip->replay) {
+	memcpy(regs, cpuid_lookup(acip->replay, leaf, subleaf), 4 * sizeof(regs[0]));
+	return;
+  }
+  if (acip->cpuid_fd >= 0) {
+	// the cpuid driver takes the leaf in the low 32 bits of the offset, the subleaf in the high ones
+	if (pread(acip->cpuid_fd, regs, 4 * sizeof(regs[0]), ((off_t)subleaf << 32) | leaf) != 4 * sizeof(regs[0]))
+	  memset(regs, 0, 4 * sizeof(regs[0]));
+	return;
+  }
+  cpuid_insn(leaf, subleaf, regs);
+}
+
+static void cpuid_capture(x86_cpuinfo_t *acip, uint32_t leaf, uint32_t subleaf, uint32_t regs[4])
+{
+  cpuid_read(acip, leaf, subleaf, regs);
+  cpuid_store(acip, leaf, subleaf, regs);
+}
+
+// Capture the specified leaf and all its valid subleaves
+static void cpuid_capture_leaf(x86_cpuinfo_t *acip, uint32_t leaf)
+{
+  uint32_t sub0[4], regs[4];
+  uint64_t mask;
+  uint32_t i;
+
+  cpuid_capture(acip, leaf, 0, sub0);
+  memcpy(regs, sub0, sizeof(regs));
+
+  switch (leaf) {
+  case 0x00000002:		// cache descriptors, from AL executions in a row (ECX is ignored)
+	for (i = 1; i < (sub0[R_EAX] & 0xff) && i < 16; i++)
+	  cpuid_capture(acip, leaf, i, regs);
+	break;
+  case 0x00000004:
+  case 0x8000001d:		// deterministic cache parameters, up to a null cache type
+	for (i = 1; i < 64 && (regs[R_EAX] & 0x1f) != 0; i++)
+	  cpuid_capture(acip, leaf, i, regs);
+	break;
+  case 0x0000000b:
+  case 0x0000001f:
+  case 0x80000026:		// extended topology, up to an invalid level type
+	for (i = 1; i < 16 && (regs[R_ECX] & 0xff00) != 0; i++)
+	  cpuid_capture(acip, leaf, i, regs);
+	break;
+  case 0x00000007:
+  case 0x00000014:
+  case 0x00000017:
+  case 0x00000018:
+  case 0x0000001d:
+  case 0x00000020:		// maximum subleaf in EAX
+	for (i = 1; i <= sub0[R_EAX] && i < 64; i++)
+	  cpuid_capture(acip, leaf, i, regs);
+	break;
+  case 0x0000000d:		// XSAVE state components, supported XCR0 | IA32_XSS bits
+	cpuid_capture(acip, leaf, 1, regs);
+	mask = (((uint64_t)sub0[R_EDX] << 32) | sub0[R_EAX]) | (((uint64_t)regs[R_EDX] << 32) | regs[R_ECX]);
+	for (i = 2; i < 64; i++) {
+	  if (mask & (1ULL << i))
+		cpuid_capture(acip, leaf, i, regs);
+	}
+	break;
+  case 0x0000000f:		// RDT monitoring, resource types in EDX
+  case 0x00000010:		// RDT allocation, resource types in EBX
+	mask = sub0[leaf == 0x0000000f ? R_EDX : R_EBX];
+	for (i = 1; i < 32; i++) {
+	  if (mask & (1ULL << i))
+		cpuid_capture(acip, leaf, i, regs);
+	}
+	break;
+  case 0x00000012:		// SGX, EPC sections up to an invalid section type
+	if ((cpuid_lookup(acip, 7, 0)[R_EBX] & (1U << 2)) == 0)
+	  break;
+	cpuid_capture(acip, leaf, 1, regs);
+	for (i = 2; i < 64; i++) {
+	  cpuid_capture(acip, leaf, i, regs);
+	  if ((regs[R_EAX] & 0xf) == 0)
+		break;
+	}
+	break;
+  }
+}
+
+// Capture all leaves from the specified CPUID range
+static void cpuid_capture_range(x86_cpuinfo_t *acip, uint32_t base)
+{
+  uint32_t regs[4], leaf, max_leaf;
+
+  cpuid_read(acip, base, 0, regs);
+  max_leaf = regs[R_EAX];
+  if (base == 0x40000000 && max_leaf == 0)	// some KVM versions
+	max_leaf = 0x40000001;
+  if (base != 0 && (max_leaf & 0xffff0000) != base)
+	return;
+  if (max_leaf - base > 0xff)
+	max_leaf = base + 0xff;
+
+  cpuid_store(acip, base, 0, regs);
+  for (leaf = base + 1; leaf <= max_leaf; leaf++)
+	cpuid_capture_leaf(acip, leaf);
+}
+
+// Capture standard, hypervisor, extended and vendor-specific CPUID leaves
+static void cpuid_capture_all(x86_cpuinfo_t *acip)
+{
+  static const uint32_t ranges[] = {
+	0x00000000,			// standard
+	0x40000000,			// hypervisor
+	0x80000000,			// extended
+	0x80860000,			// Transmeta
+	0xc0000000,			// Centaur
+  };
+  int i;
+  for (i = 0; i < sizeof(ranges) / sizeof(ranges[0]); i++) {
+	if (ranges[i] == 0x40000000 && (cpuid_lookup(acip, 1, 0)[R_ECX] & (1U << 31)) == 0)
+	  continue;
+	cpuid_capture_range(acip, ranges[i]);
+  }
+}
+
+// Capture all CPUID leaves into a new table, with room for all of them, from
+// the logical CPU, cpuid driver or recorded leaves of CTX (returns a table to
+// free, NULL if out of memory)
+static x86_cpuinfo_t *cpuid_capture_new(const x86_cpuinfo_t *ctx)
+{
+  int max_cpuid = X86_CPUID_MAX;
+  for (;;) {
+	x86_cpuinfo_t *acip = (x86_cpuinfo_t *)malloc(X86_CPUINFO_SIZE(max_cpuid));
+	if (acip == NULL)
+	  return NULL;
+	memcpy(acip, ctx, sizeof(*acip));
+	acip->max_cpuid = max_cpuid;
+	acip->n_cpuid = 0;
+	cpuid_capture_all(acip);
+	// a full table may have dropped leaves
+	if (acip->n_cpuid < max_cpuid || max_cpuid == X86_CPUID_LIMIT)
+	  return acip;
+	free(acip);
+	max_cpuid = 2 * max_cpuid < X86_CPUID_LIMIT ? 2 * max_cpuid : X86_CPUID_LIMIT;
+  }
+}
+
+static const char *cpuid_range_name(uint32_t base)
+{
+  switch (base) {
+  case 0x00000000: return "standard";
+  case 0x40000000: return "hypervisor";
+  case 0x80000000: return "extended";
+  case 0x80860000: return "Transmeta";
+  case 0xc0000000: return "Centaur";
+  }
+  return "unknown";
+}
+
+/* ========================================================================= */
+/* == CPUID Replay                                                        == */
+/* ========================================================================= */
+
+// Leaves can be read from a dump recorded by 'cpuid -r' or 'cpuinfo --raw',
+// named by $CPUINFO_CPUID_DUMP, instead of executing CPUID
+
+typedef struct {
+  int cpu;
+  x86_cpuid_t cpuid;
+} cpuid_record_t;
+
+static int cpuid_record_compare(const void *a, const void *b)
+{
+  const cpuid_record_t *ra = (const cpuid_record_t *)a, *rb = (const cpuid_record_t *)b;
+  if (ra->cpu != rb->cpu)
+	return ra->cpu < rb->cpu ? -1 : 1;
+  if (ra->cpuid.leaf != rb->cpuid.leaf)
+	return ra->cpuid.leaf < rb->cpuid.leaf ? -1 : 1;
+  if (ra->cpuid.subleaf != rb->cpuid.subleaf)
+	return ra->cpuid.subleaf < rb->cpuid.subleaf ? -1 : 1;
+  return 0;
+}
+
+// Load recorded leaves into per-CPU tables in the arena (returns the number of CPUs, -1 on error)
+static int cpuid_replay_load(struct cpuinfo *cip, x86_cpuinfo_t *acip, const char *filename)
+{
+  FILE *fp = fopen(filename, "r");
+  if (fp == NULL)
+	return -1;
+
+  char line[256];
+  int i, n_records = 0, max_records = 0, cpu = 0;
+  cpuid_record_t *records = NULL;
+  while (fgets(line, sizeof(line), fp)) {
+	cpuid_record_t r;
+	uint32_t *regs = r.cpuid.regs;
+	if (sscanf(line, "CPU %d:", &cpu) == 1)
+	  continue;
+	r.cpu = cpu;
+	if (sscanf(line, " 0x%x 0x%x: eax=0x%x ebx=0x%x ecx=0x%x edx=0x%x", &r.cpuid.leaf, &r.cpuid.subleaf,
+			   &regs[R_EAX], &regs[R_EBX], &regs[R_ECX], &regs[R_EDX]) != 6) {
+	  // older dumps without subleaves
+	  r.cpuid.subleaf = 0;
+	  if (sscanf(line, " 0x%x: eax=0x%x ebx=0x%x ecx=0x%x edx=0x%x", &r.cpuid.leaf,
+				 &regs[R_EAX], &regs[R_EBX], &regs[R_ECX], &regs[R_EDX]) != 5)
+		continue;
+	}
+	if (n_records == max_records) {
+	  cpuid_record_t *new_records = (cpuid_record_t *)realloc(records, (max_records += 256) * sizeof(*records));
+	  if (new_records == NULL) {
+		n_records = 0;
+		break;
+	  }
+	  records = new_records;
+	}
+	records[n_records++] = r;
+  }
+  fclose(fp);
+  qsort(records, n_records, sizeof(*records), cpuid_record_compare);
+
+  int n_cpus = 0;
+  for (i = 0; i < n_records; i++)
+	n_cpus += i == 0 || records[i].cpu != records[i - 1].cpu;
+  if (n_cpus == 0 || (acip->replays = (x86_cpuinfo_t **)cpuinfo_arena_alloc(cip, n_cpus * sizeof(acip->replays[0]))) == NULL) {
+	free(records);
+	return -1;
+  }
+  int first = 0;
+  for (i = 1; i <= n_records; i++) {
+	if (i < n_records && records[i].cpu == records[first].cpu)
+	  continue;
+	x86_cpuinfo_t *rp = (x86_cpuinfo_t *)cpuinfo_arena_alloc(cip, X86_CPUINFO_SIZE(i - first));
+	if (rp == NULL) {
+	  free(records);
+	  return -1;
+	}
+	x86_cpuinfo_init(rp, i - first);
+	rp->cpu = records[first].cpu;
+	for (; first < i; first++)
+	  cpuid_store(rp, records[first].cpuid.leaf, records[first].cpuid.subleaf, records[first].cpuid.regs);
+	acip->replays[acip->n_replays++] = rp;
+  }
+  free(records);
+  D(bug("cpuinfo_arch_new: replaying %d cpus from %s\n", acip->n_replays, filename));
+  return acip->n_replays;
+}
+
+// Get recorded leaves of the specified logical CPU (NULL if not recorded)
+static const x86_cpuinfo_t *cpuid_replay_lookup(const x86_cpuinfo_t *acip, int cpu)
+{
+  int i;
+  if (acip->n_replays == 1)		// e.g. 'cpuid -1 -r', assumed alike
+	return acip->replays[0];
+  for (i = 0; i < acip->n_replays; i++) {
+	if (acip->replays[i]->cpu == cpu)
+	  return acip->replays[i];
+  }
+  return NULL;
+}
+
+// Get XCR0 of a recorded logical CPU, assuming all supported state components are enabled
+static uint64_t cpuid_replay_xcr0(const x86_cpuinfo_t *rp)
+{
+  if ((cpuid_lookup(rp, 1, 0)[R_ECX] & (1U << 27)) == 0)	// OSXSAVE
+	return 0;
+  const uint32_t *regs = cpuid_lookup(rp, 0xd, 0);
+  return (((uint64_t)regs[R_EDX]) << 32) | regs[R_EAX];
+}
+
 // Returns a new cpuinfo descriptor
 int cpuinfo_arch_new(struct cpuinfo *cip)
 {
-  x86_cpuinfo_t *p = (x86_cpuinfo_t *)malloc(sizeof(*p));
+  x86_cpuinfo_t ctx, *acip = NULL;
+  x86_cpuinfo_init(&ctx, 0);
+  const char *dump = getenv("CPUINFO_CPUID_DUMP");
+  if (dump && dump[0] != '\0') {
+	if (cpuid_replay_load(cip, &ctx, dump) <= 0) {
+	  D(bug("cpuinfo_arch_new: could not load CPUID dump %s\n", dump));
+	  return -1;
+	}
+	ctx.replay = ctx.replays[0];
+	ctx.cpu = ctx.replay->cpu;
+	ctx.xcr0 = cpuid_replay_xcr0(ctx.replay);
+  }
+  if ((ctx.replay || cpuinfo_has_cpuid()) && (acip = cpuid_capture_new(&ctx)) == NULL)
+	return -1;
+
+  // keep only the captured leaves, in the arena
+  const int n_cpuid = acip ? acip->n_cpuid : 0;
+  x86_cpuinfo_t *p = (x86_cpuinfo_t *)cpuinfo_arena_alloc(cip, X86_CPUINFO_SIZE(n_cpuid));
+  if (p)
+	memcpy(p, acip ? acip : &ctx, X86_CPUINFO_SIZE(n_cpuid));
+  free(acip);
   if (p == NULL)
 	return -1;
-  memset(p->features, 0, sizeof(p->features));
+  p->max_cpuid = n_cpuid;
+  p->signature = cpuid_lookup(p, 1, 0)[R_EAX];
+  if (p->replay == NULL && (cpuid_lookup(p, 1, 0)[R_ECX] & (1U << 27)))	// OSXSAVE
+	p->xcr0 = xgetbv(0);
   cip->opaque = p;
   return 0;
 }
@@ -116,71 +530,150 @@ int cpuinfo_arch_new(struct cpuinfo *cip)
 // Release the cpuinfo descriptor and all allocated data
 void cpuinfo_arch_destroy(struct cpuinfo *cip)
 {
-  if (cip->opaque)
-	free(cip->opaque);
+}
+
+// Get processor signature: vendor and family/model/stepping
+uint64_t cpuinfo_arch_get_signature(void)
+{
+  uint32_t vendor[4], version[4];
+  const char *dump = getenv("CPUINFO_CPUID_DUMP");
+  if (dump && dump[0] != '\0') {
+	// recorded leaves, identified by the dump file
+	struct stat st;
+	if (stat(dump, &st) < 0)
+	  return 0;
+	return (((uint64_t)st.st_ino) << 32) ^ ((uint64_t)st.st_mtime << 16) ^ st.st_size;
+  }
+  if (!cpuinfo_has_cpuid())
+	return 0;
+  cpuid_insn(0, 0, vendor);
+  cpuid_insn(1, 0, version);
+  return ((uint64_t)(vendor[R_EBX] ^ vendor[R_ECX] ^ vendor[R_EDX]) << 32) | version[R_EAX];
+}
+
+// Serialize captured CPUID leaves, followed by the per-CPU captures
+int cpuinfo_arch_save(struct cpuinfo *cip, void *buf, int size)
+{
+  x86_cpuinfo_t *acip = (x86_cpuinfo_t *)cip->opaque;
+  int i, n = X86_CPUINFO_SIZE(acip->n_cpuid);
+  for (i = 0; i < acip->n_probes; i++)
+	n += X86_CPUINFO_SIZE(acip->probes[i]->n_cpuid);
+  if (buf && n <= size) {
+	char *p = (char *)buf;
+	memcpy(p, acip, X86_CPUINFO_SIZE(acip->n_cpuid));
+	p += X86_CPUINFO_SIZE(acip->n_cpuid);
+	for (i = 0; i < acip->n_probes; i++) {
+	  memcpy(p, acip->probes[i], X86_CPUINFO_SIZE(acip->probes[i]->n_cpuid));
+	  p += X86_CPUINFO_SIZE(acip->probes[i]->n_cpuid);
+	}
+  }
+  return n;
+}
+
+// Restore captured CPUID leaves, per-CPU captures are used in place
+int cpuinfo_arch_load(struct cpuinfo *cip, const void *data, int size)
+{
+  const char *p = (const char *)data, *end = p + size;
+  const x86_cpuinfo_t *src = (const x86_cpuinfo_t *)p;
+  if (size < (int)sizeof(*src) || src->n_cpuid < 0 || src->n_cpuid > X86_CPUID_LIMIT
+	  || (int)X86_CPUINFO_SIZE(src->n_cpuid) > size)
+	return -1;
+  x86_cpuinfo_t *acip = (x86_cpuinfo_t *)cpuinfo_arena_alloc(cip, X86_CPUINFO_SIZE(src->n_cpuid));
+  if (acip == NULL)
+	return -1;
+  memcpy(acip, src, X86_CPUINFO_SIZE(src->n_cpuid));
+  acip->max_cpuid = acip->n_cpuid;
+  acip->cpuid_fd = -1;
+  acip->replay = NULL;
+  acip->n_replays = 0;
+  acip->replays = NULL;
+  acip->probes = NULL;
+  p += X86_CPUINFO_SIZE(src->n_cpuid);
+
+  int i, n_probes = acip->n_probes;
+  acip->n_probes = n_probes < 0 ? -1 : 0;
+  if (n_probes > 0) {
+	if ((acip->probes = (x86_cpuinfo_t **)cpuinfo_arena_alloc(cip, n_probes * sizeof(acip->probes[0]))) == NULL)
+	  return -1;
+	for (i = 0; i < n_probes; i++) {
+	  const x86_cpuinfo_t *pp = (const x86_cpuinfo_t *)p;
+	  if (end - p < (long)sizeof(*pp) || pp->n_cpuid < 0 || pp->n_cpuid > X86_CPUID_LIMIT
+		  || end - p < (long)X86_CPUINFO_SIZE(pp->n_cpuid))
+		return -1;
+	  acip->probes[i] = (x86_cpuinfo_t *)pp;
+	  p += X86_CPUINFO_SIZE(pp->n_cpuid);
+	}
+	acip->n_probes = n_probes;
+  }
+  cip->opaque = acip;
+  return 0;
 }
 
 // Dump all useful information for debugging
 int cpuinfo_dump(struct cpuinfo *cip, FILE *out)
 {
-  uint32_t i, n;
-  uint32_t cpuid_level;
-  uint32_t eax, ebx, ecx, edx;
+  x86_cpuinfo_t *acip = (x86_cpuinfo_t *)cip->opaque;
+  int i;
 
   char v[13] = { 0, };
-  cpuid(0, &cpuid_level, (uint32_t *)&v[0], (uint32_t *)&v[8], (uint32_t *)&v[4]);
+  cpuid(cip, 0, NULL, (uint32_t *)&v[0], (uint32_t *)&v[8], (uint32_t *)&v[4]);
   fprintf(out, "Vendor ID string: '%s'\n", v);
   fprintf(out, "\n");
 
-  fprintf(out, "Maximum supported standard level: %08x\n", cpuid_level);
-  for (i = 0; i <= cpuid_level; i++) {
-	cpuid(i, &eax, &ebx, &ecx, &edx);
-	fprintf(out, "%08x: eax %08x, ebx %08x, ecx %08x, edx %08x\n", i, eax, ebx, ecx, edx);
-	if (i == 4) { // special case for cpuid(4)
-	  for (n = 0; /* nothing */; n++) {
-		ecx = n;
-		cpuid(4, &eax, &ebx, &ecx, &edx);
-		if ((eax & 0x1f) == 0)
-		  break;
-		fprintf(out, "--- %04d: eax %08x, ebx %08x, ecx %08x, edx %08x\n", n, eax, ebx, ecx, edx);
-	  }
+  for (i = 0; i < acip->n_cpuid; i++) {
+	const x86_cpuid_t *cp = &acip->cpuid[i];
+	if ((cp->leaf & 0xffff) == 0 && cp->subleaf == 0) {
+	  if (i > 0)
+		fprintf(out, "\n");
+	  fprintf(out, "Maximum supported %s level: %08x\n", cpuid_range_name(cp->leaf), cp->regs[R_EAX]);
 	}
+	if (cp->subleaf == 0)
+	  fprintf(out, "%08x: ", cp->leaf);
+	else
+	  fprintf(out, "--- %04d: ", cp->subleaf);
+	fprintf(out, "eax %08x, ebx %08x, ecx %08x, edx %08x\n",
+			cp->regs[R_EAX], cp->regs[R_EBX], cp->regs[R_ECX], cp->regs[R_EDX]);
   }
+  if (acip->n_cpuid > 0)
+	fprintf(out, "\n");
+
+  fprintf(out, "XCR0: %016llx\n", (unsigned long long)acip->xcr0);
   fprintf(out, "\n");
 
-  // Extended-level
-  cpuid(0x80000000, &cpuid_level, NULL, NULL, NULL);
-  if ((cpuid_level & 0xffff0000) == 0x80000000) {
-	fprintf(out, "Maximum supported extended level: %08x\n", cpuid_level);
-	for (i = 0x80000000; i <= cpuid_level; i++) {
-	  cpuid(i, &eax, &ebx, &ecx, &edx);
-	  fprintf(out, "%08x: eax %08x, ebx %08x, ecx %08x, edx %08x\n", i, eax, ebx, ecx, edx);
-	}
+  if (cpuid_probe_all(cip) > 0) {
+	fprintf(out, "Per-CPU CPUID leaves: %d logical CPUs probed, differences from cpu%d:\n",
+			acip->n_probes, acip->probes[0]->cpu);
+	for (i = 1; i < acip->n_probes; i++)
+	  cpuid_compare(acip->probes[0], acip->probes[i], out);
 	fprintf(out, "\n");
   }
 
-  // Transmeta level
-  cpuid(0x80860000, &cpuid_level, NULL, NULL, NULL);
-  if ((cpuid_level & 0xffff0000) == 0x80860000) {
-	fprintf(out, "Maximum supported Transmeta level: %08x\n", cpuid_level);
-	for (i = 0x80860000; i <= cpuid_level; i++) {
-	  cpuid(i, &eax, &ebx, &ecx, &edx);
-	  fprintf(out, "%08x: eax %08x, ebx %08x, ecx %08x, edx %08x\n", i, eax, ebx, ecx, edx);
-	}
-	fprintf(out, "\n");
-  }
+  return 0;
+}
 
-  // Centaur level
-  cpuid(0xc0000000, &cpuid_level, NULL, NULL, NULL);
-  if ((cpuid_level & 0xffff0000) == 0xc0000000) {
-	fprintf(out, "Maximum supported Centaur level: %08x\n", cpuid_level);
-	for (i = 0xc0000000; i <= cpuid_level; i++) {
-	  cpuid(i, &eax, &ebx, &ecx, &edx);
-	  fprintf(out, "%08x: eax %08x, ebx %08x, ecx %08x, edx %08x\n", i, eax, ebx, ecx, edx);
-	}
-	fprintf(out, "\n");
+// Dump raw CPUID leaves of one logical CPU
+static void cpuid_dump_raw(const x86_cpuinfo_t *acip, int cpu, FILE *out)
+{
+  int i;
+  fprintf(out, "CPU %d:\n", cpu);
+  for (i = 0; i < acip->n_cpuid; i++) {
+	const x86_cpuid_t *cp = &acip->cpuid[i];
+	fprintf(out, "   0x%08x 0x%02x: eax=0x%08x ebx=0x%08x ecx=0x%08x edx=0x%08x\n",
+			cp->leaf, cp->subleaf, cp->regs[R_EAX], cp->regs[R_EBX], cp->regs[R_ECX], cp->regs[R_EDX]);
   }
+}
 
+// Dump raw CPUID leaves of every logical CPU, in the format of 'cpuid -r'
+int cpuinfo_dump_raw(struct cpuinfo *cip, FILE *out)
+{
+  x86_cpuinfo_t *acip = (x86_cpuinfo_t *)cip->opaque;
+  int i, n_probes = cpuid_probe_all(cip);
+  if (acip->n_cpuid == 0)
+	return -1;
+  if (n_probes <= 0)
+	cpuid_dump_raw(acip, acip->cpu < 0 ? 0 : acip->cpu, out);
+  for (i = 0; i < n_probes; i++)
+	cpuid_dump_raw(acip->probes[i], acip->probes[i]->cpu, out);
   return 0;
 }
 
@@ -190,7 +683,7 @@ int cpuinfo_arch_get_vendor(struct cpuinfo *cip)
   int vendor = -1;
 
   char v[13] = { 0, };
-  cpuid(0, NULL, (uint32_t *)&v[0], (uint32_t *)&v[8], (uint32_t *)&v[4]);
+  cpuid(cip, 0, NULL, (uint32_t *)&v[0], (uint32_t *)&v[8], (uint32_t *)&v[4]);
 
   if (!strcmp(v, "GenuineIntel"))
 	vendor = CPUINFO_VENDOR_INTEL;
@@ -212,9 +705,9 @@ int cpuinfo_arch_get_vendor(struct cpuinfo *cip)
 	vendor = CPUINFO_VENDOR_NSC;
   else {
 	uint32_t cpuid_level;
-	cpuid(0x80000000, &cpuid_level, NULL, NULL, NULL);
+	cpuid(cip, 0x80000000, &cpuid_level, NULL, NULL, NULL);
 	if ((cpuid_level & 0xffff0000) == 0x80000000) {
-	  cpuid(0x80000000, NULL, (uint32_t *)&v[0], (uint32_t *)&v[8], (uint32_t *)&v[4]);
+	  cpuid(cip, 0x80000000, NULL, (uint32_t *)&v[0], (uint32_t *)&v[8], (uint32_t *)&v[4]);
 	  if (!strcmp(v, "TransmetaCPU"))
 		vendor = CPUINFO_VENDOR_TRANSMETA;
 	}
@@ -231,7 +724,7 @@ static char *get_model_amd_npt(struct cpuinfo *cip)
 {
   // assume we are a valid AMD NPT Family 0Fh processor
   uint32_t eax, ebx;
-  cpuid(0x80000001, &eax, &ebx, NULL, NULL);
+  cpuid(cip, 0x80000001, &eax, &ebx, NULL, NULL);
   uint32_t BrandId = ebx & 0xffff;
 
   uint32_t PwrLmt = ((BrandId >> 5) & 0xe) | ((BrandId >> 14) & 1);		// BrandId[8:6,14]
@@ -305,13 +798,9 @@ static char *get_model_amd_npt(struct cpuinfo *cip)
 	  case 'Z': model_number = 57 + NN; break;
 	  case 'Y': model_number = 29 + NN; break;
 	  }
-	  char *model = (char *)malloc(64);
-	  if (model) {
-		if (model_number)
-		  sprintf("%s", model, mp->name, model_number);
-		else
-		  sprintf("%s", model, mp->name);
-	  }
+	  char *model = (char *)cpuinfo_arena_alloc(cip, 64);
+	  if (model)
+		snprintf(model, 64, mp->name, model_number);
 	  return model;
 	}
   }
@@ -323,14 +812,14 @@ static char *get_model_amd_k8(struct cpuinfo *cip)
 {
   // assume we are a valid AMD K8 Family processor
   uint32_t eax, ebx;
-  cpuid(1, &eax, &ebx, NULL, NULL);
+  cpuid(cip, 1, &eax, &ebx, NULL, NULL);
   uint32_t eightbit_brand_id = ebx & 0xff;
 
   if ((eax & 0xfffcff00) == 0x00040f00)
 	return get_model_amd_npt(cip);
 
   uint32_t ecx, edx;
-  cpuid(0x80000001, NULL, &ebx, &ecx, &edx);
+  cpuid(cip, 0x80000001, NULL, &ebx, &ecx, &edx);
   uint32_t brand_id = ebx & 0xffff;
 
   int BrandTableIndex, NN;
@@ -433,13 +922,9 @@ static char *get_model_amd_k8(struct cpuinfo *cip)
   if (name == NULL)
 	return NULL;
 
-  char *model = (char *)malloc(64);
-  if (model) {
-	if (model_number)
-	  sprintf("%s", model, name, model_number);
-	else
-	  sprintf("%s", model, name);
-  }
+  char *model = (char *)cpuinfo_arena_alloc(cip, 64);
+  if (model)
+	snprintf(model, 64, name, model_number);
 
   return model;
 }
@@ -454,12 +939,12 @@ static char *get_model_amd(struct cpuinfo *cip)
 {
   // assume we are a valid AMD processor
   uint32_t cpuid_level;
-  cpuid(0, &cpuid_level, NULL, NULL, NULL);
+  cpuid(cip, 0, &cpuid_level, NULL, NULL, NULL);
   if (cpuid_level < 1)
 	return NULL;
 
   uint32_t eax;
-  cpuid(1, &eax, NULL, NULL, NULL);
+  cpuid(cip, 1, &eax, NULL, NULL, NULL);
   if ((eax & 0xfff0ff00) == 0x00000f00)
 	return get_model_amd_k8(cip);
 
@@ -488,10 +973,7 @@ static char *get_model_amd(struct cpuinfo *cip)
   }
 
   if (processor) {
-	char *model = (char *)malloc(strlen(processor) + 1);
-	if (model)
-	  strcpy(model, processor);
-	return model;
+	return cpuinfo_arena_strdup(cip, processor);
   }
 
   return NULL;
@@ -502,12 +984,12 @@ static char *get_model_intel(struct cpuinfo *cip)
 {
   // assume we are a valid Intel processor
   uint32_t cpuid_level;
-  cpuid(0, &cpuid_level, NULL, NULL, NULL);
+  cpuid(cip, 0, &cpuid_level, NULL, NULL, NULL);
   if (cpuid_level < 1)
 	return NULL;
 
   uint32_t eax, ebx;
-  cpuid(1, &eax, &ebx, NULL, NULL);
+  cpuid(cip, 1, &eax, &ebx, NULL, NULL);
   const char *processor = NULL;
 
   // check Brand ID
@@ -540,10 +1022,7 @@ static char *get_model_intel(struct cpuinfo *cip)
   }
 
   if (processor) {
-	char *model = (char *)malloc(strlen(processor) + 1);
-	if (model)
-	  strcpy(model, processor);
-	return model;
+	return cpuinfo_arena_strdup(cip, processor);
   }
 
   return NULL;
@@ -554,7 +1033,7 @@ static char *get_model_centaur(struct cpuinfo *cip)
 {
   // assume we are a valid Centaur processor
   uint32_t eax;
-  cpuid(1, &eax, NULL, NULL, NULL);
+  cpuid(cip, 1, &eax, NULL, NULL, NULL);
 
   const char *processor = NULL;
   switch ((eax >> 4) & 0xff) {
@@ -582,10 +1061,7 @@ static char *get_model_centaur(struct cpuinfo *cip)
   }
 
   if (processor) {
-	char *model = (char *)malloc(strlen(processor) + 1);
-	if (model)
-	  strcpy(model, processor);
-	return model;
+	return cpuinfo_arena_strdup(cip, processor);
   }
 
   return NULL;
@@ -634,9 +1110,9 @@ static int freq_string(const char *cp, const char *ep)
 	&& (cp[0] == 'M' || cp[0] == 'G') && cp[1] == 'H' && cp[2] == 'z';
 }
 
-static char *sanitize_brand_string(const char *str)
+static char *sanitize_brand_string(struct cpuinfo *cip, const char *str)
 {
-  char *model = (char *)malloc(64);
+  char *model = (char *)cpuinfo_arena_alloc(cip, 64);
   if (model == NULL)
 	return NULL;
   const char *cp;
@@ -658,10 +1134,8 @@ static char *sanitize_brand_string(const char *str)
 	cp = ep;
   } while (*cp != 0);
   *mp = '\0';
-  if (mp == model) {
-	free(model);
-	model = NULL;
-  }
+  if (mp == model)
+	return NULL;
   return model;
 }
 
@@ -685,14 +1159,14 @@ char *cpuinfo_arch_get_model(struct cpuinfo *cip)
 
   if (model == NULL) {
 	uint32_t cpuid_level;
-	cpuid(0x80000000, &cpuid_level, NULL, NULL, NULL);
+	cpuid(cip, 0x80000000, &cpuid_level, NULL, NULL, NULL);
 	if ((cpuid_level & 0xffff0000) == 0x80000000 && cpuid_level >= 0x80000004) {
 	  D(bug("cpuinfo_get_model: cpuid(0x80000002)\n"));
 	  union { uint32_t r[13]; char str[52]; } m = { { 0, } };
-	  cpuid(0x80000002, &m.r[0], &m.r[1], &m.r[2], &m.r[3]);
-	  cpuid(0x80000003, &m.r[4], &m.r[5], &m.r[6], &m.r[7]);
-	  cpuid(0x80000004, &m.r[8], &m.r[9], &m.r[10], &m.r[11]);
-	  model = sanitize_brand_string(m.str);
+	  cpuid(cip, 0x80000002, &m.r[0], &m.r[1], &m.r[2], &m.r[3]);
+	  cpuid(cip, 0x80000003, &m.r[4], &m.r[5], &m.r[6], &m.r[7]);
+	  cpuid(cip, 0x80000004, &m.r[8], &m.r[9], &m.r[10], &m.r[11]);
+	  model = sanitize_brand_string(cip, m.str);
 	}
   }
 
@@ -707,74 +1181,204 @@ static inline uint64_t get_ticks(void)
   return (((uint64_t)high) << 32) | low;
 }
 
-// Get current value of microsecond timer
-static inline uint64_t get_ticks_usec(void)
+// Get current value of nanosecond timer, not subject to NTP slewing
+static inline uint64_t get_ticks_nsec(void)
 {
-  struct timeval tv;
-  gettimeofday(&tv, NULL);
-  return ((uint64_t)tv.tv_sec * 1000000) + tv.tv_usec;
+  struct timespec ts;
+#ifdef CLOCK_MONOTONIC_RAW
+  clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+#else
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+#endif
+  return ((uint64_t)ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+// Get current value of nanosecond timer and the matching TSC value. The
+// pair least likely to have been split by an interrupt is retained
+static uint64_t get_ticks_nsec_tsc(uint64_t *ticks)
+{
+  uint64_t nsec = 0, delta = UINT64_MAX;
+  int i;
+  for (i = 0; i < 4; i++) {
+	uint64_t t0 = get_ticks();
+	uint64_t ns = get_ticks_nsec();
+	uint64_t t1 = get_ticks();
+	if (t1 - t0 < delta) {
+	  delta = t1 - t0;
+	  nsec = ns;
+	  *ticks = t0 + delta / 2;
+	}
+  }
+  return nsec;
 }
 
 // Try to get CPU frequency from other OS-dependent means
 static int os_get_frequency(void)
 {
-  int freq = 0;
+  int i, freq = 0;
+  cpuinfo_proc_t *pp = cpuinfo_proc_parse();
+  if (pp) {
+	for (i = 0; i < pp->n_cpus; i++) {
+	  if (pp->cpus[i].mhz > 0)
+		freq = (int)pp->cpus[i].mhz;
+	}
+	cpuinfo_proc_destroy(pp);
+  }
+  return freq;
+}
 
-#if defined __linux__
-  FILE *proc_file = fopen("/proc/cpuinfo", "r");
-  if (proc_file) {
-	char line[256];
-	while(fgets(line, sizeof(line), proc_file)) {
-	  // Read line
-	  int len = strlen(line);
-	  if (len == 0)
-		continue;
-	  line[len-1] = 0;
+// Get TSC frequency in MHz from CPUID leaves 0x15/0x16
+static int cpuid_get_frequency(struct cpuinfo *cip)
+{
+  uint32_t eax, ebx, ecx;
+  uint32_t base_mhz;
+
+  cpuid(cip, 0x16, &base_mhz, NULL, NULL, NULL);
+  base_mhz &= 0xffff;
+
+  // TSC / core crystal clock ratio
+  cpuid(cip, 0x15, &eax, &ebx, &ecx, NULL);
+  if (eax && ebx) {
+	uint64_t crystal_hz = ecx;
+	if (crystal_hz == 0) {
+	  // Crystal clock frequency not enumerated, use the model default
+	  uint32_t signature = ((x86_cpuinfo_t *)cip->opaque)->signature;
+	  if ((signature & 0xf00) == 0x600) {
+		switch (((signature >> 12) & 0xf0) | ((signature >> 4) & 0xf)) {
+		case 0x4e: case 0x5e:			// Skylake
+		case 0x8e: case 0x9e:			// Kaby Lake
+		  crystal_hz = 24000000;
+		  break;
+		case 0x5f:						// Denverton
+		  crystal_hz = 25000000;
+		  break;
+		case 0x5c:						// Apollo Lake
+		  crystal_hz = 19200000;
+		  break;
+		}
+	  }
+	  if (crystal_hz == 0 && base_mhz)
+		crystal_hz = (uint64_t)base_mhz * 1000000 * eax / ebx;
+	}
+	if (crystal_hz) {
+	  D(bug("cpuinfo_get_frequency: cpuid(0x15) crystal %llu Hz, ratio %u/%u\n",
+			(unsigned long long)crystal_hz, ebx, eax));
+	  return (crystal_hz * ebx / eax + 500000) / 1000000;
+	}
+  }
+
+  // Processor base frequency
+  if (base_mhz)
+	D(bug("cpuinfo_get_frequency: cpuid(0x16) base %u MHz\n", base_mhz));
+  return base_mhz;
+}
+
+// Get TSC frequency in MHz from the hypervisor timing leaf
+static int hypervisor_get_frequency(struct cpuinfo *cip)
+{
+  uint32_t ecx, eax;
+  cpuid(cip, 1, NULL, NULL, &ecx, NULL);
+  if ((ecx & (1U << 31)) == 0)
+	return 0;
+  cpuid(cip, 0x40000000, &eax, NULL, NULL, NULL);
+  if (eax < 0x40000010)
+	return 0;
+  cpuid(cip, 0x40000010, &eax, NULL, NULL, NULL);
+  D(bug("cpuinfo_get_frequency: cpuid(0x40000010) TSC %u kHz\n", eax));
+  return (eax + 500) / 1000;
+}
+
+#define TSC_CALIBRATION_SAMPLES	9		// Number of measurements
+#define TSC_CALIBRATION_NSEC	50000	// Duration of each measurement
+#define TSC_CALIBRATION_PPM		2000	// Max deviation from the median
+
+// Measure TSC frequency in MHz against the monotonic clock. Samples far
+// from the median (preemption, migration) are dropped and the ratio of
+// retained samples is the CONFIDENCE, in percent
+static int tsc_calibrate_frequency(int *confidence)
+{
+  double samples[TSC_CALIBRATION_SAMPLES];
+  int i, j;
+
+  for (i = 0; i < TSC_CALIBRATION_SAMPLES; i++) {
+	uint64_t ticks_start, ticks_stop;
+	uint64_t start = get_ticks_nsec_tsc(&ticks_start);
+	uint64_t stop;
+	do {
+	  stop = get_ticks_nsec_tsc(&ticks_stop);
+	} while (stop - start < TSC_CALIBRATION_NSEC);
+	double f = (double)(ticks_stop - ticks_start) * 1000.0 / (double)(stop - start);
+	for (j = i; j > 0 && samples[j - 1] > f; j--)
+	  samples[j] = samples[j - 1];
+	samples[j] = f;
+  }
 
-	  // Parse line
-	  float f;
-	  if (sscanf(line, "cpu MHz : %f", &f) == 1)
-		freq = (int)f;
+  double median = samples[TSC_CALIBRATION_SAMPLES / 2];
+  double sum = 0.0;
+  int n_samples = 0;
+  for (i = 0; i < TSC_CALIBRATION_SAMPLES; i++) {
+	if (samples[i] >= median * (1.0 - TSC_CALIBRATION_PPM / 1e6) &&
+		samples[i] <= median * (1.0 + TSC_CALIBRATION_PPM / 1e6)) {
+	  sum += samples[i];
+	  n_samples++;
 	}
-	fclose(proc_file);
   }
-#endif
+  *confidence = (100 * n_samples) / TSC_CALIBRATION_SAMPLES;
+  D(bug("cpuinfo_get_frequency: calibrated %.2f MHz, %d/%d samples retained\n",
+		sum / n_samples, n_samples, TSC_CALIBRATION_SAMPLES));
 
-  return freq;
+  uint64_t freq = (uint64_t)(sum / n_samples + 0.5);
+  return ((freq % 10) >= 5) ? (((freq / 10) * 10) + 10) : ((freq / 10) * 10);
 }
 
 // Get processor frequency in MHz
 int cpuinfo_arch_get_frequency(struct cpuinfo *cip)
 {
-  uint64_t start, stop;
-  uint64_t ticks_start, ticks_stop;
+  int freq;
 
   // Make sure TSC is available
   uint32_t edx;
-  cpuid(1, NULL, NULL, NULL, &edx);
-  if ((edx & (1 << 4)) == 0)
-	return os_get_frequency();
+  cpuid(cip, 1, NULL, NULL, NULL, &edx);
+  if ((edx & (1 << 4)) == 0) {
+	if ((freq = os_get_frequency()) > 0) {
+	  // current frequency, subject to power management
+	  cip->frequency_source = CPUINFO_FREQUENCY_SOURCE_OS;
+	  cip->frequency_confidence = 50;
+	}
+	return freq;
+  }
 
-  start = get_ticks_usec();
-  ticks_start = get_ticks();
-  while ((get_ticks_usec() - start) < 50000) {
-	static unsigned long next = 1;
-	next = next * 1103515245 + 12345;
+  if ((freq = cpuid_get_frequency(cip)) > 0) {
+	cip->frequency_source = CPUINFO_FREQUENCY_SOURCE_CPUID;
+	cip->frequency_confidence = 100;
+	return freq;
   }
-  ticks_stop = get_ticks();
-  stop = get_ticks_usec();
 
-  uint64_t freq = (ticks_stop - ticks_start) / (stop - start);
-  return ((freq % 10) >= 5) ? (((freq / 10) * 10) + 10) : ((freq / 10) * 10);
+  if ((freq = hypervisor_get_frequency(cip)) > 0) {
+	cip->frequency_source = CPUINFO_FREQUENCY_SOURCE_HYPERVISOR;
+	cip->frequency_confidence = 100;
+	return freq;
+  }
+
+  // TSC rate follows the current frequency without invariant TSC
+  uint32_t edx_ext;
+  cpuid(cip, 0x80000007, NULL, NULL, NULL, &edx_ext);
+  int confidence;
+  freq = tsc_calibrate_frequency(&confidence);
+  if ((edx_ext & (1 << 8)) == 0)
+	confidence /= 2;
+  cip->frequency_source = CPUINFO_FREQUENCY_SOURCE_CALIBRATION;
+  cip->frequency_confidence = confidence;
+  return freq;
 }
 
 // Get processor socket ID
-static int cpuinfo_get_socket_amd(void)
+static int cpuinfo_get_socket_amd(struct cpuinfo *cip)
 {
   int socket = -1;
 
   uint32_t eax;
-  cpuid(1, &eax, NULL, NULL, NULL);
+  cpuid(cip, 1, &eax, NULL, NULL, NULL);
   if ((eax & 0xfff0ff00) == 0x00000f00) {	// AMD K8
 	// Factored from AMD Revision Guide, rev 3.59
 	switch ((eax >> 4) & 0xf) {
@@ -793,7 +1397,7 @@ static int cpuinfo_get_socket_amd(void)
 	}
 	if ((eax & 0xfffcff00) == 0x00040f00) {
 	  // AMD NPT Family 0Fh (Orleans/Manila)
-	  cpuid(0x80000001, &eax, NULL, NULL, NULL);
+	  cpuid(cip, 0x80000001, &eax, NULL, NULL, NULL);
 	  switch ((eax >> 4) & 3) {
 	  case 0:
 		socket = CPUINFO_SOCKET_S1;
@@ -816,33 +1420,86 @@ int cpuinfo_arch_get_socket(struct cpuinfo *cip)
   int socket = -1;
 
   if (cpuinfo_get_vendor(cip) == CPUINFO_VENDOR_AMD)
-	socket = cpuinfo_get_socket_amd();
+	socket = cpuinfo_get_socket_amd(cip);
 
   return socket;
 }
 
+// Get number of logical processors per core and per package from the
+// extended topology leaf 0x1f or 0xb
+static int cpuid_get_topology(struct cpuinfo *cip, int *n_smt, int *n_package)
+{
+  static const uint32_t leaves[] = { 0x1f, 0xb };
+  uint32_t max_level;
+  int n;
+  cpuid(cip, 0, &max_level, NULL, NULL, NULL);
+  for (n = 0; n < sizeof(leaves) / sizeof(leaves[0]); n++) {
+	uint32_t leaf = leaves[n];
+	if (max_level < leaf)
+	  continue;
+	int i, smt = 0, package = 0;
+	for (i = 0; i < 16; i++) {
+	  uint32_t ebx, ecx;
+	  cpuid_count(cip, leaf, i, NULL, &ebx, &ecx, NULL);
+	  int type = (ecx >> 8) & 0xff;
+	  if (type == 0)
+		break;
+	  if (type == 1)							// SMT level
+		smt = ebx & 0xffff;
+	  package = ebx & 0xffff;					// the last level spans the package
+	}
+	if (smt > 0 && package >= smt) {
+	  D(bug("cpuinfo_get_topology: cpuid(0x%x) %d threads per core, %d per package\n", leaf, smt, package));
+	  *n_smt = smt;
+	  *n_package = package;
+	  return 0;
+	}
+  }
+  return -1;
+}
+
+// Get number of threads per AMD core (0 if unknown)
+static int cpuid_get_threads_amd(struct cpuinfo *cip)
+{
+  uint32_t eax, ebx, ecx;
+  cpuid(cip, 0x80000000, &eax, NULL, NULL, NULL);
+  if (eax >= 0x8000001e) {
+	cpuid(cip, 0x80000001, NULL, NULL, &ecx, NULL);
+	if (ecx & (1 << 22)) {						// TOPOEXT
+	  cpuid(cip, 0x8000001e, NULL, &ebx, NULL, NULL);
+	  return 1 + ((ebx >> 8) & 0xff);
+	}
+  }
+  return 0;
+}
+
 // Get number of cores per CPU package
 int cpuinfo_arch_get_cores(struct cpuinfo *cip)
 {
   uint32_t eax, ecx;
+  int n_smt, n_package;
 
-  /* Intel Dual Core characterisation */
-  if (cpuinfo_get_vendor(cip) == CPUINFO_VENDOR_INTEL) {
-	cpuid(0, &eax, NULL, NULL, NULL);
+  if (cpuid_get_topology(cip, &n_smt, &n_package) == 0)
+	return n_package / n_smt;
+
+  switch (cpuinfo_get_vendor(cip)) {
+  case CPUINFO_VENDOR_INTEL:
+	/* Intel Dual Core characterisation */
+	cpuid(cip, 0, &eax, NULL, NULL, NULL);
 	if (eax >= 4) {
-	  ecx = 0;
-	  cpuid(4, &eax, NULL, &ecx, NULL);
+	  cpuid(cip, 4, &eax, NULL, NULL, NULL);
 	  return 1 + ((eax >> 26) & 0x3f);
 	}
-  }
-
-  /* AMD Dual Core characterisation */
-  else if (cpuinfo_get_vendor(cip) == CPUINFO_VENDOR_AMD) {
-	cpuid(0x80000000, &eax, NULL, NULL, NULL);
+	break;
+  case CPUINFO_VENDOR_AMD:
+	/* AMD Dual Core characterisation, NC counts threads on SMT parts */
+	cpuid(cip, 0x80000000, &eax, NULL, NULL, NULL);
 	if (eax >= 0x80000008) {
-	  cpuid(0x80000008, NULL, NULL, &ecx, NULL);
-	  return 1 + (ecx & 0xff);
+	  cpuid(cip, 0x80000008, NULL, NULL, &ecx, NULL);
+	  int n_threads = cpuid_get_threads_amd(cip);
+	  return (1 + (ecx & 0xff)) / (n_threads > 0 ? n_threads : 1);
 	}
+	break;
   }
 
   return 1;
@@ -852,21 +1509,29 @@ int cpuinfo_arch_get_cores(struct cpuinfo *cip)
 int cpuinfo_arch_get_threads(struct cpuinfo *cip)
 {
   uint32_t eax, ebx, edx;
+  int n_smt, n_package;
+
+  if (cpuid_get_topology(cip, &n_smt, &n_package) == 0)
+	return n_smt;
 
   switch (cpuinfo_get_vendor(cip)) {
   case CPUINFO_VENDOR_INTEL:
 	/* Check for Hyper Threading Technology activated */
 	/* See "Intel Processor Identification and the CPUID Instruction" (3.3 Feature Flags) */
-	cpuid(0, &eax, NULL, NULL, NULL);
+	cpuid(cip, 0, &eax, NULL, NULL, NULL);
 	if (eax >= 1) {
-	  cpuid(1, NULL, &ebx, NULL, &edx);
+	  cpuid(cip, 1, NULL, &ebx, NULL, &edx);
 	  if (edx & (1 << 28)) { /* HTT flag */
-		int n_cores = cpuinfo_get_cores(cip);
-		assert(n_cores > 0);
-		return ((ebx >> 16) & 0xff) / n_cores;
+		int n_cores = cpuinfo_arch_get_cores(cip);
+		int n_threads = ((ebx >> 16) & 0xff) / n_cores;
+		return n_threads > 0 ? n_threads : 1;
 	  }
 	}
 	break;
+  case CPUINFO_VENDOR_AMD:
+	if ((n_smt = cpuid_get_threads_amd(cip)) > 0)
+	  return n_smt;
+	break;
   }
 
   return 1;
@@ -953,9 +1618,7 @@ enum {
 
 static int has_cache_info_errata_amd(struct cpuinfo *cip, int errata)
 {
-  // XXX store F/M/S fields in x86_cpuinfo_t
-  uint32_t eax;
-  cpuid(1, &eax, NULL, NULL, NULL);
+  uint32_t eax = ((x86_cpuinfo_t *)cip->opaque)->signature;
   if ((eax & 0xfff) == 0x630) {
 	if (errata == CACHE_INFO_ERRATA_AMD_DURON) {
 	  D(bug("cpuinfo_get_cache: errata for AMD K7 processors with CPUID=630h (Duron)\n"));
@@ -967,9 +1630,7 @@ static int has_cache_info_errata_amd(struct cpuinfo *cip, int errata)
 
 static int has_cache_info_errata_centaur(struct cpuinfo *cip, int errata)
 {
-  // XXX store F/M/S fields in x86_cpuinfo_t
-  uint32_t eax;
-  cpuid(1, &eax, NULL, NULL, NULL);
+  uint32_t eax = ((x86_cpuinfo_t *)cip->opaque)->signature;
   switch ((eax >> 4) & 0xff) {
   case 0x67:
   case 0x68:
@@ -1001,48 +1662,105 @@ static inline int has_cache_info_errata(struct cpuinfo *cip, int errata)
   return 0;
 }
 
-cpuinfo_list_t cpuinfo_arch_get_caches(struct cpuinfo *cip)
+// Decode deterministic cache parameters from leaf 4 (Intel) or 0x8000001d (AMD)
+static int cpuid_get_caches(struct cpuinfo *cip, uint32_t leaf, cpuinfo_cache_list_t *caches_list)
+{
+  cpuinfo_cache_geometry_t cache_desc;
+  uint32_t eax, ebx, ecx, edx;
+  int count;
+
+  // leaves captured on the calling CPU, see cpuinfo_get_heterogeneity() for the others
+  D(bug("cpuinfo_get_cache: cpuid(0x%x)\n", leaf));
+  for (count = 0; count < 64; count++) {
+	cpuid_count(cip, leaf, count, &eax, &ebx, &ecx, &edx);
+	int cache_type = eax & 0x1f;
+	if (cache_type == 0)
+	  break;
+	switch (cache_type) {
+	case 1: cache_type = CPUINFO_CACHE_TYPE_DATA; break;
+	case 2: cache_type = CPUINFO_CACHE_TYPE_CODE; break;
+	case 3: cache_type = CPUINFO_CACHE_TYPE_UNIFIED; break;
+	default: cache_type = CPUINFO_CACHE_TYPE_UNKNOWN; break;
+	}
+	cache_desc.type = cache_type;
+	cache_desc.level = (eax >> 5) & 7;
+	uint32_t W = 1 + ((ebx >> 22) & 0x3f);	// ways of associativity
+	uint32_t P = 1 + ((ebx >> 12) & 0x1f);	// physical line partition
+	uint32_t L = 1 + (ebx & 0xfff);			// system coherency line size
+	uint32_t S = 1 + ecx;						// number of sets
+	cache_desc.size = (L * W * P * S) / 1024;
+	cache_desc.line_size = L;
+	cache_desc.ways = W;
+	cache_desc.sets = S;
+	cache_desc.partitions = P;
+	cache_desc.flags = 0;
+	if (eax & (1 << 8))
+	  cache_desc.flags |= CPUINFO_CACHE_FLAG_SELF_INITIALIZING;
+	if (eax & (1 << 9))
+	  cache_desc.flags |= CPUINFO_CACHE_FLAG_FULLY_ASSOCIATIVE;
+	if (edx & (1 << 1))
+	  cache_desc.flags |= CPUINFO_CACHE_FLAG_INCLUSIVE;
+	else
+	  cache_desc.flags |= CPUINFO_CACHE_FLAG_NON_INCLUSIVE;
+	if (edx & (1 << 2))
+	  cache_desc.flags |= CPUINFO_CACHE_FLAG_COMPLEX_INDEXING;
+	cpuinfo_caches_list_insert(&cache_desc);
+  }
+  return caches_list->count;
+}
+
+// Set geometry from AMD leaves 0x80000005/0x80000006 (WAYS < 0 if fully associative)
+static void set_cache_geometry_amd(cpuinfo_cache_geometry_t *cdp, int line_size, int ways)
+{
+  cdp->line_size = line_size;
+  cdp->ways = ways > 0 ? ways : 0;
+  cdp->sets = 0;
+  cdp->partitions = 0;
+  cdp->flags = 0;
+  if (ways < 0) {
+	cdp->ways = line_size ? (cdp->size * 1024) / line_size : 0;
+	cdp->sets = 1;
+	cdp->flags |= CPUINFO_CACHE_FLAG_FULLY_ASSOCIATIVE;
+  }
+  else if (line_size && ways)
+	cdp->sets = (cdp->size * 1024) / (line_size * ways);
+}
+
+// Decode AMD L2 associativity field from leaf 0x80000006 (-1 if fully associative)
+static int amd_l2_ways(uint32_t assoc)
+{
+  static const int ways[16] = { 0, 1, 2, 0, 4, 0, 8, 0, 16, 0, 32, 48, 64, 96, 128, -1 };
+  return ways[assoc & 0xf];
+}
+
+// Get cache information
+int cpuinfo_arch_get_caches(struct cpuinfo *cip, cpuinfo_cache_list_t *caches_list)
 {
   uint32_t cpuid_level;
-  cpuid(0, &cpuid_level, NULL, NULL, NULL);
+  cpuid(cip, 0, &cpuid_level, NULL, NULL, NULL);
 
-  cpuinfo_list_t caches_list = NULL;
-  cpuinfo_cache_descriptor_t cache_desc;
+  cpuinfo_cache_geometry_t cache_desc;
+  memset(&cache_desc, 0, sizeof(cache_desc));
 
   if (cpuid_level >= 4) {
-	// XXX not MP safe cpuid()
-	D(bug("cpuinfo_get_cache: cpuid(4)\n"));
-	uint32_t eax, ebx, ecx, edx;
-	int count = 0;
-	int saw_L1I_cache = 0;
-	for (;;) {
-	  ecx = count;
-	  cpuid(4, &eax, &ebx, &ecx, &edx);
-	  int cache_type = eax & 0x1f;
-	  if (cache_type == 0)
-		break;
-	  switch (cache_type) {
-	  case 1: cache_type = CPUINFO_CACHE_TYPE_DATA; break;
-	  case 2: cache_type = CPUINFO_CACHE_TYPE_CODE; break;
-	  case 3: cache_type = CPUINFO_CACHE_TYPE_UNIFIED; break;
-	  default: cache_type = CPUINFO_CACHE_TYPE_UNKNOWN; break;
-	  }
-	  cache_desc.type = cache_type;
-	  cache_desc.level = (eax >> 5) & 7;
-	  uint32_t W = 1 + ((ebx >> 22) & 0x3f);	// ways of associativity
-	  uint32_t P = 1 + ((ebx >> 12) & 0x1f);	// physical line partition
-	  uint32_t L = 1 + (ebx & 0xfff);			// system coherency line size
-	  uint32_t S = 1 + ecx;						// number of sets
-	  cache_desc.size = (L * W * P * S) / 1024;
-	  cpuinfo_caches_list_insert(&cache_desc);
-	  ++count;
-	  if (cache_desc.type == CPUINFO_CACHE_TYPE_CODE && cache_desc.level == 1)
-		saw_L1I_cache = 1;
-	}
+	int i;
+	cpuid_get_caches(cip, 4, caches_list);
 	/* XXX find a better way to detect 'Instruction Trace Cache'-based processors? */
-	if (saw_L1I_cache)
-	  return caches_list;
-	cpuinfo_list_clear(&caches_list);
+	for (i = 0; i < caches_list->count; i++) {
+	  const cpuinfo_cache_geometry_t *cdp = &caches_list->caches[i];
+	  if (cdp->type == CPUINFO_CACHE_TYPE_CODE && cdp->level == 1)
+		return caches_list->count;
+	}
+	caches_list->count = 0;
+  }
+
+  uint32_t cpuid_ext_level, ext_features;
+  cpuid(cip, 0x80000000, &cpuid_ext_level, NULL, NULL, NULL);
+  cpuid(cip, 0x80000001, NULL, NULL, &ext_features, NULL);
+  if ((cpuid_ext_level & 0xffff0000) == 0x80000000 && cpuid_ext_level >= 0x8000001d
+	  && (ext_features & (1 << 22))) {		// TOPOEXT
+	if (cpuid_get_caches(cip, 0x8000001d, caches_list) > 0)
+	  return caches_list->count;
   }
 
   if (cpuid_level >= 2) {
@@ -1050,10 +1768,11 @@ cpuinfo_list_t cpuinfo_arch_get_caches(struct cpuinfo *cip)
 	uint32_t regs[4];
 	uint8_t *dp = (uint8_t *)regs;
 	D(bug("cpuinfo_get_cache: cpuid(2)\n"));
-	cpuid(2, &regs[0], NULL, NULL, NULL);
+	cpuid(cip, 2, &regs[0], NULL, NULL, NULL);
 	n = regs[0] & 0xff;						// number of times to iterate
 	for (i = 0; i < n; i++) {
-	  cpuid(2, &regs[0], &regs[1], &regs[2], &regs[3]);
+	  // each execution was captured as a subleaf
+	  cpuid_count(cip, 2, i, &regs[0], &regs[1], &regs[2], &regs[3]);
 	  for (j = 0; j < 4; j++) {
 		if (regs[j] & 0x80000000)
 		  regs[j] = 0;
@@ -1072,30 +1791,35 @@ cpuinfo_list_t cpuinfo_arch_get_caches(struct cpuinfo *cip)
 		}
 	  }
 	}
-	return caches_list;
+	// AMD processors leave leaf 2 empty
+	if (caches_list->count > 0)
+	  return caches_list->count;
   }
 
-  cpuid(0x80000000, &cpuid_level, NULL, NULL, NULL);
+  cpuid(cip, 0x80000000, &cpuid_level, NULL, NULL, NULL);
   if ((cpuid_level & 0xffff0000) == 0x80000000 && cpuid_level >= 0x80000005) {
 	uint32_t ecx, edx;
 	D(bug("cpuinfo_get_cache: cpuid(0x80000005)\n"));
-	cpuid(0x80000005, NULL, NULL, &ecx, &edx);
+	cpuid(cip, 0x80000005, NULL, NULL, &ecx, &edx);
 	cache_desc.level = 1;
 	cache_desc.type = CPUINFO_CACHE_TYPE_CODE;
 	cache_desc.size = (edx >> 24) & 0xff;
+	set_cache_geometry_amd(&cache_desc, edx & 0xff, ((edx >> 16) & 0xff) == 0xff ? -1 : (edx >> 16) & 0xff);
 	cpuinfo_caches_list_insert(&cache_desc);
 	cache_desc.level = 1;
 	cache_desc.type = CPUINFO_CACHE_TYPE_DATA;
 	cache_desc.size = (ecx >> 24) & 0xff;
+	set_cache_geometry_amd(&cache_desc, ecx & 0xff, ((ecx >> 16) & 0xff) == 0xff ? -1 : (ecx >> 16) & 0xff);
 	cpuinfo_caches_list_insert(&cache_desc);
 	if (cpuid_level >= 0x80000006) {
 	  D(bug("cpuinfo_get_cache: cpuid(0x80000006)\n"));
-	  cpuid(0x80000006, NULL, NULL, &ecx, NULL);
+	  cpuid(cip, 0x80000006, NULL, NULL, &ecx, NULL);
 	  if (has_cache_info_errata(cip, CACHE_INFO_ERRATA_VIA_C3_1)) {
 		if (((ecx >> 16) & 0xffff) != 0) {
 		  cache_desc.level = 2;
 		  cache_desc.type = CPUINFO_CACHE_TYPE_UNIFIED;
 		  cache_desc.size = (ecx >> 24) & 0xff;
+		  set_cache_geometry_amd(&cache_desc, 0, 0);
 		  cpuinfo_caches_list_insert(&cache_desc);
 		}
 	  }
@@ -1110,14 +1834,14 @@ cpuinfo_list_t cpuinfo_arch_get_caches(struct cpuinfo *cip)
 			if (cache_desc.size == 65)
 			  cache_desc.size = 64;
 		  }
+		  set_cache_geometry_amd(&cache_desc, ecx & 0xff, amd_l2_ways(ecx >> 12));
 		  cpuinfo_caches_list_insert(&cache_desc);
 		}
 	  }
 	}
-	return caches_list;
   }
 
-  return NULL;
+  return caches_list->count;
 }
 
 static int bsf_clobbers_eflags(void)
@@ -1148,6 +1872,122 @@ static int bsf_clobbers_eflags(void)
   return mismatch;
 }
 
+// Get package, die and core IDs of a logical CPU from its x2APIC ID, split by
+// the shift widths of the extended topology leaf 0x1f, or else 0xb (returns
+// -1 if neither is available)
+static int cpuid_get_apic_topology(const x86_cpuinfo_t *p, cpuinfo_topology_cpu_t *cp)
+{
+  const uint32_t max_level = cpuid_lookup(p, 0, 0)[R_EAX];
+  uint32_t leaf = 0x1f;
+  if (max_level < leaf || cpuid_lookup(p, leaf, 0)[R_EBX] == 0)
+	leaf = 0xb;
+  if (max_level < leaf || cpuid_lookup(p, leaf, 0)[R_EBX] == 0)
+	return -1;
+
+  // each level gives the shift from the x2APIC ID to the ID of the next one
+  const uint32_t apic_id = cpuid_lookup(p, leaf, 0)[R_EDX];
+  int i, shift = 0, smt_shift = 0, die_low_shift = -1, die_shift = -1;
+  for (i = 0; i < 16; i++) {
+	const uint32_t *regs = cpuid_lookup(p, leaf, i);
+	const int level_type = (regs[R_ECX] >> 8) & 0xff;
+	if (level_type == 0)
+	  break;
+	if (level_type == 1)				// SMT
+	  smt_shift = regs[R_EAX] & 0x1f;
+	else if (level_type == 5) {			// die
+	  die_low_shift = shift;
+	  die_shift = regs[R_EAX] & 0x1f;
+	}
+	shift = regs[R_EAX] & 0x1f;
+  }
+  if (shift == 0)
+	return -1;
+
+  // core IDs are unique within the package, as in sysfs
+  const uint32_t package_mask = (1U << shift) - 1;
+  cp->package = apic_id >> shift;
+  cp->die = die_shift > die_low_shift ? (apic_id & ((1U << die_shift) - 1)) >> die_low_shift : 0;
+  cp->core = (apic_id & package_mask) >> smt_shift;
+  return 0;
+}
+
+// Get topology of each logical CPU from the CPUID leaves captured on it
+int cpuinfo_arch_get_cpu_topology(struct cpuinfo *cip, cpuinfo_topology_cpu_t *cpus, int max_cpus)
+{
+  x86_cpuinfo_t *acip = (x86_cpuinfo_t *)cip->opaque;
+  int i, n = cpuid_probe_all(cip);
+  if (n > max_cpus)
+	return 0;
+  for (i = 0; i < n; i++) {
+	memset(&cpus[i], 0, sizeof(cpus[i]));
+	cpus[i].cpu = acip->probes[i]->cpu;
+	if (cpuid_get_apic_topology(acip->probes[i], &cpus[i]) < 0)
+	  return 0;
+	D(bug("cpuinfo_get_topology: cpu%d x2apic package %d, die %d, core %d\n",
+		  cpus[i].cpu, cpus[i].package, cpus[i].die, cpus[i].core));
+  }
+  return n;
+}
+
+// Get core class of a logical CPU, from the native model ID of hybrid parts
+int cpuinfo_arch_get_core_class(struct cpuinfo *cip, int cpu)
+{
+  uint32_t max_level, edx;
+  cpuid(cip, 0, &max_level, NULL, NULL, NULL);
+  cpuid_count(cip, 7, 0, NULL, NULL, NULL, &edx);
+  if ((edx & (1 << 15)) == 0)				// HYBRID
+	return CPUINFO_CORE_CLASS_PERFORMANCE;
+  if (max_level < 0x1a)
+	return CPUINFO_CORE_CLASS_UNKNOWN;
+
+  // leaf 0x1a describes the CPU executing it
+  x86_cpuinfo_t *p = cpuid_probe_lookup(cip, cpu);
+  if (p == NULL)
+	return CPUINFO_CORE_CLASS_UNKNOWN;
+  const uint32_t *regs = cpuid_lookup(p, 0x1a, 0);
+
+  D(bug("cpuinfo_get_core_class: cpu%d cpuid(0x1a) => %08x\n", cpu, regs[R_EAX]));
+  switch (regs[R_EAX] >> 24) {
+  case 0x20: return CPUINFO_CORE_CLASS_EFFICIENCY;	// Intel Atom
+  case 0x40: return CPUINFO_CORE_CLASS_PERFORMANCE;	// Intel Core
+  }
+  return CPUINFO_CORE_CLASS_UNKNOWN;
+}
+
+// Get number of logical CPUs sharing a cache, from the deterministic
+// cache parameters leaf 4 (Intel) or 0x8000001d (AMD)
+int cpuinfo_arch_get_cache_sharing(struct cpuinfo *cip, int level, int type)
+{
+  uint32_t leaf = 4, max_level, eax, ecx;
+  int i;
+
+  // AMD processors leave leaf 4 empty
+  cpuid(cip, 0, &max_level, NULL, NULL, NULL);
+  cpuid_count(cip, 4, 0, &eax, NULL, NULL, NULL);
+  if (max_level < 4 || (eax & 0x1f) == 0) {
+	cpuid(cip, 0x80000000, &max_level, NULL, NULL, NULL);
+	cpuid(cip, 0x80000001, NULL, NULL, &ecx, NULL);
+	if (max_level < 0x8000001d || (ecx & (1 << 22)) == 0)	// TOPOEXT
+	  return -1;
+	leaf = 0x8000001d;
+  }
+
+  for (i = 0; i < 64; i++) {
+	cpuid_count(cip, leaf, i, &eax, NULL, NULL, NULL);
+	int cache_type;
+	switch (eax & 0x1f) {
+	case 0: return -1;
+	case 1: cache_type = CPUINFO_CACHE_TYPE_DATA; break;
+	case 2: cache_type = CPUINFO_CACHE_TYPE_CODE; break;
+	case 3: cache_type = CPUINFO_CACHE_TYPE_UNIFIED; break;
+	default: cache_type = CPUINFO_CACHE_TYPE_UNKNOWN; break;
+	}
+	if (cache_type == type && ((eax >> 5) & 7) == level)
+	  return 1 + ((eax >> 14) & 0xfff);
+  }
+  return -1;
+}
+
 // Returns features table
 uint32_t *cpuinfo_arch_feature_table(struct cpuinfo *cip, int feature)
 {
@@ -1160,6 +2000,433 @@ uint32_t *cpuinfo_arch_feature_table(struct cpuinfo *cip, int feature)
   return NULL;
 }
 
+// CPUID registers holding feature bits
+enum {
+#define CPUINFO_X86_CPUID_REG(SLOT, LEAF, SUBLEAF, REG) X86_SLOT_##SLOT,
+#define CPUINFO_X86_FEATURE(ID, NAME, DETAIL, SLOT, BIT, VENDORS, XSTATE)
+#define CPUINFO_X86_FEATURE_ALT(ID, SLOT, BIT, VENDORS, XSTATE)
+#include "cpuinfo-x86-features.h"
+#undef CPUINFO_X86_FEATURE_ALT
+#undef CPUINFO_X86_FEATURE
+#undef CPUINFO_X86_CPUID_REG
+  X86_SLOT_NONE,
+  X86_SLOT_COUNT
+};
+
+static const struct {
+  uint32_t leaf;
+  uint32_t subleaf;
+  int reg;
+}
+x86_feature_slots[X86_SLOT_NONE] = {
+#define CPUINFO_X86_CPUID_REG(SLOT, LEAF, SUBLEAF, REG) { LEAF, SUBLEAF, R_##REG },
+#define CPUINFO_X86_FEATURE(ID, NAME, DETAIL, SLOT, BIT, VENDORS, XSTATE)
+#define CPUINFO_X86_FEATURE_ALT(ID, SLOT, BIT, VENDORS, XSTATE)
+#include "cpuinfo-x86-features.h"
+#undef CPUINFO_X86_FEATURE_ALT
+#undef CPUINFO_X86_FEATURE
+#undef CPUINFO_X86_CPUID_REG
+};
+
+// Vendors masks (0 if the feature bit is not vendor specific)
+#define X86_VENDOR_ANY			0
+#define X86_VENDOR_(NAME)		(1U << CPUINFO_VENDOR_##NAME)
+#define X86_VENDOR_AMD			X86_VENDOR_(AMD)
+#define X86_VENDOR_CENTAUR		X86_VENDOR_(CENTAUR)
+#define X86_VENDOR_CYRIX		X86_VENDOR_(CYRIX)
+#define X86_VENDOR_INTEL		X86_VENDOR_(INTEL)
+#define X86_VENDOR_NEXTGEN		X86_VENDOR_(NEXTGEN)
+#define X86_VENDOR_NSC			X86_VENDOR_(NSC)
+#define X86_VENDOR_RISE			X86_VENDOR_(RISE)
+#define X86_VENDOR_SIS			X86_VENDOR_(SIS)
+#define X86_VENDOR_TRANSMETA	X86_VENDOR_(TRANSMETA)
+#define X86_VENDOR_UMC			X86_VENDOR_(UMC)
+
+// XCR0 state components the OS must enable
+#define X86_XSTATE_NONE			0
+#define X86_XSTATE_YMM			(XCR0_SSE | XCR0_AVX)
+#define X86_XSTATE_ZMM			(XCR0_SSE | XCR0_AVX | XCR0_OPMASK | XCR0_ZMM_HI256 | XCR0_HI16_ZMM)
+#define X86_XSTATE_TILE			(XCR0_TILECFG | XCR0_TILEDATA)
+
+typedef struct {
+#ifndef HAVE_DESIGNATED_INITIALIZERS
+  uint8_t slot;
+  uint8_t bit;
+#endif
+  uint8_t feature;
+  uint32_t vendors;
+  uint32_t xstate;
+} x86_feature_spec_t;
+
+#ifdef HAVE_DESIGNATED_INITIALIZERS
+// Features of the NONE slot are left out: it is never scanned, and they
+// would all initialize [X86_SLOT_NONE][0] again. X86_SLOT_SKIP_(SLOT) is 1
+// for NONE, which X86_SLOT_SKIP_NONE turns into a second argument
+#define X86_SLOT_SKIP_NONE				~, 1
+#define X86_SLOT_SKIP_(...)				X86_SLOT_SKIP__(__VA_ARGS__, 0, ~)
+#define X86_SLOT_SKIP__(X, SKIP, ...)	SKIP
+#define X86_SLOT_IF_(SKIP)				X86_SLOT_IF__(SKIP)
+#define X86_SLOT_IF__(SKIP)				X86_SLOT_IF_##SKIP
+#define X86_SLOT_IF_0(...)				__VA_ARGS__,
+#define X86_SLOT_IF_1(...)
+#define DEFINE_(ID, SLOT, BIT, VENDORS, XSTATE) \
+		X86_SLOT_IF_(X86_SLOT_SKIP_(X86_SLOT_SKIP_##SLOT))( \
+		[X86_SLOT_##SLOT][BIT] = { CPUINFO_FEATURE_X86_##ID & CPUINFO_FEATURE_MASK, X86_VENDOR_##VENDORS, X86_XSTATE_##XSTATE })
+// Features reported by each CPUID register slot, indexed by bit number
+static const x86_feature_spec_t x86_feature_specs[X86_SLOT_NONE][32] = {
+#else
+#define DEFINE_(ID, SLOT, BIT, VENDORS, XSTATE) \
+		{ X86_SLOT_##SLOT, BIT, CPUINFO_FEATURE_X86_##ID & CPUINFO_FEATURE_MASK, X86_VENDOR_##VENDORS, X86_XSTATE_##XSTATE },
+static const x86_feature_spec_t x86_feature_specs[] = {
+#endif
+#define CPUINFO_X86_CPUID_REG(SLOT, LEAF, SUBLEAF, REG)
+#define CPUINFO_X86_FEATURE(ID, NAME, DETAIL, SLOT, BIT, VENDORS, XSTATE) \
+  DEFINE_(ID, SLOT, BIT, VENDORS, XSTATE)
+#define CPUINFO_X86_FEATURE_ALT(ID, SLOT, BIT, VENDORS, XSTATE) \
+  DEFINE_(ID, SLOT, BIT, VENDORS, XSTATE)
+#include "cpuinfo-x86-features.h"
+#undef CPUINFO_X86_FEATURE_ALT
+#undef CPUINFO_X86_FEATURE
+#undef CPUINFO_X86_CPUID_REG
+};
+
+#undef DEFINE_
+#ifdef HAVE_DESIGNATED_INITIALIZERS
+#undef X86_SLOT_IF_1
+#undef X86_SLOT_IF_0
+#undef X86_SLOT_IF__
+#undef X86_SLOT_IF_
+#undef X86_SLOT_SKIP__
+#undef X86_SLOT_SKIP_
+#undef X86_SLOT_SKIP_NONE
+#endif
+
+// Decode CPUID feature bits into the x86 features table
+static void cpuid_decode_features(x86_cpuinfo_t *acip, int cpu_vendor)
+{
+  uint32_t vendor = 1U << cpu_vendor;
+  uint32_t xcr0 = acip->xcr0;
+  uint32_t regs[X86_SLOT_COUNT];
+  int i;
+
+  for (i = 0; i < X86_SLOT_NONE; i++)
+	regs[i] = cpuid_lookup(acip, x86_feature_slots[i].leaf, x86_feature_slots[i].subleaf)[x86_feature_slots[i].reg];
+  regs[X86_SLOT_NONE] = 0;
+
+#ifdef HAVE_DESIGNATED_INITIALIZERS
+  // scatter set bits of each register through its features map
+  for (i = 0; i < X86_SLOT_NONE; i++) {
+	uint32_t bits = regs[i];
+	while (bits) {
+	  const x86_feature_spec_t *fsp = &x86_feature_specs[i][__builtin_ctz(bits)];
+	  bits &= bits - 1;
+	  if (fsp->feature && (fsp->vendors == 0 || (fsp->vendors & vendor))
+		  && (xcr0 & fsp->xstate) == fsp->xstate)
+		acip->features[fsp->feature / 32] |= 1U << (fsp->feature % 32);
+	}
+  }
+#else
+  for (i = 0; i < sizeof(x86_feature_specs) / sizeof(x86_feature_specs[0]); i++) {
+	const x86_feature_spec_t *fsp = &x86_feature_specs[i];
+	if ((regs[fsp->slot] & (1U << fsp->bit)) && (fsp->vendors == 0 || (fsp->vendors & vendor))
+		&& (xcr0 & fsp->xstate) == fsp->xstate)
+	  acip->features[fsp->feature / 32] |= 1U << (fsp->feature % 32);
+  }
+#endif
+}
+
+static void x86_decode_features(struct cpuinfo *cip)
+{
+  cpuid_decode_features((x86_cpuinfo_t *)cip->opaque, cpuinfo_get_vendor(cip));
+}
+
+/* ========================================================================= */
+/* == Per-CPU CPUID Probing                                               == */
+/* ========================================================================= */
+
+// Clear the fields identifying the logical CPU that executed CPUID
+static void cpuid_mask_cpu_ids(uint32_t leaf, uint32_t regs[4])
+{
+  switch (leaf) {
+  case 0x00000001:
+	regs[R_EBX] &= 0x00ffffff;		// initial APIC ID
+	break;
+  case 0x0000000b:
+  case 0x0000001f:
+	regs[R_EDX] = 0;				// x2APIC ID
+	break;
+  case 0x8000001e:
+	regs[R_EAX] = 0;				// extended APIC ID
+	regs[R_EBX] &= 0xffffff00;		// core ID
+	regs[R_ECX] &= 0xffffff00;		// node ID
+	break;
+  }
+}
+
+// Get the differences a CPUID leaf reveals between logical CPUs
+static int cpuid_leaf_heterogeneity(uint32_t leaf)
+{
+  switch (leaf) {
+  case 0x00000001:
+	return CPUINFO_HETEROGENEOUS_MODEL;
+  case 0x00000002:
+  case 0x00000004:
+  case 0x80000005:
+  case 0x80000006:
+  case 0x8000001d:
+	return CPUINFO_HETEROGENEOUS_CACHES;
+  case 0x0000001a:
+	return CPUINFO_HETEROGENEOUS_CORE_CLASSES;
+  }
+  return 0;
+}
+
+// Compare per-CPU captures, optionally printing the leaves that differ
+static int cpuid_compare(const x86_cpuinfo_t *ref, const x86_cpuinfo_t *acip, FILE *out)
+{
+  static const x86_cpuid_t null_cpuid = { 0, };
+  int i = 0, j = 0, heterogeneity = 0;
+
+  if (memcmp(ref->features, acip->features, sizeof(acip->features)) != 0)
+	heterogeneity |= CPUINFO_HETEROGENEOUS_FEATURES;
+
+  // walk both tables, a leaf missing on one side reads as zero
+  while (i < ref->n_cpuid || j < acip->n_cpuid) {
+	const x86_cpuid_t *rp = i < ref->n_cpuid ? &ref->cpuid[i] : NULL;
+	const x86_cpuid_t *cp = j < acip->n_cpuid ? &acip->cpuid[j] : NULL;
+	if (rp && cp && (rp->leaf > cp->leaf || (rp->leaf == cp->leaf && rp->subleaf > cp->subleaf)))
+	  rp = NULL;
+	else if (rp && cp && (rp->leaf < cp->leaf || (rp->leaf == cp->leaf && rp->subleaf < cp->subleaf)))
+	  cp = NULL;
+	if (rp)
+	  i++;
+	if (cp)
+	  j++;
+
+	const x86_cpuid_t *p = cp ? cp : rp;
+	uint32_t ref_regs[4], regs[4];
+	memcpy(ref_regs, (rp ? rp : &null_cpuid)->regs, sizeof(ref_regs));
+	memcpy(regs, (cp ? cp : &null_cpuid)->regs, sizeof(regs));
+	cpuid_mask_cpu_ids(p->leaf, ref_regs);
+	cpuid_mask_cpu_ids(p->leaf, regs);
+	if (memcmp(ref_regs, regs, sizeof(regs)) == 0)
+	  continue;
+
+	heterogeneity |= cpuid_leaf_heterogeneity(p->leaf);
+	if (out)
+	  fprintf(out, "cpu%d: %08x/%04d: eax %08x, ebx %08x, ecx %08x, edx %08x\n",
+			  acip->cpu, p->leaf, p->subleaf, regs[R_EAX], regs[R_EBX], regs[R_ECX], regs[R_EDX]);
+  }
+  return heterogeneity;
+}
+
+#if defined __linux__
+typedef struct {
+  pthread_t thread;
+  int started;
+  int cpu;										// Logical CPU to probe
+  int vendor;
+  uint64_t xcr0;								// XCR0 of the calling thread, for the cpuid driver
+  const x86_cpuinfo_t *replay;					// Recorded leaves, if replaying a dump
+  x86_cpuinfo_t *acip;							// Captured leaves, NULL if the CPU could not be probed
+} cpuid_probe_t;
+
+// Capture all CPUID leaves of one logical CPU, either through the cpuid driver or pinned to it
+static void *cpuid_probe_thread(void *arg)
+{
+  cpuid_probe_t *pp = (cpuid_probe_t *)arg;
+  x86_cpuinfo_t ctx;
+  x86_cpuinfo_init(&ctx, 0);
+  ctx.cpu = pp->cpu;
+  ctx.xcr0 = pp->xcr0;
+
+  char path[32];
+  sprintf(path, "/dev/cpu/%d/cpuid", pp->cpu);
+  if (pp->replay) {
+	ctx.replay = pp->replay;
+	ctx.xcr0 = cpuid_replay_xcr0(pp->replay);
+  }
+  else if (sizeof(off_t) >= 8)
+	ctx.cpuid_fd = open(path, O_RDONLY);
+  if (ctx.cpuid_fd < 0 && ctx.replay == NULL) {
+	if (sched_getcpu() != pp->cpu) {
+	  D(bug("cpuinfo_probe: could not run on cpu%d\n", pp->cpu));
+	  return NULL;
+	}
+	uint32_t regs[4];
+	cpuid_insn(1, 0, regs);
+	if (regs[R_ECX] & (1U << 27))			// OSXSAVE
+	  ctx.xcr0 = xgetbv(0);
+  }
+
+  x86_cpuinfo_t *acip = cpuid_capture_new(&ctx);
+  if (ctx.cpuid_fd >= 0)
+	close(ctx.cpuid_fd);
+  if (acip == NULL)
+	return NULL;
+  acip->cpuid_fd = -1;
+  acip->signature = cpuid_lookup(acip, 1, 0)[R_EAX];
+  cpuid_decode_features(acip, pp->vendor);
+  pp->acip = acip;
+  return NULL;
+}
+#endif
+
+// Capture CPUID leaves on every online logical CPU (returns the number of CPUs probed)
+static int cpuid_probe_all(struct cpuinfo *cip)
+{
+  x86_cpuinfo_t *acip = (x86_cpuinfo_t *)cip->opaque;
+  if (acip->n_probes >= 0)
+	return acip->n_probes;
+  acip->n_probes = 0;
+
+#if defined __linux__
+  // sized for all CPUs of a descriptor, beyond the 1024 of a cpu_set_t
+  cpu_set_t *set = CPU_ALLOC(CPUINFO_CPUSET_SIZE);
+  const size_t set_size = CPU_ALLOC_SIZE(CPUINFO_CPUSET_SIZE);
+
+  // online CPUs, or else the ones we may run on: the topology may be built
+  // from the captures, so it cannot tell which CPUs to probe
+  cpuinfo_cpuset_t online;
+  int i, n_cpus = 0;
+  if (cpuinfo_sysfs_read_cpu_list("devices/system/cpu/online", &online) < 0 || cpuinfo_cpuset_count(&online) == 0) {
+	memset(&online, 0, sizeof(online));
+	for (i = 0; i < acip->n_replays; i++) {
+	  const int cpu = acip->replays[i]->cpu;
+	  if (cpu >= 0 && cpu < CPUINFO_CPUSET_SIZE)
+		online.bits[cpu / 32] |= 1U << (cpu % 32);
+	}
+	if (acip->n_replays == 0 && set && sched_getaffinity(0, set_size, set) == 0) {
+	  for (i = 0; i < CPUINFO_CPUSET_SIZE; i++) {
+		if (CPU_ISSET_S(i, set_size, set))
+		  online.bits[i / 32] |= 1U << (i % 32);
+	  }
+	}
+  }
+  int *cpus = (int *)malloc(CPUINFO_CPUSET_SIZE * sizeof(*cpus));
+  for (i = 0; cpus && i < CPUINFO_CPUSET_SIZE; i++) {
+	if (cpuinfo_cpuset_isset(&online, i))
+	  cpus[n_cpus++] = i;
+  }
+
+  cpuid_probe_t *probes = NULL;
+  if (acip->n_cpuid == 0 || n_cpus == 0 || (probes = (cpuid_probe_t *)calloc(n_cpus, sizeof(*probes))) == NULL ||
+	  (acip->probes = (x86_cpuinfo_t **)cpuinfo_arena_alloc(cip, n_cpus * sizeof(acip->probes[0]))) == NULL) {
+	free(probes);
+	free(cpus);
+	if (set)
+	  CPU_FREE(set);
+	return 0;
+  }
+
+  // one short-lived thread per logical CPU, all running at once
+  pthread_attr_t attr, pinned_attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setstacksize(&attr, PTHREAD_STACK_MIN > 65536 ? PTHREAD_STACK_MIN : 65536);
+  pthread_attr_init(&pinned_attr);
+  pthread_attr_setstacksize(&pinned_attr, PTHREAD_STACK_MIN > 65536 ? PTHREAD_STACK_MIN : 65536);
+  int vendor = cpuinfo_get_vendor(cip);
+  for (i = 0; i < n_cpus; i++) {
+	cpuid_probe_t *pp = &probes[i];
+	pp->cpu = cpus[i];
+	pp->vendor = vendor;
+	pp->xcr0 = acip->xcr0;
+	if (acip->n_replays > 0) {
+	  // recorded CPUs, which need not exist here
+	  if ((pp->replay = cpuid_replay_lookup(acip, pp->cpu)) == NULL)
+		continue;
+	}
+	else if (set) {
+	  CPU_ZERO_S(set_size, set);
+	  CPU_SET_S(pp->cpu, set_size, set);
+	  if (pthread_attr_setaffinity_np(&pinned_attr, set_size, set) == 0)
+		pp->started = pthread_create(&pp->thread, &pinned_attr, cpuid_probe_thread, pp) == 0;
+	}
+	// CPUs outside of our affinity mask are still reachable through the cpuid driver
+	if (!pp->started)
+	  pp->started = pthread_create(&pp->thread, &attr, cpuid_probe_thread, pp) == 0;
+  }
+  if (set)
+	CPU_FREE(set);
+  free(cpus);
+  pthread_attr_destroy(&pinned_attr);
+  pthread_attr_destroy(&attr);
+
+  for (i = 0; i < n_cpus; i++) {
+	cpuid_probe_t *pp = &probes[i];
+	if (pp->started)
+	  pthread_join(pp->thread, NULL);
+	if (pp->acip) {
+	  // keep only the captured leaves, in the arena
+	  x86_cpuinfo_t *p = (x86_cpuinfo_t *)cpuinfo_arena_alloc(cip, X86_CPUINFO_SIZE(pp->acip->n_cpuid));
+	  if (p) {
+		memcpy(p, pp->acip, X86_CPUINFO_SIZE(pp->acip->n_cpuid));
+		p->max_cpuid = p->n_cpuid;
+		if (acip->n_probes > 0)
+		  acip->heterogeneity |= cpuid_compare(acip->probes[0], p, NULL);
+		acip->probes[acip->n_probes++] = p;
+	  }
+	  free(pp->acip);
+	}
+  }
+  free(probes);
+  D(bug("cpuinfo_probe: %d of %d cpus probed, heterogeneity %x\n", acip->n_probes, n_cpus, acip->heterogeneity));
+#endif
+  return acip->n_probes;
+}
+
+// Get CPUID leaves captured on the specified logical CPU (NULL if not probed)
+static x86_cpuinfo_t *cpuid_probe_lookup(struct cpuinfo *cip, int cpu)
+{
+  x86_cpuinfo_t *acip = (x86_cpuinfo_t *)cip->opaque;
+  int lo = 0, hi = cpuid_probe_all(cip) - 1;
+  while (lo <= hi) {
+	int i = (lo + hi) / 2;
+	if (acip->probes[i]->cpu == cpu)
+	  return acip->probes[i];
+	if (acip->probes[i]->cpu < cpu)
+	  lo = i + 1;
+	else
+	  hi = i - 1;
+  }
+  return NULL;
+}
+
+// Get differences between logical CPUs (-1 if unknown)
+int cpuinfo_arch_get_heterogeneity(struct cpuinfo *cip)
+{
+  if (cpuid_probe_all(cip) <= 0)
+	return -1;
+  return ((x86_cpuinfo_t *)cip->opaque)->heterogeneity;
+}
+
+// Get logical CPUs supporting the specified feature (-1 if unknown)
+int cpuinfo_arch_get_feature_cpus(struct cpuinfo *cip, int feature, cpuinfo_cpuset_t *set)
+{
+  x86_cpuinfo_t *acip = (x86_cpuinfo_t *)cip->opaque;
+  if ((feature & CPUINFO_FEATURE_ARCH) != CPUINFO_FEATURE_X86 || cpuid_probe_all(cip) <= 0)
+	return -1;
+
+  int i, n = 0, bit = feature & CPUINFO_FEATURE_MASK, decoded = 0;
+  for (i = 0; i < acip->n_probes; i++)
+	decoded |= acip->probes[i]->features[bit / 32] & (1U << (bit % 32));
+  if (!decoded)	// not a CPUID feature, or no CPU has it
+	return -1;
+
+  const cpuinfo_topology_t *tp = cpuinfo_get_topology(cip);
+  memset(set, 0, sizeof(*set));
+  for (i = 0; i < tp->n_cpus; i++) {
+	int cpu = tp->cpus[i].cpu;
+	const x86_cpuinfo_t *p = cpuid_probe_lookup(cip, cpu);
+	if (p ? (p->features[bit / 32] & (1U << (bit % 32))) != 0 : cpuinfo_has_feature(cip, feature)) {
+	  if (cpu >= 0 && cpu < CPUINFO_CPUSET_SIZE)
+		set->bits[cpu / 32] |= 1U << (cpu % 32);
+	  n++;
+	}
+  }
+  return n;
+}
+
 #define feature_get_bit(NAME) cpuinfo_feature_get_bit(cip, CPUINFO_FEATURE_X86_##NAME)
 #define feature_set_bit(NAME) cpuinfo_feature_set_bit(cip, CPUINFO_FEATURE_X86_##NAME)
 
@@ -1168,198 +2435,14 @@ int cpuinfo_arch_has_feature(struct cpuinfo *cip, unsigned long feature)
 {
   if (!cpuinfo_feature_get_bit(cip, CPUINFO_FEATURE_X86)) {
 #if defined __linux__
-	static struct utsname un;
+	struct utsname un;
 #endif
 	cpuinfo_feature_set_bit(cip, CPUINFO_FEATURE_X86);
 	if(cpuinfo_has_ac())
 	    feature_set_bit(AC);
-	if(cpuinfo_has_cpuid()) {
+	if(((x86_cpuinfo_t *)cip->opaque)->n_cpuid > 0) {
 	    feature_set_bit(CPUID);
-    
-	    uint32_t eax = 0, ecx = 0, edx = 0;
-	    cpuid(1, NULL, NULL, &ecx, &edx);
-	    if (edx & (1 << 0))
-		feature_set_bit(FPU);
-	    if (edx & (1 << 1))
-		feature_set_bit(VME);
-	    if (edx & (1 << 2))
-		feature_set_bit(DE);
-	    if (edx & (1 << 3))
-		feature_set_bit(PSE);
-	    if (edx & (1 << 4))
-		feature_set_bit(TSC);
-	    if (edx & (1 << 5))
-		feature_set_bit(MSR);
-	    if (edx & (1 << 6))
-		feature_set_bit(PAE);
-	    if (edx & (1 << 7))
-		feature_set_bit(MCE);
-	    if (edx & (1 << 8))
-		feature_set_bit(CX8);
-	    if (edx & (1 << 9))
-		feature_set_bit(APIC);
-	    if (edx & (1 << 11))
-		feature_set_bit(SEP);
-	    if (edx & (1 << 12))
-		feature_set_bit(MTRR);
-	    if (edx & (1 << 13))
-		feature_set_bit(PGE);
-	    if (edx & (1 << 14))
-		feature_set_bit(MCA);
-	    if (edx & (1 << 15))
-		feature_set_bit(CMOV);
-	    if (edx & (1 << 16))
-		feature_set_bit(PAT);
-	    if (edx & (1 << 17))
-		feature_set_bit(PSE_36);
-	    if (edx & (1 << 18))
-		feature_set_bit(PSN);
-	    if (edx & (1 << 19))
-		feature_set_bit(CLFLUSH);
-	    if (edx & (1 << 21))
-		feature_set_bit(DS);
-	    if (edx & (1 << 22))
-		feature_set_bit(ACPI);
-	    if (edx & (1 << 23))
-		feature_set_bit(MMX);
-	    if (edx & (1 << 24))
-		feature_set_bit(FXSR);
-	    if (edx & (1 << 25))
-		feature_set_bit(SSE);
-	    if (edx & (1 << 26))
-		feature_set_bit(SSE2);
-	    if (edx & (1 << 27))
-		feature_set_bit(SS);
-	    if (edx & (1 << 28))
-		feature_set_bit(HTT);	
-	    if (edx & (1 << 29))
-		feature_set_bit(TM);
-	    if (edx & (1 << 30))
-		feature_set_bit(IA64);
-	    if (edx & (1 << 31))
-		feature_set_bit(PBE);	
-
-	    if (ecx & (1 << 0))
-		feature_set_bit(SSE3);
-	    if (ecx & (1 << 1))
-		feature_set_bit(PCLMULQDQ);
-	    if (ecx & (1 << 2))
-		feature_set_bit(DTES64);
-	    if (ecx & (1 << 3))
-		feature_set_bit(MONITOR);
-	    if (ecx & (1 << 4))
-		feature_set_bit(DS_CPL);
-	    if (ecx & (1 << 5))
-		feature_set_bit(VMX);
-	    if (ecx & (1 << 6))
-		feature_set_bit(SMX);
-	    if (ecx & (1 << 7))
-		feature_set_bit(EIST);
-	    if (ecx & (1 << 8))
-		feature_set_bit(TM2);
-	    if (ecx & (1 << 9))
-		feature_set_bit(SSSE3);
-	    if (ecx & (1 << 10))
-		feature_set_bit(CNXT_ID);
-	    if (ecx & (1 << 12))
-		feature_set_bit(FMA);
-	    if (ecx & (1 << 13))
-		feature_set_bit(CX16);
-	    if (ecx & (1 << 14))
-		feature_set_bit(XTPR);
-	    if (ecx & (1 << 15))
-		feature_set_bit(PDCM);
-	    if (ecx & (1 << 17))
-		feature_set_bit(PCID);
-	    if (ecx & (1 << 18))
-		feature_set_bit(DCA);
-	    if (ecx & (1 << 19))
-		feature_set_bit(SSE4_1);
-	    if (ecx & (1 << 20))
-		feature_set_bit(SSE4_2);
-	    if (ecx & (1 << 21))
-		feature_set_bit(X2APIC);
-	    if (ecx & (1 << 22))
-		feature_set_bit(MOVBE);
-	    if (ecx & (1 << 23))
-		feature_set_bit(POPCNT);
-	    if (ecx & (1 << 24))
-		feature_set_bit(TSC_DEADLINE);
-	    if (ecx & (1 << 25))
-		feature_set_bit(AES);
-	    if (ecx & (1 << 26))
-		feature_set_bit(XSAVE);
-	    if (ecx & (1 << 27))
-		feature_set_bit(OSXSAVE);
-	    if (ecx & (1 << 28))
-		feature_set_bit(AVX);
-	    if (ecx & (1 << 29))
-		feature_set_bit(F16C);
-	    if (ecx & (1 << 31))
-		feature_set_bit(HYPERVISOR);
-
-	    cpuid(0x80000000, &eax, NULL, NULL, NULL);
-	    if ((eax & 0xffff0000) == 0x80000000 && eax >= 0x80000001) {
-		cpuid(0x80000001, NULL, NULL, &ecx, &edx);
-		if (ecx & (1 << 0))
-		    feature_set_bit(LAHF64);
-		if (ecx & (1 << 1))
-		    feature_set_bit(CMP_LEGACY);
-		if (ecx & (1 << 2))
-		    feature_set_bit(SVM);
-		if (ecx & (1 << 3))
-		    feature_set_bit(EXTAPIC);
-		if (ecx & (1 << 4))
-		    feature_set_bit(CR8_LEGACY);
-		if (ecx & (1 << 5))
-		    feature_set_bit(ABM);
-		if (ecx & (1 << 6))
-		    feature_set_bit(SSE4A);
-		if (ecx & (1 << 7))
-		    feature_set_bit(MISALIGNSSE);
-		if (ecx & (1 << 8))
-		    feature_set_bit(3DNOW_PREFETCH);
-		if (ecx & (1 << 9))
-		    feature_set_bit(OSVW);
-		if (ecx & (1 << 10))
-		    feature_set_bit(IBS);
-		if (ecx & (1 << 11))
-		    feature_set_bit(SSE5);
-		if (ecx & (1 << 12))
-		    feature_set_bit(SKINIT);
-		if (ecx & (1 << 13))
-		    feature_set_bit(WDT);
-		if (ecx & (1 << 15))
-		    feature_set_bit(LWP);
-		if (ecx & (1 << 16))
-		    feature_set_bit(FMA4);
-		if (ecx & (1 << 19))
-		    feature_set_bit(NODEID_MSR);
-		if (ecx & (1 << 21))
-		    feature_set_bit(TBM);
-		if (ecx & (1 << 22))
-		    feature_set_bit(TOPOEXT);
-
-		if (edx & (1 << 20))
-		    feature_set_bit(NX);
-		// XXX not sure they are the same MMX extensions...
-		if (cpuinfo_get_vendor(cip) == CPUINFO_VENDOR_AMD && (edx & (1 << 22)))
-		    feature_set_bit(MMX_EXT);
-		if (cpuinfo_get_vendor(cip) == CPUINFO_VENDOR_CYRIX && (edx & (1 << 24)))
-		    feature_set_bit(MMX_EXT);
-		if (edx & (1 << 25))
-		    feature_set_bit(FFXSR);
-		if (edx & (1 << 26))
-		    feature_set_bit(PAGE1GB);		
-		if (edx & (1 << 27))
-		    feature_set_bit(RDTSCP);
-		if (edx & (1 << 29))
-		    feature_set_bit(LM);
-		if (edx & (1 << 30))
-		    feature_set_bit(3DNOW_EXT);
-		if (edx & (1 << 31))
-		    feature_set_bit(3DNOW);
-	    }
+	    x86_decode_features(cip);
 	}
 
 	if (bsf_clobbers_eflags())
@@ -1389,7 +2472,10 @@ int cpuinfo_arch_has_feature(struct cpuinfo *cip, unsigned long feature)
 		feature_get_bit(SSE4A) ||
 		feature_get_bit(SSE4_1) ||
 		feature_get_bit(SSE4_2) ||
-		feature_get_bit(SSE5))
+		feature_get_bit(SSE5) ||
+		feature_get_bit(AVX) ||
+		feature_get_bit(AVX2) ||
+		feature_get_bit(AVX512F))
 	  cpuinfo_feature_set_bit(cip, CPUINFO_FEATURE_SIMD);
 
 	if (feature_get_bit(POPCNT))
@@ -20,6 +20,8 @@
 
 #include "sysdeps.h"
 #include "cpuinfo.h"
+#include "writer.h"
+#include "feature-ranges.h"
 
 #define DEBUG 0
 #include "debug.h"
@@ -32,10 +34,67 @@ static void print_usage(const char *progname)
   printf("\n");
   printf("   -h --help               print this message\n");
   printf("   -d --debug [FILE]       dump debug information into FILE\n");
+  printf("   -c --cache              reuse results saved earlier during this boot\n");
+  printf("   -j --json               print all information as JSON\n");
+  printf("      --format=FORMAT      print all information as text, json or kv (key=value)\n");
+  printf("   -f --frequency          include the frequency in json and kv output\n");
+  printf("   -p --probe              include differences between logical CPUs in json and kv output\n");
+  printf("   -s --save FILE          save a binary snapshot into FILE instead of printing\n");
+  printf("   -r --raw                print raw CPUID leaves of every logical CPU, as 'cpuid -r'\n");
+  printf("   -m --measure-caches     also measure cache levels and latencies by timing loads\n");
+  printf("   -b --bandwidth          also measure memory bandwidth and latency under load\n");
+  printf("      --bandwidth-cpus=LIST  run bandwidth threads on logical CPUs LIST (e.g. 0-3,8)\n");
+  printf("      --bandwidth-node=NODE  bind memory of bandwidth threads to NUMA node NODE\n");
 }
 
-static void print_cpuinfo(struct cpuinfo *cip, FILE *out)
+// Options of output
+enum {
+  WRITE_FREQUENCY	= 1 << 0,	// may calibrate the processor frequency (structured output)
+  WRITE_PROBE		= 1 << 1,	// runs CPUID on every logical CPU (structured output)
+  WRITE_MEASURE_CACHES	= 1 << 2,	// times loads through working sets for seconds
+  WRITE_MEASURE_BANDWIDTH	= 1 << 3	// runs memory bound threads for seconds
+};
+
+// Threads and memory node of bandwidth measurements (NULL for the defaults)
+static cpuinfo_bandwidth_config_t *bandwidth_config;
+
+// Format a size in KB
+static const char *string_of_size(int size, char *str, int length)
+{
+  if (size >= 1024) {
+	if ((size % 1024) == 0)
+	  snprintf(str, length, "%d MB", size / 1024);
+	else
+	  snprintf(str, length, "%.2f MB", (double)size / 1024.0);
+  }
+  else
+	snprintf(str, length, "%d KB", size);
+  return str;
+}
+
+// Format a set of logical CPUs as a list of ranges, e.g. "0-3,8"
+static const char *string_of_cpuset(const cpuinfo_cpuset_t *set, char *str, int size)
 {
+  int cpu, n = 0;
+  str[0] = '\0';
+  for (cpu = 0; cpu < CPUINFO_CPUSET_SIZE && n < size; cpu++) {
+	if (!cpuinfo_cpuset_isset(set, cpu))
+	  continue;
+	int last = cpu;
+	while (cpuinfo_cpuset_isset(set, last + 1))
+	  last++;
+	if (last > cpu)
+	  n += snprintf(str + n, size - n, "%s%d-%d", n > 0 ? "," : "", cpu, last);
+	else
+	  n += snprintf(str + n, size - n, "%s%d", n > 0 ? "," : "", cpu);
+	cpu = last;
+  }
+  return str;
+}
+
+static void print_cpuinfo(struct cpuinfo *cip, FILE *out, int options)
+{
+  char size[32];
   int i, j;
 
   fprintf(out, "Processor Information\n");
@@ -74,52 +133,54 @@ static void print_cpuinfo(struct cpuinfo *cip, FILE *out)
 	  if (ccdp->level == 0 && ccdp->type == CPUINFO_CACHE_TYPE_TRACE)
 		fprintf(out, "  Instruction trace cache, %dK uOps", ccdp->size);
 	  else {
-		fprintf(out, "  L%d %s cache, ", ccdp->level, cpuinfo_string_of_cache_type(ccdp->type));
-		if (ccdp->size >= 1024) {
-		  if ((ccdp->size % 1024) == 0)
-			fprintf(out, "%d MB", ccdp->size / 1024);
-		  else
-			fprintf(out, "%.2f MB", (double)ccdp->size / 1024.0);
-		}
-		else
-		  fprintf(out, "%d KB", ccdp->size);
+		fprintf(out, "  L%d %s cache, %s", ccdp->level, cpuinfo_string_of_cache_type(ccdp->type),
+				string_of_size(ccdp->size, size, sizeof(size)));
 	  }
 	  fprintf(out, "\n");
 	}
   }
 #endif
 
+  const cpuinfo_cache_measurement_t *cmp;
+  if ((options & WRITE_MEASURE_CACHES) && (cmp = cpuinfo_measure_caches(cip)) != NULL) {
+	fprintf(out, "\n");
+	fprintf(out, "Measured Caches\n");
+	for (i = 0; i < cmp->count; i++) {
+	  const cpuinfo_measured_cache_t *mcp = &cmp->caches[i];
+	  fprintf(out, "  L%d %s cache, %s, %.1f ns", mcp->level, cpuinfo_string_of_cache_type(mcp->type),
+			  string_of_size(mcp->size, size, sizeof(size)), mcp->latency_ns);
+	  if (mcp->latency_cycles > 0)
+		fprintf(out, " (%.0f cycles)", mcp->latency_cycles);
+	  fprintf(out, "\n");
+	}
+	fprintf(out, "  Memory, %.1f ns", cmp->memory_latency_ns);
+	if (cmp->memory_latency_cycles > 0)
+	  fprintf(out, " (%.0f cycles)", cmp->memory_latency_cycles);
+	fprintf(out, "\n");
+  }
+
+  const cpuinfo_bandwidth_t *bp;
+  if ((options & WRITE_MEASURE_BANDWIDTH) && (bp = cpuinfo_measure_bandwidth(cip, bandwidth_config)) != NULL) {
+	char cpus[CPUINFO_CPUSET_SIZE * 5];
+	fprintf(out, "\n");
+	fprintf(out, "Memory Bandwidth\n");
+	fprintf(out, "  %d Thread%s on CPU%s %s, %s arrays", bp->n_threads, bp->n_threads > 1 ? "s" : "", bp->n_threads > 1 ? "s" : "",
+			string_of_cpuset(&bp->cpus, cpus, sizeof(cpus)), string_of_size(bp->size, size, sizeof(size)));
+	if (bp->node >= 0)
+	  fprintf(out, " on node %d", bp->node);
+	fprintf(out, "\n");
+	for (i = 0; i < CPUINFO_BANDWIDTH_KERNELS; i++)
+	  fprintf(out, "  %-12s %.0f MB/s\n", cpuinfo_string_of_bandwidth_kernel(i), bp->bandwidth[i]);
+	fprintf(out, "  Latency under load\n");
+	for (i = 0; i < bp->n_loaded_latencies; i++) {
+	  const cpuinfo_loaded_latency_t *llp = &bp->loaded_latencies[i];
+	  fprintf(out, "    %.0f MB/s, %.1f ns\n", llp->bandwidth, llp->latency_ns);
+	}
+  }
+
   fprintf(out, "\n");
   fprintf(out, "Processor Features\n");
 
-  static const struct {
-	int base;
-	int max;
-  } features_bits[] = {
-	{ CPUINFO_FEATURE_COMMON + 1, CPUINFO_FEATURE_COMMON_MAX },
-#if defined(__i386__) || defined(__x86_64__)
-	{ CPUINFO_FEATURE_X86, CPUINFO_FEATURE_X86_MAX },
-#endif
-#if defined(__ia64__)
-	{ CPUINFO_FEATURE_IA64, CPUINFO_FEATURE_IA64_MAX },
-#endif
-#if defined(__ppc__) || defined(__ppc64__)
-	{ CPUINFO_FEATURE_PPC, CPUINFO_FEATURE_PPC_MAX },
-#endif
-#if defined(__mips__) || defined(__mips64__)
-	{ CPUINFO_FEATURE_MIPS, CPUINFO_FEATURE_MIPS_MAX },
-#endif
-#if defined(__arm__)
-	{ CPUINFO_FEATURE_ARM, CPUINFO_FEATURE_ARM_MAX },
-#endif
-#if defined(__aarch64__)
-	{ CPUINFO_FEATURE_AARCH64_BEGIN, CPUINFO_FEATURE_AARCH64_MAX },
-#endif
-#if defined(__arm__) || defined(__aarch64__)
-	{ CPUINFO_FEATURE_ARM_CRYPTO_BEGIN, CPUINFO_FEATURE_ARM_CRYPTO_MAX },
-#endif
-	{ -1, 0 }
-  };
   for (i = 0; features_bits[i].base != -1; i++) {
 	int base = features_bits[i].base;
 	int count = features_bits[i].max - base;
@@ -139,11 +200,270 @@ static void print_cpuinfo(struct cpuinfo *cip, FILE *out)
   }
 }
 
+// Write everything known about the processor, with raw values and sizes in bytes
+static void write_cpuinfo(struct cpuinfo *cip, FILE *out, int format, int options)
+{
+  char cpus[CPUINFO_CPUSET_SIZE * 5];
+  writer_t w;
+  int i, j;
+
+  writer_init(&w, out, format);
+  writer_string(&w, "version", CPUINFO_VERSION);
+
+  int vendor = cpuinfo_get_vendor(cip);
+  writer_begin_object(&w, "vendor");
+  writer_int(&w, "id", vendor);
+  writer_string(&w, "name", cpuinfo_string_of_vendor(vendor));
+  writer_end(&w);
+  writer_string(&w, "model", cpuinfo_get_model(cip));
+  writer_int(&w, "microcode", cpuinfo_get_microcode(cip));
+
+  if (options & WRITE_FREQUENCY) {
+	int source;
+	writer_begin_object(&w, "frequency");
+	writer_int(&w, "mhz", cpuinfo_get_frequency(cip));
+	source = cpuinfo_get_frequency_source(cip);
+	writer_int(&w, "source_id", source);
+	writer_string(&w, "source", cpuinfo_string_of_frequency_source(source));
+	writer_int(&w, "confidence", cpuinfo_get_frequency_confidence(cip));
+	writer_end(&w);
+  }
+
+  int socket = cpuinfo_get_socket(cip);
+  writer_begin_object(&w, "socket");
+  writer_int(&w, "id", socket);
+  writer_string(&w, "name", cpuinfo_string_of_socket(socket));
+  writer_end(&w);
+  writer_int(&w, "cores", cpuinfo_get_cores(cip));
+  writer_int(&w, "threads", cpuinfo_get_threads(cip));
+
+  writer_begin_array(&w, "caches");
+  const cpuinfo_cache_t *ccp = cpuinfo_get_caches(cip);
+  for (i = 0; ccp && i < ccp->count; i++) {
+	const cpuinfo_cache_descriptor_t *ccdp = &ccp->descriptors[i];
+	const cpuinfo_cache_geometry_t *cgp = cpuinfo_get_cache_geometry(cip, i);
+	writer_begin_object(&w, NULL);
+	writer_int(&w, "level", ccdp->level);
+	writer_int(&w, "type_id", ccdp->type);
+	writer_string(&w, "type", cpuinfo_string_of_cache_type(ccdp->type));
+	if (ccdp->type == CPUINFO_CACHE_TYPE_TRACE)
+	  writer_int(&w, "uops", ccdp->size * 1024LL);
+	else
+	  writer_int(&w, "size", ccdp->size * 1024LL);
+	if (cgp) {
+	  writer_int(&w, "line_size", cgp->line_size);
+	  writer_int(&w, "ways", cgp->ways);
+	  writer_int(&w, "sets", cgp->sets);
+	  writer_int(&w, "partitions", cgp->partitions);
+	  writer_int(&w, "flags", cgp->flags);
+	}
+	writer_end(&w);
+  }
+  writer_end(&w);
+
+  const cpuinfo_cache_measurement_t *cmp;
+  if ((options & WRITE_MEASURE_CACHES) && (cmp = cpuinfo_measure_caches(cip)) != NULL) {
+	writer_begin_object(&w, "measured_caches");
+	writer_begin_array(&w, "levels");
+	for (i = 0; i < cmp->count; i++) {
+	  const cpuinfo_measured_cache_t *mcp = &cmp->caches[i];
+	  writer_begin_object(&w, NULL);
+	  writer_int(&w, "level", mcp->level);
+	  writer_int(&w, "type_id", mcp->type);
+	  writer_string(&w, "type", cpuinfo_string_of_cache_type(mcp->type));
+	  writer_int(&w, "size", mcp->size * 1024LL);
+	  writer_int(&w, "flags", mcp->flags);
+	  writer_double(&w, "latency_ns", mcp->latency_ns);
+	  writer_double(&w, "latency_cycles", mcp->latency_cycles);
+	  writer_end(&w);
+	}
+	writer_end(&w);
+	writer_begin_object(&w, "memory");
+	writer_double(&w, "latency_ns", cmp->memory_latency_ns);
+	writer_double(&w, "latency_cycles", cmp->memory_latency_cycles);
+	writer_end(&w);
+	writer_begin_array(&w, "samples");
+	for (i = 0; i < cmp->n_samples; i++) {
+	  writer_begin_object(&w, NULL);
+	  writer_int(&w, "size", cmp->samples[i].size * 1024LL);
+	  writer_double(&w, "latency_ns", cmp->samples[i].latency_ns);
+	  writer_end(&w);
+	}
+	writer_end(&w);
+	writer_end(&w);
+  }
+
+  const cpuinfo_bandwidth_t *bp;
+  if ((options & WRITE_MEASURE_BANDWIDTH) && (bp = cpuinfo_measure_bandwidth(cip, bandwidth_config)) != NULL) {
+	writer_begin_object(&w, "bandwidth");
+	writer_string(&w, "cpus", string_of_cpuset(&bp->cpus, cpus, sizeof(cpus)));
+	writer_int(&w, "n_threads", bp->n_threads);
+	writer_int(&w, "node", bp->node);
+	writer_int(&w, "size", bp->size * 1024LL);
+	writer_begin_object(&w, "kernels");
+	for (i = 0; i < CPUINFO_BANDWIDTH_KERNELS; i++)
+	  writer_double(&w, cpuinfo_string_of_bandwidth_kernel(i), bp->bandwidth[i]);
+	writer_end(&w);
+	writer_begin_array(&w, "loaded_latencies");
+	for (i = 0; i < bp->n_loaded_latencies; i++) {
+	  writer_begin_object(&w, NULL);
+	  writer_double(&w, "bandwidth", bp->loaded_latencies[i].bandwidth);
+	  writer_double(&w, "latency_ns", bp->loaded_latencies[i].latency_ns);
+	  writer_end(&w);
+	}
+	writer_end(&w);
+	writer_end(&w);
+  }
+
+  writer_begin_array(&w, "features");
+  for (i = 0; features_bits[i].base != -1; i++) {
+	int base = features_bits[i].base;
+	int count = features_bits[i].max - base;
+	for (j = 0; j < count; j++) {
+	  int feature = base + j;
+	  if (cpuinfo_has_feature(cip, feature)) {
+		const char *name = cpuinfo_string_of_feature(feature);
+		writer_begin_object(&w, NULL);
+		writer_int(&w, "id", feature);
+		writer_string(&w, "name", name ? name : "<unknown>");
+		writer_end(&w);
+	  }
+	}
+  }
+  writer_end(&w);
+
+  const cpuinfo_topology_t *tp = cpuinfo_get_topology(cip);
+  if (tp && tp->n_cpus > 0) {
+	writer_begin_object(&w, "topology");
+	writer_int(&w, "n_cpus", tp->n_cpus);
+	writer_int(&w, "n_packages", tp->n_packages);
+	writer_int(&w, "n_dies", tp->n_dies);
+	writer_int(&w, "n_cores", tp->n_cores);
+	writer_begin_array(&w, "cpus");
+	for (i = 0; i < tp->n_cpus; i++) {
+	  const cpuinfo_topology_cpu_t *tcp = &tp->cpus[i];
+	  writer_begin_object(&w, NULL);
+	  writer_int(&w, "cpu", tcp->cpu);
+	  writer_int(&w, "package", tcp->package);
+	  writer_int(&w, "die", tcp->die);
+	  writer_int(&w, "core", tcp->core);
+	  writer_int(&w, "thread", tcp->thread);
+	  writer_int(&w, "node", tcp->node);
+	  writer_string(&w, "core_class", cpuinfo_string_of_core_class(tcp->core_class));
+	  writer_int(&w, "capacity", tcp->capacity);
+	  writer_end(&w);
+	}
+	writer_end(&w);
+	writer_end(&w);
+  }
+
+  const cpuinfo_cache_instances_t *ip = cpuinfo_get_cache_instances(cip);
+  if (ip && ip->count > 0) {
+	writer_begin_array(&w, "cache_instances");
+	for (i = 0; i < ip->count; i++) {
+	  const cpuinfo_cache_instance_t *cinp = &ip->instances[i];
+	  writer_begin_object(&w, NULL);
+	  writer_int(&w, "id", cinp->id);
+	  writer_int(&w, "level", cinp->level);
+	  writer_string(&w, "type", cpuinfo_string_of_cache_type(cinp->type));
+	  writer_int(&w, "size", cinp->size * 1024LL);
+	  writer_string(&w, "cpus", string_of_cpuset(&cinp->cpus, cpus, sizeof(cpus)));
+	  writer_end(&w);
+	}
+	writer_end(&w);
+  }
+
+  const cpuinfo_numa_t *np = cpuinfo_get_numa_nodes(cip);
+  if (np && np->count > 0) {
+	writer_begin_array(&w, "numa_nodes");
+	for (i = 0; i < np->count; i++) {
+	  const cpuinfo_numa_node_t *nnp = &np->nodes[i];
+	  writer_begin_object(&w, NULL);
+	  writer_int(&w, "id", nnp->id);
+	  writer_string(&w, "cpus", string_of_cpuset(&nnp->cpus, cpus, sizeof(cpus)));
+	  writer_int(&w, "memory_total", nnp->memory_total * 1024LL);
+	  writer_int(&w, "memory_free", nnp->memory_free * 1024LL);
+	  if (np->distances) {
+		writer_begin_array(&w, "distances");
+		for (j = 0; j < np->count; j++)
+		  writer_int(&w, NULL, np->distances[i * np->count + j]);
+		writer_end(&w);
+	  }
+	  writer_end(&w);
+	}
+	writer_end(&w);
+  }
+
+  cpuinfo_parallelism_t p;
+  if (cpuinfo_get_parallelism(cip, &p) == 0) {
+	writer_begin_object(&w, "parallelism");
+	writer_string(&w, "cpus", string_of_cpuset(&p.cpus, cpus, sizeof(cpus)));
+	writer_int(&w, "n_cpus", p.n_cpus);
+	writer_double(&w, "budget", p.budget);
+	writer_end(&w);
+  }
+
+  if (options & WRITE_PROBE) {
+	int heterogeneity = cpuinfo_get_heterogeneity(cip);
+	writer_int(&w, "heterogeneity", heterogeneity);
+	// -1 when unknown, which has all bits set
+	if (heterogeneity > 0 && (heterogeneity & CPUINFO_HETEROGENEOUS_FEATURES) && tp) {
+	  // features not supported by all logical CPUs
+	  writer_begin_array(&w, "partial_features");
+	  for (i = 0; features_bits[i].base != -1; i++) {
+		for (j = features_bits[i].base; j < features_bits[i].max; j++) {
+		  cpuinfo_cpuset_t set;
+		  int n = cpuinfo_get_feature_cpus(cip, j, &set);
+		  if (n <= 0 || n == tp->n_cpus)
+			continue;
+		  writer_begin_object(&w, NULL);
+		  writer_int(&w, "id", j);
+		  writer_string(&w, "cpus", string_of_cpuset(&set, cpus, sizeof(cpus)));
+		  writer_end(&w);
+		}
+	  }
+	  writer_end(&w);
+	}
+  }
+
+  writer_finish(&w);
+}
+
+// Save a binary snapshot of the descriptor (-1 on error)
+static int save_cpuinfo(struct cpuinfo *cip, const char *filename)
+{
+  int size = cpuinfo_save(cip, NULL, 0);
+  if (size < 0)
+	return -1;
+  void *buf = malloc(size);
+  if (buf == NULL)
+	return -1;
+  int ret = -1;
+  FILE *fp = fopen(filename, "wb");
+  if (fp) {
+	if (cpuinfo_save(cip, buf, size) == size && fwrite(buf, size, 1, fp) == 1)
+	  ret = 0;
+	if (fclose(fp) != 0)
+	  ret = -1;
+  }
+  free(buf);
+  return ret;
+}
+
 int main(int argc, char *argv[])
 {
   int i;
   FILE *out;
   const char *out_filename = NULL;
+  const char *save_filename = NULL;
+  int use_cache = 0;
+  int raw = 0;
+  int format = -1; /* text */
+  int options = 0;
+  cpuinfo_bandwidth_config_t config;
+
+  memset(&config, 0, sizeof(config));
+  config.node = -1;
 
   for (i = 1; i < argc; i++) {
 	const char *arg = argv[i];
@@ -153,18 +473,85 @@ int main(int argc, char *argv[])
 	  else
 		out_filename = "-"; /* stdout */
 	}
+	else if (strcmp(arg, "-c") == 0 || strcmp(arg, "--cache") == 0)
+	  use_cache = 1;
+	else if (strcmp(arg, "-j") == 0 || strcmp(arg, "--json") == 0)
+	  format = WRITER_FORMAT_JSON;
+	else if (strncmp(arg, "--format=", 9) == 0) {
+	  if (strcmp(arg + 9, "json") == 0)
+		format = WRITER_FORMAT_JSON;
+	  else if (strcmp(arg + 9, "kv") == 0)
+		format = WRITER_FORMAT_KV;
+	  else if (strcmp(arg + 9, "text") == 0)
+		format = -1;
+	  else {
+		fprintf(stderr, "ERROR: unknown output format '%s'\n", arg + 9);
+		return 1;
+	  }
+	}
+	else if (strcmp(arg, "-f") == 0 || strcmp(arg, "--frequency") == 0)
+	  options |= WRITE_FREQUENCY;
+	else if (strcmp(arg, "-p") == 0 || strcmp(arg, "--probe") == 0)
+	  options |= WRITE_PROBE;
+	else if (strcmp(arg, "-s") == 0 || strcmp(arg, "--save") == 0) {
+	  if (++i >= argc) {
+		fprintf(stderr, "ERROR: missing snapshot file name\n");
+		return 1;
+	  }
+	  save_filename = argv[i];
+	}
+	else if (strcmp(arg, "-r") == 0 || strcmp(arg, "--raw") == 0)
+	  raw = 1;
+	else if (strcmp(arg, "-m") == 0 || strcmp(arg, "--measure-caches") == 0)
+	  options |= WRITE_MEASURE_CACHES;
+	else if (strcmp(arg, "-b") == 0 || strcmp(arg, "--bandwidth") == 0)
+	  options |= WRITE_MEASURE_BANDWIDTH;
+	else if (strncmp(arg, "--bandwidth-cpus=", 17) == 0) {
+	  bandwidth_config = &config;
+	  if (cpuinfo_cpuset_parse(arg + 17, &config.cpus) < 0) {
+		fprintf(stderr, "ERROR: invalid CPU list '%s'\n", arg + 17);
+		return 1;
+	  }
+	  options |= WRITE_MEASURE_BANDWIDTH;
+	}
+	else if (strncmp(arg, "--bandwidth-node=", 17) == 0) {
+	  bandwidth_config = &config;
+	  char *end;
+	  config.node = strtol(arg + 17, &end, 10);
+	  if (end == arg + 17 || *end != '\0' || config.node < 0) {
+		fprintf(stderr, "ERROR: invalid NUMA node '%s'\n", arg + 17);
+		return 1;
+	  }
+	  options |= WRITE_MEASURE_BANDWIDTH;
+	}
 	else if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
 	  print_usage(argv[0]);
 	  return 0;
 	}
   }
 
-  struct cpuinfo *cip = cpuinfo_new();
+  struct cpuinfo *cip = use_cache ? cpuinfo_new_cached() : cpuinfo_new();
   if (cip == NULL) {
 	fprintf(stderr, "ERROR: could not allocate cpuinfo descriptor\n");
 	return 1;
   }
 
+  if (save_filename) {
+	int ret = save_cpuinfo(cip, save_filename);
+	if (ret < 0)
+	  fprintf(stderr, "ERROR: could not save snapshot into '%s'\n", save_filename);
+	cpuinfo_destroy(cip);
+	return ret < 0 ? 2 : 0;
+  }
+
+  if (raw) {
+	int ret = cpuinfo_dump_raw(cip, stdout);
+	if (ret < 0)
+	  fprintf(stderr, "ERROR: no raw identification registers on this processor\n");
+	cpuinfo_destroy(cip);
+	return ret < 0 ? 2 : 0;
+  }
+
   if (out_filename == NULL || strcmp(out_filename, "-") == 0)
 	out = stdout;
   else {
@@ -177,7 +564,10 @@ int main(int argc, char *argv[])
   if (out_filename)
 	cpuinfo_set_debug_file(out);
 
-  print_cpuinfo(cip, out);
+  if (format < 0)
+	print_cpuinfo(cip, out, options);
+  else
+	write_cpuinfo(cip, out, format, options);
 
   if (out_filename) { /* debug mode */
 	fprintf(out, "\n### DEBUGGING INFORMATION ###\n\n");
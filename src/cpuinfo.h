@@ -37,6 +37,32 @@ extern void cpuinfo_destroy(cpuinfo_t *cip);
 // Dump all useful information for debugging
 extern int cpuinfo_dump(cpuinfo_t *cip, FILE *out);
 
+// Dump raw identification registers of every logical CPU (-1 if unsupported).
+// On x86, CPUID leaves in the format of 'cpuid -r', which can be replayed
+// instead of executing CPUID by naming the dump in $CPUINFO_CPUID_DUMP
+extern int cpuinfo_dump_raw(cpuinfo_t *cip, FILE *out);
+
+// Save a fully determined descriptor into BUF if SIZE is large enough
+// (returns the snapshot size, -1 on error)
+extern int cpuinfo_save(cpuinfo_t *cip, void *buf, int size);
+
+// Create a descriptor from a snapshot saved by the same library build, on a
+// machine of the same byte order (NULL if invalid). The snapshot, e.g. a
+// mapped file, is used in place and must outlive the descriptor
+extern cpuinfo_t *cpuinfo_load(const void *buf, int size);
+
+// Returns a new cpuinfo descriptor, reusing the results saved by a previous
+// call during this boot, on the same CPUs and microcode. Results are saved
+// in $CPUINFO_CACHE_DIR, $XDG_RUNTIME_DIR/cpuinfo or /run/cpuinfo
+extern cpuinfo_t *cpuinfo_new_cached(void);
+
+// Read system information below ROOT instead of /sys or /proc, e.g. from a
+// tree copied off another machine (-1 if ROOT is too long). NULL restores
+// $CPUINFO_SYSFS_ROOT or $CPUINFO_PROCFS_ROOT, or else the system trees.
+// Not thread-safe: descriptors created afterwards use the new roots
+extern int cpuinfo_set_sysfs_root(const char *root);
+extern int cpuinfo_set_procfs_root(const char *root);
+
 /* ========================================================================= */
 /* == General Processor Information                                       == */
 /* ========================================================================= */
@@ -89,9 +115,24 @@ typedef enum {
   CPUINFO_SOCKET_S1
 } cpuinfo_socket_t;
 
+// Processor frequency source
+typedef enum {
+  CPUINFO_FREQUENCY_SOURCE_UNKNOWN,
+  CPUINFO_FREQUENCY_SOURCE_CPUID,			// Reported by the processor
+  CPUINFO_FREQUENCY_SOURCE_HYPERVISOR,		// Reported by the hypervisor
+  CPUINFO_FREQUENCY_SOURCE_CALIBRATION,		// Measured against a system clock
+  CPUINFO_FREQUENCY_SOURCE_OS				// Reported by the OS or firmware
+} cpuinfo_frequency_source_t;
+
 // Get processor frequency in MHz
 extern int cpuinfo_get_frequency(cpuinfo_t *cip);
 
+// Get how the processor frequency was determined
+extern int cpuinfo_get_frequency_source(cpuinfo_t *cip);
+
+// Get confidence in the processor frequency, in percent
+extern int cpuinfo_get_frequency_confidence(cpuinfo_t *cip);
+
 // Get processor socket ID
 extern int cpuinfo_get_socket(cpuinfo_t *cip);
 
@@ -101,6 +142,111 @@ extern int cpuinfo_get_cores(cpuinfo_t *cip);
 // Get number of threads per CPU core
 extern int cpuinfo_get_threads(cpuinfo_t *cip);
 
+// Get microcode revision, as reported by the OS (0 if unknown)
+extern unsigned int cpuinfo_get_microcode(cpuinfo_t *cip);
+
+/* ========================================================================= */
+/* == Logical CPU Sets                                                    == */
+/* ========================================================================= */
+
+#define CPUINFO_CPUSET_SIZE 4096	// max number of logical CPUs in a set
+
+typedef struct {
+  unsigned int bits[CPUINFO_CPUSET_SIZE / 32];
+} cpuinfo_cpuset_t;
+
+// Returns 1 if the logical CPU is in the set
+static inline int cpuinfo_cpuset_isset(const cpuinfo_cpuset_t *set, int cpu)
+{
+  if (cpu < 0 || cpu >= CPUINFO_CPUSET_SIZE)
+	return 0;
+  return (set->bits[cpu / 32] >> (cpu % 32)) & 1;
+}
+
+// Get number of logical CPUs in the set
+extern int cpuinfo_cpuset_count(const cpuinfo_cpuset_t *set);
+
+// Get the lowest logical CPU of the set (-1 if empty)
+extern int cpuinfo_cpuset_first(const cpuinfo_cpuset_t *set);
+
+// Parse a CPU list ("0-3,8,10-11") into SET (returns the number of CPUs, -1 if none)
+extern int cpuinfo_cpuset_parse(const char *str, cpuinfo_cpuset_t *set);
+
+/* ========================================================================= */
+/* == Processor Topology                                                  == */
+/* ========================================================================= */
+
+// Core classes of hybrid processors
+typedef enum {
+  CPUINFO_CORE_CLASS_UNKNOWN,
+  CPUINFO_CORE_CLASS_PERFORMANCE,	// big cores, or all cores of regular processors
+  CPUINFO_CORE_CLASS_EFFICIENCY		// little cores
+} cpuinfo_core_class_t;
+
+typedef struct {
+  int cpu;		// logical CPU number, as used by the OS
+  int package;	// package ID
+  int die;		// die ID within the package
+  int core;		// core ID within the die
+  int thread;	// SMT thread ID within the core
+  int node;		// NUMA node ID
+  int core_class;	// core class (above)
+  int capacity;	// relative capacity, 1024 for the fastest CPUs
+} cpuinfo_topology_cpu_t;
+
+typedef struct {
+  int n_cpus;		// number of logical CPUs
+  int n_packages;	// number of packages
+  int n_dies;		// number of dies, in all packages
+  int n_cores;		// number of cores, in all packages
+  const cpuinfo_topology_cpu_t *cpus;	// logical CPUs, sorted by CPU number
+} cpuinfo_topology_t;
+
+// Get logical CPUs topology (returns read-only records)
+extern const cpuinfo_topology_t *cpuinfo_get_topology(cpuinfo_t *cip);
+
+// Get logical CPUs with the highest capacity (returns the number of CPUs)
+extern int cpuinfo_get_fastest_cpus(cpuinfo_t *cip, cpuinfo_cpuset_t *set);
+
+/* ========================================================================= */
+/* == Usable Parallelism                                                  == */
+/* ========================================================================= */
+
+typedef struct {
+  cpuinfo_cpuset_t cpus;	// logical CPUs the calling thread may run on
+  int n_cpus;				// number of logical CPUs in the set
+  double budget;			// CPU time available, in CPUs (n_cpus if not throttled)
+} cpuinfo_parallelism_t;
+
+// Get logical CPUs and CPU time available, from affinity and cgroup limits (-1 on error)
+extern int cpuinfo_get_parallelism(cpuinfo_t *cip, cpuinfo_parallelism_t *pp);
+
+// Get number of threads worth running in parallel (at least 1)
+extern int cpuinfo_get_usable_cpus(cpuinfo_t *cip);
+
+/* ========================================================================= */
+/* == NUMA Nodes                                                          == */
+/* ========================================================================= */
+
+typedef struct {
+  int id;						// node ID, as used by the OS
+  cpuinfo_cpuset_t cpus;		// logical CPUs of the node
+  unsigned long long memory_total;	// total memory in KB
+  unsigned long long memory_free;	// free memory in KB, at discovery time
+} cpuinfo_numa_node_t;
+
+typedef struct {
+  int count;	// number of nodes
+  const cpuinfo_numa_node_t *nodes;		// sorted by node ID
+  const int *distances;	// SLIT distance from nodes[i] to nodes[j] at [i * count + j]
+} cpuinfo_numa_t;
+
+// Get NUMA nodes (returns read-only descriptors)
+extern const cpuinfo_numa_t *cpuinfo_get_numa_nodes(cpuinfo_t *cip);
+
+// Get distance between two NUMA nodes, by node ID (-1 if unknown)
+extern int cpuinfo_get_numa_distance(cpuinfo_t *cip, int from, int to);
+
 /* ========================================================================= */
 /* == Processor Caches Information                                        == */
 /* ========================================================================= */
@@ -127,6 +273,122 @@ typedef struct {
 // Get cache information (returns read-only descriptors)
 extern const cpuinfo_cache_t *cpuinfo_get_caches(cpuinfo_t *cip);
 
+// Cache properties
+enum {
+  CPUINFO_CACHE_FLAG_SELF_INITIALIZING	= 1 << 0,	// no software initialization needed
+  CPUINFO_CACHE_FLAG_FULLY_ASSOCIATIVE	= 1 << 1,	// any line can hold any address
+  CPUINFO_CACHE_FLAG_INCLUSIVE			= 1 << 2,	// includes lower cache levels
+  CPUINFO_CACHE_FLAG_NON_INCLUSIVE		= 1 << 3,	// does not include lower cache levels
+  CPUINFO_CACHE_FLAG_COMPLEX_INDEXING	= 1 << 4,	// set index hashed from address bits
+  CPUINFO_CACHE_FLAG_MEASURED			= 1 << 5	// found by timing loads, not reported
+};
+
+typedef struct {
+  int type;			// cache type
+  int level;		// cache level
+  int size;			// cache size in KB
+  int line_size;	// line size in bytes (0 if unknown)
+  int ways;			// ways of associativity (0 if unknown)
+  int sets;			// number of sets (0 if unknown)
+  int partitions;	// physical line partitions (0 if unknown)
+  int flags;		// cache properties (above)
+} cpuinfo_cache_geometry_t;
+
+// Get geometry of the cache described by cpuinfo_get_caches()->descriptors[INDEX]
+// (returns a read-only descriptor, NULL if INDEX is out of range)
+extern const cpuinfo_cache_geometry_t *cpuinfo_get_cache_geometry(cpuinfo_t *cip, int index);
+
+typedef struct {
+  int id;		// instance ID, unique among caches of the same level and type
+  int type;		// cache type
+  int level;	// cache level
+  int size;		// cache size in KB
+  cpuinfo_cpuset_t cpus;	// logical CPUs sharing this cache instance
+} cpuinfo_cache_instance_t;
+
+typedef struct {
+  int count;	// number of cache instances
+  const cpuinfo_cache_instance_t *instances;	// sorted by level, type and ID
+} cpuinfo_cache_instances_t;
+
+// Get cache instances and the logical CPUs sharing each of them
+// (returns read-only descriptors)
+extern const cpuinfo_cache_instances_t *cpuinfo_get_cache_instances(cpuinfo_t *cip);
+
+// Cache level found by timing loads. Level 1 is assumed to be a data cache
+// and the levels beyond unified ones
+typedef struct {
+  int type;					// cache type
+  int level;				// cache level
+  int size;					// cache size in KB, the largest working set at its latency
+  int flags;				// cache properties, CPUINFO_CACHE_FLAG_MEASURED
+  double latency_ns;		// load-to-use latency in ns
+  double latency_cycles;	// load-to-use latency in cycles at cpuinfo_get_frequency() (0 if unknown)
+} cpuinfo_measured_cache_t;
+
+typedef struct {
+  int size;					// working set in KB
+  double latency_ns;		// average latency of dependent loads
+} cpuinfo_latency_sample_t;
+
+typedef struct {
+  int count;				// number of cache levels found
+  const cpuinfo_measured_cache_t *caches;	// sorted by level
+  double memory_latency_ns;	// latency beyond the last cache level
+  double memory_latency_cycles;
+  int n_samples;			// number of working sets timed
+  const cpuinfo_latency_sample_t *samples;	// sorted by working set size
+} cpuinfo_cache_measurement_t;
+
+// Measure caches by chasing pointers in random order through working sets
+// of 4 KB to 4 times the largest reported cache, on the calling CPU. Takes
+// seconds the first time (returns read-only results, NULL on error)
+extern const cpuinfo_cache_measurement_t *cpuinfo_measure_caches(cpuinfo_t *cip);
+
+/* ========================================================================= */
+/* == Memory Bandwidth                                                    == */
+/* ========================================================================= */
+
+// Bandwidth kernels, as in STREAM, on arrays of doubles
+typedef enum {
+  CPUINFO_BANDWIDTH_READ,		// s += a[i]
+  CPUINFO_BANDWIDTH_COPY,		// c[i] = a[i]
+  CPUINFO_BANDWIDTH_SCALE,		// b[i] = q * c[i]
+  CPUINFO_BANDWIDTH_ADD,		// c[i] = a[i] + b[i]
+  CPUINFO_BANDWIDTH_TRIAD,		// a[i] = b[i] + q * c[i]
+  CPUINFO_BANDWIDTH_COPY_NT,	// copy with non-temporal stores
+  CPUINFO_BANDWIDTH_TRIAD_NT,	// triad with non-temporal stores
+  CPUINFO_BANDWIDTH_KERNELS
+} cpuinfo_bandwidth_kernel_t;
+
+typedef struct {
+  cpuinfo_cpuset_t cpus;	// logical CPUs to run one thread on each (empty for all usable CPUs)
+  int node;					// NUMA node to bind memory to (-1 for memory local to each thread)
+} cpuinfo_bandwidth_config_t;
+
+typedef struct {
+  double bandwidth;			// background traffic in MB/s
+  double latency_ns;		// average latency of dependent loads from memory
+} cpuinfo_loaded_latency_t;
+
+typedef struct {
+  cpuinfo_cpuset_t cpus;	// logical CPUs the threads ran on
+  int n_threads;			// number of threads, one per logical CPU
+  int node;					// NUMA node memory was bound to (-1 if local to each thread)
+  int size;					// size of each array of a thread in KB
+  double bandwidth[CPUINFO_BANDWIDTH_KERNELS];	// best sustained bandwidth in MB/s, by kernel
+  int n_loaded_latencies;
+  const cpuinfo_loaded_latency_t *loaded_latencies;	// from idle to full background traffic
+} cpuinfo_bandwidth_t;
+
+// Measure memory bandwidth of all threads running the STREAM kernels on
+// arrays 4 times the largest reported cache, then the latency seen by the
+// first CPU while the others read memory at increasing rates. Traffic is
+// counted as STREAM does, without write-allocate reads. Takes seconds; the
+// results with CONFIG set to NULL are kept (returns read-only results, NULL
+// on error)
+extern const cpuinfo_bandwidth_t *cpuinfo_measure_bandwidth(cpuinfo_t *cip, const cpuinfo_bandwidth_config_t *config);
+
 /* ========================================================================= */
 /* == Processor Features Information                                      == */
 /* ========================================================================= */
@@ -146,95 +408,13 @@ typedef enum {
   CPUINFO_FEATURE_COMMON_MAX,
 
   CPUINFO_FEATURE_X86	= CPUINFO_CLASS('X'),
-  CPUINFO_FEATURE_X86_AC,
-  CPUINFO_FEATURE_X86_CPUID,
-  CPUINFO_FEATURE_X86_FPU,
-  CPUINFO_FEATURE_X86_VME,
-  CPUINFO_FEATURE_X86_DE,
-  CPUINFO_FEATURE_X86_PSE,
-  CPUINFO_FEATURE_X86_TSC,
-  CPUINFO_FEATURE_X86_MSR,
-  CPUINFO_FEATURE_X86_PAE,
-  CPUINFO_FEATURE_X86_MCE,
-  CPUINFO_FEATURE_X86_CX8,
-  CPUINFO_FEATURE_X86_APIC,
-  CPUINFO_FEATURE_X86_SEP,
-  CPUINFO_FEATURE_X86_MTRR,
-  CPUINFO_FEATURE_X86_PGE,
-  CPUINFO_FEATURE_X86_MCA,
-  CPUINFO_FEATURE_X86_CMOV,
-  CPUINFO_FEATURE_X86_PAT,
-  CPUINFO_FEATURE_X86_PSE_36,
-  CPUINFO_FEATURE_X86_PSN,
-  CPUINFO_FEATURE_X86_CLFLUSH,
-  CPUINFO_FEATURE_X86_DS,
-  CPUINFO_FEATURE_X86_ACPI,
-  CPUINFO_FEATURE_X86_FXSR,
-  CPUINFO_FEATURE_X86_SS,
-  CPUINFO_FEATURE_X86_HTT,
-  CPUINFO_FEATURE_X86_IA64,
-  CPUINFO_FEATURE_X86_PBE,
-  CPUINFO_FEATURE_X86_MMX,
-  CPUINFO_FEATURE_X86_MMX_EXT,
-  CPUINFO_FEATURE_X86_3DNOW,
-  CPUINFO_FEATURE_X86_3DNOW_EXT,
-  CPUINFO_FEATURE_X86_3DNOW_PREFETCH,  
-  CPUINFO_FEATURE_X86_SSE,
-  CPUINFO_FEATURE_X86_SSE2,
-  CPUINFO_FEATURE_X86_SSE3,
-  CPUINFO_FEATURE_X86_SSSE3,
-  CPUINFO_FEATURE_X86_SSE4_1,
-  CPUINFO_FEATURE_X86_SSE4_2,
-  CPUINFO_FEATURE_X86_SSE4A,
-  CPUINFO_FEATURE_X86_SSE5,
-  CPUINFO_FEATURE_X86_MISALIGNSSE,
-  CPUINFO_FEATURE_X86_VMX,
-  CPUINFO_FEATURE_X86_SVM,
-  CPUINFO_FEATURE_X86_LM,
-  CPUINFO_FEATURE_X86_LAHF64,
-  CPUINFO_FEATURE_X86_POPCNT,
-  CPUINFO_FEATURE_X86_TSC_DEADLINE,
-  CPUINFO_FEATURE_X86_ABM,
-  CPUINFO_FEATURE_X86_BSFCC,
-  CPUINFO_FEATURE_X86_TM,
-  CPUINFO_FEATURE_X86_TM2,
-  CPUINFO_FEATURE_X86_EIST,
-  CPUINFO_FEATURE_X86_NX,
-  CPUINFO_FEATURE_X86_DTES64,
-  CPUINFO_FEATURE_X86_MONITOR,
-  CPUINFO_FEATURE_X86_DS_CPL,
-  CPUINFO_FEATURE_X86_SMX,
-  CPUINFO_FEATURE_X86_CNXT_ID,
-  CPUINFO_FEATURE_X86_CX16,
-  CPUINFO_FEATURE_X86_XTPR,
-  CPUINFO_FEATURE_X86_PDCM,
-  CPUINFO_FEATURE_X86_PCID,
-  CPUINFO_FEATURE_X86_DCA,
-  CPUINFO_FEATURE_X86_X2APIC,
-  CPUINFO_FEATURE_X86_MOVBE,
-  CPUINFO_FEATURE_X86_XSAVE,
-  CPUINFO_FEATURE_X86_OSXSAVE,
-  CPUINFO_FEATURE_X86_PCLMULQDQ,
-  CPUINFO_FEATURE_X86_FMA,
-  CPUINFO_FEATURE_X86_AES,
-  CPUINFO_FEATURE_X86_AVX,
-  CPUINFO_FEATURE_X86_F16C,
-  CPUINFO_FEATURE_X86_HYPERVISOR,
-  CPUINFO_FEATURE_X86_CMP_LEGACY,
-  CPUINFO_FEATURE_X86_EXTAPIC,
-  CPUINFO_FEATURE_X86_CR8_LEGACY,
-  CPUINFO_FEATURE_X86_OSVW,
-  CPUINFO_FEATURE_X86_IBS,
-  CPUINFO_FEATURE_X86_SKINIT,
-  CPUINFO_FEATURE_X86_WDT,
-  CPUINFO_FEATURE_X86_LWP,
-  CPUINFO_FEATURE_X86_FMA4,
-  CPUINFO_FEATURE_X86_NODEID_MSR,
-  CPUINFO_FEATURE_X86_TBM,
-  CPUINFO_FEATURE_X86_TOPOEXT,
-  CPUINFO_FEATURE_X86_FFXSR,
-  CPUINFO_FEATURE_X86_PAGE1GB,
-  CPUINFO_FEATURE_X86_RDTSCP,
+#define CPUINFO_X86_CPUID_REG(SLOT, LEAF, SUBLEAF, REG)
+#define CPUINFO_X86_FEATURE(ID, NAME, DETAIL, SLOT, BIT, VENDORS, XSTATE) CPUINFO_FEATURE_X86_##ID,
+#define CPUINFO_X86_FEATURE_ALT(ID, SLOT, BIT, VENDORS, XSTATE)
+#include "cpuinfo-x86-features.h"
+#undef CPUINFO_X86_FEATURE_ALT
+#undef CPUINFO_X86_FEATURE
+#undef CPUINFO_X86_CPUID_REG
   CPUINFO_FEATURE_X86_MAX,
   
   CPUINFO_FEATURE_IA64	= CPUINFO_CLASS('I'),
@@ -324,10 +504,93 @@ extern cpuinfo_feature_t cpuinfo_feature_common,
 // Returns 1 if CPU supports the specified feature
 extern int cpuinfo_has_feature(cpuinfo_t *cip, int feature);
 
+/* ========================================================================= */
+/* == Heterogeneous Processors                                            == */
+/* ========================================================================= */
+
+// Differences between logical CPUs, as seen by executing CPUID on each of them
+enum {
+  CPUINFO_HETEROGENEOUS_MODEL			= 1 << 0,	// family, model or stepping
+  CPUINFO_HETEROGENEOUS_FEATURES		= 1 << 1,	// supported features
+  CPUINFO_HETEROGENEOUS_CACHES			= 1 << 2,	// cache parameters
+  CPUINFO_HETEROGENEOUS_CORE_CLASSES	= 1 << 3,	// core classes of hybrid processors
+};
+
+// Get differences between logical CPUs (0 if all alike, -1 if unknown)
+extern int cpuinfo_get_heterogeneity(cpuinfo_t *cip);
+
+// Get logical CPUs supporting the specified feature (returns the number of CPUs)
+extern int cpuinfo_get_feature_cpus(cpuinfo_t *cip, int feature, cpuinfo_cpuset_t *set);
+
+/* ========================================================================= */
+/* == Process-wide Features Snapshot                                      == */
+/* ========================================================================= */
+
+// Number of 32-bit words in the snapshot (one bit per feature ID)
+#define CPUINFO_FEATURE_SNAPSHOT_WORDS \
+		(((CPUINFO_FEATURE_ARCH | CPUINFO_FEATURE_MASK) + 1) / 32)
+
+// Read-only features bitmap, indexed by feature ID. Bit CPUINFO_FEATURE_COMMON
+// is set once the snapshot is complete (use cpuinfo_has_feature_fast()).
+// CPUINFO_FEATURE_64BIT depends on the process persona, it is not part of it
+extern const unsigned int cpuinfo_feature_snapshot[];
+
+// Initialize the process-wide features snapshot (thread-safe, runs once)
+extern void cpuinfo_features_init(void);
+
+// Returns 1 if CPU supports the specified feature (out-of-line version)
+extern int cpuinfo_has_feature_slow(int feature);
+
+// Returns 1 if CPU supports the specified feature, initializing the
+// snapshot on first use. Present features cost one load and a bit test,
+// CPUINFO_FEATURE_64BIT is checked against the persona on every call
+static inline int cpuinfo_has_feature_fast(int feature)
+{
+#if defined __GNUC__
+  if (feature == CPUINFO_FEATURE_64BIT)
+	return cpuinfo_has_feature_slow(feature);
+  const unsigned int i = (unsigned int)feature & (CPUINFO_FEATURE_ARCH | CPUINFO_FEATURE_MASK);
+  const unsigned int m = 1U << (i % 32);
+  if (__atomic_load_n(&cpuinfo_feature_snapshot[i / 32], __ATOMIC_RELAXED) & m)
+	return 1;
+  if (__atomic_load_n(&cpuinfo_feature_snapshot[0], __ATOMIC_ACQUIRE) & 1)
+	return (cpuinfo_feature_snapshot[i / 32] & m) != 0;
+#endif
+  return cpuinfo_has_feature_slow(feature);
+}
+
+/* ========================================================================= */
+/* == Function Multi-Versioning                                           == */
+/* ========================================================================= */
+
+typedef struct cpuinfo_dispatcher cpuinfo_dispatcher_t;
+typedef void (*cpuinfo_function_t)(void);
+
+// Allocate a new dispatcher (NAME is used for debug logging)
+extern cpuinfo_dispatcher_t *cpuinfo_dispatcher_new(const char *name);
+
+// Release the dispatcher and all registered candidates
+extern void cpuinfo_dispatcher_destroy(cpuinfo_dispatcher_t *dp);
+
+// Register a candidate implementation, usable if the CPU supports all
+// the features of the zero-terminated list. Higher priorities win
+extern int cpuinfo_dispatcher_add(cpuinfo_dispatcher_t *dp, const char *name,
+								  cpuinfo_function_t func, int priority, ...);
+
+// Get the best candidate supported by the CPU (NULL if none). The choice
+// is made once and cached, later calls are a single atomic load
+extern cpuinfo_function_t cpuinfo_dispatcher_resolve(cpuinfo_dispatcher_t *dp);
+
+// Get the name of the resolved candidate (NULL if none)
+extern const char *cpuinfo_dispatcher_get_name(cpuinfo_dispatcher_t *dp);
+
 // Utility functions to convert IDs
 extern const char *cpuinfo_string_of_vendor(int vendor);
 extern const char *cpuinfo_string_of_socket(int socket);
+extern const char *cpuinfo_string_of_frequency_source(int source);
+extern const char *cpuinfo_string_of_core_class(int core_class);
 extern const char *cpuinfo_string_of_cache_type(int cache_type);
+extern const char *cpuinfo_string_of_bandwidth_kernel(int kernel);
 extern const char *cpuinfo_string_of_feature(int feature);
 extern const char *cpuinfo_string_of_feature_detail(int feature);
 
@@ -0,0 +1,54 @@
+/*
+ *  feature-ranges.h - Feature ID ranges reported by the tools
+ *
+ *  cpuinfo (C) 2006-2007 Gwenole Beauchesne
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef FEATURE_RANGES_H
+#define FEATURE_RANGES_H
+
+// Features to report, by ranges of feature IDs
+static const struct {
+  int base;
+  int max;
+} features_bits[] = {
+  { CPUINFO_FEATURE_COMMON + 1, CPUINFO_FEATURE_COMMON_MAX },
+#if defined(__i386__) || defined(__x86_64__)
+  { CPUINFO_FEATURE_X86, CPUINFO_FEATURE_X86_MAX },
+#endif
+#if defined(__ia64__)
+  { CPUINFO_FEATURE_IA64, CPUINFO_FEATURE_IA64_MAX },
+#endif
+#if defined(__ppc__) || defined(__ppc64__)
+  { CPUINFO_FEATURE_PPC, CPUINFO_FEATURE_PPC_MAX },
+#endif
+#if defined(__mips__) || defined(__mips64__)
+  { CPUINFO_FEATURE_MIPS, CPUINFO_FEATURE_MIPS_MAX },
+#endif
+#if defined(__arm__)
+  { CPUINFO_FEATURE_ARM, CPUINFO_FEATURE_ARM_MAX },
+#endif
+#if defined(__aarch64__)
+  { CPUINFO_FEATURE_AARCH64_BEGIN, CPUINFO_FEATURE_AARCH64_MAX },
+#endif
+#if defined(__arm__) || defined(__aarch64__)
+  { CPUINFO_FEATURE_ARM_CRYPTO_BEGIN, CPUINFO_FEATURE_ARM_CRYPTO_MAX },
+#endif
+  { -1, 0 }
+};
+
+#endif /* FEATURE_RANGES_H */
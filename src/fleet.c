@@ -0,0 +1,851 @@
+/*
+ *  fleet.c - Aggregate processor information of many hosts
+ *
+ *  cpuinfo (C) 2006-2007 Gwenole Beauchesne
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "sysdeps.h"
+#include <ctype.h>
+#include "cpuinfo.h"
+#include "writer.h"
+#include "feature-ranges.h"
+
+static void print_usage(const char *progname)
+{
+  printf("cpuinfo-fleet, aggregate processor information of many hosts.  Version %s\n", CPUINFO_VERSION);
+  printf("\n");
+  printf("  usage: %s [<options>] FILE...\n", progname);
+  printf("         %s [<options>] --diff FILE1 FILE2\n", progname);
+  printf("\n");
+  printf("   -h --help               print this message\n");
+  printf("   -j --json               print results as JSON\n");
+  printf("      --diff               compare two hosts\n");
+  printf("\n");
+  printf("  FILEs are written by 'cpuinfo --json' or 'cpuinfo --save'\n");
+}
+
+/* ========================================================================= */
+/* == JSON Parser                                                         == */
+/* ========================================================================= */
+
+// Enough to read back the output of 'cpuinfo --json'
+
+enum {
+  JSON_NULL,
+  JSON_BOOLEAN,
+  JSON_NUMBER,
+  JSON_STRING,
+  JSON_ARRAY,
+  JSON_OBJECT
+};
+
+#define JSON_DEPTH_MAX 32
+
+typedef struct json_value json_value_t;
+struct json_value {
+  int type;
+  double number;				// number or boolean value
+  char *string;					// string value
+  int count;					// number of elements or members
+  json_value_t **values;		// elements or member values
+  char **keys;					// member names
+};
+
+static void json_free(json_value_t *vp)
+{
+  int i;
+  if (vp == NULL)
+	return;
+  for (i = 0; i < vp->count; i++) {
+	json_free(vp->values[i]);
+	if (vp->keys)
+	  free(vp->keys[i]);
+  }
+  free(vp->values);
+  free(vp->keys);
+  free(vp->string);
+  free(vp);
+}
+
+static const char *json_skip_spaces(const char *p)
+{
+  while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')
+	p++;
+  return p;
+}
+
+// Parse a string, P points after the opening quote (NULL on error)
+static char *json_parse_string(const char **pp)
+{
+  const char *p = *pp;
+  int n = 0, size = 64;
+  char *str = (char *)malloc(size);
+  if (str == NULL)
+	return NULL;
+  while (*p != '"') {
+	int c = (unsigned char)*p++;
+	if (c == '\0')
+	  goto error;
+	if (c == '\\') {
+	  switch (c = *p++) {
+	  case 'b': c = '\b'; break;
+	  case 'f': c = '\f'; break;
+	  case 'n': c = '\n'; break;
+	  case 'r': c = '\r'; break;
+	  case 't': c = '\t'; break;
+	  case 'u':
+		// only control characters are escaped by the writer
+		if (!isxdigit(p[0]) || !isxdigit(p[1]) || !isxdigit(p[2]) || !isxdigit(p[3]))
+		  goto error;
+		c = strtol((char[]){ p[0], p[1], p[2], p[3], '\0' }, NULL, 16);
+		if (c > 0x7f)
+		  c = '?';
+		p += 4;
+		break;
+	  case '"': case '\\': case '/':
+		break;
+	  default:
+		goto error;
+	  }
+	}
+	if (n + 1 >= size) {
+	  char *new_str = (char *)realloc(str, size *= 2);
+	  if (new_str == NULL)
+		goto error;
+	  str = new_str;
+	}
+	str[n++] = c;
+  }
+  str[n] = '\0';
+  *pp = p + 1;
+  return str;
+
+ error:
+  free(str);
+  return NULL;
+}
+
+// Append an element or member to a container (-1 on error)
+static int json_append(json_value_t *vp, char *key, json_value_t *value)
+{
+  if ((vp->count & (vp->count - 1)) == 0) {
+	int size = vp->count ? vp->count * 2 : 4;
+	json_value_t **values = (json_value_t **)realloc(vp->values, size * sizeof(*values));
+	if (values == NULL)
+	  return -1;
+	vp->values = values;
+	if (vp->type == JSON_OBJECT) {
+	  char **keys = (char **)realloc(vp->keys, size * sizeof(*keys));
+	  if (keys == NULL)
+		return -1;
+	  vp->keys = keys;
+	}
+  }
+  vp->values[vp->count] = value;
+  if (vp->keys)
+	vp->keys[vp->count] = key;
+  vp->count++;
+  return 0;
+}
+
+static json_value_t *json_parse_value(const char **pp, int depth)
+{
+  const char *p = json_skip_spaces(*pp);
+  json_value_t *vp = (json_value_t *)calloc(1, sizeof(*vp));
+  if (vp == NULL)
+	return NULL;
+
+  if (*p == '{' || *p == '[') {
+	int is_object = *p++ == '{';
+	vp->type = is_object ? JSON_OBJECT : JSON_ARRAY;
+	if (depth >= JSON_DEPTH_MAX)
+	  goto error;
+	p = json_skip_spaces(p);
+	if (*p == (is_object ? '}' : ']'))
+	  p++;
+	else {
+	  for (;;) {
+		char *key = NULL;
+		if (is_object) {
+		  p = json_skip_spaces(p);
+		  if (*p++ != '"' || (key = json_parse_string(&p)) == NULL)
+			goto error;
+		  p = json_skip_spaces(p);
+		  if (*p++ != ':') {
+			free(key);
+			goto error;
+		  }
+		}
+		json_value_t *value = json_parse_value(&p, depth + 1);
+		if (value == NULL || json_append(vp, key, value) < 0) {
+		  json_free(value);
+		  free(key);
+		  goto error;
+		}
+		p = json_skip_spaces(p);
+		if (*p == ',')
+		  p++;
+		else if (*p++ == (is_object ? '}' : ']'))
+		  break;
+		else
+		  goto error;
+	  }
+	}
+  }
+  else if (*p == '"') {
+	p++;
+	vp->type = JSON_STRING;
+	if ((vp->string = json_parse_string(&p)) == NULL)
+	  goto error;
+  }
+  else if (strncmp(p, "true", 4) == 0 || strncmp(p, "false", 5) == 0) {
+	vp->type = JSON_BOOLEAN;
+	vp->number = *p == 't';
+	p += *p == 't' ? 4 : 5;
+  }
+  else if (strncmp(p, "null", 4) == 0) {
+	vp->type = JSON_NULL;
+	p += 4;
+  }
+  else {
+	char *end;
+	vp->type = JSON_NUMBER;
+	vp->number = strtod(p, &end);
+	if (end == p)
+	  goto error;
+	p = end;
+  }
+  *pp = p;
+  return vp;
+
+ error:
+  json_free(vp);
+  return NULL;
+}
+
+// Parse a whole document (NULL on error)
+static json_value_t *json_parse(const char *str)
+{
+  const char *p = str;
+  json_value_t *vp = json_parse_value(&p, 0);
+  if (vp && *json_skip_spaces(p) != '\0') {
+	json_free(vp);
+	vp = NULL;
+  }
+  return vp;
+}
+
+// Get member KEY of an object (NULL if none)
+static const json_value_t *json_get(const json_value_t *vp, const char *key)
+{
+  int i;
+  if (vp == NULL || vp->type != JSON_OBJECT)
+	return NULL;
+  for (i = 0; i < vp->count; i++) {
+	if (strcmp(vp->keys[i], key) == 0)
+	  return vp->values[i];
+  }
+  return NULL;
+}
+
+static const char *json_get_string(const json_value_t *vp, const char *key)
+{
+  vp = json_get(vp, key);
+  return vp && vp->type == JSON_STRING ? vp->string : NULL;
+}
+
+static double json_get_number(const json_value_t *vp, const char *key)
+{
+  vp = json_get(vp, key);
+  return vp && vp->type == JSON_NUMBER ? vp->number : 0;
+}
+
+/* ========================================================================= */
+/* == Name Tables                                                         == */
+/* ========================================================================= */
+
+// Distinct names with the number of hosts they were seen on
+
+#define TABLE_BUCKETS 1024
+
+typedef struct {
+  int count;					// number of names
+  int size;						// allocated names
+  char **names;
+  int *hosts;					// number of hosts per name
+  int *next;					// next name in the same bucket
+  int buckets[TABLE_BUCKETS];	// first name of each bucket (-1 if none)
+} table_t;
+
+static void table_init(table_t *tp)
+{
+  int i;
+  tp->count = tp->size = 0;
+  tp->names = NULL;
+  tp->hosts = tp->next = NULL;
+  for (i = 0; i < TABLE_BUCKETS; i++)
+	tp->buckets[i] = -1;
+}
+
+static void table_destroy(table_t *tp)
+{
+  int i;
+  for (i = 0; i < tp->count; i++)
+	free(tp->names[i]);
+  free(tp->names);
+  free(tp->hosts);
+  free(tp->next);
+}
+
+static unsigned int table_hash(const char *name)
+{
+  unsigned int hash = 2166136261u;
+  while (*name)
+	hash = (hash ^ (unsigned char)*name++) * 16777619u;
+  return hash % TABLE_BUCKETS;
+}
+
+// Get index of NAME, adding it if needed (-1 on error)
+static int table_lookup(table_t *tp, const char *name)
+{
+  unsigned int hash = table_hash(name);
+  int i;
+  for (i = tp->buckets[hash]; i >= 0; i = tp->next[i]) {
+	if (strcmp(tp->names[i], name) == 0)
+	  return i;
+  }
+  if (tp->count == tp->size) {
+	int size = tp->size ? tp->size * 2 : 64;
+	char **names = (char **)realloc(tp->names, size * sizeof(*names));
+	if (names == NULL)
+	  return -1;
+	tp->names = names;
+	int *hosts = (int *)realloc(tp->hosts, size * sizeof(*hosts));
+	if (hosts == NULL)
+	  return -1;
+	tp->hosts = hosts;
+	int *next = (int *)realloc(tp->next, size * sizeof(*next));
+	if (next == NULL)
+	  return -1;
+	tp->next = next;
+	tp->size = size;
+  }
+  if ((tp->names[tp->count] = strdup(name)) == NULL)
+	return -1;
+  tp->hosts[tp->count] = 0;
+  tp->next[tp->count] = tp->buckets[hash];
+  tp->buckets[hash] = tp->count;
+  return tp->count++;
+}
+
+// Sort names by decreasing number of hosts, then by order of appearance
+static const table_t *table_sort_table;
+
+static int table_sort_compare(const void *a, const void *b)
+{
+  int i = *(const int *)a, j = *(const int *)b;
+  int d = table_sort_table->hosts[j] - table_sort_table->hosts[i];
+  return d ? d : i - j;
+}
+
+// Get indexes of the names in the order above (NULL on error)
+static int *table_sort(const table_t *tp)
+{
+  int i, *order = (int *)malloc((tp->count + 1) * sizeof(*order));
+  if (order == NULL)
+	return NULL;
+  for (i = 0; i < tp->count; i++)
+	order[i] = i;
+  table_sort_table = tp;
+  qsort(order, tp->count, sizeof(*order), table_sort_compare);
+  return order;
+}
+
+/* ========================================================================= */
+/* == Hosts                                                               == */
+/* ========================================================================= */
+
+typedef struct {
+  const char *name;				// file the host was read from
+  char *vendor;
+  char *model;
+  unsigned int microcode;		// microcode revision (0 if unknown)
+  char caches[256];				// cache geometry, e.g. "L1d 48K/12w/64B L2 2M/16w/64B"
+  int n_features;
+  int *features;				// indexes in the features table
+} host_t;
+
+// Append a cache to the cache geometry of the host
+static void host_add_cache(host_t *hp, int level, int type, int size, int ways, int line_size)
+{
+  static const char *suffixes[] = { "", "d", "i", "", "t" };
+  int n = strlen(hp->caches);
+  char str[64];
+  if (size >= 1024 && (size % 1024) == 0)
+	snprintf(str, sizeof(str), "%dM", size / 1024);
+  else
+	snprintf(str, sizeof(str), "%dK", size);
+  snprintf(hp->caches + n, sizeof(hp->caches) - n, "%sL%d%s %s/%dw/%dB", n > 0 ? " " : "",
+		   level, type >= 0 && type <= CPUINFO_CACHE_TYPE_TRACE ? suffixes[type] : "?",
+		   str, ways, line_size);
+}
+
+// Add a feature to the host (-1 on error)
+static int host_add_feature(host_t *hp, table_t *features, const char *name)
+{
+  int index = table_lookup(features, name);
+  if (index < 0)
+	return -1;
+  if ((hp->n_features & (hp->n_features - 1)) == 0) {
+	int size = hp->n_features ? hp->n_features * 2 : 64;
+	int *new_features = (int *)realloc(hp->features, size * sizeof(*new_features));
+	if (new_features == NULL)
+	  return -1;
+	hp->features = new_features;
+  }
+  hp->features[hp->n_features++] = index;
+  return 0;
+}
+
+// Fill in the host from a snapshot written by 'cpuinfo --save' (-1 on error)
+static int host_init_snapshot(host_t *hp, table_t *features, const char *data, int size)
+{
+  int i, j;
+  cpuinfo_t *cip = cpuinfo_load(data, size);
+  if (cip == NULL)
+	return -1;
+  hp->vendor = strdup(cpuinfo_string_of_vendor(cpuinfo_get_vendor(cip)));
+  hp->model = strdup(cpuinfo_get_model(cip));
+  hp->microcode = cpuinfo_get_microcode(cip);
+  const cpuinfo_cache_t *ccp = cpuinfo_get_caches(cip);
+  for (i = 0; ccp && i < ccp->count; i++) {
+	const cpuinfo_cache_geometry_t *cgp = cpuinfo_get_cache_geometry(cip, i);
+	host_add_cache(hp, cgp->level, cgp->type, cgp->size, cgp->ways, cgp->line_size);
+  }
+  for (i = 0; features_bits[i].base != -1; i++) {
+	for (j = features_bits[i].base; j < features_bits[i].max; j++) {
+	  const char *name = cpuinfo_string_of_feature(j);
+	  if (name && cpuinfo_has_feature(cip, j) && host_add_feature(hp, features, name) < 0)
+		break;
+	}
+  }
+  cpuinfo_destroy(cip);
+  return 0;
+}
+
+// Fill in the host from the output of 'cpuinfo --json' (-1 on error)
+static int host_init_json(host_t *hp, table_t *features, const char *data)
+{
+  int i;
+  json_value_t *root = json_parse(data);
+  if (root == NULL)
+	return -1;
+  const char *str = json_get_string(json_get(root, "vendor"), "name");
+  hp->vendor = strdup(str ? str : "<unknown>");
+  str = json_get_string(root, "model");
+  hp->model = strdup(str ? str : "<unknown>");
+  hp->microcode = json_get_number(root, "microcode");
+  const json_value_t *vp = json_get(root, "caches");
+  for (i = 0; vp && vp->type == JSON_ARRAY && i < vp->count; i++) {
+	const json_value_t *cp = vp->values[i];
+	int size = json_get_number(cp, "size") / 1024;
+	if (json_get(cp, "uops"))
+	  size = json_get_number(cp, "uops") / 1024;
+	host_add_cache(hp, json_get_number(cp, "level"), json_get_number(cp, "type_id"), size,
+				   json_get_number(cp, "ways"), json_get_number(cp, "line_size"));
+  }
+  vp = json_get(root, "features");
+  for (i = 0; vp && vp->type == JSON_ARRAY && i < vp->count; i++) {
+	const char *name = json_get_string(vp->values[i], "name");
+	if (name && host_add_feature(hp, features, name) < 0)
+	  break;
+  }
+  json_free(root);
+  return 0;
+}
+
+// Read a host from FILENAME (-1 on error)
+static int host_init(host_t *hp, table_t *features, const char *filename)
+{
+  memset(hp, 0, sizeof(*hp));
+  hp->name = filename;
+
+  FILE *fp = fopen(filename, "rb");
+  if (fp == NULL) {
+	fprintf(stderr, "ERROR: could not open '%s'\n", filename);
+	return -1;
+  }
+  int size = 0, max_size = 0, error = 0;
+  char *data = NULL;
+  for (;;) {
+	if (max_size - size < 4096) {
+	  char *new_data = (char *)realloc(data, (max_size += 65536) + 1);
+	  if (new_data == NULL) {
+		error = 1;
+		break;
+	  }
+	  data = new_data;
+	}
+	int n = fread(data + size, 1, max_size - size, fp);
+	if (n <= 0)
+	  break;
+	size += n;
+  }
+  if (ferror(fp))
+	error = 1;
+  fclose(fp);
+
+  // snapshots start with "CPUINFO", the malloc()ed buffer is suitably aligned
+  int ret = -1;
+  if (!error) {
+	data[size] = '\0';
+	if (size >= 8 && memcmp(data, "CPUINFO", 8) == 0)
+	  ret = host_init_snapshot(hp, features, data, size);
+	else
+	  ret = host_init_json(hp, features, data);
+  }
+  free(data);
+  if (ret < 0)
+	fprintf(stderr, "ERROR: '%s' is not a usable snapshot or JSON report\n", filename);
+  return ret;
+}
+
+static void host_destroy(host_t *hp)
+{
+  free(hp->vendor);
+  free(hp->model);
+  free(hp->features);
+}
+
+// Returns 1 if the host has the feature of the specified index
+static int host_has_feature(const host_t *hp, int index)
+{
+  int i;
+  for (i = 0; i < hp->n_features; i++) {
+	if (hp->features[i] == index)
+	  return 1;
+  }
+  return 0;
+}
+
+/* ========================================================================= */
+/* == Fleet Report                                                        == */
+/* ========================================================================= */
+
+typedef struct {
+  int n_hosts;
+  table_t features;
+  table_t caches;				// cache geometries
+  table_t microcodes;			// "revision model" strings
+} fleet_t;
+
+static void fleet_init(fleet_t *fp)
+{
+  fp->n_hosts = 0;
+  table_init(&fp->features);
+  table_init(&fp->caches);
+  table_init(&fp->microcodes);
+}
+
+static void fleet_destroy(fleet_t *fp)
+{
+  table_destroy(&fp->features);
+  table_destroy(&fp->caches);
+  table_destroy(&fp->microcodes);
+}
+
+// Account for a host (-1 on error)
+static int fleet_add_host(fleet_t *fp, const host_t *hp)
+{
+  char str[512];
+  int i, index;
+  for (i = 0; i < hp->n_features; i++)
+	fp->features.hosts[hp->features[i]]++;
+  if ((index = table_lookup(&fp->caches, hp->caches)) < 0)
+	return -1;
+  fp->caches.hosts[index]++;
+  snprintf(str, sizeof(str), "%08x %s", hp->microcode, hp->model);
+  if ((index = table_lookup(&fp->microcodes, str)) < 0)
+	return -1;
+  fp->microcodes.hosts[index]++;
+  fp->n_hosts++;
+  return 0;
+}
+
+static void print_fleet(const fleet_t *fp, FILE *out)
+{
+  const table_t *tp = &fp->features;
+  int i, n, *order;
+
+  fprintf(out, "Hosts: %d\n", fp->n_hosts);
+
+  // in order of appearance, i.e. feature IDs order of the first host
+  for (i = n = 0; i < tp->count; i++)
+	n += tp->hosts[i] == fp->n_hosts;
+  fprintf(out, "\nCommon features (%d)\n", n);
+  for (i = 0; i < tp->count; i++) {
+	if (tp->hosts[i] == fp->n_hosts)
+	  fprintf(out, "  %s\n", tp->names[i]);
+  }
+
+  fprintf(out, "\nPartial features (%d), lost with the common baseline\n", tp->count - n);
+  if ((order = table_sort(tp)) != NULL) {
+	for (i = 0; i < tp->count; i++) {
+	  int j = order[i];
+	  if (tp->hosts[j] < fp->n_hosts)
+		fprintf(out, "  %-16s %6d hosts, %5.1f%%\n", tp->names[j], tp->hosts[j],
+				100.0 * tp->hosts[j] / fp->n_hosts);
+	}
+	free(order);
+  }
+
+  tp = &fp->caches;
+  fprintf(out, "\nCache geometries (%d)\n", tp->count);
+  if ((order = table_sort(tp)) != NULL) {
+	for (i = 0; i < tp->count; i++)
+	  fprintf(out, "  %6d hosts  %s\n", tp->hosts[order[i]], tp->names[order[i]]);
+	free(order);
+  }
+
+  tp = &fp->microcodes;
+  fprintf(out, "\nMicrocode revisions (%d)\n", tp->count);
+  if ((order = table_sort(tp)) != NULL) {
+	for (i = 0; i < tp->count; i++) {
+	  const char *str = tp->names[order[i]];
+	  fprintf(out, "  %6d hosts  0x%.8s  %s\n", tp->hosts[order[i]], str, str + 9);
+	}
+	free(order);
+  }
+}
+
+static void write_fleet(const fleet_t *fp, FILE *out)
+{
+  const table_t *tp = &fp->features;
+  writer_t w;
+  int i, *order;
+
+  writer_init(&w, out, WRITER_FORMAT_JSON);
+  writer_int(&w, "hosts", fp->n_hosts);
+
+  writer_begin_array(&w, "common_features");
+  for (i = 0; i < tp->count; i++) {
+	if (tp->hosts[i] == fp->n_hosts)
+	  writer_string(&w, NULL, tp->names[i]);
+  }
+  writer_end(&w);
+
+  writer_begin_array(&w, "features");
+  if ((order = table_sort(tp)) != NULL) {
+	for (i = 0; i < tp->count; i++) {
+	  writer_begin_object(&w, NULL);
+	  writer_string(&w, "name", tp->names[order[i]]);
+	  writer_int(&w, "hosts", tp->hosts[order[i]]);
+	  writer_end(&w);
+	}
+	free(order);
+  }
+  writer_end(&w);
+
+  tp = &fp->caches;
+  writer_begin_array(&w, "cache_geometries");
+  if ((order = table_sort(tp)) != NULL) {
+	for (i = 0; i < tp->count; i++) {
+	  writer_begin_object(&w, NULL);
+	  writer_string(&w, "caches", tp->names[order[i]]);
+	  writer_int(&w, "hosts", tp->hosts[order[i]]);
+	  writer_end(&w);
+	}
+	free(order);
+  }
+  writer_end(&w);
+
+  tp = &fp->microcodes;
+  writer_begin_array(&w, "microcodes");
+  if ((order = table_sort(tp)) != NULL) {
+	for (i = 0; i < tp->count; i++) {
+	  const char *str = tp->names[order[i]];
+	  writer_begin_object(&w, NULL);
+	  writer_string(&w, "model", str + 9);
+	  writer_int(&w, "revision", strtoul(str, NULL, 16));
+	  writer_int(&w, "hosts", tp->hosts[order[i]]);
+	  writer_end(&w);
+	}
+	free(order);
+  }
+  writer_end(&w);
+
+  writer_finish(&w);
+}
+
+// Aggregate hosts one at a time, none is kept in memory
+static int do_fleet(int n_files, char *files[], int json)
+{
+  fleet_t fleet;
+  int i, ret = 0;
+
+  fleet_init(&fleet);
+  for (i = 0; i < n_files; i++) {
+	host_t host;
+	if (host_init(&host, &fleet.features, files[i]) < 0 || fleet_add_host(&fleet, &host) < 0)
+	  ret = 2;
+	host_destroy(&host);
+  }
+  if (fleet.n_hosts > 0) {
+	if (json)
+	  write_fleet(&fleet, stdout);
+	else
+	  print_fleet(&fleet, stdout);
+  }
+  fleet_destroy(&fleet);
+  return ret;
+}
+
+/* ========================================================================= */
+/* == Hosts Comparison                                                    == */
+/* ========================================================================= */
+
+// Compare two hosts (returns 1 if they differ, like diff(1))
+static int do_diff(const char *file1, const char *file2, int json)
+{
+  table_t features;
+  host_t hosts[2];
+  writer_t w;
+  int i, j, n_diffs = 0;
+
+  table_init(&features);
+  int ret1 = host_init(&hosts[0], &features, file1);
+  int ret2 = host_init(&hosts[1], &features, file2);
+  if (ret1 < 0 || ret2 < 0) {
+	host_destroy(&hosts[0]);
+	host_destroy(&hosts[1]);
+	table_destroy(&features);
+	return 2;
+  }
+
+  const struct {
+	const char *name;
+	const char *values[2];
+  } fields[] = {
+	{ "vendor", { hosts[0].vendor, hosts[1].vendor } },
+	{ "model", { hosts[0].model, hosts[1].model } },
+	{ "caches", { hosts[0].caches, hosts[1].caches } },
+  };
+  char microcodes[2][16];
+  for (i = 0; i < 2; i++)
+	snprintf(microcodes[i], sizeof(microcodes[i]), "0x%x", hosts[i].microcode);
+
+  if (json) {
+	writer_init(&w, stdout, WRITER_FORMAT_JSON);
+	writer_begin_array(&w, "hosts");
+	writer_string(&w, NULL, file1);
+	writer_string(&w, NULL, file2);
+	writer_end(&w);
+  }
+  else {
+	printf("--- %s\n", file1);
+	printf("+++ %s\n", file2);
+  }
+
+  for (i = 0; i < (int)(sizeof(fields) / sizeof(fields[0])); i++) {
+	if (strcmp(fields[i].values[0], fields[i].values[1]) == 0)
+	  continue;
+	n_diffs++;
+	if (json) {
+	  writer_begin_array(&w, fields[i].name);
+	  writer_string(&w, NULL, fields[i].values[0]);
+	  writer_string(&w, NULL, fields[i].values[1]);
+	  writer_end(&w);
+	}
+	else
+	  printf("  %s: %s -> %s\n", fields[i].name, fields[i].values[0], fields[i].values[1]);
+  }
+  if (hosts[0].microcode != hosts[1].microcode) {
+	n_diffs++;
+	if (json) {
+	  writer_begin_array(&w, "microcode");
+	  writer_int(&w, NULL, hosts[0].microcode);
+	  writer_int(&w, NULL, hosts[1].microcode);
+	  writer_end(&w);
+	}
+	else
+	  printf("  microcode: %s -> %s\n", microcodes[0], microcodes[1]);
+  }
+
+  // features of one host but not of the other
+  static const char *keys[2] = { "removed_features", "added_features" };
+  for (i = 0; i < 2; i++) {
+	const host_t *hp = &hosts[i], *other = &hosts[1 - i];
+	if (json)
+	  writer_begin_array(&w, keys[i]);
+	for (j = 0; j < hp->n_features; j++) {
+	  int index = hp->features[j];
+	  if (host_has_feature(other, index))
+		continue;
+	  n_diffs++;
+	  if (json)
+		writer_string(&w, NULL, features.names[index]);
+	  else
+		printf("%c %s\n", i == 0 ? '-' : '+', features.names[index]);
+	}
+	if (json)
+	  writer_end(&w);
+  }
+
+  if (json)
+	writer_finish(&w);
+
+  for (i = 0; i < 2; i++)
+	host_destroy(&hosts[i]);
+  table_destroy(&features);
+  return n_diffs > 0;
+}
+
+int main(int argc, char *argv[])
+{
+  int i, n_files = 0;
+  int json = 0, diff = 0;
+  char **files = (char **)malloc(argc * sizeof(*files));
+  if (files == NULL)
+	return 2;
+
+  for (i = 1; i < argc; i++) {
+	const char *arg = argv[i];
+	if (strcmp(arg, "-j") == 0 || strcmp(arg, "--json") == 0)
+	  json = 1;
+	else if (strcmp(arg, "--diff") == 0)
+	  diff = 1;
+	else if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+	  print_usage(argv[0]);
+	  free(files);
+	  return 0;
+	}
+	else
+	  files[n_files++] = argv[i];
+  }
+
+  int ret;
+  if (diff ? n_files != 2 : n_files == 0) {
+	print_usage(argv[0]);
+	ret = 2;
+  }
+  else if (diff)
+	ret = do_diff(files[0], files[1], json);
+  else
+	ret = do_fleet(n_files, files, json);
+  free(files);
+  return ret;
+}
@@ -0,0 +1,200 @@
+/*
+ *  writer.c - Streaming structured output
+ *
+ *  cpuinfo (C) 2006-2007 Gwenole Beauchesne
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "sysdeps.h"
+#include "writer.h"
+#include <math.h>
+
+// Values are written as soon as they are known, nothing is buffered
+
+static void json_indent(writer_t *wp)
+{
+  int i;
+  for (i = 0; i < wp->depth; i++)
+	fputs("  ", wp->out);
+}
+
+static void json_string(writer_t *wp, const char *str)
+{
+  fputc('"', wp->out);
+  for (; *str; str++) {
+	unsigned char c = *str;
+	if (c == '"' || c == '\\')
+	  fprintf(wp->out, "\\%c", c);
+	else if (c == '\n')
+	  fputs("\\n", wp->out);
+	else if (c == '\t')
+	  fputs("\\t", wp->out);
+	else if (c < 0x20)
+	  fprintf(wp->out, "\\u%04x", c);
+	else
+	  fputc(c, wp->out);
+  }
+  fputc('"', wp->out);
+}
+
+// Start a new value of the innermost container
+// (JSON: writes the separator and the key, KV: writes the path)
+static void begin_value(writer_t *wp, const char *key)
+{
+  int n = wp->stack[wp->depth].path_length;
+  char index[16];
+  if (wp->stack[wp->depth].is_array) {
+	snprintf(index, sizeof(index), "%d", wp->stack[wp->depth].count);
+	key = index;
+  }
+  wp->stack[wp->depth].count++;
+
+  if (wp->format == WRITER_FORMAT_JSON) {
+	fputs(wp->stack[wp->depth].count > 1 ? ",\n" : "\n", wp->out);
+	wp->depth++;
+	json_indent(wp);
+	wp->depth--;
+	if (!wp->stack[wp->depth].is_array) {
+	  json_string(wp, key);
+	  fputs(": ", wp->out);
+	}
+  }
+  else {
+	// truncated paths are still unique enough to be useful
+	if (key)
+	  snprintf(wp->path + n, sizeof(wp->path) - n, "%s%s", n > 0 ? "." : "", key);
+	else
+	  wp->path[n] = '\0';
+  }
+}
+
+static void begin_container(writer_t *wp, const char *key, int is_array)
+{
+  // drop the whole subtree, so that the matching writer_end() is not
+  // taken as the end of the parent
+  if (wp->skipped > 0 || wp->depth + 1 >= WRITER_DEPTH_MAX) {
+	wp->skipped++;
+	return;
+  }
+  begin_value(wp, key);
+  if (wp->format == WRITER_FORMAT_JSON)
+	fputc(is_array ? '[' : '{', wp->out);
+  wp->depth++;
+  wp->stack[wp->depth].is_array = is_array;
+  wp->stack[wp->depth].count = 0;
+  wp->stack[wp->depth].path_length = strlen(wp->path);
+}
+
+void writer_init(writer_t *wp, FILE *out, int format)
+{
+  wp->out = out;
+  wp->format = format;
+  wp->depth = 0;
+  wp->skipped = 0;
+  wp->stack[0].is_array = 0;
+  wp->stack[0].count = 0;
+  wp->stack[0].path_length = 0;
+  wp->path[0] = '\0';
+  if (wp->format == WRITER_FORMAT_JSON)
+	fputc('{', wp->out);
+}
+
+void writer_finish(writer_t *wp)
+{
+  while (wp->depth > 0 || wp->skipped > 0)
+	writer_end(wp);
+  if (wp->format == WRITER_FORMAT_JSON)
+	fputs("\n}\n", wp->out);
+  fflush(wp->out);
+}
+
+void writer_begin_object(writer_t *wp, const char *key)
+{
+  begin_container(wp, key, 0);
+}
+
+void writer_begin_array(writer_t *wp, const char *key)
+{
+  begin_container(wp, key, 1);
+}
+
+void writer_end(writer_t *wp)
+{
+  if (wp->skipped > 0) {
+	wp->skipped--;
+	return;
+  }
+  if (wp->depth == 0)
+	return;
+  int is_array = wp->stack[wp->depth].is_array;
+  int count = wp->stack[wp->depth].count;
+  wp->depth--;
+  if (wp->format == WRITER_FORMAT_JSON) {
+	if (count > 0) {
+	  fputc('\n', wp->out);
+	  wp->depth++;
+	  json_indent(wp);
+	  wp->depth--;
+	}
+	fputc(is_array ? ']' : '}', wp->out);
+  }
+  wp->path[wp->stack[wp->depth].path_length] = '\0';
+}
+
+void writer_int(writer_t *wp, const char *key, long long value)
+{
+  if (wp->skipped > 0)
+	return;
+  begin_value(wp, key);
+  if (wp->format == WRITER_FORMAT_JSON)
+	fprintf(wp->out, "%lld", value);
+  else
+	fprintf(wp->out, "%s=%lld\n", wp->path, value);
+}
+
+void writer_double(writer_t *wp, const char *key, double value)
+{
+  if (wp->skipped > 0)
+	return;
+  begin_value(wp, key);
+  if (wp->format == WRITER_FORMAT_JSON && !isfinite(value))
+	fputs("null", wp->out);				// JSON has no NaN nor infinities
+  else if (wp->format == WRITER_FORMAT_JSON)
+	fprintf(wp->out, "%.6g", value);
+  else
+	fprintf(wp->out, "%s=%.6g\n", wp->path, value);
+}
+
+void writer_string(writer_t *wp, const char *key, const char *value)
+{
+  if (wp->skipped > 0)
+	return;
+  begin_value(wp, key);
+  if (wp->format == WRITER_FORMAT_JSON)
+	json_string(wp, value);
+  else {
+	fprintf(wp->out, "%s=", wp->path);
+	for (; *value; value++) {
+	  if (*value == '\n')
+		fputs("\\n", wp->out);
+	  else if (*value == '\\')
+		fputs("\\\\", wp->out);
+	  else
+		fputc(*value, wp->out);
+	}
+	fputc('\n', wp->out);
+  }
+}
@@ -0,0 +1,64 @@
+/*
+ *  writer.h - Streaming structured output
+ *
+ *  cpuinfo (C) 2006-2007 Gwenole Beauchesne
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef WRITER_H
+#define WRITER_H
+
+// Output formats
+enum {
+  WRITER_FORMAT_JSON,		// one JSON document
+  WRITER_FORMAT_KV			// one "path=value" line per value, e.g. caches.0.level=1
+};
+
+#define WRITER_DEPTH_MAX 16
+#define WRITER_PATH_MAX 256
+
+typedef struct {
+  FILE *out;
+  int format;
+  int depth;
+  int skipped;				// containers too deep to be written, with their values
+  struct {
+	int is_array;			// otherwise, an object
+	int count;				// number of values written so far
+	int path_length;		// length of the path of this container
+  } stack[WRITER_DEPTH_MAX];
+  char path[WRITER_PATH_MAX];
+} writer_t;
+
+// Start a document, whose root is an object
+extern void writer_init(writer_t *wp, FILE *out, int format);
+
+// Finish the document
+extern void writer_finish(writer_t *wp);
+
+// Open a container (KEY is NULL for array elements)
+extern void writer_begin_object(writer_t *wp, const char *key);
+extern void writer_begin_array(writer_t *wp, const char *key);
+
+// Close the innermost container
+extern void writer_end(writer_t *wp);
+
+// Write a value (KEY is NULL for array elements)
+extern void writer_int(writer_t *wp, const char *key, long long value);
+extern void writer_double(writer_t *wp, const char *key, double value);
+extern void writer_string(writer_t *wp, const char *key, const char *value);
+
+#endif /* WRITER_H */